@@ -6,11 +6,14 @@
 namespace madrona::phys {
 
 struct ObjectManager;
+class PhysicsLoader;
 
 }
 
 namespace madrona::phys::broadphase {
 
+// Negative for entities bound to a shared static tree, which have no leaf
+// in their world's BVH
 struct LeafID {
     int32_t id;
 };
@@ -20,23 +23,52 @@ public:
     BVH(const ObjectManager *obj_mgr,
         CountT max_leaves,
         float leaf_velocity_expansion,
-        float leaf_accel_expansion);
+        float leaf_accel_expansion,
+        float rebuild_cost_threshold = 1.5f);
 
     inline LeafID reserveLeaf(Entity e, base::ObjectID obj_id);
     inline math::AABB getLeafAABB(LeafID leaf_id) const;
 
+    // Includes entities bound to the shared static tree
     template <typename Fn>
     inline void findIntersecting(const math::AABB &aabb, Fn &&fn) const;
 
+    // Only this world's leaves
     template <typename Fn>
     inline void findLeafIntersecting(LeafID leaf_id, Fn &&fn) const;
 
+    // Only the shared static tree
+    template <typename Fn>
+    inline void findStaticIntersecting(const math::AABB &aabb,
+                                       Fn &&fn) const;
+
+    // Static colliders identical in every world can be put in one read-only
+    // tree (built with PhysicsLoader::buildStaticBVH) that all worlds query
+    // instead of each world's BVH holding, refitting and rebuilding its own
+    // leaves for them. Each world still has entities for the static
+    // colliders (for narrowphase and the solver), bound to the tree's
+    // leaves with bindStaticEntity. Queries on this BVH (findIntersecting,
+    // traceRay, traceOcclusion) also search the static tree.
+    void setStaticTree(const BVH *static_tree);
+
+    // static_idx is the collider's index in the instances passed to
+    // PhysicsLoader::buildStaticBVH. Every static_idx must be bound.
+    inline LeafID bindStaticEntity(Entity e, CountT static_idx);
+
     Entity traceRay(math::Vector3 o,
                     math::Vector3 d,
                     float *out_hit_t,
                     math::Vector3 *out_hit_normal,
                     float t_max = float(INFINITY));
 
+    // Returns true as soon as any leaf is hit along o + t * d for t in
+    // [0, t_max]. Leaves belonging to ignore_a or ignore_b are skipped.
+    bool traceOcclusion(math::Vector3 o,
+                        math::Vector3 d,
+                        float t_max,
+                        Entity ignore_a = Entity::none(),
+                        Entity ignore_b = Entity::none());
+
     void updateLeafPosition(LeafID leaf_id,
                             const math::Vector3 &pos,
                             const math::Quat &rot,
@@ -44,14 +76,25 @@ public:
                             const math::Vector3 &linear_vel,
                             const math::AABB &obj_aabb);
 
-    math::AABB expandLeaf(LeafID leaf_id,
-                          const math::Vector3 &linear_vel);
-
-    void refitLeaf(LeafID leaf_id, const math::AABB &leaf_aabb);
+    // Bottom up refit of every node above a leaf that moved since the last
+    // refit. Bounds are recomputed exactly from the children, so they shrink
+    // as well as grow. Flags a rebuild for the next updateTree() if the
+    // refit tree's cost has grown past rebuild_cost_threshold times its
+    // cost right after the last rebuild.
+    void refit();
 
     inline void rebuildOnUpdate();
+
+    // Rebuilds if requested (or if leaves were added since the last
+    // rebuild), otherwise refits.
     void updateTree();
 
+    // Translates every leaf and node by -delta, for origin rebasing. The
+    // tree's topology and cost are unchanged, so no refit is needed.
+    void shiftOrigin(math::Vector3 delta);
+
+    inline CountT numLeaves() const;
+
     inline void clearLeaves();
 
 private:
@@ -74,6 +117,10 @@ private:
         inline void setInternal(CountT child, int32_t internal_idx);
         inline bool hasChild(CountT child) const;
         inline void clearChild(CountT child);
+
+        inline math::AABB childAABB(CountT child) const;
+        inline void setChildAABB(CountT child, const math::AABB &aabb);
+        inline float childAreaSum() const;
     };
 
     // FIXME: evaluate whether storing this in-line in the tree
@@ -86,8 +133,27 @@ private:
 
     inline CountT numInternalNodes(CountT num_leaves) const;
 
+    template <typename Fn>
+    inline void findIntersectingLeaves(const math::AABB &aabb,
+                                       Fn &&fn) const;
+
+    // Closest hit leaf in this tree, -1 if none. *t_max is shortened to
+    // the hit.
+    int32_t traceClosestLeaf(math::Vector3 o,
+                             math::Vector3 d,
+                             float *t_max,
+                             math::Vector3 *hit_normal) const;
+
+    // leaf_entities maps this tree's leaves to the entities to ignore
+    bool traceAnyLeaf(math::Vector3 o,
+                      math::Vector3 d,
+                      float t_max,
+                      const Entity *leaf_entities,
+                      Entity ignore_a,
+                      Entity ignore_b) const;
+
     void rebuild();
-    void refit(LeafID *leaf_ids, CountT num_moved);
+    float treeCost(float total_child_area) const;
 
     bool traceRayIntoLeaf(int32_t leaf_idx,
                           math::Vector3 world_ray_o,
@@ -95,7 +161,7 @@ private:
                           float t_min,
                           float t_max,
                           float *hit_t,
-                          math::Vector3 *hit_normal);
+                          math::Vector3 *hit_normal) const;
 
     Node *nodes_;
     CountT num_nodes_;
@@ -111,7 +177,18 @@ private:
     int32_t num_allocated_leaves_;
     float leaf_velocity_expansion_;
     float leaf_accel_expansion_;
+    uint32_t *node_dirty_;
+    int32_t num_tree_leaves_;
+    float rebuild_cost_;
+    float rebuild_cost_threshold_;
     bool force_rebuild_;
+
+    // Shared by every world, static_entities_ maps its leaves to this
+    // world's entities
+    const BVH *static_tree_;
+    Entity *static_entities_;
+
+friend class phys::PhysicsLoader;
 };
 
 }
@@ -18,8 +18,24 @@ math::AABB BVH::getLeafAABB(LeafID leaf_id) const
     return leaf_aabbs_[leaf_id.id];
 }
 
+LeafID BVH::bindStaticEntity(Entity e, CountT static_idx)
+{
+    assert(static_tree_ != nullptr &&
+           static_idx < static_tree_->num_leaves_.load_relaxed());
+    static_entities_[static_idx] = e;
+
+    return LeafID {
+        -1 - int32_t(static_idx),
+    };
+}
+
+CountT BVH::numLeaves() const
+{
+    return num_leaves_.load_relaxed();
+}
+
 template <typename Fn>
-void BVH::findIntersecting(const math::AABB &aabb, Fn &&fn) const
+void BVH::findIntersectingLeaves(const math::AABB &aabb, Fn &&fn) const
 {
     int32_t stack[32];
     stack[0] = 0;
@@ -48,8 +64,7 @@ void BVH::findIntersecting(const math::AABB &aabb, Fn &&fn) const
 
             if (aabb.overlaps(child_aabb)) {
                 if (node.isLeaf(i)) {
-                    Entity e = leaf_entities_[node.leafIDX(i)];
-                    fn(e);
+                    fn(node.leafIDX(i));
                 } else {
                     stack[stack_size++] = node.children[i];
                 }
@@ -58,11 +73,35 @@ void BVH::findIntersecting(const math::AABB &aabb, Fn &&fn) const
     }
 }
 
+template <typename Fn>
+void BVH::findIntersecting(const math::AABB &aabb, Fn &&fn) const
+{
+    findIntersectingLeaves(aabb, [&](int32_t leaf_idx) {
+        fn(leaf_entities_[leaf_idx]);
+    });
+
+    findStaticIntersecting(aabb, fn);
+}
+
 template <typename Fn>
 void BVH::findLeafIntersecting(LeafID leaf_id, Fn &&fn) const
 {
     math::AABB leaf_aabb = leaf_aabbs_[leaf_id.id];
-    findIntersecting(leaf_aabb, std::forward<Fn>(fn));
+    findIntersectingLeaves(leaf_aabb, [&](int32_t leaf_idx) {
+        fn(leaf_entities_[leaf_idx]);
+    });
+}
+
+template <typename Fn>
+void BVH::findStaticIntersecting(const math::AABB &aabb, Fn &&fn) const
+{
+    if (static_tree_ == nullptr) {
+        return;
+    }
+
+    static_tree_->findIntersectingLeaves(aabb, [&](int32_t leaf_idx) {
+        fn(static_entities_[leaf_idx]);
+    });
 }
 
 void BVH::rebuildOnUpdate()
@@ -105,4 +144,44 @@ void BVH::Node::clearChild(CountT child)
     children[child] = sentinel_;
 }
 
+math::AABB BVH::Node::childAABB(CountT child) const
+{
+    return math::AABB {
+        /* .pMin = */ {
+            minX[child],
+            minY[child],
+            minZ[child],
+        },
+        /* .pMax = */ {
+            maxX[child],
+            maxY[child],
+            maxZ[child],
+        },
+    };
+}
+
+void BVH::Node::setChildAABB(CountT child, const math::AABB &aabb)
+{
+    minX[child] = aabb.pMin.x;
+    minY[child] = aabb.pMin.y;
+    minZ[child] = aabb.pMin.z;
+    maxX[child] = aabb.pMax.x;
+    maxY[child] = aabb.pMax.y;
+    maxZ[child] = aabb.pMax.z;
+}
+
+float BVH::Node::childAreaSum() const
+{
+    float sum = 0.f;
+    for (CountT i = 0; i < 4; i++) {
+        if (!hasChild(i)) {
+            break;
+        }
+
+        sum += childAABB(i).surfaceArea();
+    }
+
+    return sum;
+}
+
 }
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#pragma once
+
+#include <madrona/math.hpp>
+
+namespace madrona {
+
+// Compact storage types for hot components. Declare the component with one
+// of these as its member (or base) and convert to / from the math types at
+// the start and end of the systems that use it, e.g.:
+//   struct Velocity : HalfVector3 {};
+//   math::Vector3 v = vel.decode();
+//   ...
+//   vel.encode(v);
+
+// IEEE 754 binary16, round to nearest even on encode.
+struct Half {
+    uint16_t bits;
+
+    static inline Half fromFloat(float v);
+    inline float toFloat() const;
+};
+
+inline uint16_t floatToHalfBits(float v);
+inline float halfBitsToFloat(uint16_t bits);
+
+struct HalfVector3 {
+    Half x;
+    Half y;
+    Half z;
+
+    inline math::Vector3 decode() const;
+    inline void encode(math::Vector3 v);
+};
+
+// Unit quaternion with each component stored as a 16 bit signed
+// normalized integer. Renormalized on decode.
+struct SNormQuat {
+    int16_t w;
+    int16_t x;
+    int16_t y;
+    int16_t z;
+
+    inline math::Quat decode() const;
+    inline void encode(math::Quat q);
+};
+
+inline int16_t floatToSNorm16(float v);
+inline float snorm16ToFloat(int16_t v);
+
+// Position stored as 16 bit fixed point offsets from an origin (usually the
+// world or level origin). resolution is the size of one step, so the
+// representable range is +-32767 * resolution around the origin.
+struct FixedVector3 {
+    int16_t x;
+    int16_t y;
+    int16_t z;
+
+    inline math::Vector3 decode(math::Vector3 origin,
+                                float resolution) const;
+    inline void encode(math::Vector3 v, math::Vector3 origin,
+                       float resolution);
+};
+
+}
+
+#include "compact.inl"
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstring>
+
+namespace madrona {
+
+uint16_t floatToHalfBits(float v)
+{
+    uint32_t f;
+    memcpy(&f, &v, sizeof(float));
+
+    uint32_t sign = (f >> 16) & 0x8000;
+    uint32_t abs_f = f & 0x7FFF'FFFF;
+
+    // NaN / Inf
+    if (abs_f >= 0x7F80'0000) {
+        uint32_t mantissa = abs_f > 0x7F80'0000 ? 0x200 : 0;
+        return uint16_t(sign | 0x7C00 | mantissa);
+    }
+
+    // Overflow, round to Inf
+    if (abs_f >= 0x4780'0000) {
+        return uint16_t(sign | 0x7C00);
+    }
+
+    // Normal half
+    if (abs_f >= 0x3880'0000) {
+        uint32_t rounded = abs_f + 0x0FFF + ((abs_f >> 13) & 1);
+        return uint16_t(sign | ((rounded - 0x3800'0000) >> 13));
+    }
+
+    // Subnormal half or zero
+    if (abs_f < 0x3300'0000) {
+        return uint16_t(sign);
+    }
+
+    uint32_t exponent = abs_f >> 23;
+    uint32_t mantissa = (abs_f & 0x007F'FFFF) | 0x0080'0000;
+    uint32_t shift = 126 - exponent;
+
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+
+    if (remainder > halfway ||
+        (remainder == halfway && (half_mantissa & 1) != 0)) {
+        half_mantissa += 1;
+    }
+
+    return uint16_t(sign | half_mantissa);
+}
+
+float halfBitsToFloat(uint16_t bits)
+{
+    uint32_t sign = uint32_t(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1F;
+    uint32_t mantissa = bits & 0x3FF;
+
+    uint32_t f;
+    if (exponent == 0x1F) {
+        f = sign | 0x7F80'0000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        f = sign;
+    } else {
+        // Subnormal half, normalize for float
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent -= 1;
+        }
+
+        f = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+
+    float v;
+    memcpy(&v, &f, sizeof(float));
+    return v;
+}
+
+Half Half::fromFloat(float v)
+{
+    return Half { floatToHalfBits(v) };
+}
+
+float Half::toFloat() const
+{
+    return halfBitsToFloat(bits);
+}
+
+math::Vector3 HalfVector3::decode() const
+{
+    return math::Vector3 {
+        x.toFloat(),
+        y.toFloat(),
+        z.toFloat(),
+    };
+}
+
+void HalfVector3::encode(math::Vector3 v)
+{
+    x = Half::fromFloat(v.x);
+    y = Half::fromFloat(v.y);
+    z = Half::fromFloat(v.z);
+}
+
+int16_t floatToSNorm16(float v)
+{
+    v = fminf(fmaxf(v, -1.f), 1.f);
+    return int16_t(lroundf(v * 32767.f));
+}
+
+float snorm16ToFloat(int16_t v)
+{
+    return fmaxf(float(v) / 32767.f, -1.f);
+}
+
+math::Quat SNormQuat::decode() const
+{
+    return math::Quat {
+        snorm16ToFloat(w),
+        snorm16ToFloat(x),
+        snorm16ToFloat(y),
+        snorm16ToFloat(z),
+    }.normalize();
+}
+
+void SNormQuat::encode(math::Quat q)
+{
+    // q and -q are the same rotation, keep w positive so the sign of w
+    // never needs to be stored exactly
+    if (q.w < 0.f) {
+        q = math::Quat { -q.w, -q.x, -q.y, -q.z };
+    }
+
+    w = floatToSNorm16(q.w);
+    x = floatToSNorm16(q.x);
+    y = floatToSNorm16(q.y);
+    z = floatToSNorm16(q.z);
+}
+
+math::Vector3 FixedVector3::decode(math::Vector3 origin,
+                                   float resolution) const
+{
+    return math::Vector3 {
+        origin.x + float(x) * resolution,
+        origin.y + float(y) * resolution,
+        origin.z + float(z) * resolution,
+    };
+}
+
+void FixedVector3::encode(math::Vector3 v, math::Vector3 origin,
+                          float resolution)
+{
+    float inv_resolution = 1.f / resolution;
+
+    auto toFixed = [inv_resolution](float offset) {
+        float steps = fminf(fmaxf(offset * inv_resolution, -32767.f),
+                            32767.f);
+        return int16_t(lroundf(steps));
+    };
+
+    x = toFixed(v.x - origin.x);
+    y = toFixed(v.y - origin.y);
+    z = toFixed(v.z - origin.z);
+}
+
+}
@@ -101,6 +101,22 @@ public:
     // memory.
     inline void * tmpAlloc(uint64_t num_bytes);
 
+    // Add the current state of this world to the pool of initial states
+    // that AutoResetNode restores from. Returns the index of the new
+    // initial state. Intended to be called while worlds are being
+    // constructed; see StateManager::captureInitialState for what is saved.
+    inline CountT captureInitialState();
+
+    // Number of initial states captured so far across all worlds.
+    inline CountT numInitialStates() const;
+
+    // Gives this world a private copy of an ArchetypeFlags::SharedTemplate
+    // archetype's rows. Writes through get or a non-const query column do
+    // this implicitly once worlds are running; call it directly to copy
+    // ahead of time.
+    template <typename ArchetypeT>
+    inline void makeWorldLocal();
+
     // Create an ECS query matching the template components.
     // Pass to iterateQuery to iterate over all entities with the
     // template set of components.
@@ -99,6 +99,23 @@ void * Context::tmpAlloc(uint64_t num_bytes)
     return state_mgr_->tmpAlloc(MADRONA_MW_COND(cur_world_id_,) num_bytes);
 }
 
+CountT Context::captureInitialState()
+{
+    return state_mgr_->captureInitialState(MADRONA_MW_COND(cur_world_id_));
+}
+
+CountT Context::numInitialStates() const
+{
+    return state_mgr_->numInitialStates();
+}
+
+template <typename ArchetypeT>
+void Context::makeWorldLocal()
+{
+    state_mgr_->makeWorldLocal(MADRONA_MW_COND(cur_world_id_,)
+        state_mgr_->archetypeID<ArchetypeT>().id);
+}
+
 template <typename... ComponentTs>
 Query<ComponentTs...> Context::query()
 {
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <madrona/components.hpp>
+#include <madrona/span.hpp>
+#include <madrona/taskgraph_builder.hpp>
+#include <madrona/context.hpp>
+#include <madrona/navmesh.hpp>
+
+namespace madrona::crowd {
+
+// Local collision avoidance for navmesh agents that don't need rigid body
+// physics. Each step, every entity with Position and crowd::Agent gets a
+// velocity as close as possible to its preferred velocity that avoids the
+// other agents (ORCA: each neighbor contributes a half-plane of allowed
+// velocities, solved as a small 2D linear program) and the navmesh's
+// boundary edges. Agents move in the world XY plane.
+//
+// Neighbors are found with a per world hash grid rebuilt every step, and
+// walls with a static grid over the navmesh boundary built in init. The
+// module only computes velocities; the simulator integrates Position.
+
+struct Agent {
+    float radius;
+    float maxSpeed;
+    // Input, usually toward the next corner of the agent's path
+    math::Vector2 preferredVelocity;
+    // Output
+    math::Vector2 velocity;
+};
+
+struct Config {
+    // Boundary edges of the navmesh are walls. May be nullptr for no walls.
+    const Navmesh *navmesh;
+    // Agents further apart than this are ignored. Also the grid cell size.
+    float neighborDist;
+    // Closest neighbors considered per agent, between 1 and 16
+    CountT maxNeighbors;
+    // How far ahead in time collisions with other agents / walls are
+    // avoided. Shorter horizons let agents get closer before reacting.
+    float timeHorizon;
+    float timeHorizonWalls;
+    // Simulation step, used to push apart agents that already overlap
+    float deltaT;
+    // Maximum number of agents in each world
+    CountT maxAgents;
+};
+
+void registerTypes(ECSRegistry &registry);
+
+void init(Context &ctx, const Config &cfg);
+
+TaskGraphNodeID setupAvoidanceTasks(TaskGraphBuilder &builder,
+                                    Span<const TaskGraphNodeID> deps);
+
+}
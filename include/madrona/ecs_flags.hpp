@@ -17,6 +17,17 @@ namespace madrona {
 enum class ArchetypeFlags : uint32_t {
     None = 0,
     ImportOffsets = 1_u32 << 0,
+    // Skip this archetype when capturing / restoring pooled initial
+    // states (StateManager::captureInitialState). Must be set for
+    // archetypes used for temporaries.
+    ExcludeFromInitialState = 1_u32 << 1,
+    // Rows are stored once and shared by every world instead of per world
+    // (CPU multi-world backend). Meant for static entities, which should
+    // be created from a single world during setup. Once worlds start
+    // running the rows can't be added or removed, and a world that writes
+    // them gets a private copy first (see
+    // StateManager::sealSharedTemplates).
+    SharedTemplate = 1_u32 << 2,
 };
 
 enum class ComponentFlags : uint32_t {
@@ -27,6 +38,18 @@ enum class ComponentFlags : uint32_t {
     CudaAllocMemory = 1_u32 << 3,
 };
 
+// Optional encoding of exported component data. The component is treated
+// as an array of floats, each stored as a 16 bit value in the export buffer
+// to cut copy-out and learner memory bandwidth. SNorm16 clamps to [-1, 1]
+// and suits unit quaternions / directions. Encoded exports are output
+// only: writes to the export buffer are not copied back into the
+// simulation.
+enum class ExportEncoding : uint32_t {
+    None,
+    Float16,
+    SNorm16,
+};
+
 template <typename... ComponentTs>
 struct ComponentMetadataSelector {
     std::array<ComponentFlags, sizeof...(ComponentTs)> flags;
@@ -15,6 +15,16 @@ struct Plane {
     float d;
 };
 
+// Per edge data precomputed when hulls are loaded so edge-edge SAT queries
+// don't have to walk the half edge structure. Edge i corresponds to half
+// edges 2i and 2i + 1.
+struct HullEdge {
+    uint32_t v1;
+    uint32_t v2;
+    uint32_t face1;
+    uint32_t face2;
+};
+
 struct Segment {
     math::Vector3 p1;
     math::Vector3 p2;
@@ -31,6 +41,7 @@ struct HalfEdgeMesh {
     uint32_t *faceBaseHalfEdges;
     Plane *facePlanes;
     math::Vector3 *vertices;
+    HullEdge *edges;
 
     uint32_t numHalfEdges;
     uint32_t numFaces;
@@ -65,6 +76,16 @@ inline math::Vector3 triangleClosestPointToOrigin(
     math::Vector3 ab,
     math::Vector3 ac);
 
+// Closest points between segments p1q1 and p2q2, written to *c1 and *c2.
+// Returns the squared distance between them.
+inline float segmentClosestPoints(
+    math::Vector3 p1,
+    math::Vector3 q1,
+    math::Vector3 p2,
+    math::Vector3 q2,
+    math::Vector3 *c1,
+    math::Vector3 *c2);
+
 // Returns distance to closest point squared + closest point itself
 // in *closest_point. If the hull is touching the origin returns 0 and
 // *closest_point is invalid.
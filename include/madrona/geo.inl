@@ -237,4 +237,68 @@ inline math::Vector3 triangleClosestPointToOrigin(
     return a + ab * v + ac * w; //=u*a+v*b+w*c,u=va*denom=1.0f-v-w
 }
 
+inline float segmentClosestPoints(
+    math::Vector3 p1,
+    math::Vector3 q1,
+    math::Vector3 p2,
+    math::Vector3 q2,
+    math::Vector3 *c1,
+    math::Vector3 *c2)
+{
+    using namespace math;
+    // RTCD 5.1.9
+
+    constexpr float epsilon = 1e-12f;
+
+    Vector3 d1 = q1 - p1;
+    Vector3 d2 = q2 - p2;
+    Vector3 r = p1 - p2;
+    float a = d1.length2();
+    float e = d2.length2();
+    float f = dot(d2, r);
+
+    float s, t;
+    if (a <= epsilon && e <= epsilon) {
+        // Both segments degenerate into points
+        s = t = 0.f;
+    } else if (a <= epsilon) {
+        // First segment degenerates into a point
+        s = 0.f;
+        t = fminf(fmaxf(f / e, 0.f), 1.f);
+    } else {
+        float c = dot(d1, r);
+        if (e <= epsilon) {
+            // Second segment degenerates into a point
+            t = 0.f;
+            s = fminf(fmaxf(-c / a, 0.f), 1.f);
+        } else {
+            float b = dot(d1, d2);
+            float denom = a * e - b * b;
+
+            // If segments not parallel, compute closest point on L1 to L2
+            // and clamp to segment S1. Else pick arbitrary s (here 0)
+            if (denom != 0.f) {
+                s = fminf(fmaxf((b * f - c * e) / denom, 0.f), 1.f);
+            } else {
+                s = 0.f;
+            }
+
+            // Compute point on L2 closest to S1(s), if t is outside [0, 1]
+            // clamp it and recompute s for the new value of t
+            t = (b * s + f) / e;
+            if (t < 0.f) {
+                t = 0.f;
+                s = fminf(fmaxf(-c / a, 0.f), 1.f);
+            } else if (t > 1.f) {
+                t = 1.f;
+                s = fminf(fmaxf((b - c) / a, 0.f), 1.f);
+            }
+        }
+    }
+
+    *c1 = p1 + d1 * s;
+    *c2 = p2 + d2 * t;
+    return (*c1 - *c2).length2();
+}
+
 }
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <madrona/components.hpp>
+#include <madrona/span.hpp>
+#include <madrona/taskgraph_builder.hpp>
+#include <madrona/context.hpp>
+
+namespace madrona::hierarchy {
+
+// Parent-child transform hierarchy. Add the Child bundle to any archetype
+// that can be attached to another entity (the archetype also needs
+// Position, Rotation and Scale). A root parent, one that is not itself
+// attached, must also have Position, Rotation and Scale. Each step,
+// setupPropagateTasks() computes the world-space Position / Rotation /
+// Scale of every attached entity from its parent's world transform and its
+// LocalTransform.
+//
+// Attached entities are kept in a per-world array sorted by depth, so
+// propagation is a linear pass over each level where every parent was
+// written by the previous level, rather than a chain of Entity lookups per
+// child. The sorted order is only rebuilt when the hierarchy changes
+// (attach / detach / markDirty).
+
+struct Parent {
+    Entity e;
+};
+
+// Transform relative to the parent. Scale is applied in the parent's
+// rotated frame without shear, so non-uniform parent scale combined with a
+// rotated child is approximate.
+struct LocalTransform {
+    math::Vector3 position;
+    math::Quat rotation;
+    math::Diag3x3 scale;
+};
+
+// Index of this entity in the depth sorted order. Managed by the hierarchy
+// module.
+struct HierarchySlot {
+    int32_t idx;
+};
+
+struct Child : Bundle<
+    Parent,
+    LocalTransform,
+    HierarchySlot
+> {};
+
+void registerTypes(ECSRegistry &registry);
+
+// max_attached is the maximum number of entities attached at once in each
+// world, summed over all parents. Exceeding it is fatal.
+void init(Context &ctx, CountT max_attached);
+
+void attach(Context &ctx,
+            Entity child,
+            Entity parent,
+            const LocalTransform &local);
+
+// child becomes a root: its world transform is left where it was last
+// propagated.
+void detach(Context &ctx, Entity child);
+
+// Must be called after destroying attached entities or their parents, or
+// after writing Parent directly.
+void markDirty(Context &ctx);
+
+TaskGraphNodeID setupPropagateTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+}
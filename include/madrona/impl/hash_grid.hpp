@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#pragma once
+
+#include <madrona/memory.hpp>
+#include <madrona/types.hpp>
+
+#include <cmath>
+
+namespace madrona {
+
+// Uninitialized array for per world singleton state
+template <typename T>
+inline T * allocArray(CountT num_elems)
+{
+    return (T *)rawAlloc(sizeof(T) * num_elems);
+}
+
+// Spatial hash grids map integer cells onto a power of two number of
+// buckets. Elements are counting sorted by bucket, so bucket b's elements
+// are sorted[starts[b], starts[b + 1]).
+
+// Power of two bucket count with at most half the buckets in use
+inline uint32_t numHashCells(CountT max_elems)
+{
+    uint32_t num_cells = 1;
+    while (num_cells < 2 * max_elems) {
+        num_cells *= 2;
+    }
+
+    return num_cells;
+}
+
+inline int32_t cellCoord(float v, float inv_cell_size)
+{
+    return (int32_t)floorf(v * inv_cell_size);
+}
+
+inline uint32_t hashCell(int32_t x, int32_t y, uint32_t num_cells)
+{
+    return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u) &
+        (num_cells - 1);
+}
+
+inline uint32_t hashCell(int32_t x, int32_t y, int32_t z,
+                         uint32_t num_cells)
+{
+    return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+            (uint32_t)z * 83492791u) & (num_cells - 1);
+}
+
+// cell_fn(i) returns element i's bucket. cell_counts and elem_cells are
+// scratch, cell_starts needs num_cells + 1 entries.
+template <typename Fn>
+inline void buildGrid(CountT num_elems,
+                      uint32_t num_cells,
+                      uint32_t *cell_starts,
+                      uint32_t *cell_counts,
+                      uint32_t *elem_cells,
+                      uint32_t *sorted,
+                      Fn &&cell_fn)
+{
+    for (uint32_t i = 0; i < num_cells; i++) {
+        cell_counts[i] = 0;
+    }
+
+    for (CountT i = 0; i < num_elems; i++) {
+        uint32_t cell = cell_fn(i);
+        elem_cells[i] = cell;
+        cell_counts[cell] += 1;
+    }
+
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < num_cells; i++) {
+        cell_starts[i] = offset;
+        offset += cell_counts[i];
+    }
+    cell_starts[num_cells] = offset;
+
+    for (CountT i = 0; i < num_elems; i++) {
+        uint32_t cell = elem_cells[i];
+        uint32_t dst = cell_starts[cell + 1] - cell_counts[cell]--;
+        sorted[dst] = (uint32_t)i;
+    }
+}
+
+}
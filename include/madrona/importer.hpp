@@ -28,19 +28,59 @@ struct SourceObject {
     Span<SourceMesh> meshes;
 };
 
+// AssetImporter deduplicates imported geometry, so meshes with identical
+// content point at the same arrays and objects with identical meshes share
+// the same SourceMesh array. Consumers use these checks to process each
+// unique piece of geometry once.
+inline bool sharesGeometry(const SourceMesh &a, const SourceMesh &b)
+{
+    return a.positions == b.positions &&
+        a.normals == b.normals &&
+        a.tangentAndSigns == b.tangentAndSigns &&
+        a.uvs == b.uvs &&
+        a.indices == b.indices &&
+        a.faceCounts == b.faceCounts &&
+        a.faceMaterials == b.faceMaterials &&
+        a.numVertices == b.numVertices &&
+        a.numFaces == b.numFaces;
+}
+
+inline bool sharesGeometry(const SourceObject &a, const SourceObject &b)
+{
+    return a.meshes.data() == b.meshes.data() &&
+        a.meshes.size() == b.meshes.size();
+}
+
 enum class SourceTextureFormat : int32_t {
     R8G8B8A8,
     BC7,
 };
 
+// data holds numLevels mip levels back to back, largest first, each
+// sourceTextureLevelBytes in size. width and height are the first level's.
 struct SourceTexture {
     void *data;
     SourceTextureFormat format;
     uint32_t width;
     uint32_t height;
     size_t numBytes;
+    uint32_t numLevels;
 };
 
+// BC7 levels are stored as whole 4x4 blocks, so small levels are padded
+inline size_t sourceTextureLevelBytes(SourceTextureFormat format,
+                                      uint32_t width,
+                                      uint32_t height)
+{
+    switch (format) {
+    case SourceTextureFormat::BC7:
+        return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 16;
+    case SourceTextureFormat::R8G8B8A8:
+    default:
+        return (size_t)width * (size_t)height * 4;
+    }
+}
+
 struct SourceMaterial {
     math::Vector4 color;
 
@@ -69,6 +109,8 @@ public:
     using ImportHandler =
         Optional<SourceTexture> (*)(void *data, size_t num_bytes);
 
+    // Overrides the built in handler for png, jpg or ktx2 if given one of
+    // those extensions
     int32_t addHandler(const char *extension, ImportHandler fn);
 
     int32_t getPNGTypeCode();
@@ -120,6 +162,8 @@ public:
 
     ImageImporter & imageImporter();
 
+    // Identical geometry across all loaded files is collapsed after import,
+    // see sharesGeometry.
     Optional<ImportedAssets> importFromDisk(
         Span<const char * const> asset_paths,
         Span<char> err_buf = { nullptr, 0 },
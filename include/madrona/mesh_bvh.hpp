@@ -46,23 +46,135 @@ struct BVHNodeQuantized {
     // between 0th leaf node and 0th internal node.
     NodeIndex childrenIdx[Width];
 
+    // Children bounds decoded to floats, one lane per child
+    struct DecodedChildren {
+        float minX[Width], minY[Width], minZ[Width];
+        float maxX[Width], maxY[Width], maxZ[Width];
+    };
+
+    // 2^exp, built directly from the IEEE exponent bits. exp must be in
+    // [minExponent, 127].
+    static float exponentScale(int32_t exp)
+    {
+        uint32_t bits = (uint32_t)(exp + 127) << 23;
+#ifdef MADRONA_GPU_MODE
+        return __uint_as_float(bits);
+#else
+        return std::bit_cast<float>(bits);
+#endif
+    }
+
+    // Keeps exponentScale() a normal float even for flat nodes
+    static constexpr int32_t minExponent = -126;
+
+    // x * 2^-exp. 2^-127 isn't a normal float (exponentScale(-127) is 0),
+    // so that case is split into two multiplies.
+    static float divideByScale(float x, int32_t exp)
+    {
+        if (exp == 127) {
+            return x * exponentScale(-126) * 0.5f;
+        }
+
+        return x * exponentScale(-exp);
+    }
+
+    // Smallest exponent such that node_min + 255 * 2^exp >= node_max, so
+    // every child fits in 8 bits. Reads the exponent of the extent from its
+    // bits instead of calling log2f.
+    static int8_t computeExponent(float node_min, float node_max)
+    {
+        float extent = (node_max - node_min) * (1.f / 255.f);
+
+        int32_t exp;
+        if (!(extent > 0.f)) {
+            exp = minExponent;
+        } else {
+#ifdef MADRONA_GPU_MODE
+            uint32_t bits = __float_as_uint(extent);
+#else
+            uint32_t bits = std::bit_cast<uint32_t>(extent);
+#endif
+            // ceil(log2(extent)): bump the exponent unless extent is an
+            // exact power of two. Denormals land on minExponent.
+            exp = (int32_t)(bits >> 23) - 127 +
+                ((bits & 0x7F'FFFF) != 0 ? 1 : 0);
+            exp = exp < minExponent ? minExponent : exp;
+            // An infinite extent (node_max - node_min overflowed) would
+            // give 128
+            exp = exp > 127 ? 127 : exp;
+        }
+
+        // The extent computation rounds, fix up with the decode arithmetic
+        while (exp < 127 && node_min + exponentScale(exp) * 255.f < node_max) {
+            exp += 1;
+        }
+
+        return (int8_t)exp;
+    }
+
+    // Conservative quantization: decoding gives a bound <= v (quantizeMin)
+    // or >= v (quantizeMax) with the same arithmetic the traversal uses.
+    static uint8_t quantizeMin(float v, float node_min, int8_t exp)
+    {
+        float scale = exponentScale(exp);
+        float q = floorf(divideByScale(v - node_min, exp));
+        q = fminf(fmaxf(q, 0.f), 255.f);
+        while (q > 0.f && node_min + scale * q > v) {
+            q -= 1.f;
+        }
+        return (uint8_t)q;
+    }
+
+    static uint8_t quantizeMax(float v, float node_min, int8_t exp)
+    {
+        float scale = exponentScale(exp);
+        float q = ceilf(divideByScale(v - node_min, exp));
+        q = fminf(fmaxf(q, 0.f), 255.f);
+        while (q < 255.f && node_min + scale * q < v) {
+            q += 1.f;
+        }
+        return (uint8_t)q;
+    }
+
+    // All children at once: three scales per node, then one multiply-add
+    // per bound in loops the compiler turns into vector instructions.
+    DecodedChildren decodeChildren() const
+    {
+        float scale_x = exponentScale(expX);
+        float scale_y = exponentScale(expY);
+        float scale_z = exponentScale(expZ);
+
+        DecodedChildren decoded;
+        MADRONA_UNROLL
+        for (int i = 0; i < Width; i++) {
+            decoded.minX[i] = minPoint.x + scale_x * (float)qMinX[i];
+            decoded.minY[i] = minPoint.y + scale_y * (float)qMinY[i];
+            decoded.minZ[i] = minPoint.z + scale_z * (float)qMinZ[i];
+            decoded.maxX[i] = minPoint.x + scale_x * (float)qMaxX[i];
+            decoded.maxY[i] = minPoint.y + scale_y * (float)qMaxY[i];
+            decoded.maxZ[i] = minPoint.z + scale_z * (float)qMaxZ[i];
+        }
+
+        return decoded;
+    }
+
     math::AABB convertToAABB(uint32_t child_idx) const
     {
-        auto to_float = [](uint32_t data) -> float {
-            return *((float *)&data);
-        };
+        float scale_x = exponentScale(expX);
+        float scale_y = exponentScale(expY);
+        float scale_z = exponentScale(expZ);
 
         return math::AABB {
             .pMin = {
-                minPoint.x + to_float((expX + 127) << 23) * qMinX[child_idx],
-                minPoint.y + to_float((expY + 127) << 23) * qMinY[child_idx],
-                minPoint.z + to_float((expZ + 127) << 23) * qMinZ[child_idx],
+                minPoint.x + scale_x * qMinX[child_idx],
+                minPoint.y + scale_y * qMinY[child_idx],
+                minPoint.z + scale_z * qMinZ[child_idx],
             },
 
             .pMax = {
-                minPoint.x + to_float((expX + 127) << 23) * qMaxX[child_idx],
-                minPoint.y + to_float((expY + 127) << 23) * qMaxY[child_idx],
-                minPoint.z + to_float((expZ + 127) << 23) * qMaxZ[child_idx],
+                minPoint.x + scale_x * qMaxX[child_idx],
+                minPoint.y + scale_y * qMaxY[child_idx],
+                minPoint.z + scale_z * qMaxZ[child_idx],
             },
         };
     }
@@ -87,13 +199,11 @@ struct BVHNodeQuantized {
             root_max.z = fmaxf(root_max.z, aabb.pMax.z);
         }
 
-        math::Vector3 root_extent = root_max - root_min;
-
         BVHNodeT ret = {
             .minPoint = root_min,
-            .expX = (int8_t)ceilf(log2f(root_extent.x / (powf(2.f, 8.f) - 1.f))),
-            .expY = (int8_t)ceilf(log2f(root_extent.y / (powf(2.f, 8.f) - 1.f))),
-            .expZ = (int8_t)ceilf(log2f(root_extent.z / (powf(2.f, 8.f) - 1.f))),
+            .expX = computeExponent(root_min.x, root_max.x),
+            .expY = computeExponent(root_min.y, root_max.y),
+            .expZ = computeExponent(root_min.z, root_max.z),
             .numChildren = (uint8_t)num_children
         };
 
@@ -102,13 +212,13 @@ struct BVHNodeQuantized {
             // Quantize the AABB of the child
             math::AABB &aabb = child_aabbs[iter];
 
-            ret.qMinX[iter] = floorf((aabb.pMin.x - root_min.x) / powf(2, ret.expX));
-            ret.qMinY[iter] = floorf((aabb.pMin.y - root_min.y) / powf(2, ret.expY));
-            ret.qMinZ[iter] = floorf((aabb.pMin.z - root_min.z) / powf(2, ret.expZ));
+            ret.qMinX[iter] = quantizeMin(aabb.pMin.x, root_min.x, ret.expX);
+            ret.qMinY[iter] = quantizeMin(aabb.pMin.y, root_min.y, ret.expY);
+            ret.qMinZ[iter] = quantizeMin(aabb.pMin.z, root_min.z, ret.expZ);
 
-            ret.qMaxX[iter] = ceilf((aabb.pMax.x - root_min.x) / powf(2, ret.expX));
-            ret.qMaxY[iter] = ceilf((aabb.pMax.y - root_min.y) / powf(2, ret.expY));
-            ret.qMaxZ[iter] = ceilf((aabb.pMax.z - root_min.z) / powf(2, ret.expZ));
+            ret.qMaxX[iter] = quantizeMax(aabb.pMax.x, root_min.x, ret.expX);
+            ret.qMaxY[iter] = quantizeMax(aabb.pMax.y, root_min.y, ret.expY);
+            ret.qMaxZ[iter] = quantizeMax(aabb.pMax.z, root_min.z, ret.expZ);
 
             if (child_indices[iter] < 0) {
                 ret.childrenIdx[iter] = (uint32_t)(-child_indices[iter] - 1) | 
@@ -208,6 +318,35 @@ struct MeshBVH {
         uint32_t leafMaterialIDX;
     };
 
+    // Inputs for the batched sweeps below. d must be normalized, t is
+    // measured in world units along d.
+    struct SphereSweep {
+        math::Vector3 o;
+        math::Vector3 d;
+        float radius;
+        float tMax;
+    };
+
+    // Capsule around the segment p0p1
+    struct CapsuleSweep {
+        math::Vector3 p0;
+        math::Vector3 p1;
+        math::Vector3 d;
+        float radius;
+        float tMax;
+    };
+
+    struct SweepHit {
+        // The query's tMax if nothing was hit
+        float tHit;
+        // Unit surface normal at the contact point, facing the swept
+        // shape. Only written on a hit.
+        math::Vector3 normal;
+    };
+
+    // Queries traversing the tree together
+    static constexpr inline CountT sweepPacketSize = 8;
+
     template <typename Fn>
     void findOverlaps(const math::AABB &aabb, Fn &&fn) const;
 
@@ -224,6 +363,20 @@ struct MeshBVH {
                             math::Vector3 *out_hit_normal,
                             float t_max = float(FLT_MAX));
 
+    // Sweeps many spheres / capsules against this mesh, for instance every
+    // agent of a world moving against the static level. Queries whose swept
+    // bounds overlap are grouped into packets of up to sweepPacketSize that
+    // share one traversal: each node's children are decoded once and tested
+    // against the whole packet, and each leaf triangle is fetched once.
+    // Passing nearby queries next to each other gives the best packets.
+    inline void sphereCastBatch(const SphereSweep *sweeps,
+                                SweepHit *out_hits,
+                                CountT num_sweeps) const;
+
+    inline void capsuleCastBatch(const CapsuleSweep *sweeps,
+                                 SweepHit *out_hits,
+                                 CountT num_sweeps) const;
+
     inline bool traceRayLeaf(
         int32_t leaf_idx,
         int32_t num_tris,
@@ -288,6 +441,41 @@ struct MeshBVH {
                                     float sphere_r,
                                     math::Vector3 *out_hit_normal) const;
 
+    inline float capsuleCastTriangle(math::Vector3 tri_a,
+                                     math::Vector3 tri_b,
+                                     math::Vector3 tri_c,
+                                     math::Vector3 p0,
+                                     math::Vector3 p1,
+                                     math::Vector3 ray_d,
+                                     float t_max,
+                                     float capsule_r) const;
+
+    // Box with half extents ext centered at o, moving along d
+    struct SweepBounds {
+        math::Vector3 o;
+        math::Vector3 d;
+        math::Vector3 ext;
+        float tMax;
+    };
+
+    // Shared packet traversal of sphereCastBatch and capsuleCastBatch.
+    // tri_fn returns the time of impact with one triangle, normal_fn the
+    // contact normal given the closest triangle.
+    template <typename BoundsFn, typename TriFn, typename NormalFn>
+    inline void sweepBatch(CountT num_sweeps,
+                           SweepHit *out_hits,
+                           BoundsFn &&bounds_fn,
+                           TriFn &&tri_fn,
+                           NormalFn &&normal_fn) const;
+
+    // Normalized separation, or the triangle's face normal against d if the
+    // shapes touch at a point
+    static inline math::Vector3 sweepHitNormal(math::Vector3 separation,
+                                               math::Vector3 tri_a,
+                                               math::Vector3 tri_b,
+                                               math::Vector3 tri_c,
+                                               math::Vector3 ray_d);
+
     inline uint32_t getMaterialIDX(const HitInfo &info) const;
     inline uint32_t getMaterialIDX(int32_t mat_idx) const;
 
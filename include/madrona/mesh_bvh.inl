@@ -27,31 +27,17 @@ void MeshBVH::findOverlaps(const math::AABB &aabb, Fn &&fn) const
     while (stack_size > 0) {
         int32_t node_idx = stack[--stack_size];
         const QBVHNode &node = nodes[node_idx];
+        QBVHNode::DecodedChildren children = node.decodeChildren();
+
         for (int32_t i = 0; i < QBVHNode::NodeWidth; i++) {
             if (!node.hasChild(i)) {
                 continue; // Technically this could be break?
             };
 
-
-#ifdef MADRONA_GPU_MODE
-#define U32TOFLOAT(x) (__uint_as_float(x))
-#else
-#define U32TOFLOAT(x) (std::bit_cast<float>(x))
-#endif
-
             math::AABB child_aabb {
-                .pMin = {
-                    node.minPoint.x + U32TOFLOAT((node.expX + 127) << 23) * node.qMinX[i],
-                    node.minPoint.y + U32TOFLOAT((node.expY + 127) << 23) * node.qMinY[i],
-                    node.minPoint.z + U32TOFLOAT((node.expZ + 127) << 23) * node.qMinZ[i],
-                },
-                .pMax = {
-                    node.minPoint.x + U32TOFLOAT((node.expX + 127) << 23) * node.qMaxX[i],
-                    node.minPoint.y + U32TOFLOAT((node.expY + 127) << 23) * node.qMaxY[i],
-                    node.minPoint.z + U32TOFLOAT((node.expZ + 127) << 23) * node.qMaxZ[i],
-                },
+                .pMin = { children.minX[i], children.minY[i], children.minZ[i] },
+                .pMax = { children.maxX[i], children.maxY[i], children.maxZ[i] },
             };
-#undef U32TOFLOAT
 
             if (aabb.overlaps(child_aabb)) {
                 if (node.isLeaf(i)) {
@@ -97,64 +83,63 @@ bool MeshBVH::traceRay(math::Vector3 ray_o,
 
     bool ray_hit = false;
 
+    float rayXInv = copysignf(ray_d.x == 0 ? 1/diveps : 1/ray_d.x,ray_d.x);
+    float rayYInv = copysignf(ray_d.y == 0 ? 1/diveps : 1/ray_d.y,ray_d.y);
+    float rayZInv = copysignf(ray_d.z == 0 ? 1/diveps : 1/ray_d.z,ray_d.z);
+
     while (stack_size > previous_stack_size) { 
         int32_t node_idx = stack[--stack_size];
         const QBVHNode &node = nodes[node_idx];
 
-        float rayXInv = copysignf(ray_d.x == 0 ? 1/diveps : 1/ray_d.x,ray_d.x);
-        float rayYInv = copysignf(ray_d.y == 0 ? 1/diveps : 1/ray_d.y,ray_d.y);
-        float rayZInv = copysignf(ray_d.z == 0 ? 1/diveps : 1/ray_d.z,ray_d.z);
         //NVIDIA's method, transform for ray plane to quantized space. Shift to IEEE exponent bits.
-
-#ifdef MADRONA_GPU_MODE
-        float dirQuantX = __uint_as_float((node.expX + 127) << 23) * rayXInv;
-        float dirQuantY = __uint_as_float((node.expY + 127) << 23) * rayYInv;
-        float dirQuantZ = __uint_as_float((node.expZ + 127) << 23) * rayZInv;
-#else
-        float dirQuantX = std::bit_cast<float>((node.expX + 127) << 23) * rayXInv;
-        float dirQuantY = std::bit_cast<float>((node.expY + 127) << 23) * rayYInv;
-        float dirQuantZ = std::bit_cast<float>((node.expZ + 127) << 23) * rayZInv;
-#endif
+        float dirQuantX = QBVHNode::exponentScale(node.expX) * rayXInv;
+        float dirQuantY = QBVHNode::exponentScale(node.expY) * rayYInv;
+        float dirQuantZ = QBVHNode::exponentScale(node.expZ) * rayZInv;
 
         float originQuantX = (node.minPoint.x - ray_o.x) * rayXInv;
         float originQuantY = (node.minPoint.y - ray_o.y) * rayYInv;
         float originQuantZ = (node.minPoint.z - ray_o.z) * rayZInv;
 
-        for (CountT i = 0; i < MeshBVH::nodeWidth; i++) {
-            if (!node.hasChild(i)) {
-                continue; // Technically this could be break?
-            };
-
-
-            float t_near_x = node.qMinX[i] * dirQuantX + originQuantX;
-            float t_near_y = node.qMinY[i] * dirQuantY + originQuantY;
-            float t_near_z = node.qMinZ[i] * dirQuantZ + originQuantZ;
+        // Test all children before branching on any of them, so the slab
+        // tests run as vector instructions across the node width
+        bool child_hit[MeshBVH::nodeWidth];
 
-            float t_far_x = node.qMaxX[i] * dirQuantX + originQuantX;
-            float t_far_y = node.qMaxY[i] * dirQuantY + originQuantY;
-            float t_far_z = node.qMaxZ[i] * dirQuantZ + originQuantZ;
+        MADRONA_UNROLL
+        for (CountT i = 0; i < MeshBVH::nodeWidth; i++) {
+            float t_near_x = (float)node.qMinX[i] * dirQuantX + originQuantX;
+            float t_near_y = (float)node.qMinY[i] * dirQuantY + originQuantY;
+            float t_near_z = (float)node.qMinZ[i] * dirQuantZ + originQuantZ;
 
+            float t_far_x = (float)node.qMaxX[i] * dirQuantX + originQuantX;
+            float t_far_y = (float)node.qMaxY[i] * dirQuantY + originQuantY;
+            float t_far_z = (float)node.qMaxZ[i] * dirQuantZ + originQuantZ;
 
             float t_near = fmaxf(fminf(t_near_x,t_far_x), fmaxf(fminf(t_near_y,t_far_y),
                 fmaxf(fminf(t_near_z,t_far_z), 0.f)));
             float t_far = fminf(fmaxf(t_far_x,t_near_x), fminf(fmaxf(t_far_y,t_near_y),
                 fminf(fmaxf(t_far_z,t_near_z), t_max)));
 
-            if (t_near <= t_far) {
-                if (node.isLeaf(i)) {
-                    int32_t leaf_idx = node.leafIDX(i);
-                    
-                    bool leaf_hit = traceRayLeaf(leaf_idx, node.triSize[i], tri_isect_txfm,
-                        ray_o, t_max, hit_info);
+            child_hit[i] = t_near <= t_far;
+        }
 
-                    if (leaf_hit) {
-                        ray_hit = true;
-                        t_max = hit_info->tHit;
-                    }
-                } else {
-                    // stack->push(node.children[i]);
-                    stack[stack_size++] = node.childrenIdx[i];
+        for (CountT i = 0; i < MeshBVH::nodeWidth; i++) {
+            if (!child_hit[i] || !node.hasChild(i)) {
+                continue;
+            }
+
+            if (node.isLeaf(i)) {
+                int32_t leaf_idx = node.leafIDX(i);
+                
+                bool leaf_hit = traceRayLeaf(leaf_idx, node.triSize[i], tri_isect_txfm,
+                    ray_o, t_max, hit_info);
+
+                if (leaf_hit) {
+                    ray_hit = true;
+                    t_max = hit_info->tHit;
                 }
+            } else {
+                // stack->push(node.children[i]);
+                stack[stack_size++] = node.childrenIdx[i];
             }
         }
     }
@@ -707,33 +692,19 @@ float MeshBVH::sphereCast(math::Vector3 ray_o,
     while (stack_size > 0) { 
         int32_t node_idx = stack[--stack_size];
         const QBVHNode &node = nodes[node_idx];
+        QBVHNode::DecodedChildren children = node.decodeChildren();
+
         MADRONA_UNROLL
         for (CountT i = 0; i < (CountT)MeshBVH::nodeWidth; i++) {
             if (!node.hasChild(i)) {
                 continue; // Technically this could be break?
             };
 
-#ifdef MADRONA_GPU_MODE
-#define U32TOFLOAT(x) (__uint_as_float(x))
-#else
-#define U32TOFLOAT(x) (std::bit_cast<float>(x))
-#endif
-
             math::AABB child_aabb {
-                .pMin = {
-                    node.minPoint.x + U32TOFLOAT(((uint32_t)node.expX + 127) << 23) * node.qMinX[i],
-                    node.minPoint.y + U32TOFLOAT(((uint32_t)node.expY + 127) << 23) * node.qMinY[i],
-                    node.minPoint.z + U32TOFLOAT(((uint32_t)node.expZ + 127) << 23) * node.qMinZ[i],
-                },
-                .pMax = {
-                    node.minPoint.x + U32TOFLOAT(((uint32_t)node.expX + 127) << 23) * node.qMaxX[i],
-                    node.minPoint.y + U32TOFLOAT(((uint32_t)node.expY + 127) << 23) * node.qMaxY[i],
-                    node.minPoint.z + U32TOFLOAT(((uint32_t)node.expZ + 127) << 23) * node.qMaxZ[i],
-                },
+                .pMin = { children.minX[i], children.minY[i], children.minZ[i] },
+                .pMax = { children.maxX[i], children.maxY[i], children.maxZ[i] },
             };
 
-#undef U32TOFLOAT
-
             if (sphereCastNodeCheck(ray_o, inv_d, hit_t, sphere_r, child_aabb)) {
                 if (node.isLeaf(i)) {
                     int32_t leaf_idx = node.leafIDX(i);
@@ -961,7 +932,8 @@ float MeshBVH::sphereCastTriangle(math::Vector3 tri_a,
 	    // Test if segment is fully on the A side of the cylinder
 	    const float start_dot_axis = dot(start, axis);
 	    const float dir_dot_axis = dot(ray_d, axis);
-	    const float end_dot_axis = start_dot_axis + dir_dot_axis;
+	    // ray_d is normalized, so the sweep ends at hit_t rather than 1
+	    const float end_dot_axis = start_dot_axis + dir_dot_axis * hit_t;
 	    if (start_dot_axis < 0.0f && end_dot_axis < 0.0f) {
 	    	return hit_t;
         }
@@ -1017,8 +989,9 @@ float MeshBVH::sphereCastTriangle(math::Vector3 tri_a,
         return t;
     };
 
-    auto testVert = [sphere_r2, ray_d, ray_o](Vector3 v, float hit_t) {
-        Vector3 m = ray_o - v;
+    auto testVert = [sphere_r2, ray_d](Vector3 v, float hit_t) {
+        // v is already relative to the ray origin
+        Vector3 m = -v;
 
         float b = dot(m, ray_d);
         float c = dot(m, m) - sphere_r2;
@@ -1073,6 +1046,448 @@ float MeshBVH::sphereCastTriangle(math::Vector3 tri_a,
     return hit_t;
 }
 
+float MeshBVH::capsuleCastTriangle(math::Vector3 tri_a,
+                                   math::Vector3 tri_b,
+                                   math::Vector3 tri_c,
+                                   math::Vector3 p0,
+                                   math::Vector3 p1,
+                                   math::Vector3 ray_d,
+                                   float t_max,
+                                   float capsule_r) const
+{
+    using namespace math;
+
+    // The first contact of the capsule is between either one of its end
+    // caps and the triangle, a triangle vertex and the capsule's side, or a
+    // triangle edge and the capsule's side. Contacts between the side and
+    // the triangle's face only happen when the segment is parallel to the
+    // face, in which case an end cap or edge touches at the same time.
+
+    const Vector3 axis = p1 - p0;
+    const float axis_len2 = axis.length2();
+    const float r2 = capsule_r * capsule_r;
+
+    // Already overlapping if the segment pierces the triangle
+    {
+        Vector3 ab = tri_b - tri_a;
+        Vector3 ac = tri_c - tri_a;
+        Vector3 n = cross(ab, ac);
+        float d0 = dot(p0 - tri_a, n);
+        float d1 = dot(p1 - tri_a, n);
+        if (d0 * d1 < 0.f) {
+            Vector3 x = p0 + axis * (d0 / (d0 - d1));
+            Vector3 q = geo::triangleClosestPointToOrigin(
+                tri_a - x, tri_b - x, tri_c - x, ab, ac);
+            if (q.length2() <= r2) {
+                return 0.f;
+            }
+        }
+    }
+
+    Vector3 unused_normal;
+    float hit_t = sphereCastTriangle(tri_a, tri_b, tri_c, p0, ray_d, t_max,
+                                     capsule_r, &unused_normal);
+    hit_t = sphereCastTriangle(tri_a, tri_b, tri_c, p1, ray_d, hit_t,
+                               capsule_r, &unused_normal);
+
+    if (hit_t == 0.f || axis_len2 < 1e-12f) {
+        return hit_t;
+    }
+
+    // Cast the vertex backwards against the infinite cylinder around the
+    // segment (RTCD 5.3.7), keeping hits between the end caps
+    auto testVert = [&](Vector3 v, float cur_t) {
+        Vector3 start = v - p0;
+        Vector3 dir = -ray_d;
+
+        float start_dot_axis = dot(start, axis);
+        float dir_dot_axis = dot(dir, axis);
+        float c = axis_len2 * (start.length2() - r2) -
+            start_dot_axis * start_dot_axis;
+
+        if (c <= 0.f && start_dot_axis >= 0.f &&
+                start_dot_axis <= axis_len2) {
+            return 0.f;
+        }
+
+        float a = axis_len2 - dir_dot_axis * dir_dot_axis;
+        if (a <= 1e-6f * axis_len2) {
+            // Moving along the axis, only the end caps can hit
+            return cur_t;
+        }
+
+        float b = axis_len2 * dot(start, dir) - dir_dot_axis * start_dot_axis;
+        float discr = b * b - a * c;
+        if (discr < 0.f) {
+            return cur_t;
+        }
+
+        float t = -(b + sqrtf(discr)) / a;
+        if (t < 0.f || t >= cur_t) {
+            return cur_t;
+        }
+
+        float s = start_dot_axis + t * dir_dot_axis;
+        if (s < 0.f || s > axis_len2) {
+            return cur_t;
+        }
+
+        return t;
+    };
+
+    // The segment moves along d until the distance between the lines
+    // through it and the edge drops to capsule_r. The hit is valid if the
+    // closest points of the two lines are then inside both segments.
+    auto testEdge = [&](Vector3 e0, Vector3 e1, float cur_t) {
+        Vector3 edge = e1 - e0;
+        float edge_len2 = edge.length2();
+
+        Vector3 n = cross(edge, axis);
+        float n_len2 = n.length2();
+        if (n_len2 <= 1e-12f * edge_len2 * axis_len2) {
+            // Parallel, covered by the end cap and vertex tests
+            return cur_t;
+        }
+        n = n / sqrtf(n_len2);
+
+        Vector3 base = p0 - e0;
+        float dist = dot(base, n);
+        float abs_dist = fabsf(dist);
+
+        float t;
+        if (abs_dist <= capsule_r) {
+            t = 0.f;
+        } else {
+            float approach_speed = -copysignf(1.f, dist) * dot(ray_d, n);
+            if (approach_speed <= 0.f) {
+                return cur_t;
+            }
+
+            t = (abs_dist - capsule_r) / approach_speed;
+            if (t >= cur_t) {
+                return cur_t;
+            }
+        }
+
+        Vector3 w = base + ray_d * t;
+        float edge_dot_axis = dot(edge, axis);
+        float edge_dot_w = dot(edge, w);
+        float axis_dot_w = dot(axis, w);
+        float denom = edge_dot_axis * edge_dot_axis - edge_len2 * axis_len2;
+
+        float s = (edge_dot_axis * axis_dot_w - axis_len2 * edge_dot_w) /
+            denom;
+        float u = (edge_len2 * axis_dot_w - edge_dot_axis * edge_dot_w) /
+            denom;
+
+        // s is the parameter along the edge, u along the segment
+        if (s < 0.f || s > 1.f || u < 0.f || u > 1.f) {
+            return cur_t;
+        }
+
+        return t;
+    };
+
+    hit_t = testVert(tri_a, hit_t);
+    hit_t = testVert(tri_b, hit_t);
+    hit_t = testVert(tri_c, hit_t);
+
+    hit_t = testEdge(tri_a, tri_b, hit_t);
+    hit_t = testEdge(tri_b, tri_c, hit_t);
+    hit_t = testEdge(tri_c, tri_a, hit_t);
+
+    return hit_t;
+}
+
+template <typename BoundsFn, typename TriFn, typename NormalFn>
+void MeshBVH::sweepBatch(CountT num_sweeps,
+                         SweepHit *out_hits,
+                         BoundsFn &&bounds_fn,
+                         TriFn &&tri_fn,
+                         NormalFn &&normal_fn) const
+{
+    using namespace math;
+
+    // Packets are formed greedily from blocks of consecutive queries: each
+    // packet starts from the first unassigned query and takes the following
+    // queries whose swept bounds overlap it.
+    constexpr CountT block_size = 64;
+    constexpr CountT packet_size = sweepPacketSize;
+    static_assert(packet_size <= 32);
+
+    struct StackEntry {
+        int32_t nodeIdx;
+        uint32_t packetMask;
+    };
+
+    SweepBounds block_bounds[block_size];
+    AABB block_aabbs[block_size];
+    bool block_assigned[block_size];
+
+    for (CountT block_start = 0; block_start < num_sweeps;
+         block_start += block_size) {
+        CountT block_len = num_sweeps - block_start < block_size ?
+            num_sweeps - block_start : block_size;
+
+        for (CountT i = 0; i < block_len; i++) {
+            SweepBounds bounds = bounds_fn(block_start + i);
+            Vector3 end = bounds.o + bounds.d * bounds.tMax;
+
+            block_bounds[i] = bounds;
+            block_aabbs[i] = AABB {
+                .pMin = Vector3::min(bounds.o, end) - bounds.ext,
+                .pMax = Vector3::max(bounds.o, end) + bounds.ext,
+            };
+            block_assigned[i] = false;
+        }
+
+        for (CountT seed = 0; seed < block_len; seed++) {
+            if (block_assigned[seed]) {
+                continue;
+            }
+
+            CountT packet[packet_size];
+            CountT num_packet = 0;
+            packet[num_packet++] = seed;
+            block_assigned[seed] = true;
+
+            for (CountT i = seed + 1;
+                 i < block_len && num_packet < packet_size; i++) {
+                if (!block_assigned[i] &&
+                        block_aabbs[seed].overlaps(block_aabbs[i])) {
+                    packet[num_packet++] = i;
+                    block_assigned[i] = true;
+                }
+            }
+
+            Vector3 origins[packet_size];
+            Diag3x3 inv_dirs[packet_size];
+            Vector3 exts[packet_size];
+            float hit_ts[packet_size];
+            Vector3 hit_tris[packet_size][3];
+
+            for (CountT q = 0; q < num_packet; q++) {
+                const SweepBounds &bounds = block_bounds[packet[q]];
+                origins[q] = bounds.o;
+                inv_dirs[q] = Diag3x3::fromVec(bounds.d).inv();
+                exts[q] = bounds.ext;
+                hit_ts[q] = bounds.tMax;
+            }
+
+            StackEntry stack[32];
+            stack[0] = { 0, (uint32_t)((1_u64 << num_packet) - 1) };
+            CountT stack_size = 1;
+
+            while (stack_size > 0) {
+                StackEntry entry = stack[--stack_size];
+                const QBVHNode &node = nodes[entry.nodeIdx];
+
+                // Decode the children once for the whole packet
+                QBVHNode::DecodedChildren children = node.decodeChildren();
+
+                uint32_t child_masks[nodeWidth] = {};
+                for (CountT q = 0; q < num_packet; q++) {
+                    if ((entry.packetMask & (1u << q)) == 0) {
+                        continue;
+                    }
+
+                    Vector3 o = origins[q];
+                    Diag3x3 inv_d = inv_dirs[q];
+                    Vector3 ext = exts[q];
+                    float t_max = hit_ts[q];
+
+                    // Slab test of the ray against all children expanded
+                    // by the query's extents. Branch free across the
+                    // children so it runs as one vector operation.
+                    MADRONA_UNROLL
+                    for (CountT i = 0; i < nodeWidth; i++) {
+                        float lo_x = (children.minX[i] - ext.x - o.x) * inv_d.d0;
+                        float hi_x = (children.maxX[i] + ext.x - o.x) * inv_d.d0;
+                        float lo_y = (children.minY[i] - ext.y - o.y) * inv_d.d1;
+                        float hi_y = (children.maxY[i] + ext.y - o.y) * inv_d.d1;
+                        float lo_z = (children.minZ[i] - ext.z - o.z) * inv_d.d2;
+                        float hi_z = (children.maxZ[i] + ext.z - o.z) * inv_d.d2;
+
+                        float t_enter = fmaxf(
+                            fmaxf(fminf(lo_x, hi_x), fminf(lo_y, hi_y)),
+                            fmaxf(fminf(lo_z, hi_z), 0.f));
+                        float t_exit = fminf(
+                            fminf(fmaxf(lo_x, hi_x), fmaxf(lo_y, hi_y)),
+                            fminf(fmaxf(lo_z, hi_z), t_max));
+
+                        child_masks[i] |= (uint32_t)(t_enter <= t_exit) << q;
+                    }
+                }
+
+                for (CountT i = 0; i < nodeWidth; i++) {
+                    uint32_t child_mask = child_masks[i];
+                    if (child_mask == 0 || !node.hasChild(i)) {
+                        continue;
+                    }
+
+                    if (!node.isLeaf(i)) {
+                        stack[stack_size++] = StackEntry {
+                            (int32_t)node.childrenIdx[i],
+                            child_mask,
+                        };
+                        continue;
+                    }
+
+                    int32_t leaf_idx = node.leafIDX(i);
+                    for (CountT tri = 0; tri < node.triSize[i]; tri++) {
+                        Vector3 a, b, c;
+                        Vector2 uva, uvb, uvc;
+                        bool tri_exists = fetchLeafTriangle(
+                            leaf_idx, tri, &a, &b, &c, &uva, &uvb, &uvc);
+                        if (!tri_exists) continue;
+
+                        for (CountT q = 0; q < num_packet; q++) {
+                            if ((child_mask & (1u << q)) == 0) {
+                                continue;
+                            }
+
+                            float t = tri_fn(block_start + packet[q],
+                                             a, b, c, hit_ts[q]);
+                            if (t < hit_ts[q]) {
+                                hit_ts[q] = t;
+                                hit_tris[q][0] = a;
+                                hit_tris[q][1] = b;
+                                hit_tris[q][2] = c;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for (CountT q = 0; q < num_packet; q++) {
+                CountT sweep_idx = block_start + packet[q];
+                SweepHit &hit = out_hits[sweep_idx];
+
+                hit.tHit = hit_ts[q];
+                if (hit_ts[q] < block_bounds[packet[q]].tMax) {
+                    hit.normal = normal_fn(sweep_idx, hit_ts[q],
+                        hit_tris[q][0], hit_tris[q][1], hit_tris[q][2]);
+                }
+            }
+        }
+    }
+}
+
+math::Vector3 MeshBVH::sweepHitNormal(math::Vector3 separation,
+                                      math::Vector3 tri_a,
+                                      math::Vector3 tri_b,
+                                      math::Vector3 tri_c,
+                                      math::Vector3 ray_d)
+{
+    using namespace math;
+
+    float separation_len2 = separation.length2();
+    if (separation_len2 > 1e-12f) {
+        return separation / sqrtf(separation_len2);
+    }
+
+    Vector3 face_normal = normalize(cross(tri_b - tri_a, tri_c - tri_a));
+    return dot(face_normal, ray_d) > 0.f ? -face_normal : face_normal;
+}
+
+void MeshBVH::sphereCastBatch(const SphereSweep *sweeps,
+                              SweepHit *out_hits,
+                              CountT num_sweeps) const
+{
+    using namespace math;
+
+    sweepBatch(num_sweeps, out_hits,
+        [sweeps](CountT i) {
+            const SphereSweep &sweep = sweeps[i];
+            return SweepBounds {
+                .o = sweep.o,
+                .d = sweep.d,
+                .ext = Vector3::all(sweep.radius),
+                .tMax = sweep.tMax,
+            };
+        },
+        [this, sweeps](CountT i, Vector3 a, Vector3 b, Vector3 c,
+                       float t_max) {
+            const SphereSweep &sweep = sweeps[i];
+
+            Vector3 unused_normal;
+            return sphereCastTriangle(a, b, c, sweep.o, sweep.d, t_max,
+                                      sweep.radius, &unused_normal);
+        },
+        [sweeps](CountT i, float t, Vector3 a, Vector3 b, Vector3 c) {
+            const SphereSweep &sweep = sweeps[i];
+            Vector3 center = sweep.o + sweep.d * t;
+
+            Vector3 to_closest = geo::triangleClosestPointToOrigin(
+                a - center, b - center, c - center, b - a, c - a);
+
+            return sweepHitNormal(-to_closest, a, b, c, sweep.d);
+        });
+}
+
+void MeshBVH::capsuleCastBatch(const CapsuleSweep *sweeps,
+                               SweepHit *out_hits,
+                               CountT num_sweeps) const
+{
+    using namespace math;
+
+    sweepBatch(num_sweeps, out_hits,
+        [sweeps](CountT i) {
+            const CapsuleSweep &sweep = sweeps[i];
+            Vector3 half_axis = 0.5f * (sweep.p1 - sweep.p0);
+
+            return SweepBounds {
+                .o = sweep.p0 + half_axis,
+                .d = sweep.d,
+                .ext = Vector3 {
+                    fabsf(half_axis.x) + sweep.radius,
+                    fabsf(half_axis.y) + sweep.radius,
+                    fabsf(half_axis.z) + sweep.radius,
+                },
+                .tMax = sweep.tMax,
+            };
+        },
+        [this, sweeps](CountT i, Vector3 a, Vector3 b, Vector3 c,
+                       float t_max) {
+            const CapsuleSweep &sweep = sweeps[i];
+            return capsuleCastTriangle(a, b, c, sweep.p0, sweep.p1, sweep.d,
+                                       t_max, sweep.radius);
+        },
+        [sweeps](CountT i, float t, Vector3 a, Vector3 b, Vector3 c) {
+            const CapsuleSweep &sweep = sweeps[i];
+            Vector3 p0 = sweep.p0 + sweep.d * t;
+            Vector3 p1 = sweep.p1 + sweep.d * t;
+
+            // Closest points between the segment and the triangle, which
+            // are on an end point or against one of the edges
+            Vector3 best_separation;
+            float best_dist2 = FLT_MAX;
+            auto consider = [&](Vector3 on_segment, Vector3 on_tri) {
+                Vector3 separation = on_segment - on_tri;
+                float dist2 = separation.length2();
+                if (dist2 < best_dist2) {
+                    best_dist2 = dist2;
+                    best_separation = separation;
+                }
+            };
+
+            consider(p0, p0 + geo::triangleClosestPointToOrigin(
+                a - p0, b - p0, c - p0, b - a, c - a));
+            consider(p1, p1 + geo::triangleClosestPointToOrigin(
+                a - p1, b - p1, c - p1, b - a, c - a));
+
+            Vector3 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+            for (CountT e = 0; e < 3; e++) {
+                Vector3 on_segment, on_edge;
+                geo::segmentClosestPoints(p0, p1, edges[e][0], edges[e][1],
+                                          &on_segment, &on_edge);
+                consider(on_segment, on_edge);
+            }
+
+            return sweepHitNormal(best_separation, a, b, c, sweep.d);
+        });
+}
+
 uint32_t MeshBVH::getMaterialIDX(const HitInfo &info) const
 {
     if (materialIDX == -1) {
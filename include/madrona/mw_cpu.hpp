@@ -21,8 +21,23 @@ public:
         uint32_t numWorlds;
         // Number of exported ECS components
         uint32_t numExportedBuffers;
-        // Number of worker threads
+        // Number of worker threads, 0 = one per CPU in cpuList, or one per
+        // CPU in the process affinity mask if cpuList is empty
         uint32_t numWorkers = 0;
+        // OS CPU IDs to pin workers to (worker i runs on
+        // cpuList[i % size]). Empty = the i-th CPU in the affinity mask.
+        Span<const int32_t> cpuList = {};
+        // How long idle workers and the main thread spin waiting for a
+        // step before sleeping in the kernel. Short steps benefit from a
+        // few tens of microseconds, 0 sleeps immediately.
+        uint32_t spinWaitMicroseconds = 0;
+        // If nonzero, after this many task graph runs every growable
+        // archetype table is switched to fixed per world capacity, sized
+        // from the most rows any world used so far times tableHeadroom
+        // (see StateManager::fixTableCapacities). Worlds that later exceed
+        // the capacity fall back to a growable table of their own.
+        uint32_t tableWarmupSteps = 0;
+        float tableHeadroom = 1.25f;
     };
 
     struct Job {
@@ -30,16 +45,68 @@ public:
         void *data;
     };
 
+    enum class ReduceOp : uint32_t {
+        Sum,
+        Mean,
+        Min,
+        Max,
+        Histogram,
+    };
+
+    enum class ReduceValueType : uint32_t {
+        Float32,
+        Int32,
+    };
+
+    // A reduction across all worlds of one value in an exported component.
+    // The exported archetype must have numRowsPerWorld rows in every world.
+    struct Reduction {
+        ReduceOp op;
+        CountT exportSlot;
+        ReduceValueType valueType = ReduceValueType::Float32;
+        CountT numRowsPerWorld = 1;
+        // Bytes between consecutive rows and offset of the value in a row
+        uint32_t rowStride = sizeof(float);
+        uint32_t valueOffset = 0;
+        // Histogram only: numBins bins evenly covering [histMin, histMax).
+        // Out of range values are clamped into the edge bins, NaNs are not
+        // counted.
+        uint32_t numBins = 0;
+        float histMin = 0.f;
+        float histMax = 1.f;
+    };
+
     ThreadPoolExecutor(const Config &cfg);
     ThreadPoolExecutor(ThreadPoolExecutor &&o);
 
     ~ThreadPoolExecutor();
     void run(Job *jobs, CountT num_jobs);
 
+    // Only the first num_active workers pick up jobs from subsequent run()
+    // calls, the rest sleep. Lets the simulation shrink while other work
+    // (e.g. a learner update) is using the same cores. Must not be called
+    // concurrently with run().
+    void setNumActiveWorkers(CountT num_active);
+    CountT numWorkers() const;
+
     // Get the base pointer of the component data exported with
     // ECSRegister::exportColumn
     void * getExported(CountT slot) const;
 
+    // Registers a cross-world reduction and returns the index of its first
+    // output in reductionOutputs() (numBins outputs for histograms, 1
+    // otherwise). Register all reductions before reading the output
+    // pointer, it moves when the output buffer grows.
+    CountT addReduction(const Reduction &reduction);
+
+    // Workers reduce fixed size chunks of worlds and the chunk results are
+    // combined in a fixed pairwise tree, so outputs are bitwise identical
+    // regardless of thread count or scheduling.
+    void runReductions();
+
+    float * reductionOutputs() const;
+    CountT numReductionOutputs() const;
+
 protected:
     void initializeContexts(
         Context & (*init_fn)(void *, const WorkerInit &, CountT),
@@ -91,6 +158,19 @@ public:
     // ECSRegister::exportColumn
     using ThreadPoolExecutor::getExported;
 
+    using ThreadPoolExecutor::setNumActiveWorkers;
+    using ThreadPoolExecutor::numWorkers;
+
+    // Reductions are run automatically at the end of run(), call
+    // runReductions directly when stepping with runTaskGraph
+    using ThreadPoolExecutor::Reduction;
+    using ThreadPoolExecutor::ReduceOp;
+    using ThreadPoolExecutor::ReduceValueType;
+    using ThreadPoolExecutor::addReduction;
+    using ThreadPoolExecutor::runReductions;
+    using ThreadPoolExecutor::reductionOutputs;
+    using ThreadPoolExecutor::numReductionOutputs;
+
     // Get a reference to the per world data class
     inline WorldT & getWorldData(CountT world_idx);
 
@@ -109,6 +189,94 @@ private:
     uint32_t num_taskgraphs_;
 };
 
+// Base class for MultiProcessTaskGraphExecutor below, don't use directly
+class MultiProcessExecutor {
+public:
+    struct Config {
+        // Total batch size across all processes
+        uint32_t numWorlds;
+        // Number of exported ECS components
+        uint32_t numExportedBuffers;
+        // Size in bytes of each exported component per world
+        // (numExportedBuffers entries). Exported archetypes must have a
+        // fixed number of rows per world so the per process exports can
+        // be concatenated into one batch.
+        const uint64_t *exportedBytesPerWorld;
+        // Number of simulation processes, 0 = one per NUMA node
+        uint32_t numProcesses = 0;
+    };
+
+    MultiProcessExecutor(const Config &cfg);
+    MultiProcessExecutor(MultiProcessExecutor &&o);
+
+    ~MultiProcessExecutor();
+    void run(uint32_t taskgraph_idx);
+
+    // Get the base pointer of the shared memory buffer that holds the
+    // concatenation of every process's copy of exported slot
+    void * getExported(CountT slot) const;
+
+    CountT numProcesses() const;
+
+protected:
+    struct ShardInit {
+        uint32_t worldOffset;
+        uint32_t numWorlds;
+    };
+
+    struct Shard {
+        void *data;
+        void (*run)(void *, uint32_t);
+        void * (*getExported)(void *, CountT);
+        void (*destroy)(void *);
+    };
+
+    // Forks the simulation processes. make_shard is called in each child
+    // after it has been pinned to its NUMA node, the child never returns.
+    void launchShards(Shard (*make_shard)(void *, const ShardInit &),
+                      void *make_data);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// MultiProcessTaskGraphExecutor splits the batch across one
+// TaskGraphExecutor process per NUMA node (Linux only). Each process owns a
+// contiguous range of worlds and a thread pool pinned to the CPUs of its
+// node, so simulation memory stays node local and the thread pool atomics
+// are never shared across sockets. Processes are stepped in lockstep through
+// a shared memory barrier and their exports are copied into shared buffers
+// laid out exactly like a single TaskGraphExecutor's, so getExported
+// pointers can be wrapped in the usual TrainInterface tensors.
+//
+// Worlds are constructed in the child processes, so the WorldT instances
+// aren't accessible from the launching process and the world IDs seen by
+// systems are local to each process (user_inits is offset to match).
+// Construct this before the launching process starts other threads.
+template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
+class MultiProcessTaskGraphExecutor : private MultiProcessExecutor {
+public:
+    MultiProcessTaskGraphExecutor(
+        const Config &cfg,
+        const ConfigT &user_cfg,
+        const InitT *user_inits,
+        CountT num_taskgraphs);
+
+    template <EnumType EnumT>
+    inline void runTaskGraph(EnumT taskgraph_id);
+
+    inline void runTaskGraph(uint32_t taskgraph_idx);
+
+    inline void run();
+
+    using MultiProcessExecutor::getExported;
+    using MultiProcessExecutor::numProcesses;
+
+private:
+    uint32_t num_taskgraphs_;
+};
+
 }
 
 #include "mw_cpu.inl"
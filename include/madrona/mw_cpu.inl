@@ -94,6 +94,8 @@ void TaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::run()
     for (uint32_t i = 0; i < (uint32_t)num_taskgraphs_; i++) {
         runTaskGraph(i);
     }
+
+    ThreadPoolExecutor::runReductions();
 }
 
 template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
@@ -110,4 +112,67 @@ ContextT & TaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::getWorldContext(
     return contexts_[world_idx];
 }
 
+template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
+MultiProcessTaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::
+MultiProcessTaskGraphExecutor(
+        const Config &cfg,
+        const ConfigT &user_cfg,
+        const InitT *user_inits,
+        CountT num_taskgraphs)
+    : MultiProcessExecutor(cfg),
+      num_taskgraphs_((uint32_t)num_taskgraphs)
+{
+    using ShardExecutor = TaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>;
+
+    auto make_shard_cb = [&](const ShardInit &shard_init) -> Shard {
+        auto exec = new ShardExecutor(ThreadPoolExecutor::Config {
+            .numWorlds = shard_init.numWorlds,
+            .numExportedBuffers = cfg.numExportedBuffers,
+            // The child's affinity mask is already restricted to its node
+            .numWorkers = 0,
+        }, user_cfg, user_inits + shard_init.worldOffset, num_taskgraphs);
+
+        return Shard {
+            .data = exec,
+            .run = [](void *ptr, uint32_t taskgraph_idx) {
+                ((ShardExecutor *)ptr)->runTaskGraph(taskgraph_idx);
+            },
+            .getExported = [](void *ptr, CountT slot) {
+                return ((ShardExecutor *)ptr)->getExported(slot);
+            },
+            .destroy = [](void *ptr) {
+                delete (ShardExecutor *)ptr;
+            },
+        };
+    };
+
+    using CBPtrT = decltype(&make_shard_cb);
+    launchShards([](void *ptr_raw, const ShardInit &shard_init) -> Shard {
+        return (*(CBPtrT)ptr_raw)(shard_init);
+    }, &make_shard_cb);
+}
+
+template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
+template <EnumType EnumT>
+void MultiProcessTaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::
+    runTaskGraph(EnumT taskgraph_id)
+{
+    runTaskGraph(static_cast<uint32_t>(taskgraph_id));
+}
+
+template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
+void MultiProcessTaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::
+    runTaskGraph(uint32_t taskgraph_idx)
+{
+    MultiProcessExecutor::run(taskgraph_idx);
+}
+
+template <typename ContextT, typename WorldT, typename ConfigT, typename InitT>
+void MultiProcessTaskGraphExecutor<ContextT, WorldT, ConfigT, InitT>::run()
+{
+    for (uint32_t i = 0; i < num_taskgraphs_; i++) {
+        runTaskGraph(i);
+    }
+}
+
 }
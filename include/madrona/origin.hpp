@@ -0,0 +1,84 @@
+#pragma once
+
+#include <madrona/components.hpp>
+#include <madrona/span.hpp>
+#include <madrona/taskgraph_builder.hpp>
+#include <madrona/context.hpp>
+
+namespace madrona::origin {
+
+// Origin rebasing for worlds larger than float precision allows. Position
+// stays a float Vector3, but relative to a per world origin that follows an
+// anchor entity (usually the agent or camera). When the anchor gets more
+// than Config::rebaseDistance from the origin, the origin moves by whole
+// cells and every Position in the world is shifted to match, along with the
+// physics broadphase. Everything derived from Position each step (physics
+// solver state, hierarchy, render InstanceData, cameras and lights, topdown
+// observations) follows automatically.
+//
+// Cells are a power of two in size, so every shift is a whole multiple of
+// the cell size and exactly representable. Subtracting it is exact for
+// every entity that ends up closer to the new origin than it was to the old
+// one, as long as the cell size is no finer than the float spacing at that
+// entity's position. Other entities are rounded once, like any float
+// subtraction. The absolute position of anything
+// is local + WorldOrigin::offset(), computed in double. WorldOrigin can be
+// exported with ECSRegistry::exportSingleton so training code can recover
+// absolute coordinates from local observations.
+//
+// Data stored in world space outside of Position (navmeshes, waypoints,
+// spawn points) must be converted with toLocal() when it is used.
+
+struct WorldPosition {
+    double x;
+    double y;
+    double z;
+};
+
+struct WorldOrigin {
+    int32_t cellX;
+    int32_t cellY;
+    int32_t cellZ;
+    float cellSize;
+
+    inline WorldPosition offset() const;
+    inline WorldPosition toWorld(math::Vector3 local) const;
+    inline math::Vector3 toLocal(WorldPosition world) const;
+};
+
+struct Config {
+    // Granularity of origin moves, must be a power of two
+    float cellSize;
+    // The origin is moved once the anchor is further than this from it
+    // along any axis
+    float rebaseDistance;
+    // Shift the physics broadphase BVH and particles with the origin.
+    // Requires PhysicsSystem to be registered and initialized. Must be set
+    // if particles are used, otherwise they jump by every shift.
+    bool shiftPhysics;
+};
+
+void registerTypes(ECSRegistry &registry);
+
+void init(Context &ctx, const Config &cfg);
+
+// The origin follows this entity, which must have a Position.
+// Entity::none() (the default) disables rebasing.
+void setAnchor(Context &ctx, Entity anchor);
+
+// Moves the origin back to zero on the next rebase task, e.g. after a reset
+// that places entities at absolute coordinates. Positions and the
+// broadphase are not shifted: every Position is taken to already be
+// absolute (relative to a zero origin) by then. The anchor is checked again
+// from the following step.
+void resetOrigin(Context &ctx);
+
+// Checks the anchor and, if needed, moves the origin and shifts every
+// Position. Add at the start of the step, before the physics broadphase
+// tasks and anything else that reads Position.
+TaskGraphNodeID setupRebaseTasks(TaskGraphBuilder &builder,
+                                 Span<const TaskGraphNodeID> deps);
+
+}
+
+#include "origin.inl"
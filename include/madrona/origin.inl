@@ -0,0 +1,36 @@
+namespace madrona::origin {
+
+WorldPosition WorldOrigin::offset() const
+{
+    double cell_size = cellSize;
+
+    return WorldPosition {
+        double(cellX) * cell_size,
+        double(cellY) * cell_size,
+        double(cellZ) * cell_size,
+    };
+}
+
+WorldPosition WorldOrigin::toWorld(math::Vector3 local) const
+{
+    WorldPosition o = offset();
+
+    return WorldPosition {
+        o.x + double(local.x),
+        o.y + double(local.y),
+        o.z + double(local.z),
+    };
+}
+
+math::Vector3 WorldOrigin::toLocal(WorldPosition world) const
+{
+    WorldPosition o = offset();
+
+    return math::Vector3 {
+        float(world.x - o.x),
+        float(world.y - o.y),
+        float(world.z - o.z),
+    };
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <madrona/math.hpp>
+#include <madrona/context.hpp>
+
+namespace madrona::phys::particles {
+
+// Large populations of small spheres (debris, granular media, ball pits)
+// that don't need to be entities. Particles are stored per world as
+// structure of arrays and simulated inside the XPBD substep loop next to
+// the rigid bodies, instead of going through CandidateTemporary and the
+// narrowphase with a temporary entity per pair:
+//  - particle - particle contacts are found with a uniform hash grid
+//    rebuilt every substep, cells 2 * maxRadius wide
+//  - particle - rigid body pairs are found once per step by querying the
+//    broadphase BVH (including a shared static tree), and resolved
+//    against the body's sphere, hull and plane primitives every substep
+//    with the same XPBD contact constraint as rigid contacts, so dynamic
+//    bodies are pushed back by the particles.
+// Contacts are inelastic with positional Coulomb friction. Particles don't
+// generate CollisionEvents. Only supported with the XPBD solver.
+//
+// Call init after PhysicsSystem::init; without it the particle tasks do
+// nothing. With origin rebasing, set origin::Config::shiftPhysics so
+// particles move with the origin.
+
+struct Config {
+    CountT maxParticles;
+    // Largest radius passed to spawn, sets the hash grid cell size
+    float maxRadius;
+    // Coulomb coefficient for particle - particle contacts. Contacts with
+    // rigid bodies average it with the body's static friction.
+    float friction;
+    // Particle - rigid body pairs with overlapping bounds per step.
+    // Exceeding it is fatal.
+    CountT maxRigidPairs;
+};
+
+// Read-only view of a world's particles, valid until the next spawn,
+// clear or physics step
+struct ParticleData {
+    CountT numParticles;
+    const float *posX;
+    const float *posY;
+    const float *posZ;
+    const float *velX;
+    const float *velY;
+    const float *velZ;
+    const float *radii;
+};
+
+void init(Context &ctx, const Config &cfg);
+
+// Returns the new particle's index, which stays the same until clear.
+// mass <= 0 pins the particle in place.
+CountT spawn(Context &ctx,
+             math::Vector3 position,
+             math::Vector3 velocity,
+             float radius,
+             float mass);
+
+void clear(Context &ctx);
+
+ParticleData getParticles(Context &ctx);
+
+}
@@ -99,6 +99,25 @@ struct CollisionEvent {
 
 struct CollisionEventTemporary : Archetype<CollisionEvent> {};
 
+// Number of substeps the world ran in the last physics step. Export with
+// ECSRegistry::exportSingleton to monitor adaptive substepping.
+struct SubstepCount {
+    int32_t numSubsteps;
+};
+
+// Optional component limiting what an entity sees in
+// PhysicsSystem::checkLineOfSight: targets further than maxDistance or
+// outside the cone around the entity's forward (+Y) axis aren't visible.
+struct ViewCone {
+    float cosHalfAngle;
+    float maxDistance;
+};
+
+struct LineOfSightQuery {
+    Entity viewer;
+    Entity target;
+};
+
 // Per object state
 struct RigidBodyMassData {
     float invMass;
@@ -170,11 +189,43 @@ namespace PhysicsSystem {
               CountT max_dynamic_objects,
               Solver solver = Solver::XPBD);
 
+    // With adaptive substepping each world picks its substep count at the
+    // start of every step as the largest of:
+    //  - fastest body's motion over the step, relative to its smallest
+    //    extent, divided by maxMotionRatio
+    //  - last step's deepest contact penetration / maxPenetration, and
+    //    largest joint error / maxJointError, scaled by last step's count
+    // clamped to [minSubsteps, num_substeps passed to init]. The three
+    // limits must be positive. Worlds without this config always run
+    // num_substeps. Call after init; the graph must be built with the same
+    // num_substeps as init.
+    struct AdaptiveSubstepConfig {
+        CountT minSubsteps;
+        float maxMotionRatio;
+        float maxPenetration;
+        float maxJointError;
+    };
+
+    void setAdaptiveSubsteps(Context &ctx,
+                             const AdaptiveSubstepConfig &config);
+
     void reset(Context &ctx);
     broadphase::LeafID registerEntity(Context &ctx,
                                       Entity e,
                                       base::ObjectID obj_id);
 
+    // Makes every world query static_bvh (from
+    // PhysicsLoader::buildStaticBVH) for static colliders shared by all
+    // worlds, see broadphase::BVH::setStaticTree. Call once after init,
+    // then bind each instance to this world's entity for it with
+    // registerStaticEntity instead of registerEntity. The entity must be a
+    // ResponseType::Static rigid body placed at the instance's transform.
+    void setStaticBVH(Context &ctx, const broadphase::BVH *static_bvh);
+
+    broadphase::LeafID registerStaticEntity(Context &ctx,
+                                            Entity e,
+                                            CountT static_idx);
+
     template <typename Fn>
     void findEntitiesWithinAABB(Context &ctx,
                                        math::AABB aabb,
@@ -184,6 +235,16 @@ namespace PhysicsSystem {
                                        math::AABB aabb,
                                        Entity e);
 
+    // Sets out_visible[i] if nothing in the broadphase BVH blocks the
+    // segment between the Positions of queries[i]'s viewer and target.
+    // The viewer's and target's own bodies never block, any hit ends the
+    // ray early, and viewers with a ViewCone reject targets outside it
+    // before tracing. Queries sharing a viewer should be consecutive (e.g.
+    // an N x M visibility matrix in row order) to reuse its setup.
+    void checkLineOfSight(Context &ctx,
+                          Span<const LineOfSightQuery> queries,
+                          bool *out_visible);
+
     Entity makeFixedJoint(Context &ctx,
                           Entity e1, Entity e2,
                           math::Quat attach_rot1, math::Quat attach_rot2,
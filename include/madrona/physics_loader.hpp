@@ -17,7 +17,24 @@ public:
 
     ObjectManager & getObjectManager();
 
+    struct StaticInstance {
+        base::ObjectID objID;
+        math::Vector3 position;
+        math::Quat rotation;
+        math::Diag3x3 scale;
+    };
+
+    // Builds one read-only broadphase tree over static colliders that are
+    // identical in every world, for PhysicsSystem::setStaticBVH. The tree
+    // lives in the backend's memory and is owned by the loader. A world's
+    // entity for instances[i] is bound with
+    // PhysicsSystem::registerStaticEntity(ctx, e, i).
+    const broadphase::BVH * buildStaticBVH(
+        Span<const StaticInstance> instances);
+
 private:
+    static void freeHostBVH(broadphase::BVH *bvh);
+
     struct Impl;
     std::unique_ptr<Impl> impl_;
 };
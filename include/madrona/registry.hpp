@@ -69,6 +69,18 @@ public:
     template <typename SingletonT, EnumType EnumT>
     void exportSingleton(EnumT slot);
 
+    // Export with a compact encoding (CPU backend), see ExportEncoding.
+    // The exported tensor has 16 bit elements.
+    template <typename ArchetypeT, typename ComponentT>
+    void exportColumn(int32_t slot, ExportEncoding encoding);
+    template <typename SingletonT>
+    void exportSingleton(int32_t slot, ExportEncoding encoding);
+
+    template <typename ArchetypeT, typename ComponentT, EnumType EnumT>
+    void exportColumn(EnumT slot, ExportEncoding encoding);
+    template <typename SingletonT, EnumType EnumT>
+    void exportSingleton(EnumT slot, ExportEncoding encoding);
+
 private:
     StateManager *state_mgr_;
     void **export_ptrs_;
@@ -67,4 +67,30 @@ void ECSRegistry::exportSingleton(EnumT slot)
     exportSingleton<SingletonT>(static_cast<uint32_t>(slot));
 }
 
+template <typename ArchetypeT, typename ComponentT>
+void ECSRegistry::exportColumn(int32_t slot, ExportEncoding encoding)
+{
+    export_ptrs_[slot] =
+        state_mgr_->exportColumn<ArchetypeT, ComponentT>(encoding);
+}
+
+template <typename SingletonT>
+void ECSRegistry::exportSingleton(int32_t slot, ExportEncoding encoding)
+{
+    export_ptrs_[slot] = state_mgr_->exportSingleton<SingletonT>(encoding);
+}
+
+template <typename ArchetypeT, typename ComponentT, EnumType EnumT>
+void ECSRegistry::exportColumn(EnumT slot, ExportEncoding encoding)
+{
+    exportColumn<ArchetypeT, ComponentT>(static_cast<uint32_t>(slot),
+                                         encoding);
+}
+
+template <typename SingletonT, EnumType EnumT>
+void ECSRegistry::exportSingleton(EnumT slot, ExportEncoding encoding)
+{
+    exportSingleton<SingletonT>(static_cast<uint32_t>(slot), encoding);
+}
+
 }
@@ -37,6 +37,17 @@ public:
         ExecMode execMode;
 
         VoxelConfig voxelCfg;
+
+        // CPU backend only: render the agent views with the CPU tile
+        // rasterizer instead of the Vulkan batch renderer. Meant for
+        // small views; batchRendererRGBOut / batchRendererDepthOut return
+        // host pointers in this case.
+        bool useCPURasterizer = false;
+        // Threads used by the CPU rasterizer, separate from the executor's
+        // workers. 0 picks min(4, cores).
+        uint32_t numCPURasterThreads = 0;
+        // Instances covering fewer pixels than this are not drawn
+        float cpuRasterMinProjectedSize = 0.f;
     };
 
     RenderManager(APIBackend *render_backend,
@@ -58,6 +69,8 @@ public:
     inline RenderContext & renderContext() const;
 
     // Processes the ECS's output in order to be ready for rendering.
+    // If a viewer is running the simulation asynchronously, this only
+    // snapshots the output for the viewer to render later.
     void readECS();
 
     // Draw the batched output for all worlds
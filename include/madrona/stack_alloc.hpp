@@ -6,7 +6,8 @@
 namespace madrona {
 
 struct AllocFrame {
-    void *ptr;
+    void *chunk;
+    uint32_t offset;
 };
 
 class StackAlloc {
@@ -33,7 +33,8 @@ StackAlloc & StackAlloc::operator=(StackAlloc &&o)
 AllocFrame StackAlloc::push()
 {
     return AllocFrame {
-        cur_chunk_ + chunk_offset_,
+        cur_chunk_,
+        chunk_offset_,
     };
 }
 
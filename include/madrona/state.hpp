@@ -100,6 +100,7 @@ public:
 #else
     StateManager();
 #endif
+    ~StateManager();
 
     template <typename ComponentT>
     ComponentID registerComponent(uint32_t num_bytes = 0);
@@ -125,6 +126,13 @@ public:
     template <typename SingletonT>
     SingletonT * exportSingleton();
 
+    // Encoded exports return the untyped encoded buffer
+    template <typename ArchetypeT, typename ComponentT>
+    void * exportColumn(ExportEncoding encoding);
+
+    template <typename SingletonT>
+    void * exportSingleton(ExportEncoding encoding);
+
     void copyInExportedColumns();
     void copyOutExportedColumns();
 
@@ -212,6 +220,53 @@ public:
     void * tmpAlloc(MADRONA_MW_COND(uint32_t world_id,) uint64_t num_bytes);
     void resetTmpAlloc(MADRONA_MW_COND(uint32_t world_id));
 
+    // Pool of prebuilt world states used for cheap episode resets.
+    // captureInitialState copies every row of every archetype in the world
+    // (except singletons and ArchetypeFlags::ExcludeFromInitialState
+    // archetypes) into a new pool entry and returns its index.
+    // restoreInitialState makes the world's tables match a pool entry with
+    // one bulk copy per column, reusing the world's existing entities and
+    // only creating / destroying entities if the row counts differ.
+    // Entity handles stored inside components are copied as is, so
+    // captured worlds shouldn't reference their own entities in components.
+    CountT captureInitialState(MADRONA_MW_COND(uint32_t world_id));
+    void restoreInitialState(MADRONA_MW_COND(uint32_t world_id,)
+                             StateCache &cache, CountT state_idx);
+    CountT numInitialStates() const;
+
+    // Gives world_id a private copy of an ArchetypeFlags::SharedTemplate
+    // archetype's rows, so it can modify component values without affecting
+    // other worlds. Entities keep their rows, so existing handles stay
+    // valid. No-op for other archetypes or if the world already has a copy.
+    // Seals the archetype (see sealSharedTemplates). Writable access to a
+    // sealed shared archetype does this implicitly.
+    void makeWorldLocal(MADRONA_MW_COND(uint32_t world_id,)
+                        uint32_t archetype_id);
+
+#ifdef MADRONA_MW_MODE
+    // Ends setup of ArchetypeFlags::SharedTemplate archetypes. Before this,
+    // rows can be added and written through any world and every world sees
+    // the changes. Afterwards the shared rows are read only: a world that
+    // writes a component (non-const query column or get) first gets its
+    // own copy, and adding, removing or clearing rows is fatal. Called by
+    // the CPU executor before the first step. Must not be called while
+    // worlds are running.
+    void sealSharedTemplates();
+#endif
+
+#ifdef MADRONA_MW_MODE
+    // Moves every growable archetype to the fixed per world layout used
+    // when registerArchetype is given max_num_entities_per_world: one
+    // allocation per column, with each world's rows at a fixed offset.
+    // Capacity is the most rows any world has held since the archetype was
+    // registered times headroom (at least min_rows_per_world). A world that
+    // later outgrows its capacity moves to a private growable table until
+    // the archetype is next cleared in that world. Shared template archetypes
+    // and archetypes with exported columns are left growable. Must not be
+    // called while worlds are running.
+    void fixTableCapacities(float headroom, CountT min_rows_per_world);
+#endif
+
 private:
     template <typename SingletonT>
     struct SingletonArchetype : public madrona::Archetype<SingletonT> {};
@@ -224,21 +279,59 @@ private:
     // Table is always just an array of pointers
     struct TableStorage {
 #ifdef MADRONA_MW_MODE
+        // World w's rows start at row w * maxNumPerWorld of tbl. A world
+        // that outgrows its slice moves its rows to overflowTbls[w] and
+        // uses that growable table until it is cleared.
         struct Fixed {
             Table tbl;
             HeapArray<int32_t> activeRows;
+            HeapArray<Table *> overflowTbls;
+        };
+
+        // Template rows shared by all worlds. worldTbls[world] points at
+        // tbl until that world makes the archetype local, after which it
+        // points at the world's private copy. Rows are added and written
+        // through tbl until the template is sealed; afterwards tbl is read
+        // only, the first write from a world copies it, and the row set
+        // can't change.
+        struct Shared {
+            Table tbl;
+            HeapArray<Table *> worldTbls;
+            // WorldID column of tbl as seen by each world, [world][row].
+            // Allocated when sealed.
+            WorldID *worldIDs;
+            bool sealed;
         };
 
         union {
             HeapArray<Table> tbls;
             Fixed fixed;
+            Shared shared;
         };
+        HeapArray<TypeInfo> types;
         CountT maxNumPerWorld;
+        bool isShared;
+        // Fixed tables exported without encoding hand out a pointer to
+        // fixed.tbl, so they can't overflow or change layout.
+        bool isExported;
 
         inline TableStorage(Span<TypeInfo> types,
                             CountT num_worlds,
-                            CountT max_num_per_world);
+                            CountT max_num_per_world,
+                            bool is_shared);
         ~TableStorage();
+
+        void makeWorldLocal(uint32_t world_id);
+        void seal();
+        // Column col_idx of world_id's view of a shared table. A write
+        // access makes the archetype local to the world once sealed.
+        void * sharedColumn(uint32_t world_id, CountT col_idx,
+                            bool writable);
+        void checkSharedUnsealed() const;
+
+        // Growable to fixed, with room for max_num_per_world rows per world
+        void makeFixed(CountT max_num_per_world);
+        Table * overflow(uint32_t world_id);
 #else
         inline TableStorage(Span<TypeInfo> types);
 
@@ -249,6 +342,10 @@ private:
         inline ColumnT * column(MADRONA_MW_COND(uint32_t world_id,)
                                 CountT col_idx);
 
+        // Untyped version of column
+        inline void * rawColumn(MADRONA_MW_COND(uint32_t world_id,)
+                                CountT col_idx, uint32_t num_row_bytes);
+
         inline CountT numRows(MADRONA_MW_COND(uint32_t world_id));
 
         inline void clear(MADRONA_MW_COND(uint32_t world_id));
@@ -263,6 +360,7 @@ private:
 
         uint32_t componentOffset;
         uint32_t numComponents;
+        ArchetypeFlags flags;
         TableStorage tblStorage;
         ColumnMap columnLookup;
     };
@@ -284,6 +382,8 @@ private:
         uint32_t archetypeIdx;
         uint32_t columnIdx;
         uint32_t numBytesPerRow;
+        uint32_t numExportBytesPerRow;
+        ExportEncoding encoding;
 
         uint32_t numMappedChunks;
 
@@ -312,11 +412,14 @@ private:
                         const uint32_t *components,
                         CountT num_components);
 
-    void * exportColumn(uint32_t archetype_id, uint32_t component_id);
+    void * exportColumn(uint32_t archetype_id, uint32_t component_id,
+                        ExportEncoding encoding = ExportEncoding::None);
 
     void clear(MADRONA_MW_COND(uint32_t world_id,) StateCache &cache,
                uint32_t archetype_id, bool is_temporary);
 
+    struct InitialState;
+
     StateCache init_state_cache_; // FIXME remove
     EntityStore entity_store_;
     DynArray<Optional<TypeInfo>> component_infos_;
@@ -329,6 +432,9 @@ private:
     DynArray<ExportJob> export_jobs_;
 #endif
 
+    DynArray<InitialState *> initial_states_;
+    mutable SpinLock initial_states_lock_;
+
     // FIXME: TmpAllocator doesn't belong here should be per CPU worker
     struct TmpAllocator {
         struct Block;
@@ -167,7 +167,8 @@ void StateManager::registerSingleton()
 
     registerComponent<SingletonT>();
     registerArchetype<ArchetypeT>(
-        ComponentMetadataSelector<> {}, ArchetypeFlags::None, 1);
+        ComponentMetadataSelector<> {},
+        ArchetypeFlags::ExcludeFromInitialState, 1);
 
 #ifdef MADRONA_MW_MODE
     for (CountT i = 0; i < (CountT)num_worlds_; i++) {
@@ -256,6 +257,23 @@ SingletonT * StateManager::exportSingleton()
     return exportColumn<ArchetypeT, SingletonT>();
 }
 
+template <typename ArchetypeT, typename ComponentT>
+void * StateManager::exportColumn(ExportEncoding encoding)
+{
+    return exportColumn(
+        archetypeID<ArchetypeT>().id,
+        componentID<ComponentT>().id,
+        encoding);
+}
+
+template <typename SingletonT>
+void * StateManager::exportSingleton(ExportEncoding encoding)
+{
+    using ArchetypeT = SingletonArchetype<SingletonT>;
+
+    return exportColumn<ArchetypeT, SingletonT>(encoding);
+}
+
 template <typename SingletonT>
 SingletonT & StateManager::getSingleton(MADRONA_MW_COND(uint32_t world_id))
 {
@@ -303,7 +321,8 @@ inline ResultRef<ComponentT> StateManager::get(
     MADRONA_MW_COND(uint32_t world_id,) Loc loc)
 {
     ArchetypeStore &archetype = *archetype_stores_[loc.archetype];
-    auto col_idx = archetype.columnLookup.lookup(componentID<ComponentT>().id);
+    auto col_idx = archetype.columnLookup.lookup(
+        componentID<std::remove_const_t<ComponentT>>().id);
 
     if (!col_idx.has_value()) {
         return ResultRef<ComponentT>(nullptr);
@@ -340,8 +359,8 @@ ComponentT & StateManager::getUnsafe(
     MADRONA_MW_COND(uint32_t world_id,) Loc loc)
 {
     ArchetypeStore &archetype = *archetype_stores_[loc.archetype];
-    auto col_idx =
-        *archetype.columnLookup.lookup(componentID<ComponentT>().id);
+    auto col_idx = *archetype.columnLookup.lookup(
+        componentID<std::remove_const_t<ComponentT>>().id);
 
     auto col = archetype.tblStorage.column<ComponentT>(
         MADRONA_MW_COND(world_id,) col_idx);
@@ -540,8 +559,18 @@ inline ColumnT * StateManager::TableStorage::column(
 {
 #ifdef MADRONA_MW_MODE
     if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            return (ColumnT *)sharedColumn(world_id, col_idx,
+                                           !std::is_const_v<ColumnT>);
+        }
+
         return (ColumnT *)tbls[world_id].data(col_idx);
     } else {
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl != nullptr) [[unlikely]] {
+            return (ColumnT *)overflow_tbl->data(col_idx);
+        }
+
         return ((ColumnT *)fixed.tbl.data(col_idx)) +
             CountT(world_id) * maxNumPerWorld;
     }
@@ -550,13 +579,49 @@ inline ColumnT * StateManager::TableStorage::column(
 #endif
 }
 
+inline void * StateManager::TableStorage::rawColumn(
+    MADRONA_MW_COND(uint32_t world_id,)
+    CountT col_idx,
+    uint32_t num_row_bytes)
+{
+#ifdef MADRONA_MW_MODE
+    if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            return sharedColumn(world_id, col_idx, true);
+        }
+
+        return tbls[world_id].data(col_idx);
+    } else {
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl != nullptr) [[unlikely]] {
+            return overflow_tbl->data(col_idx);
+        }
+
+        return (char *)fixed.tbl.data(col_idx) +
+            CountT(world_id) * maxNumPerWorld * num_row_bytes;
+    }
+#else
+    (void)num_row_bytes;
+    return tbl.data(col_idx);
+#endif
+}
+
 inline CountT StateManager::TableStorage::numRows(
     MADRONA_MW_COND(uint32_t world_id))
 {
 #ifdef MADRONA_MW_MODE
     if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            return shared.worldTbls[world_id]->numRows();
+        }
+
         return tbls[world_id].numRows();
     } else {
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl != nullptr) [[unlikely]] {
+            return overflow_tbl->numRows();
+        }
+
         return fixed.activeRows[world_id];
     }
 #else
@@ -569,8 +634,22 @@ void StateManager::TableStorage::clear(
 {
 #ifdef MADRONA_MW_MODE
     if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            // Setup only, rows are shared by every world
+            checkSharedUnsealed();
+            shared.tbl.clear();
+            return;
+        }
+
         tbls[world_id].clear();
     } else {
+        // The world goes back to its fixed slice
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl != nullptr) [[unlikely]] {
+            delete overflow_tbl;
+            fixed.overflowTbls[world_id] = nullptr;
+        }
+
         fixed.activeRows[world_id] = 0;
     }
 #else
@@ -583,9 +662,24 @@ CountT StateManager::TableStorage::addRow(
 {
 #ifdef MADRONA_MW_MODE
     if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            // Setup only, rows are shared by every world
+            checkSharedUnsealed();
+            return shared.tbl.addRow();
+        }
+
         return tbls[world_id].addRow();
     } else {
-        return fixed.activeRows[world_id]++;
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl == nullptr) [[likely]] {
+            if (fixed.activeRows[world_id] < maxNumPerWorld) [[likely]] {
+                return fixed.activeRows[world_id]++;
+            }
+
+            overflow_tbl = overflow(world_id);
+        }
+
+        return overflow_tbl->addRow();
     }
 #else
     return tbl.addRow();
@@ -597,14 +691,27 @@ bool StateManager::TableStorage::removeRow(MADRONA_MW_COND(uint32_t world_id,)
 {
 #ifdef MADRONA_MW_MODE
     if (maxNumPerWorld == 0) {
+        if (isShared) [[unlikely]] {
+            // Setup only, rows are shared by every world
+            checkSharedUnsealed();
+            return shared.tbl.removeRow(row);
+        }
+
         return tbls[world_id].removeRow(row);
     } else {
+        Table *overflow_tbl = fixed.overflowTbls[world_id];
+        if (overflow_tbl != nullptr) [[unlikely]] {
+            return overflow_tbl->removeRow(row);
+        }
+
         CountT removed_row = --fixed.activeRows[world_id];
         if (removed_row == row) {
             return false;
         }
 
-        fixed.tbl.copyRow(row, removed_row);
+        // copyRow takes rows of the whole table, not the world's slice
+        CountT world_offset = CountT(world_id) * maxNumPerWorld;
+        fixed.tbl.copyRow(world_offset + row, world_offset + removed_row);
 
         return true;
     }
@@ -39,6 +39,9 @@ public:
 
     inline uint32_t numRows() const { return num_rows_; }
 
+    // Most rows the table has held at once since it was created
+    inline uint32_t peakNumRows() const { return num_peak_rows_; }
+
     // Drops all rows in the table and frees memory
     void clear();
 
@@ -46,6 +49,7 @@ public:
 
 private:
     uint32_t num_rows_;
+    uint32_t num_peak_rows_;
     uint32_t num_allocated_rows_;
     uint32_t num_components_;
     InlineArray<void *, maxColumns> columns_;
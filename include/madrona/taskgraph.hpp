@@ -45,6 +45,7 @@ public:
     template <typename ArchetypeT>
     void clearTemporaries();
     void resetTmpAlloc();
+    void restoreInitialState(CountT state_idx);
 
     template <typename ContextT, typename Fn, typename ...ComponentTs>
     void iterateQuery(ContextT &ctx,
@@ -3,6 +3,7 @@
 #include <madrona/fwd.hpp>
 #include <madrona/taskgraph.hpp>
 #include <madrona/context.hpp>
+#include <madrona/template_helpers.hpp>
 
 namespace madrona {
 
@@ -125,10 +126,32 @@ private:
 //
 // TODO: Make sure to either fix this, or throw an error in the case of this
 // happening.
+// Query iterated by a ParallelForNode: components Fn takes by value or by
+// const reference are queried as const, so read only systems don't copy
+// ArchetypeFlags::SharedTemplate rows into their world.
+template <typename FnT, typename ...ComponentTs>
+struct SystemQuery {
+    using type = Query<ComponentTs...>;
+};
+
+template <typename ReturnT, typename ContextT, typename ...ArgTs,
+          typename ...ComponentTs>
+    requires (sizeof...(ArgTs) == sizeof...(ComponentTs))
+struct SystemQuery<ReturnT (*)(ContextT, ArgTs...), ComponentTs...> {
+    template <typename ComponentT, typename ArgT>
+    using QueryComponent = std::conditional_t<
+        std::is_lvalue_reference_v<ArgT> &&
+            !std::is_const_v<std::remove_reference_t<ArgT>>,
+        ComponentT, const ComponentT>;
+
+    using type = Query<QueryComponent<ComponentTs, ArgTs>...>;
+};
+
 template <typename ContextT, auto Fn, typename ...ComponentTs>
 class ParallelForNode : public NodeBase {
+    using QueryT = typename SystemQuery<decltype(Fn), ComponentTs...>::type;
 public:
-    ParallelForNode(Query<ComponentTs...> &&query);
+    ParallelForNode(QueryT &&query);
 
     inline void run(Context &ctx_base, TaskGraph &taskgraph);
 
@@ -138,7 +161,7 @@ public:
         Span<const TaskGraphNodeID> dependencies);
 
 private:
-    Query<ComponentTs...> query_;
+    QueryT query_;
 };
 
 // This node resets the temporary bump allocator accessible through
@@ -166,6 +189,26 @@ public:
 };
 
 
+// This node resets the world by restoring one of the pooled initial states
+// captured with Context::captureInitialState, so an episode reset is a bulk
+// table copy rather than destroying and rebuilding entities. Fn decides
+// whether the world resets and from which state:
+//     int32_t selectInitialState(MyContext &ctx);
+// returning the initial state index to restore (for instance chosen
+// randomly or by a curriculum kept in a singleton), or -1 to leave the
+// world untouched this step. Singletons are not restored, so
+// bookkeeping like episode counters or reset flags can live there.
+template <typename ContextT, auto Fn>
+class AutoResetNode : public NodeBase {
+public:
+    inline void run(Context &ctx_base, TaskGraph &taskgraph);
+
+    static TaskGraphNodeID addToGraph(
+        StateManager &,
+        TaskGraphBuilder &builder,
+        Span<const TaskGraphNodeID> dependencies);
+};
+
 }
 
 #include "taskgraph_builder.inl"
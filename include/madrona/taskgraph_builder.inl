@@ -64,7 +64,7 @@ TaskGraphBuilder & TaskGraphManager::init(EnumT taskgraph_id)
 
 template <typename ContextT, auto Fn, typename ...ComponentTs>
 ParallelForNode<ContextT, Fn, ComponentTs...>::ParallelForNode(
-        Query<ComponentTs...> &&query)
+        QueryT &&query)
     : query_(std::move(query))
 {}
 
@@ -85,7 +85,11 @@ ParallelForNode<ContextT, Fn, ComponentTs...>::addToGraph(
 {
     using NodeT = ParallelForNode<ContextT, Fn, ComponentTs...>;
 
-    auto query = state_mgr.query<ComponentTs...>();
+    auto query = utils::PackDelegator<QueryT>::call(
+        [&state_mgr]<typename... QueryComponentTs>() {
+            return state_mgr.query<QueryComponentTs...>();
+        });
+
     return builder.addDefaultNode<NodeT>(dependencies, std::move(query));
 }
 
@@ -109,4 +113,26 @@ TaskGraphNodeID ClearTmpNode<ArchetypeT>::addToGraph(
     return builder.addDefaultNode<ClearTmpNode>(dependencies);
 }
 
+template <typename ContextT, auto Fn>
+void AutoResetNode<ContextT, Fn>::run(Context &ctx_base, TaskGraph &taskgraph)
+{
+    ContextT &ctx = static_cast<ContextT &>(ctx_base);
+
+    int32_t state_idx = Fn(ctx);
+    if (state_idx < 0) {
+        return;
+    }
+
+    taskgraph.restoreInitialState(state_idx);
+}
+
+template <typename ContextT, auto Fn>
+TaskGraphNodeID AutoResetNode<ContextT, Fn>::addToGraph(
+    StateManager &,
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> dependencies)
+{
+    return builder.addDefaultNode<AutoResetNode>(dependencies);
+}
+
 }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <madrona/components.hpp>
+#include <madrona/span.hpp>
+#include <madrona/taskgraph_builder.hpp>
+#include <madrona/context.hpp>
+
+namespace madrona::topdown {
+
+// Egocentric top-down grid observations. Entities with a Footprint are
+// drawn, as 2D outlines on the world XY plane, into the grid of every
+// observer in the same world. Each cell holds the bitwise OR of the masks of
+// all footprints overlapping it, so one bit per class (walls, agents,
+// goals, ...) gives a semantic occupancy map in one byte per cell.
+//
+// Grids are ordinary components declared by the simulator, e.g.
+//   struct TopDownObs : topdown::Grid<32, 32> {};
+// so they can be exported like any other observation column. Row 0 is the
+// row farthest in front of the observer, and column 0 is on its left.
+// The grid rotates with the observer's heading around Z.
+//
+// Footprints are collected once per world per step, then every observer
+// scan converts the convex outlines row by row, filling whole cell spans.
+// Coverage is conservative: any overlap with a cell marks it.
+
+template <int32_t W, int32_t H>
+struct Grid {
+    static constexpr int32_t width = W;
+    static constexpr int32_t height = H;
+
+    uint8_t cells[H][W];
+};
+
+enum class FootprintShape : uint32_t {
+    // Outline of the ObjectID's AABB, rotated with the entity
+    ObjectAABB,
+    // Outline of the ObjectID's collision hulls and spheres
+    ObjectHull,
+    // Rectangle of Footprint::halfExtents in the entity's local XY
+    Box,
+};
+
+struct Footprint {
+    FootprintShape shape;
+    math::Vector2 halfExtents;
+    uint8_t mask;
+};
+
+struct Config {
+    // World units per cell side
+    float cellSize;
+    // Rows behind the observer's cell, the rest of the grid is in front
+    int32_t rowsBehind;
+    // Maximum number of entities with a Footprint in each world
+    CountT maxFootprints;
+};
+
+// The ObjectAABB and ObjectHull shapes read the physics ObjectManager, so
+// PhysicsSystem must be registered and initialized to use them.
+void registerTypes(ECSRegistry &registry);
+
+void init(Context &ctx, const Config &cfg);
+
+// Clears cells (width * height, row major) and draws every footprint
+// collected this step from the point of view of an observer at pos facing
+// rot's +Y axis.
+void rasterize(Context &ctx,
+               math::Vector3 pos,
+               math::Quat rot,
+               uint8_t *cells,
+               int32_t width,
+               int32_t height);
+
+// Collects this step's footprints for rasterize()
+TaskGraphNodeID setupCollectTasks(TaskGraphBuilder &builder,
+                                  Span<const TaskGraphNodeID> deps);
+
+// Collects footprints, then fills the GridT component of every entity with
+// Position, Rotation and GridT.
+template <typename GridT>
+TaskGraphNodeID setupRasterizeTasks(TaskGraphBuilder &builder,
+                                    Span<const TaskGraphNodeID> deps);
+
+}
+
+#include "topdown.inl"
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace madrona::topdown {
+
+template <typename GridT>
+inline void rasterizeGridEntry(Context &ctx,
+                               const base::Position &pos,
+                               const base::Rotation &rot,
+                               GridT &grid)
+{
+    rasterize(ctx, pos, rot, &grid.cells[0][0], GridT::width, GridT::height);
+}
+
+template <typename GridT>
+TaskGraphNodeID setupRasterizeTasks(TaskGraphBuilder &builder,
+                                    Span<const TaskGraphNodeID> deps)
+{
+    auto collect = setupCollectTasks(builder, deps);
+
+    return builder.addToGraph<ParallelForNode<Context,
+        rasterizeGridEntry<GridT>,
+            base::Position,
+            base::Rotation,
+            GridT
+        >>({collect});
+}
+
+}
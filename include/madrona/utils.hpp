@@ -177,6 +177,44 @@ constexpr inline uint32_t int32Hash(uint32_t x)
     return x;
 }
 
+// 64-bit content hash for deduplicating asset data. Mixes 8 byte words
+// with a multiply-rotate step and finishes with the splitmix64 finalizer.
+inline uint64_t hashBytes(const void *data, size_t num_bytes,
+                          uint64_t seed = 0x9e3779b97f4a7c15ull)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    auto mix = [](uint64_t h, uint64_t w) {
+        h ^= w * 0xbf58476d1ce4e5b9ull;
+        h = (h << 31u) | (h >> 33u);
+        return h * 0x94d049bb133111ebull;
+    };
+
+    uint64_t h = seed ^ (num_bytes * 0xff51afd7ed558ccdull);
+
+    size_t num_words = num_bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < num_words; i++) {
+        uint64_t w;
+        memcpy(&w, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+        h = mix(h, w);
+    }
+
+    size_t num_tail = num_bytes % sizeof(uint64_t);
+    if (num_tail > 0) {
+        uint64_t w = 0;
+        memcpy(&w, bytes + num_words * sizeof(uint64_t), num_tail);
+        h = mix(h, w);
+    }
+
+    h ^= h >> 30u;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27u;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31u;
+
+    return h;
+}
+
 inline int64_t computeBufferOffsets(const Span<const int64_t> chunk_sizes,
                                     Span<int64_t> out_offsets,
                                     int64_t pow2_alignment)
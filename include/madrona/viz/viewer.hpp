@@ -21,6 +21,17 @@ public:
         float cameraMoveSpeed;
         math::Vector3 cameraPosition;
         math::Quat cameraRotation;
+
+        // Run step_fn on its own thread instead of inside the render loop.
+        // The simulation then runs as fast as possible (or at the tick rate
+        // if one is set) and the viewer renders the latest snapshot of the
+        // ECS output at its own frame rate. CPU backend only. step_fn should
+        // still call RenderManager::readECS after stepping, but must not
+        // call batchRender, and ui_fn runs concurrently with step_fn.
+        bool asyncSimulation = false;
+        // With asyncSimulation, only snapshot the world currently selected
+        // in the viewer rather than every world.
+        bool followSelectedWorld = false;
     };
 
     enum class KeyboardKey : uint32_t {
@@ -424,17 +424,17 @@ MeshBVH MeshBVHBuilder::build(
 
 #if defined(MADRONA_COMPRESSED_BVH) || defined(MADRONA_COMPRESSED_DEINDEXED) \
 || defined(MADRONA_COMPRESSED_DEINDEXED_TEX)
-    float rootMaxX = FLT_MIN;
-    float rootMaxY = FLT_MIN;
-    float rootMaxZ = FLT_MIN;
+    float rootMaxX = -FLT_MAX;
+    float rootMaxY = -FLT_MAX;
+    float rootMaxZ = -FLT_MAX;
 
     if(innerID == 0) {
         float minX = FLT_MAX,
               minY = FLT_MAX,
               minZ = FLT_MAX,
-              maxX = FLT_MIN,
-              maxY = FLT_MIN,
-              maxZ = FLT_MIN;
+              maxX = -FLT_MAX,
+              maxY = -FLT_MAX,
+              maxZ = -FLT_MAX;
 
         for(uint32_t i2 = 0; i2 < QBVHNode::NodeWidth; i2++) {
             if(i2 < leafNodes.size()) {
@@ -454,9 +454,9 @@ MeshBVH MeshBVHBuilder::build(
         rootMaxZ = maxZ;
 
         QBVHNode node;
-        int8_t ex = ceilf(log2f((maxX-minX) / (powf(2, 8) - 1)));
-        int8_t ey = ceilf(log2f((maxY-minY) / (powf(2, 8) - 1)));
-        int8_t ez = ceilf(log2f((maxZ-minZ) / (powf(2, 8) - 1)));
+        int8_t ex = QBVHNode::computeExponent(minX, maxX);
+        int8_t ey = QBVHNode::computeExponent(minY, maxY);
+        int8_t ez = QBVHNode::computeExponent(minZ, maxZ);
         
         node.minPoint = { minX, minY, minZ };
         node.expX = ex;
@@ -469,12 +469,12 @@ MeshBVH MeshBVHBuilder::build(
                 LeafNode *iNode = (LeafNode *) leafNodes[j];
                 child = 0x80000000 | iNode->lid;
                 BoundingBox box = iNode->bounds;
-                node.qMinX[j] = floorf((box.lower_x - minX) / powf(2, ex));
-                node.qMinY[j] = floorf((box.lower_y - minY) / powf(2, ey));
-                node.qMinZ[j] = floorf((box.lower_z - minZ) / powf(2, ez));
-                node.qMaxX[j] = ceilf((box.upper_x - minX) / powf(2, ex));
-                node.qMaxY[j] = ceilf((box.upper_y - minY) / powf(2, ey));
-                node.qMaxZ[j] = ceilf((box.upper_z - minZ) / powf(2, ez));
+                node.qMinX[j] = QBVHNode::quantizeMin(box.lower_x, minX, ex);
+                node.qMinY[j] = QBVHNode::quantizeMin(box.lower_y, minY, ey);
+                node.qMinZ[j] = QBVHNode::quantizeMin(box.lower_z, minZ, ez);
+                node.qMaxX[j] = QBVHNode::quantizeMax(box.upper_x, minX, ex);
+                node.qMaxY[j] = QBVHNode::quantizeMax(box.upper_y, minY, ey);
+                node.qMaxZ[j] = QBVHNode::quantizeMax(box.upper_z, minZ, ez);
                 numTrisInner = iNode->numPrims;
             } else {
                 child = sentinel;
@@ -494,9 +494,9 @@ MeshBVH MeshBVHBuilder::build(
         float minX = FLT_MAX,
               minY = FLT_MAX,
               minZ = FLT_MAX,
-              maxX = FLT_MIN,
-              maxY = FLT_MIN,
-              maxZ = FLT_MIN;
+              maxX = -FLT_MAX,
+              maxY = -FLT_MAX,
+              maxZ = -FLT_MAX;
 
         for(int i2 = 0; i2 < QBVHNode::NodeWidth; i2++){
             if(innerNodes[i]->children[i2] != nullptr) {
@@ -514,21 +514,21 @@ MeshBVH MeshBVHBuilder::build(
         rootMaxZ = fmaxf(maxZ,rootMaxZ);
         //printf("%f,%f,%f | %f,%f,%f\n",minX,minY,minZ,maxX,maxY,maxZ);
 
-        int8_t ex = ceilf(log2f((maxX-minX)/(powf(2, 8) - 1)));
-        int8_t ey = ceilf(log2f((maxY-minY)/(powf(2, 8) - 1)));
-        int8_t ez = ceilf(log2f((maxZ-minZ)/(powf(2, 8) - 1)));
+        int8_t ex = QBVHNode::computeExponent(minX, maxX);
+        int8_t ey = QBVHNode::computeExponent(minY, maxY);
+        int8_t ez = QBVHNode::computeExponent(minZ, maxZ);
         //printf("%d,%d,%d\n",ex,ey,ez);
         node.minPoint = { minX, minY, minZ };
         node.expX = ex;
         node.expY = ey;
         node.expZ = ez;
         for (int i2 = 0; i2 < QBVHNode::NodeWidth; i2++) {
-            node.qMinX[i2] = floorf((innerNodes[i]->bounds[i2].lower_x - minX) / powf(2, ex));
-            node.qMinY[i2] = floorf((innerNodes[i]->bounds[i2].lower_y - minY) / powf(2, ey));
-            node.qMinZ[i2] = floorf((innerNodes[i]->bounds[i2].lower_z - minZ) / powf(2, ez));
-            node.qMaxX[i2] = ceilf((innerNodes[i]->bounds[i2].upper_x - minX) / powf(2, ex));
-            node.qMaxY[i2] = ceilf((innerNodes[i]->bounds[i2].upper_y - minY) / powf(2, ey));
-            node.qMaxZ[i2] = ceilf((innerNodes[i]->bounds[i2].upper_z - minZ) / powf(2, ez));
+            node.qMinX[i2] = QBVHNode::quantizeMin(innerNodes[i]->bounds[i2].lower_x, minX, ex);
+            node.qMinY[i2] = QBVHNode::quantizeMin(innerNodes[i]->bounds[i2].lower_y, minY, ey);
+            node.qMinZ[i2] = QBVHNode::quantizeMin(innerNodes[i]->bounds[i2].lower_z, minZ, ez);
+            node.qMaxX[i2] = QBVHNode::quantizeMax(innerNodes[i]->bounds[i2].upper_x, minX, ex);
+            node.qMaxY[i2] = QBVHNode::quantizeMax(innerNodes[i]->bounds[i2].upper_y, minY, ey);
+            node.qMaxZ[i2] = QBVHNode::quantizeMax(innerNodes[i]->bounds[i2].upper_z, minZ, ez);
         }
 
         for (int j = 0; j < QBVHNode::NodeWidth; j++){
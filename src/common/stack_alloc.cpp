@@ -15,16 +15,14 @@ StackAlloc::StackAlloc(CountT chunk_size)
 
 void StackAlloc::pop(AllocFrame frame)
 {
-    if ((uintptr_t)frame.ptr == chunk_size_) {
+    if (frame.chunk == nullptr) {
         release();
         return;
     }
 
-    uintptr_t mask = chunk_size_ - 1;
-    uintptr_t cur_offset = (uintptr_t)frame.ptr & mask;
-
-    void *chunk_start = (char *)frame.ptr - cur_offset;
-    auto *metadata = (ChunkMetadata *)chunk_start;
+    // Chunks are only 256 byte aligned and can be oversized, so the
+    // frame's chunk can't be recovered from an address within it
+    auto *metadata = (ChunkMetadata *)frame.chunk;
 
     ChunkMetadata *free_chunk = metadata->next;
     while (free_chunk != nullptr) {
@@ -36,7 +34,7 @@ void StackAlloc::pop(AllocFrame frame)
     metadata->next = nullptr;
 
     cur_chunk_ = (char *)metadata;
-    chunk_offset_ = (uint32_t)cur_offset;
+    chunk_offset_ = frame.offset;
 }
 
 void StackAlloc::release()
@@ -20,6 +20,7 @@ inline constexpr uint32_t maxRowsPerTable = 1u << 28u;
 Table::Table(const TypeInfo *component_types, CountT num_components,
              CountT init_num_rows)
     : num_rows_(init_num_rows),
+      num_peak_rows_(init_num_rows),
       num_allocated_rows_(std::max(uint32_t(init_num_rows), 1_u32)),
       num_components_(num_components),
       columns_(),
@@ -46,6 +47,7 @@ Table::Table(const TypeInfo *component_types, CountT num_components,
 uint32_t Table::addRow()
 {
     uint32_t idx = num_rows_++;
+    num_peak_rows_ = std::max(num_peak_rows_, num_rows_);
 
     if (idx >= num_allocated_rows_) {
         uint32_t new_num_rows =
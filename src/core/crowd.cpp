@@ -0,0 +1,749 @@
+#include <madrona/crowd.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/memory.hpp>
+#include <madrona/impl/hash_grid.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+namespace madrona::crowd {
+
+using namespace base;
+using namespace math;
+
+namespace {
+
+constexpr CountT maxNeighborsLimit = 16;
+// Nearest walls turned into constraints per agent
+constexpr CountT maxWallLines = 8;
+constexpr CountT maxLines = maxNeighborsLimit + maxWallLines;
+// The static wall grid is coarsened until it has at most this many cells
+constexpr CountT maxWallCells = 1 << 16;
+
+constexpr float lpEpsilon = 1e-5f;
+
+// Half-plane of allowed velocities: everything to the right of the line
+// through point along direction, i.e. det(direction, point - v) <= 0.
+struct Line {
+    Vector2 point;
+    Vector2 direction;
+};
+
+}
+
+struct CrowdState {
+    Query<Position, Agent> agentQuery;
+
+    float neighborDist;
+    CountT maxNeighbors;
+    float invTimeHorizon;
+    float invTimeHorizonWalls;
+    float invDeltaT;
+    CountT maxAgents;
+
+    // Per step agent data, in query order
+    CountT numAgents;
+    float *posX;
+    float *posY;
+    float *velX;
+    float *velY;
+    float *radii;
+    Vector2 *newVelocities;
+
+    // Agent hash grid, agents sorted by cell
+    uint32_t numAgentCells;
+    uint32_t *agentCellStarts;
+    uint32_t *agentCellCounts;
+    uint32_t *agentCells;
+    uint32_t *sortedAgents;
+
+    // Walls (navmesh boundary edges) and a uniform grid over them. Cell c
+    // lists wallCellSegments[wallCellStarts[c], wallCellStarts[c + 1]).
+    CountT numWalls;
+    Vector2 *wallStarts;
+    Vector2 *wallEnds;
+    uint32_t *wallStamps;
+    uint32_t curWallStamp;
+    Vector2 wallGridMin;
+    float wallCellSize;
+    int32_t numWallCellsX;
+    int32_t numWallCellsY;
+    uint32_t *wallCellStarts;
+    uint32_t *wallCellSegments;
+};
+
+void registerTypes(ECSRegistry &registry)
+{
+    registry.registerComponent<Agent>();
+    registry.registerSingleton<CrowdState>();
+}
+
+static inline float det(Vector2 a, Vector2 b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+static void initWalls(CrowdState &state, const Navmesh *navmesh,
+                      float cell_size)
+{
+    state.numWalls = 0;
+    state.numWallCellsX = 0;
+    state.numWallCellsY = 0;
+    state.curWallStamp = 0;
+
+    if (navmesh == nullptr) {
+        return;
+    }
+
+    CountT num_walls = 0;
+    for (uint32_t i = 0; i < navmesh->numTris * 3; i++) {
+        if (navmesh->triAdjacency[i] == Navmesh::sentinel) {
+            num_walls += 1;
+        }
+    }
+
+    if (num_walls == 0) {
+        return;
+    }
+
+    state.wallStarts = allocArray<Vector2>(num_walls);
+    state.wallEnds = allocArray<Vector2>(num_walls);
+    state.wallStamps = allocArray<uint32_t>(num_walls);
+
+    Vector2 grid_min { FLT_MAX, FLT_MAX };
+    Vector2 grid_max { -FLT_MAX, -FLT_MAX };
+
+    CountT wall_idx = 0;
+    for (uint32_t tri = 0; tri < navmesh->numTris; tri++) {
+        for (uint32_t edge = 0; edge < 3; edge++) {
+            if (navmesh->triAdjacency[3 * tri + edge] != Navmesh::sentinel) {
+                continue;
+            }
+
+            Vector3 a = navmesh->vertices[
+                navmesh->triIndices[3 * tri + edge]];
+            Vector3 b = navmesh->vertices[
+                navmesh->triIndices[3 * tri + (edge + 1) % 3]];
+
+            state.wallStarts[wall_idx] = Vector2 { a.x, a.y };
+            state.wallEnds[wall_idx] = Vector2 { b.x, b.y };
+            state.wallStamps[wall_idx] = 0;
+            wall_idx += 1;
+
+            grid_min.x = fminf(grid_min.x, fminf(a.x, b.x));
+            grid_min.y = fminf(grid_min.y, fminf(a.y, b.y));
+            grid_max.x = fmaxf(grid_max.x, fmaxf(a.x, b.x));
+            grid_max.y = fmaxf(grid_max.y, fmaxf(a.y, b.y));
+        }
+    }
+
+    int32_t num_cells_x, num_cells_y;
+    while (true) {
+        num_cells_x = (int32_t)((grid_max.x - grid_min.x) / cell_size) + 1;
+        num_cells_y = (int32_t)((grid_max.y - grid_min.y) / cell_size) + 1;
+
+        if ((CountT)num_cells_x * num_cells_y <= maxWallCells) {
+            break;
+        }
+
+        cell_size *= 2.f;
+    }
+
+    float inv_cell_size = 1.f / cell_size;
+    auto forEachCell = [&](CountT wall, auto &&fn) {
+        Vector2 a = state.wallStarts[wall];
+        Vector2 b = state.wallEnds[wall];
+
+        int32_t min_x = (int32_t)((fminf(a.x, b.x) - grid_min.x) *
+                                  inv_cell_size);
+        int32_t max_x = (int32_t)((fmaxf(a.x, b.x) - grid_min.x) *
+                                  inv_cell_size);
+        int32_t min_y = (int32_t)((fminf(a.y, b.y) - grid_min.y) *
+                                  inv_cell_size);
+        int32_t max_y = (int32_t)((fmaxf(a.y, b.y) - grid_min.y) *
+                                  inv_cell_size);
+
+        for (int32_t y = min_y; y <= std::min(max_y, num_cells_y - 1); y++) {
+            for (int32_t x = min_x; x <= std::min(max_x, num_cells_x - 1);
+                 x++) {
+                fn(y * num_cells_x + x);
+            }
+        }
+    };
+
+    CountT num_cells = (CountT)num_cells_x * num_cells_y;
+    uint32_t *cell_starts = allocArray<uint32_t>(num_cells + 1);
+    for (CountT i = 0; i <= num_cells; i++) {
+        cell_starts[i] = 0;
+    }
+
+    for (CountT i = 0; i < num_walls; i++) {
+        forEachCell(i, [&](int32_t cell) {
+            cell_starts[cell + 1] += 1;
+        });
+    }
+
+    for (CountT i = 1; i <= num_cells; i++) {
+        cell_starts[i] += cell_starts[i - 1];
+    }
+
+    uint32_t *cell_segments = allocArray<uint32_t>(cell_starts[num_cells]);
+    for (CountT i = 0; i < num_walls; i++) {
+        forEachCell(i, [&](int32_t cell) {
+            cell_segments[cell_starts[cell]++] = (uint32_t)i;
+        });
+    }
+
+    // The fill above advanced each start to the next cell's start
+    for (CountT i = num_cells; i > 0; i--) {
+        cell_starts[i] = cell_starts[i - 1];
+    }
+    cell_starts[0] = 0;
+
+    state.numWalls = num_walls;
+    state.wallGridMin = grid_min;
+    state.wallCellSize = cell_size;
+    state.numWallCellsX = num_cells_x;
+    state.numWallCellsY = num_cells_y;
+    state.wallCellStarts = cell_starts;
+    state.wallCellSegments = cell_segments;
+}
+
+void init(Context &ctx, const Config &cfg)
+{
+    if (cfg.maxNeighbors < 1 || cfg.maxNeighbors > maxNeighborsLimit) {
+        FATAL("Crowd avoidance: maxNeighbors must be in [1, %ld]",
+              (long)maxNeighborsLimit);
+    }
+
+    uint32_t num_agent_cells = numHashCells(cfg.maxAgents);
+
+    CrowdState &state = ctx.singleton<CrowdState>();
+    new (&state) CrowdState {
+        .agentQuery = ctx.query<Position, Agent>(),
+        .neighborDist = cfg.neighborDist,
+        .maxNeighbors = cfg.maxNeighbors,
+        .invTimeHorizon = 1.f / cfg.timeHorizon,
+        .invTimeHorizonWalls = 1.f / cfg.timeHorizonWalls,
+        .invDeltaT = 1.f / cfg.deltaT,
+        .maxAgents = cfg.maxAgents,
+        .numAgents = 0,
+        .posX = allocArray<float>(cfg.maxAgents),
+        .posY = allocArray<float>(cfg.maxAgents),
+        .velX = allocArray<float>(cfg.maxAgents),
+        .velY = allocArray<float>(cfg.maxAgents),
+        .radii = allocArray<float>(cfg.maxAgents),
+        .newVelocities = allocArray<Vector2>(cfg.maxAgents),
+        .numAgentCells = num_agent_cells,
+        .agentCellStarts = allocArray<uint32_t>(num_agent_cells + 1),
+        .agentCellCounts = allocArray<uint32_t>(num_agent_cells),
+        .agentCells = allocArray<uint32_t>(cfg.maxAgents),
+        .sortedAgents = allocArray<uint32_t>(cfg.maxAgents),
+        .numWalls = 0,
+        .wallStarts = nullptr,
+        .wallEnds = nullptr,
+        .wallStamps = nullptr,
+        .curWallStamp = 0,
+        .wallGridMin = Vector2 { 0.f, 0.f },
+        .wallCellSize = cfg.neighborDist,
+        .numWallCellsX = 0,
+        .numWallCellsY = 0,
+        .wallCellStarts = nullptr,
+        .wallCellSegments = nullptr,
+    };
+
+    initWalls(state, cfg.navmesh, cfg.neighborDist);
+}
+
+static void buildAgentGrid(CrowdState &state)
+{
+    const float inv_cell_size = 1.f / state.neighborDist;
+
+    buildGrid(state.numAgents, state.numAgentCells, state.agentCellStarts,
+              state.agentCellCounts, state.agentCells, state.sortedAgents,
+              [&](CountT i) {
+        return hashCell(cellCoord(state.posX[i], inv_cell_size),
+                        cellCoord(state.posY[i], inv_cell_size),
+                        state.numAgentCells);
+    });
+}
+
+// Keeps the num_kept closest candidates sorted by distance
+static inline void insertNeighbor(uint32_t *neighbors,
+                                  float *neighbor_dists,
+                                  CountT &num_kept,
+                                  CountT max_kept,
+                                  uint32_t candidate,
+                                  float dist_sq)
+{
+    if (num_kept == max_kept && dist_sq >= neighbor_dists[num_kept - 1]) {
+        return;
+    }
+
+    CountT idx = num_kept == max_kept ? num_kept - 1 : num_kept++;
+    while (idx > 0 && neighbor_dists[idx - 1] > dist_sq) {
+        neighbors[idx] = neighbors[idx - 1];
+        neighbor_dists[idx] = neighbor_dists[idx - 1];
+        idx -= 1;
+    }
+
+    neighbors[idx] = candidate;
+    neighbor_dists[idx] = dist_sq;
+}
+
+static CountT findNeighbors(const CrowdState &state,
+                            CountT agent_idx,
+                            uint32_t *neighbors,
+                            float *neighbor_dists)
+{
+    const float inv_cell_size = 1.f / state.neighborDist;
+    const float range_sq = state.neighborDist * state.neighborDist;
+
+    float x = state.posX[agent_idx];
+    float y = state.posY[agent_idx];
+    int32_t cell_x = cellCoord(x, inv_cell_size);
+    int32_t cell_y = cellCoord(y, inv_cell_size);
+
+    // Cells are neighborDist wide, so the 3x3 block around the agent
+    // covers the search radius. Different cells can hash to the same
+    // bucket, visit each bucket once.
+    uint32_t visited[9];
+    CountT num_visited = 0;
+
+    CountT num_neighbors = 0;
+    for (int32_t dy = -1; dy <= 1; dy++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+            uint32_t bucket = hashCell(cell_x + dx, cell_y + dy,
+                                       state.numAgentCells);
+
+            bool seen = false;
+            for (CountT i = 0; i < num_visited; i++) {
+                seen |= visited[i] == bucket;
+            }
+            if (seen) {
+                continue;
+            }
+            visited[num_visited++] = bucket;
+
+            uint32_t start = state.agentCellStarts[bucket];
+            uint32_t end = state.agentCellStarts[bucket + 1];
+            for (uint32_t i = start; i < end; i++) {
+                uint32_t other = state.sortedAgents[i];
+                if (other == (uint32_t)agent_idx) {
+                    continue;
+                }
+
+                float ox = state.posX[other] - x;
+                float oy = state.posY[other] - y;
+                float dist_sq = ox * ox + oy * oy;
+                if (dist_sq < range_sq) {
+                    insertNeighbor(neighbors, neighbor_dists, num_neighbors,
+                                   state.maxNeighbors, other, dist_sq);
+                }
+            }
+        }
+    }
+
+    return num_neighbors;
+}
+
+// Walls within range of the agent become constraints v . n >= -(d - r) / tau
+// where n points from the closest point on the wall to the agent.
+static CountT addWallLines(CrowdState &state,
+                           Vector2 pos,
+                           float radius,
+                           float max_speed,
+                           Line *lines)
+{
+    if (state.numWalls == 0) {
+        return 0;
+    }
+
+    float range = max_speed / state.invTimeHorizonWalls + radius;
+    float inv_cell_size = 1.f / state.wallCellSize;
+
+    int32_t min_x = std::max(cellCoord(pos.x - range - state.wallGridMin.x,
+                                       inv_cell_size), 0);
+    int32_t max_x = std::min(cellCoord(pos.x + range - state.wallGridMin.x,
+                                       inv_cell_size),
+                             state.numWallCellsX - 1);
+    int32_t min_y = std::max(cellCoord(pos.y - range - state.wallGridMin.y,
+                                       inv_cell_size), 0);
+    int32_t max_y = std::min(cellCoord(pos.y + range - state.wallGridMin.y,
+                                       inv_cell_size),
+                             state.numWallCellsY - 1);
+
+    // Segments span several cells, stamp them to visit each once
+    uint32_t stamp = ++state.curWallStamp;
+    if (stamp == 0) {
+        for (CountT i = 0; i < state.numWalls; i++) {
+            state.wallStamps[i] = 0;
+        }
+        stamp = ++state.curWallStamp;
+    }
+
+    Vector2 closest_normals[maxWallLines];
+    float closest_dists[maxWallLines];
+    CountT num_walls = 0;
+
+    for (int32_t cell_y = min_y; cell_y <= max_y; cell_y++) {
+        for (int32_t cell_x = min_x; cell_x <= max_x; cell_x++) {
+            int32_t cell = cell_y * state.numWallCellsX + cell_x;
+
+            for (uint32_t i = state.wallCellStarts[cell];
+                 i < state.wallCellStarts[cell + 1]; i++) {
+                uint32_t wall = state.wallCellSegments[i];
+                if (state.wallStamps[wall] == stamp) {
+                    continue;
+                }
+                state.wallStamps[wall] = stamp;
+
+                Vector2 a = state.wallStarts[wall];
+                Vector2 ab = state.wallEnds[wall] - a;
+                float t = std::clamp(
+                    (pos - a).dot(ab) / fmaxf(ab.length2(), FLT_MIN),
+                    0.f, 1.f);
+                Vector2 to_agent = pos - (a + t * ab);
+                float dist = to_agent.length();
+                if (dist >= range || dist < lpEpsilon) {
+                    continue;
+                }
+
+                // Same insertion as the neighbors: keep the closest walls
+                CountT idx = num_walls;
+                if (num_walls == maxWallLines) {
+                    if (dist >= closest_dists[num_walls - 1]) {
+                        continue;
+                    }
+                    idx = num_walls - 1;
+                } else {
+                    num_walls += 1;
+                }
+
+                while (idx > 0 && closest_dists[idx - 1] > dist) {
+                    closest_normals[idx] = closest_normals[idx - 1];
+                    closest_dists[idx] = closest_dists[idx - 1];
+                    idx -= 1;
+                }
+
+                closest_normals[idx] = to_agent / dist;
+                closest_dists[idx] = dist;
+            }
+        }
+    }
+
+    for (CountT i = 0; i < num_walls; i++) {
+        Vector2 n = closest_normals[i];
+        float dist = closest_dists[i];
+
+        // Already overlapping: get out within one step
+        float min_normal_speed = dist > radius ?
+            -(dist - radius) * state.invTimeHorizonWalls :
+            (radius - dist) * state.invDeltaT;
+
+        lines[i] = Line {
+            .point = n * min_normal_speed,
+            .direction = Vector2 { n.y, -n.x },
+        };
+    }
+
+    return num_walls;
+}
+
+// The linear programs below follow van den Berg et al., "Reciprocal n-body
+// Collision Avoidance" (the RVO2 library).
+
+// Optimizes along line line_no subject to lines [0, line_no) and the max
+// speed circle.
+static bool linearProgram1(const Line *lines,
+                           CountT line_no,
+                           float radius,
+                           Vector2 opt_velocity,
+                           bool direction_opt,
+                           Vector2 &result)
+{
+    const Line &line = lines[line_no];
+    float dot_product = line.point.dot(line.direction);
+    float discriminant = dot_product * dot_product + radius * radius -
+        line.point.length2();
+
+    if (discriminant < 0.f) {
+        // The max speed circle fully invalidates the line
+        return false;
+    }
+
+    float sqrt_discriminant = sqrtf(discriminant);
+    float t_left = -dot_product - sqrt_discriminant;
+    float t_right = -dot_product + sqrt_discriminant;
+
+    for (CountT i = 0; i < line_no; i++) {
+        float denominator = det(line.direction, lines[i].direction);
+        float numerator = det(lines[i].direction, line.point - lines[i].point);
+
+        if (fabsf(denominator) <= lpEpsilon) {
+            // Parallel lines
+            if (numerator < 0.f) {
+                return false;
+            }
+            continue;
+        }
+
+        float t = numerator / denominator;
+        if (denominator >= 0.f) {
+            t_right = fminf(t_right, t);
+        } else {
+            t_left = fmaxf(t_left, t);
+        }
+
+        if (t_left > t_right) {
+            return false;
+        }
+    }
+
+    if (direction_opt) {
+        float t = opt_velocity.dot(line.direction) > 0.f ? t_right : t_left;
+        result = line.point + t * line.direction;
+    } else {
+        float t = std::clamp(line.direction.dot(opt_velocity - line.point),
+                             t_left, t_right);
+        result = line.point + t * line.direction;
+    }
+
+    return true;
+}
+
+// Returns the number of lines satisfied before failing, num_lines on
+// success.
+static CountT linearProgram2(const Line *lines,
+                             CountT num_lines,
+                             float radius,
+                             Vector2 opt_velocity,
+                             bool direction_opt,
+                             Vector2 &result)
+{
+    if (direction_opt) {
+        result = opt_velocity * radius;
+    } else if (opt_velocity.length2() > radius * radius) {
+        result = opt_velocity / opt_velocity.length() * radius;
+    } else {
+        result = opt_velocity;
+    }
+
+    for (CountT i = 0; i < num_lines; i++) {
+        if (det(lines[i].direction, lines[i].point - result) > 0.f) {
+            Vector2 prev_result = result;
+            if (!linearProgram1(lines, i, radius, opt_velocity,
+                                direction_opt, result)) {
+                result = prev_result;
+                return i;
+            }
+        }
+    }
+
+    return num_lines;
+}
+
+// Infeasible: minimize the maximum violation of the agent lines, keeping the
+// first num_wall_lines satisfied.
+static void linearProgram3(const Line *lines,
+                           CountT num_lines,
+                           CountT num_wall_lines,
+                           CountT begin_line,
+                           float radius,
+                           Vector2 &result)
+{
+    Line proj_lines[maxLines];
+    float distance = 0.f;
+
+    for (CountT i = begin_line; i < num_lines; i++) {
+        if (det(lines[i].direction, lines[i].point - result) <= distance) {
+            continue;
+        }
+
+        CountT num_proj_lines = 0;
+        for (CountT j = 0; j < num_wall_lines; j++) {
+            proj_lines[num_proj_lines++] = lines[j];
+        }
+
+        for (CountT j = num_wall_lines; j < i; j++) {
+            Line line;
+            float determinant = det(lines[i].direction, lines[j].direction);
+
+            if (fabsf(determinant) <= lpEpsilon) {
+                if (lines[i].direction.dot(lines[j].direction) > 0.f) {
+                    // Same direction
+                    continue;
+                }
+                line.point = 0.5f * (lines[i].point + lines[j].point);
+            } else {
+                line.point = lines[i].point + (det(lines[j].direction,
+                    lines[i].point - lines[j].point) / determinant) *
+                        lines[i].direction;
+            }
+
+            Vector2 dir = lines[j].direction - lines[i].direction;
+            line.direction = dir / dir.length();
+            proj_lines[num_proj_lines++] = line;
+        }
+
+        Vector2 prev_result = result;
+        Vector2 opt_dir { -lines[i].direction.y, lines[i].direction.x };
+        if (linearProgram2(proj_lines, num_proj_lines, radius, opt_dir,
+                           true, result) < num_proj_lines) {
+            // Can only fail from floating point error, keep the previous
+            // result
+            result = prev_result;
+        }
+
+        distance = det(lines[i].direction, lines[i].point - result);
+    }
+}
+
+static Vector2 computeAgentVelocity(CrowdState &state,
+                                    CountT agent_idx,
+                                    const Agent &agent)
+{
+    Vector2 pos { state.posX[agent_idx], state.posY[agent_idx] };
+    Vector2 vel { state.velX[agent_idx], state.velY[agent_idx] };
+    float radius = state.radii[agent_idx];
+
+    Line lines[maxLines];
+    CountT num_wall_lines =
+        addWallLines(state, pos, radius, agent.maxSpeed, lines);
+
+    uint32_t neighbors[maxNeighborsLimit];
+    float neighbor_dists[maxNeighborsLimit];
+    CountT num_neighbors = findNeighbors(state, agent_idx, neighbors,
+                                         neighbor_dists);
+
+    CountT num_lines = num_wall_lines;
+    for (CountT i = 0; i < num_neighbors; i++) {
+        uint32_t other = neighbors[i];
+
+        Vector2 rel_pos {
+            state.posX[other] - pos.x,
+            state.posY[other] - pos.y,
+        };
+        Vector2 rel_vel {
+            vel.x - state.velX[other],
+            vel.y - state.velY[other],
+        };
+
+        float dist_sq = neighbor_dists[i];
+        float combined_radius = radius + state.radii[other];
+        float combined_radius_sq = combined_radius * combined_radius;
+
+        Line line;
+        Vector2 u;
+
+        if (dist_sq > combined_radius_sq) {
+            // Vector from the cutoff center to the relative velocity
+            Vector2 w = rel_vel - state.invTimeHorizon * rel_pos;
+            float w_len_sq = w.length2();
+            float dot_product = w.dot(rel_pos);
+
+            if (dot_product < 0.f &&
+                    dot_product * dot_product > combined_radius_sq * w_len_sq) {
+                // Project on the cutoff circle
+                float w_len = sqrtf(w_len_sq);
+                Vector2 unit_w = w / w_len;
+
+                line.direction = Vector2 { unit_w.y, -unit_w.x };
+                u = (combined_radius * state.invTimeHorizon - w_len) * unit_w;
+            } else {
+                // Project on the legs of the velocity obstacle
+                float leg = sqrtf(dist_sq - combined_radius_sq);
+
+                if (det(rel_pos, w) > 0.f) {
+                    line.direction = Vector2 {
+                        rel_pos.x * leg - rel_pos.y * combined_radius,
+                        rel_pos.x * combined_radius + rel_pos.y * leg,
+                    } / dist_sq;
+                } else {
+                    line.direction = -Vector2 {
+                        rel_pos.x * leg + rel_pos.y * combined_radius,
+                        -rel_pos.x * combined_radius + rel_pos.y * leg,
+                    } / dist_sq;
+                }
+
+                u = rel_vel.dot(line.direction) * line.direction - rel_vel;
+            }
+        } else {
+            // Already colliding, resolve within one step
+            Vector2 w = rel_vel - state.invDeltaT * rel_pos;
+            float w_len = w.length();
+            if (w_len < lpEpsilon) {
+                continue;
+            }
+            Vector2 unit_w = w / w_len;
+
+            line.direction = Vector2 { unit_w.y, -unit_w.x };
+            u = (combined_radius * state.invDeltaT - w_len) * unit_w;
+        }
+
+        // Each agent takes half the responsibility
+        line.point = vel + 0.5f * u;
+        lines[num_lines++] = line;
+    }
+
+    Vector2 result;
+    CountT line_fail = linearProgram2(lines, num_lines, agent.maxSpeed,
+                                      agent.preferredVelocity, false, result);
+
+    if (line_fail < num_lines) {
+        linearProgram3(lines, num_lines, num_wall_lines, line_fail,
+                       agent.maxSpeed, result);
+    }
+
+    return result;
+}
+
+inline void avoidanceEntry(Context &ctx, CrowdState &state)
+{
+    CountT num_agents = 0;
+    ctx.iterateQuery(state.agentQuery,
+    [&](Position pos, const Agent &agent) {
+        if (num_agents == state.maxAgents) {
+            FATAL("Crowd avoidance: more than %ld agents",
+                  (long)state.maxAgents);
+        }
+
+        state.posX[num_agents] = pos.x;
+        state.posY[num_agents] = pos.y;
+        state.velX[num_agents] = agent.velocity.x;
+        state.velY[num_agents] = agent.velocity.y;
+        state.radii[num_agents] = agent.radius;
+        num_agents += 1;
+    });
+    state.numAgents = num_agents;
+
+    buildAgentGrid(state);
+
+    // Every agent reads the previous velocities of its neighbors, so
+    // results go to a separate array and are written back after
+    CountT agent_idx = 0;
+    ctx.iterateQuery(state.agentQuery,
+    [&](Position, const Agent &agent) {
+        state.newVelocities[agent_idx] =
+            computeAgentVelocity(state, agent_idx, agent);
+        agent_idx += 1;
+    });
+
+    agent_idx = 0;
+    ctx.iterateQuery(state.agentQuery,
+    [&](Position, Agent &agent) {
+        agent.velocity = state.newVelocities[agent_idx++];
+    });
+}
+
+TaskGraphNodeID setupAvoidanceTasks(TaskGraphBuilder &builder,
+                                    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        avoidanceEntry,
+            CrowdState
+        >>(deps);
+}
+
+}
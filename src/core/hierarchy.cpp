@@ -0,0 +1,350 @@
+#include <madrona/hierarchy.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/memory.hpp>
+#include <madrona/impl/hash_grid.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+
+namespace madrona::hierarchy {
+
+using namespace base;
+using namespace math;
+
+namespace {
+
+struct SortEntry {
+    Entity e;
+    Entity parent;
+    int32_t parentIdx;
+    int32_t depth;
+};
+
+}
+
+struct HierarchyState {
+    Query<Entity, Parent, HierarchySlot> childQuery;
+    CountT maxSlots;
+    CountT numSlots;
+    CountT numLevels;
+    bool dirty;
+
+    // Sorted by depth. Level l occupies
+    // [levelOffsets[l], levelOffsets[l + 1]).
+    Entity *slotEntities;
+    // Slot of the parent, or -1 if the parent is a root (level 0 only)
+    int32_t *slotParents;
+    Entity *rootParents;
+    int32_t *levelOffsets;
+
+    Vector3 *localPositions;
+    Quat *localRotations;
+    Diag3x3 *localScales;
+    Vector3 *worldPositions;
+    Quat *worldRotations;
+    Diag3x3 *worldScales;
+
+    SortEntry *sortEntries;
+    int32_t *sortedIndices;
+};
+
+void registerTypes(ECSRegistry &registry)
+{
+    registry.registerComponent<Parent>();
+    registry.registerComponent<LocalTransform>();
+    registry.registerComponent<HierarchySlot>();
+
+    registry.registerBundle<Child>();
+
+    registry.registerSingleton<HierarchyState>();
+}
+
+void init(Context &ctx, CountT max_attached)
+{
+    new (&ctx.singleton<HierarchyState>()) HierarchyState {
+        .childQuery = ctx.query<Entity, Parent, HierarchySlot>(),
+        .maxSlots = max_attached,
+        .numSlots = 0,
+        .numLevels = 0,
+        .dirty = true,
+        .slotEntities = allocArray<Entity>(max_attached),
+        .slotParents = allocArray<int32_t>(max_attached),
+        .rootParents = allocArray<Entity>(max_attached),
+        .levelOffsets = allocArray<int32_t>(max_attached + 1),
+        .localPositions = allocArray<Vector3>(max_attached),
+        .localRotations = allocArray<Quat>(max_attached),
+        .localScales = allocArray<Diag3x3>(max_attached),
+        .worldPositions = allocArray<Vector3>(max_attached),
+        .worldRotations = allocArray<Quat>(max_attached),
+        .worldScales = allocArray<Diag3x3>(max_attached),
+        .sortEntries = allocArray<SortEntry>(max_attached),
+        .sortedIndices = allocArray<int32_t>(max_attached),
+    };
+}
+
+void attach(Context &ctx,
+            Entity child,
+            Entity parent,
+            const LocalTransform &local)
+{
+    ctx.get<Parent>(child).e = parent;
+    ctx.get<LocalTransform>(child) = local;
+    ctx.get<HierarchySlot>(child).idx = -1;
+
+    markDirty(ctx);
+}
+
+void detach(Context &ctx, Entity child)
+{
+    ctx.get<Parent>(child).e = Entity::none();
+    ctx.get<HierarchySlot>(child).idx = -1;
+
+    markDirty(ctx);
+}
+
+void markDirty(Context &ctx)
+{
+    ctx.singleton<HierarchyState>().dirty = true;
+}
+
+static inline bool isAttached(const HierarchyState &state,
+                              Entity e,
+                              HierarchySlot slot)
+{
+    return slot.idx >= 0 && slot.idx < state.numSlots &&
+        state.slotEntities[slot.idx] == e;
+}
+
+static void sortHierarchy(Context &ctx, HierarchyState &state)
+{
+    SortEntry *entries = state.sortEntries;
+
+    int32_t num_entries = 0;
+    ctx.iterateQuery(state.childQuery,
+    [&](Entity e, Parent &parent, HierarchySlot &slot) {
+        // Parents that have been destroyed leave the child as a root
+        if (parent.e == Entity::none() ||
+                !ctx.getSafe<Position>(parent.e).valid()) {
+            slot.idx = -1;
+            return;
+        }
+
+        if (num_entries == state.maxSlots) {
+            FATAL("Transform hierarchy: more than %ld attached entities",
+                  (long)state.maxSlots);
+        }
+
+        entries[num_entries] = {
+            .e = e,
+            .parent = parent.e,
+            .parentIdx = -1,
+            .depth = -1,
+        };
+        slot.idx = num_entries;
+        num_entries += 1;
+    });
+
+    for (int32_t i = 0; i < num_entries; i++) {
+        Entity parent = entries[i].parent;
+
+        auto parent_slot = ctx.getSafe<HierarchySlot>(parent);
+        if (!parent_slot.valid()) {
+            continue;
+        }
+
+        int32_t parent_idx = parent_slot.value().idx;
+        if (parent_idx >= 0 && parent_idx < num_entries &&
+                entries[parent_idx].e == parent) {
+            entries[i].parentIdx = parent_idx;
+        }
+    }
+
+    // Depth of each entry is the number of attached ancestors. Walk up to
+    // the first ancestor with a known depth, then assign on the way back.
+    int32_t max_depth = -1;
+    for (int32_t i = 0; i < num_entries; i++) {
+        int32_t chain_len = 0;
+        int32_t cur = i;
+        while (cur != -1 && entries[cur].depth == -1) {
+            chain_len += 1;
+            cur = entries[cur].parentIdx;
+
+            if (chain_len > num_entries) {
+                FATAL("Transform hierarchy: cycle through entity %d",
+                      entries[i].e.id);
+            }
+        }
+
+        int32_t depth = (cur == -1 ? -1 : entries[cur].depth) + chain_len;
+        max_depth = std::max(max_depth, depth);
+
+        cur = i;
+        while (cur != -1 && entries[cur].depth == -1) {
+            entries[cur].depth = depth--;
+            cur = entries[cur].parentIdx;
+        }
+    }
+
+    // Counting sort by depth
+    int32_t num_levels = max_depth + 1;
+    int32_t *level_offsets = state.levelOffsets;
+    for (int32_t i = 0; i <= num_levels; i++) {
+        level_offsets[i] = 0;
+    }
+
+    for (int32_t i = 0; i < num_entries; i++) {
+        level_offsets[entries[i].depth + 1] += 1;
+    }
+
+    for (int32_t i = 1; i <= num_levels; i++) {
+        level_offsets[i] += level_offsets[i - 1];
+    }
+
+    for (int32_t i = 0; i < num_entries; i++) {
+        state.sortedIndices[i] = level_offsets[entries[i].depth]++;
+    }
+
+    // The increments above shifted each level's offset to the next level's
+    for (int32_t i = num_levels; i > 0; i--) {
+        level_offsets[i] = level_offsets[i - 1];
+    }
+    level_offsets[0] = 0;
+
+    for (int32_t i = 0; i < num_entries; i++) {
+        const SortEntry &entry = entries[i];
+        int32_t slot = state.sortedIndices[i];
+
+        state.slotEntities[slot] = entry.e;
+        state.slotParents[slot] = entry.parentIdx == -1 ?
+            -1 : state.sortedIndices[entry.parentIdx];
+        state.rootParents[slot] = entry.parent;
+
+        ctx.get<HierarchySlot>(entry.e).idx = slot;
+    }
+
+    state.numSlots = num_entries;
+    state.numLevels = num_levels;
+}
+
+inline void sortEntry(Context &ctx, HierarchyState &state)
+{
+    if (!state.dirty) {
+        return;
+    }
+
+    state.dirty = false;
+    sortHierarchy(ctx, state);
+}
+
+inline void gatherLocalTransformsEntry(Context &ctx,
+                                       Entity e,
+                                       const LocalTransform &local,
+                                       const HierarchySlot &slot)
+{
+    HierarchyState &state = ctx.singleton<HierarchyState>();
+    if (!isAttached(state, e, slot)) {
+        return;
+    }
+
+    state.localPositions[slot.idx] = local.position;
+    state.localRotations[slot.idx] = local.rotation;
+    state.localScales[slot.idx] = local.scale;
+}
+
+inline void propagateEntry(Context &ctx, HierarchyState &state)
+{
+    const Vector3 *local_positions = state.localPositions;
+    const Quat *local_rotations = state.localRotations;
+    const Diag3x3 *local_scales = state.localScales;
+    Vector3 *world_positions = state.worldPositions;
+    Quat *world_rotations = state.worldRotations;
+    Diag3x3 *world_scales = state.worldScales;
+
+    if (state.numLevels == 0) {
+        return;
+    }
+
+    // Level 0: parents are roots, read their transform from the ECS
+    for (int32_t i = 0; i < state.levelOffsets[1]; i++) {
+        Entity root = state.rootParents[i];
+        Vector3 parent_pos = ctx.get<Position>(root);
+        Quat parent_rot = ctx.get<Rotation>(root);
+        Diag3x3 parent_scale = ctx.get<Scale>(root);
+
+        world_positions[i] = parent_pos +
+            parent_rot.rotateVec(parent_scale * local_positions[i]);
+        world_rotations[i] = parent_rot * local_rotations[i];
+        world_scales[i] = parent_scale * local_scales[i];
+    }
+
+    // Every parent in level l was written by level l - 1, and entries
+    // within a level are independent.
+    for (CountT level = 1; level < state.numLevels; level++) {
+        int32_t level_start = state.levelOffsets[level];
+        int32_t level_end = state.levelOffsets[level + 1];
+
+        for (int32_t i = level_start; i < level_end; i++) {
+            int32_t parent = state.slotParents[i];
+            Vector3 parent_pos = world_positions[parent];
+            Quat parent_rot = world_rotations[parent];
+            Diag3x3 parent_scale = world_scales[parent];
+
+            world_positions[i] = parent_pos +
+                parent_rot.rotateVec(parent_scale * local_positions[i]);
+            world_rotations[i] = parent_rot * local_rotations[i];
+            world_scales[i] = parent_scale * local_scales[i];
+        }
+    }
+}
+
+inline void scatterWorldTransformsEntry(Context &ctx,
+                                        Entity e,
+                                        const HierarchySlot &slot,
+                                        Position &pos,
+                                        Rotation &rot,
+                                        Scale &scale)
+{
+    HierarchyState &state = ctx.singleton<HierarchyState>();
+    if (!isAttached(state, e, slot)) {
+        return;
+    }
+
+    pos = state.worldPositions[slot.idx];
+    rot = state.worldRotations[slot.idx];
+    scale = state.worldScales[slot.idx];
+}
+
+TaskGraphNodeID setupPropagateTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    auto sort = builder.addToGraph<ParallelForNode<Context,
+        sortEntry,
+            HierarchyState
+        >>(deps);
+
+    auto gather = builder.addToGraph<ParallelForNode<Context,
+        gatherLocalTransformsEntry,
+            Entity,
+            LocalTransform,
+            HierarchySlot
+        >>({sort});
+
+    auto propagate = builder.addToGraph<ParallelForNode<Context,
+        propagateEntry,
+            HierarchyState
+        >>({gather});
+
+    auto scatter = builder.addToGraph<ParallelForNode<Context,
+        scatterWorldTransformsEntry,
+            Entity,
+            HierarchySlot,
+            Position,
+            Rotation,
+            Scale
+        >>({propagate});
+
+    return scatter;
+}
+
+}
@@ -6,9 +6,11 @@
  * https://opensource.org/licenses/MIT.
  */
 #include <madrona/state.hpp>
+#include <madrona/compact.hpp>
 #include <madrona/registry.hpp>
 #include <madrona/utils.hpp>
 #include <madrona/dyn_array.hpp>
+#include <madrona/memory.hpp>
 
 #include <cassert>
 #include <functional>
@@ -139,6 +141,8 @@ StateManager::StateManager(CountT num_worlds)
       bundle_components_(0),
       bundle_infos_(0),
       export_jobs_(0),
+      initial_states_(0),
+      initial_states_lock_(),
       tmp_allocators_(num_worlds),
       num_worlds_(num_worlds),
       register_lock_()
@@ -158,12 +162,21 @@ StateManager::StateManager()
       archetype_stores_(0),
       bundle_components_(0),
       bundle_infos_(0),
+      initial_states_(0),
+      initial_states_lock_(),
       tmp_allocator_()
 {
     registerComponent<Entity>();
 }
 #endif
 
+StateManager::~StateManager()
+{
+    for (InitialState *state : initial_states_) {
+        free(state);
+    }
+}
+
 Transaction StateManager::makeTransaction()
 {
     return Transaction();
@@ -211,8 +224,32 @@ void StateManager::destroyEntityNow(MADRONA_MW_COND(uint32_t world_id,)
 #ifdef MADRONA_MW_MODE
 StateManager::TableStorage::TableStorage(Span<TypeInfo> types,
                                          CountT num_worlds,
-                                         CountT max_num_per_world)
+                                         CountT max_num_per_world,
+                                         bool is_shared)
+    : types(types.size())
 {
+    utils::copyN<TypeInfo>(this->types.data(), types.data(), types.size());
+
+    isShared = is_shared;
+    isExported = false;
+
+    if (is_shared) {
+        maxNumPerWorld = 0;
+
+        new (&shared) Shared {
+            Table(types.data(), types.size(), 0),
+            HeapArray<Table *>(num_worlds),
+            nullptr,
+            false,
+        };
+
+        for (CountT i = 0; i < num_worlds; i++) {
+            shared.worldTbls[i] = &shared.tbl;
+        }
+
+        return;
+    }
+
     maxNumPerWorld = max_num_per_world;
 
     if (max_num_per_world == 0) {
@@ -226,32 +263,236 @@ StateManager::TableStorage::TableStorage(Span<TypeInfo> types,
             Table(types.data(), types.size(),
                   max_num_per_world * num_worlds),
             HeapArray<int32_t>(num_worlds),
+            HeapArray<Table *>(num_worlds),
         };
 
         for (CountT i = 0; i < num_worlds; i++) {
             fixed.activeRows[i] = 0;
+            fixed.overflowTbls[i] = nullptr;
         }
     }
 }
 
 StateManager::TableStorage::~TableStorage()
 {
-    if (maxNumPerWorld == 0) {
+    if (isShared) {
+        for (Table *tbl : shared.worldTbls) {
+            if (tbl != &shared.tbl) {
+                delete tbl;
+            }
+        }
+
+        rawDealloc(shared.worldIDs);
+        shared.~Shared();
+    } else if (maxNumPerWorld == 0) {
         tbls.~HeapArray<Table>();
     } else {
+        for (Table *tbl : fixed.overflowTbls) {
+            delete tbl;
+        }
+
         fixed.~Fixed();
     }
 }
 
+void StateManager::TableStorage::makeWorldLocal(uint32_t world_id)
+{
+    if (!isShared || shared.worldTbls[world_id] != &shared.tbl) {
+        return;
+    }
+
+    seal();
+
+    CountT num_rows = shared.tbl.numRows();
+
+    // Starts with num_rows rows, ready to be overwritten with the template
+    Table *local_tbl = new Table(types.data(), types.size(), num_rows);
+
+    for (CountT i = 0; i < types.size(); i++) {
+        memcpy(local_tbl->data(i), shared.tbl.data(i),
+               (size_t)types[i].numBytes * num_rows);
+    }
+
+    WorldID *world_ids = (WorldID *)local_tbl->data(1);
+    for (CountT i = 0; i < num_rows; i++) {
+        world_ids[i] = WorldID { (int32_t)world_id };
+    }
+
+    shared.worldTbls[world_id] = local_tbl;
+}
+
+void StateManager::TableStorage::seal()
+{
+    if (shared.sealed) {
+        return;
+    }
+
+    CountT num_worlds = shared.worldTbls.size();
+    CountT num_rows = shared.tbl.numRows();
+
+    shared.worldIDs = (WorldID *)rawAlloc(
+        sizeof(WorldID) * std::max(num_worlds * num_rows, CountT(1)));
+
+    for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+        WorldID *world_ids = shared.worldIDs + world_idx * num_rows;
+        for (CountT i = 0; i < num_rows; i++) {
+            world_ids[i] = WorldID { (int32_t)world_idx };
+        }
+    }
+
+    shared.sealed = true;
+}
+
+void * StateManager::TableStorage::sharedColumn(uint32_t world_id,
+                                                CountT col_idx,
+                                                bool writable)
+{
+    // Setup: every world reads and writes the template rows
+    if (!shared.sealed) {
+        return shared.tbl.data(col_idx);
+    }
+
+    if (shared.worldTbls[world_id] == &shared.tbl) {
+        if (writable) {
+            makeWorldLocal(world_id);
+        } else if (col_idx == 1) {
+            return shared.worldIDs + CountT(world_id) * shared.tbl.numRows();
+        }
+    }
+
+    return shared.worldTbls[world_id]->data(col_idx);
+}
+
+void StateManager::TableStorage::checkSharedUnsealed() const
+{
+    if (shared.sealed) {
+        FATAL("Rows of a SharedTemplate archetype can't be added, removed "
+              "or cleared once the template is sealed");
+    }
+}
+
+void StateManager::TableStorage::makeFixed(CountT max_num_per_world)
+{
+    assert(!isShared && maxNumPerWorld == 0);
+
+    CountT num_worlds = tbls.size();
+
+    Fixed new_fixed {
+        Table(types.data(), types.size(), max_num_per_world * num_worlds),
+        HeapArray<int32_t>(num_worlds),
+        HeapArray<Table *>(num_worlds),
+    };
+
+    // Rows keep their index within the world, so entity locations don't
+    // change.
+    for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+        Table &tbl = tbls[world_idx];
+        CountT num_rows = tbl.numRows();
+        assert(num_rows <= max_num_per_world);
+
+        for (CountT i = 0; i < types.size(); i++) {
+            size_t num_row_bytes = types[i].numBytes;
+            memcpy((char *)new_fixed.tbl.data(i) +
+                       num_row_bytes * world_idx * max_num_per_world,
+                   tbl.data(i), num_row_bytes * num_rows);
+        }
+
+        new_fixed.activeRows[world_idx] = int32_t(num_rows);
+        new_fixed.overflowTbls[world_idx] = nullptr;
+    }
+
+    tbls.~HeapArray<Table>();
+    new (&fixed) Fixed(std::move(new_fixed));
+    maxNumPerWorld = max_num_per_world;
+}
+
+Table * StateManager::TableStorage::overflow(uint32_t world_id)
+{
+    if (isExported) {
+        FATAL("World %u exceeded the %ld rows per world of an exported "
+              "archetype", world_id, (long)maxNumPerWorld);
+    }
+
+    // Only world_id's slice is touched, so other worlds can keep running
+    Table *overflow_tbl =
+        new Table(types.data(), types.size(), maxNumPerWorld);
+
+    for (CountT i = 0; i < types.size(); i++) {
+        size_t num_row_bytes = types[i].numBytes;
+        memcpy(overflow_tbl->data(i),
+               (char *)fixed.tbl.data(i) +
+                   num_row_bytes * world_id * maxNumPerWorld,
+               num_row_bytes * maxNumPerWorld);
+    }
+
+    fixed.overflowTbls[world_id] = overflow_tbl;
+
+    return overflow_tbl;
+}
+
 #else
 StateManager::TableStorage::TableStorage(Span<TypeInfo> types)
     : tbl(types.data(), types.size(), 0)
 {}
 #endif
 
+void StateManager::makeWorldLocal(MADRONA_MW_COND(uint32_t world_id,)
+                                  uint32_t archetype_id)
+{
+#ifdef MADRONA_MW_MODE
+    archetype_stores_[archetype_id]->tblStorage.makeWorldLocal(world_id);
+#else
+    // Single world, every archetype is already local
+    (void)archetype_id;
+#endif
+}
+
+#ifdef MADRONA_MW_MODE
+void StateManager::sealSharedTemplates()
+{
+    for (Optional<ArchetypeStore> &archetype : archetype_stores_) {
+        if (archetype.has_value() && archetype->tblStorage.isShared) {
+            archetype->tblStorage.seal();
+        }
+    }
+}
+#endif
+
+#ifdef MADRONA_MW_MODE
+void StateManager::fixTableCapacities(float headroom,
+                                      CountT min_rows_per_world)
+{
+    for (Optional<ArchetypeStore> &archetype : archetype_stores_) {
+        if (!archetype.has_value()) {
+            continue;
+        }
+
+        TableStorage &tbl_storage = archetype->tblStorage;
+        if (tbl_storage.isShared || tbl_storage.isExported ||
+                tbl_storage.maxNumPerWorld != 0) {
+            continue;
+        }
+
+        CountT peak_rows = 0;
+        for (const Table &tbl : tbl_storage.tbls) {
+            peak_rows = std::max(peak_rows, CountT(tbl.peakNumRows()));
+        }
+
+        CountT max_num_per_world = std::max(min_rows_per_world,
+            CountT(ceilf(float(peak_rows) * headroom)));
+        if (max_num_per_world == 0) {
+            continue;
+        }
+
+        tbl_storage.makeFixed(max_num_per_world);
+    }
+}
+#endif
+
 struct StateManager::ArchetypeStore::Init {
     uint32_t componentOffset;
     uint32_t numComponents;
+    ArchetypeFlags flags;
     uint32_t id;
     Span<TypeInfo> types;
     Span<IntegerMapPair> lookupInputs;
@@ -264,8 +505,11 @@ struct StateManager::ArchetypeStore::Init {
 StateManager::ArchetypeStore::ArchetypeStore(Init &&init)
     : componentOffset(init.componentOffset),
       numComponents(init.numComponents),
+      flags(init.flags),
       tblStorage(init.types
-          MADRONA_MW_COND(, init.numWorlds, init.maxNumEntitiesPerWorld)),
+          MADRONA_MW_COND(, init.numWorlds, init.maxNumEntitiesPerWorld,
+              (init.flags & ArchetypeFlags::SharedTemplate) ==
+                  ArchetypeFlags::SharedTemplate)),
       columnLookup(init.lookupInputs.data(), init.lookupInputs.size())
 {}
 
@@ -320,6 +564,13 @@ void StateManager::makeQuery(const ComponentID *components,
                 continue;
             }
 
+#ifdef MADRONA_MW_MODE
+            // Like Entity, every archetype has a WorldID column
+            if (component.id == componentID<WorldID>().id) {
+                continue;
+            }
+#endif
+
             if (!archetype.columnLookup.exists(component.id)) {
                 has_components = false;
                 break;
@@ -393,7 +644,7 @@ void StateManager::registerArchetype(uint32_t id,
                                      const ComponentID *components,
                                      const ComponentFlags *component_flags)
 {
-    (void)archetype_flags, (void)component_flags;
+    (void)component_flags;
 
     std::array<TypeInfo, max_archetype_components_> type_infos;
     std::array<IntegerMapPair, max_archetype_components_> lookup_input;
@@ -460,6 +711,7 @@ void StateManager::registerArchetype(uint32_t id,
     archetype_stores_[id].emplace(ArchetypeStore::Init {
         uint32_t(user_component_start),
         uint32_t(num_total_user_components),
+        archetype_flags,
         id,
         Span(type_infos.data(), num_total_components),
         Span(lookup_input.data(), num_total_user_components),
@@ -509,7 +761,51 @@ void StateManager::registerBundle(uint32_t id,
     };
 }
 
-void * StateManager::exportColumn(uint32_t archetype_id, uint32_t component_id)
+#ifdef MADRONA_MW_MODE
+static uint32_t exportRowBytes(uint32_t num_bytes_per_row,
+                               ExportEncoding encoding)
+{
+    if (encoding == ExportEncoding::None) {
+        return num_bytes_per_row;
+    }
+
+    if (num_bytes_per_row % sizeof(float) != 0) {
+        FATAL("Encoded exports require components made of floats");
+    }
+
+    return num_bytes_per_row / 2;
+}
+
+// Components exported with an encoding are treated as arrays of floats,
+// each converted to a 16 bit value in the export buffer
+static void encodeExportRows(void *dst, const void *src,
+                             CountT num_rows, uint32_t num_bytes_per_row,
+                             ExportEncoding encoding)
+{
+    if (encoding == ExportEncoding::None) {
+        memcpy(dst, src, num_bytes_per_row * num_rows);
+        return;
+    }
+
+    CountT num_values = num_rows * (num_bytes_per_row / sizeof(float));
+    const float *src_values = (const float *)src;
+
+    if (encoding == ExportEncoding::Float16) {
+        uint16_t *dst_values = (uint16_t *)dst;
+        for (CountT i = 0; i < num_values; i++) {
+            dst_values[i] = floatToHalfBits(src_values[i]);
+        }
+    } else {
+        int16_t *dst_values = (int16_t *)dst;
+        for (CountT i = 0; i < num_values; i++) {
+            dst_values[i] = floatToSNorm16(src_values[i]);
+        }
+    }
+}
+#endif
+
+void * StateManager::exportColumn(uint32_t archetype_id, uint32_t component_id,
+                                  ExportEncoding encoding)
 {
     auto &archetype = *archetype_stores_[archetype_id];
     uint32_t col_idx;
@@ -527,19 +823,42 @@ void * StateManager::exportColumn(uint32_t archetype_id, uint32_t component_id)
     }
 
 #ifdef MADRONA_MW_MODE
-    if (archetype.tblStorage.maxNumPerWorld == 0) {
+    if (archetype.tblStorage.isShared) {
+        FATAL("Exporting SharedTemplate archetype columns is not supported");
+    }
+
+    archetype.tblStorage.isExported = true;
 
+    if (archetype.tblStorage.maxNumPerWorld == 0 ||
+        encoding != ExportEncoding::None) {
         uint32_t num_bytes_per_row = component_infos_[component_id]->numBytes;
-        uint64_t map_size = 1'000'000'000 * num_bytes_per_row;
+        uint32_t num_export_bytes_per_row =
+            exportRowBytes(num_bytes_per_row, encoding);
+
+        uint64_t map_size = 1'000'000'000 * num_export_bytes_per_row;
 
         VirtualRegion mem(map_size, 0, 1);
         void *export_buffer = mem.ptr();
 
+        uint32_t num_mapped_chunks = 0;
+
+        // Fixed size tables are exported whole, so the buffer never grows
+        if (archetype.tblStorage.maxNumPerWorld != 0) {
+            uint64_t num_fixed_bytes = (uint64_t)num_export_bytes_per_row *
+                archetype.tblStorage.maxNumPerWorld * num_worlds_;
+
+            num_mapped_chunks = (uint32_t)utils::divideRoundUp(
+                num_fixed_bytes, mem.chunkSize());
+            mem.commitChunks(0, num_mapped_chunks);
+        }
+
         export_jobs_.push_back(ExportJob {
             .archetypeIdx = archetype_id,
             .columnIdx = col_idx,
             .numBytesPerRow = num_bytes_per_row,
-            .numMappedChunks = 0,
+            .numExportBytesPerRow = num_export_bytes_per_row,
+            .encoding = encoding,
+            .numMappedChunks = num_mapped_chunks,
             .mem = std::move(mem),
         });
 
@@ -548,6 +867,10 @@ void * StateManager::exportColumn(uint32_t archetype_id, uint32_t component_id)
         return archetype.tblStorage.fixed.tbl.data(col_idx);
     }
 #else
+    if (encoding != ExportEncoding::None) {
+        FATAL("Encoded exports require the multi-world backend");
+    }
+
     return archetype.tblStorage.tbl.data(col_idx);
 #endif
 }
@@ -556,6 +879,14 @@ void StateManager::copyInExportedColumns()
 {
 #ifdef MADRONA_MW_MODE
     for (ExportJob &export_job : export_jobs_) {
+        // Encoded exports are output only: decoding them would overwrite
+        // the simulation's values with their 16 bit approximations. This
+        // also skips every fixed table job, since only encoded fixed
+        // columns get an export buffer.
+        if (export_job.encoding != ExportEncoding::None) {
+            continue;
+        }
+
         auto &archetype = *archetype_stores_[export_job.archetypeIdx];
 
         CountT cumulative_copied_rows = 0;
@@ -585,6 +916,16 @@ void StateManager::copyOutExportedColumns()
     for (ExportJob &export_job : export_jobs_) {
         auto &archetype = *archetype_stores_[export_job.archetypeIdx];
 
+        if (archetype.tblStorage.maxNumPerWorld != 0) {
+            encodeExportRows(
+                export_job.mem.ptr(),
+                archetype.tblStorage.fixed.tbl.data(export_job.columnIdx),
+                archetype.tblStorage.maxNumPerWorld * num_worlds_,
+                export_job.numBytesPerRow, export_job.encoding);
+
+            continue;
+        }
+
         CountT cumulative_copied_rows = 0;
         for (Table &tbl : archetype.tblStorage.tbls) {
             CountT num_rows = tbl.numRows();
@@ -601,7 +942,7 @@ void StateManager::copyOutExportedColumns()
                  num_mapped_chunks * export_job.mem.chunkSize();
 
             uint64_t num_needed_bytes = (uint64_t)cumulative_copied_rows *
-                (uint64_t)export_job.numBytesPerRow;
+                (uint64_t)export_job.numExportBytesPerRow;
 
             if (num_needed_bytes > num_mapped_bytes) {
                 uint64_t new_num_mapped_bytes =
@@ -615,10 +956,11 @@ void StateManager::copyOutExportedColumns()
                 export_job.numMappedChunks = new_num_chunks;
             }
 
-            memcpy((char *)export_job.mem.ptr() +
-                       tbl_start * export_job.numBytesPerRow,
-                   tbl.data(export_job.columnIdx),
-                   export_job.numBytesPerRow * num_rows);
+            encodeExportRows((char *)export_job.mem.ptr() +
+                                 tbl_start * export_job.numExportBytesPerRow,
+                             tbl.data(export_job.columnIdx),
+                             num_rows, export_job.numBytesPerRow,
+                             export_job.encoding);
         }
     }
 #endif
@@ -643,6 +985,200 @@ void StateManager::clear(MADRONA_MW_COND(uint32_t world_id,)
 }
 
 
+// Captured rows are stored in a single allocation: the InitialState header,
+// one ArchetypeRows entry per captured archetype, then each archetype's user
+// columns back to back.
+struct StateManager::InitialState {
+    struct ArchetypeRows {
+        uint32_t archetypeID;
+        uint32_t numRows;
+        uint64_t dataOffset;
+    };
+
+    CountT numArchetypes;
+
+    ArchetypeRows * archetypes()
+    {
+        return (ArchetypeRows *)(this + 1);
+    }
+
+    char * data()
+    {
+        return (char *)this;
+    }
+};
+
+CountT StateManager::captureInitialState(MADRONA_MW_COND(uint32_t world_id))
+{
+    using ArchetypeRows = InitialState::ArchetypeRows;
+
+    // Shared template rows aren't per world state
+    auto shouldCapture = [](const ArchetypeStore &archetype) {
+        return (archetype.flags & (ArchetypeFlags::ExcludeFromInitialState |
+                                   ArchetypeFlags::SharedTemplate)) ==
+            ArchetypeFlags::None;
+    };
+
+    auto numRowBytes = [this](const ArchetypeStore &archetype) {
+        uint64_t num_bytes = 0;
+        for (CountT i = 0; i < (CountT)archetype.numComponents; i++) {
+            ComponentID component_id =
+                archetype_components_[archetype.componentOffset + i];
+            num_bytes += component_infos_[component_id.id]->numBytes;
+        }
+
+        return num_bytes;
+    };
+
+    CountT num_archetypes = 0;
+    for (const Optional<ArchetypeStore> &archetype : archetype_stores_) {
+        if (archetype.has_value() && shouldCapture(*archetype)) {
+            num_archetypes++;
+        }
+    }
+
+    uint64_t header_bytes = utils::roundUpPow2(sizeof(InitialState) +
+        sizeof(ArchetypeRows) * num_archetypes, 16);
+    uint64_t total_bytes = header_bytes;
+
+    for (Optional<ArchetypeStore> &archetype : archetype_stores_) {
+        if (!archetype.has_value() || !shouldCapture(*archetype)) {
+            continue;
+        }
+
+        CountT num_rows =
+            archetype->tblStorage.numRows(MADRONA_MW_COND(world_id));
+
+        // Keep every column 16 byte aligned
+        total_bytes += utils::roundUpPow2(
+            numRowBytes(*archetype) * num_rows + 16 * archetype->numComponents,
+            16);
+    }
+
+    auto state = (InitialState *)malloc(total_bytes);
+    state->numArchetypes = num_archetypes;
+
+    ArchetypeRows *archetype_rows = state->archetypes();
+    uint64_t cur_offset = header_bytes;
+
+    CountT archetype_idx = 0;
+    for (CountT id = 0; id < archetype_stores_.size(); id++) {
+        Optional<ArchetypeStore> &archetype = archetype_stores_[id];
+        if (!archetype.has_value() || !shouldCapture(*archetype)) {
+            continue;
+        }
+
+        CountT num_rows =
+            archetype->tblStorage.numRows(MADRONA_MW_COND(world_id));
+
+        archetype_rows[archetype_idx++] = ArchetypeRows {
+            .archetypeID = uint32_t(id),
+            .numRows = uint32_t(num_rows),
+            .dataOffset = cur_offset,
+        };
+
+        for (CountT i = 0; i < (CountT)archetype->numComponents; i++) {
+            ComponentID component_id =
+                archetype_components_[archetype->componentOffset + i];
+            uint32_t num_row_bytes =
+                component_infos_[component_id.id]->numBytes;
+            uint64_t num_column_bytes = (uint64_t)num_row_bytes * num_rows;
+
+            memcpy(state->data() + cur_offset,
+                   archetype->tblStorage.rawColumn(MADRONA_MW_COND(world_id,)
+                       i + user_component_offset_, num_row_bytes),
+                   num_column_bytes);
+
+            cur_offset = utils::roundUpPow2(cur_offset + num_column_bytes, 16);
+        }
+    }
+
+    std::lock_guard lock(initial_states_lock_);
+    initial_states_.push_back(state);
+
+    return initial_states_.size() - 1;
+}
+
+void StateManager::restoreInitialState(MADRONA_MW_COND(uint32_t world_id,)
+                                       StateCache &cache, CountT state_idx)
+{
+    InitialState *state;
+    {
+        std::lock_guard lock(initial_states_lock_);
+        if (state_idx < 0 || state_idx >= initial_states_.size()) {
+            FATAL("restoreInitialState: no captured state %ld",
+                  (long)state_idx);
+        }
+        state = initial_states_[state_idx];
+    }
+
+    const InitialState::ArchetypeRows *archetype_rows = state->archetypes();
+
+    for (CountT archetype_idx = 0; archetype_idx < state->numArchetypes;
+         archetype_idx++) {
+        const InitialState::ArchetypeRows &rows =
+            archetype_rows[archetype_idx];
+        ArchetypeStore &archetype = *archetype_stores_[rows.archetypeID];
+        TableStorage &tbl_storage = archetype.tblStorage;
+
+        CountT num_cur_rows = tbl_storage.numRows(MADRONA_MW_COND(world_id));
+        CountT num_dst_rows = rows.numRows;
+
+        // Existing entities are reused in row order, only the difference in
+        // row counts needs entities to be destroyed or created.
+        if (num_cur_rows > num_dst_rows) {
+            Entity *entities =
+                tbl_storage.column<Entity>(MADRONA_MW_COND(world_id,) 0);
+            entity_store_.bulkFree(cache.entity_cache_,
+                                   entities + num_dst_rows,
+                                   uint32_t(num_cur_rows - num_dst_rows));
+
+            for (CountT row = num_cur_rows - 1; row >= num_dst_rows; row--) {
+                tbl_storage.removeRow(MADRONA_MW_COND(world_id,) row);
+            }
+        } else {
+            for (CountT i = num_cur_rows; i < num_dst_rows; i++) {
+                Entity e = entity_store_.newEntity(cache.entity_cache_);
+                CountT row = tbl_storage.addRow(MADRONA_MW_COND(world_id));
+
+                tbl_storage.column<Entity>(MADRONA_MW_COND(world_id,) 0)[row] =
+                    e;
+#ifdef MADRONA_MW_MODE
+                tbl_storage.column<WorldID>(world_id, 1)[row] =
+                    WorldID { (int32_t)world_id };
+#endif
+
+                entity_store_.setLoc(e, Loc {
+                    .archetype = rows.archetypeID,
+                    .row = int32_t(row),
+                });
+            }
+        }
+
+        uint64_t cur_offset = rows.dataOffset;
+        for (CountT i = 0; i < (CountT)archetype.numComponents; i++) {
+            ComponentID component_id =
+                archetype_components_[archetype.componentOffset + i];
+            uint32_t num_row_bytes =
+                component_infos_[component_id.id]->numBytes;
+            uint64_t num_column_bytes = (uint64_t)num_row_bytes * num_dst_rows;
+
+            memcpy(tbl_storage.rawColumn(MADRONA_MW_COND(world_id,)
+                       i + user_component_offset_, num_row_bytes),
+                   state->data() + cur_offset,
+                   num_column_bytes);
+
+            cur_offset = utils::roundUpPow2(cur_offset + num_column_bytes, 16);
+        }
+    }
+}
+
+CountT StateManager::numInitialStates() const
+{
+    std::lock_guard lock(initial_states_lock_);
+    return initial_states_.size();
+}
+
 void * StateManager::tmpAlloc(MADRONA_MW_COND(uint32_t world_id,)
                               uint64_t num_bytes)
 {
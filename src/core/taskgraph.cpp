@@ -175,6 +175,12 @@ void TaskGraph::resetTmpAlloc()
     state_mgr_->resetTmpAlloc(MADRONA_MW_COND(cur_world_id_));
 }
 
+void TaskGraph::restoreInitialState(CountT state_idx)
+{
+    state_mgr_->restoreInitialState(MADRONA_MW_COND(cur_world_id_,)
+                                    *state_cache_, state_idx);
+}
+
 TaskGraphNodeID ResetTmpAllocNode::addToGraph(
     StateManager &,
     TaskGraphBuilder &builder,
@@ -5,10 +5,18 @@
 #include <madrona/math.hpp>
 #include <madrona/optional.hpp>
 
+#include <meshoptimizer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
 #include <cstdarg>
+#include <cstring>
+#include <limits>
 #include <optional>
 #include <filesystem>
 #include <string_view>
+#include <thread>
 #include <vector>
 #include <fstream>
 
@@ -222,11 +230,40 @@ struct GLTFBuffer {
     std::string_view filePath;
 };
 
+enum class GLTFMeshoptMode {
+    NONE,
+    ATTRIBUTES,
+    TRIANGLES,
+    INDICES,
+};
+
+enum class GLTFMeshoptFilter {
+    NONE,
+    OCTAHEDRAL,
+    QUATERNION,
+    EXPONENTIAL,
+};
+
+// EXT_meshopt_compression: the view's data is decoded from this range of
+// another buffer into LoaderData::decodedData, and the view's own buffer
+// is only a fallback for loaders without the extension
+struct GLTFMeshoptCompression {
+    GLTFMeshoptMode mode;
+    GLTFMeshoptFilter filter;
+    uint32_t bufferIdx;
+    uint32_t offset;
+    uint32_t numBytes;
+    uint32_t count;
+    uint32_t stride;
+    uint32_t decodedOffset;
+};
+
 struct GLTFBufferView {
     uint32_t bufferIdx;
     uint32_t offset;
     uint32_t stride;
     uint32_t numBytes;
+    GLTFMeshoptCompression meshopt;
 };
 
 enum class GLTFComponentType {
@@ -243,6 +280,8 @@ struct GLTFAccessor {
     uint32_t offset;
     uint32_t numElems;
     GLTFComponentType type;
+    // Integer components map to [0, 1] / [-1, 1] (KHR_mesh_quantization)
+    bool normalized;
 };
     
 enum class GLTFImageType {
@@ -330,6 +369,8 @@ struct GLTFLoader::Impl {
     // Scene data filled when loading a GLTF file
     std::string sceneName;
     DynArray<uint8_t> internalData;
+    // Decompressed EXT_meshopt_compression buffer views
+    DynArray<uint8_t> decodedData;
     DynArray<GLTFBuffer> buffers;
     DynArray<GLTFBufferView> bufferViews;
     DynArray<GLTFAccessor> accessors;
@@ -431,6 +472,114 @@ static bool jsonGetOr(const LoaderData &loader,
     }
 }
 
+// Leaves out.mode as NONE if the view isn't compressed
+template <typename T>
+static bool gltfParseMeshoptView(const LoaderData &loader,
+                                 simdjson::simdjson_result<T> ext,
+                                 GLTFMeshoptCompression &out)
+{
+    uint64_t buffer_idx;
+    auto buffer_err = ext["buffer"].get(buffer_idx);
+    if (buffer_err == simdjson::NO_SUCH_FIELD) {
+        return true;
+    } else if (buffer_err) {
+        loader.recordJSONError(buffer_err);
+        return false;
+    }
+
+    uint64_t byte_offset;
+    auto offset_err = ext["byteOffset"].get(byte_offset);
+    if (offset_err) {
+        byte_offset = 0;
+    }
+
+    uint64_t byte_len, stride, count;
+    string_view mode, filter;
+
+    auto err = ext["byteLength"].get(byte_len);
+    if (!err) {
+        err = ext["byteStride"].get(stride);
+    }
+    if (!err) {
+        err = ext["count"].get(count);
+    }
+    if (!err) {
+        err = ext["mode"].get(mode);
+    }
+    if (err) {
+        loader.recordJSONError(err);
+        return false;
+    }
+
+    auto filter_err = ext["filter"].get(filter);
+    if (filter_err) {
+        filter = "NONE";
+    }
+
+    if (mode == "ATTRIBUTES") {
+        out.mode = GLTFMeshoptMode::ATTRIBUTES;
+    } else if (mode == "TRIANGLES") {
+        out.mode = GLTFMeshoptMode::TRIANGLES;
+    } else if (mode == "INDICES") {
+        out.mode = GLTFMeshoptMode::INDICES;
+    } else {
+        loader.recordError("Unknown meshopt compression mode");
+        return false;
+    }
+
+    if (filter == "NONE") {
+        out.filter = GLTFMeshoptFilter::NONE;
+    } else if (filter == "OCTAHEDRAL") {
+        out.filter = GLTFMeshoptFilter::OCTAHEDRAL;
+    } else if (filter == "QUATERNION") {
+        out.filter = GLTFMeshoptFilter::QUATERNION;
+    } else if (filter == "EXPONENTIAL") {
+        out.filter = GLTFMeshoptFilter::EXPONENTIAL;
+    } else {
+        loader.recordError("Unknown meshopt compression filter");
+        return false;
+    }
+
+    // The decoders assert on these, so reject them here
+    bool valid_stride;
+    if (out.mode == GLTFMeshoptMode::ATTRIBUTES) {
+        valid_stride = stride % 4 == 0 && stride <= 256;
+    } else {
+        valid_stride = stride == 2 || stride == 4;
+    }
+
+    switch (out.filter) {
+    case GLTFMeshoptFilter::NONE: break;
+    case GLTFMeshoptFilter::OCTAHEDRAL: {
+        valid_stride = valid_stride && (stride == 4 || stride == 8);
+    } break;
+    case GLTFMeshoptFilter::QUATERNION: {
+        valid_stride = valid_stride && stride == 8;
+    } break;
+    case GLTFMeshoptFilter::EXPONENTIAL: break;
+    }
+
+    if (!valid_stride || (out.filter != GLTFMeshoptFilter::NONE &&
+            out.mode != GLTFMeshoptMode::ATTRIBUTES)) {
+        loader.recordError("Invalid meshopt compressed buffer view");
+        return false;
+    }
+
+    if (out.mode == GLTFMeshoptMode::TRIANGLES && count % 3 != 0) {
+        loader.recordError("Meshopt triangle count not a multiple of 3");
+        return false;
+    }
+
+    out.bufferIdx = uint32_t(buffer_idx);
+    out.offset = uint32_t(byte_offset);
+    out.numBytes = uint32_t(byte_len);
+    out.count = uint32_t(count);
+    out.stride = uint32_t(stride);
+    out.decodedOffset = 0;
+
+    return true;
+}
+
 static bool gltfLoad(const char *gltf_filename,
                      LoaderData &loader)
 {
@@ -548,10 +697,10 @@ static bool gltfLoad(const char *gltf_filename,
             return false;
         }
 
-        auto byte_offset = view["byteOffset"].get_uint64();
-        if (byte_offset.error()) {
-            loader.recordJSONError(byte_offset.error());
-            return false;
+        uint64_t byte_offset;
+        auto offset_err = view["byteOffset"].get(byte_offset);
+        if (offset_err) {
+            byte_offset = 0;
         }
 
         uint64_t stride;
@@ -566,11 +715,19 @@ static bool gltfLoad(const char *gltf_filename,
             return false;
         }
 
+        GLTFMeshoptCompression meshopt {};
+        bool meshopt_valid = gltfParseMeshoptView(loader,
+            view["extensions"]["EXT_meshopt_compression"], meshopt);
+        if (!meshopt_valid) {
+            return false;
+        }
+
         loader.bufferViews.push_back(GLTFBufferView {
             static_cast<uint32_t>(buffer.value_unsafe()),
-            static_cast<uint32_t>(byte_offset.value_unsafe()),
+            static_cast<uint32_t>(byte_offset),
             static_cast<uint32_t>(stride),
             static_cast<uint32_t>(byte_len.value_unsafe()),
+            meshopt,
         });
     }
 
@@ -636,11 +793,18 @@ static bool gltfLoad(const char *gltf_filename,
             return false;
         }
 
+        bool normalized;
+        auto normalized_err = accessor["normalized"].get(normalized);
+        if (normalized_err) {
+            normalized = false;
+        }
+
         loader.accessors.push_back(GLTFAccessor {
             static_cast<uint32_t>(buffer_view_idx.value_unsafe()),
             static_cast<uint32_t>(byte_offset),
             static_cast<uint32_t>(accessor_count.value_unsafe()),
             type,
+            normalized,
         });
     }
 
@@ -1278,6 +1442,139 @@ static bool gltfLoad(const char *gltf_filename,
     return true;
 }
 
+static bool decodeMeshoptView(const LoaderData &loader,
+                              const GLTFMeshoptCompression &meshopt,
+                              uint8_t *dst)
+{
+    const uint8_t *src =
+        loader.buffers[meshopt.bufferIdx].dataPtr + meshopt.offset;
+
+    int res;
+    switch (meshopt.mode) {
+    case GLTFMeshoptMode::ATTRIBUTES: {
+        res = meshopt_decodeVertexBuffer(dst, meshopt.count, meshopt.stride,
+                                         src, meshopt.numBytes);
+    } break;
+    case GLTFMeshoptMode::TRIANGLES: {
+        res = meshopt_decodeIndexBuffer(dst, meshopt.count, meshopt.stride,
+                                        src, meshopt.numBytes);
+    } break;
+    case GLTFMeshoptMode::INDICES: {
+        res = meshopt_decodeIndexSequence(dst, meshopt.count, meshopt.stride,
+                                          src, meshopt.numBytes);
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+
+    if (res != 0) {
+        return false;
+    }
+
+    switch (meshopt.filter) {
+    case GLTFMeshoptFilter::NONE: break;
+    case GLTFMeshoptFilter::OCTAHEDRAL: {
+        meshopt_decodeFilterOct(dst, meshopt.count, meshopt.stride);
+    } break;
+    case GLTFMeshoptFilter::QUATERNION: {
+        meshopt_decodeFilterQuat(dst, meshopt.count, meshopt.stride);
+    } break;
+    case GLTFMeshoptFilter::EXPONENTIAL: {
+        meshopt_decodeFilterExp(dst, meshopt.count, meshopt.stride);
+    } break;
+    }
+
+    return true;
+}
+
+// Decompresses every EXT_meshopt_compression buffer view into
+// loader.decodedData before any accessor reads them. Views decode
+// independently, so they're spread over worker threads.
+static bool gltfDecodeCompressedViews(LoaderData &loader)
+{
+    DynArray<uint32_t> compressed_views(0);
+    uint64_t total_decoded_bytes = 0;
+
+    for (CountT i = 0; i < loader.bufferViews.size(); i++) {
+        GLTFMeshoptCompression &meshopt = loader.bufferViews[i].meshopt;
+        if (meshopt.mode == GLTFMeshoptMode::NONE) {
+            continue;
+        }
+
+        const GLTFBuffer &src_buffer = loader.buffers[meshopt.bufferIdx];
+        if (src_buffer.dataPtr == nullptr) {
+            loader.recordError(
+                "GLTF loading failed: external references not supported");
+            return false;
+        }
+
+        // Keep every decoded view 16 byte aligned for the decoders
+        meshopt.decodedOffset = uint32_t(total_decoded_bytes);
+        total_decoded_bytes += ((uint64_t)meshopt.count * meshopt.stride +
+                                15) & ~uint64_t(15);
+
+        compressed_views.push_back(uint32_t(i));
+    }
+
+    if (compressed_views.size() == 0) {
+        return true;
+    }
+
+    if (total_decoded_bytes > UINT32_MAX) {
+        loader.recordError("Decompressed buffer views larger than 4GB");
+        return false;
+    }
+
+    loader.decodedData.resize(total_decoded_bytes, [](uint8_t *) {});
+
+    std::atomic<CountT> next_view { 0 };
+    std::atomic<int64_t> failed_view { -1 };
+
+    auto decodeWorker = [&]() {
+        while (true) {
+            CountT i = next_view.fetch_add(1, std::memory_order_relaxed);
+            if (i >= compressed_views.size()) {
+                break;
+            }
+
+            uint32_t view_idx = compressed_views[i];
+            const GLTFMeshoptCompression &meshopt =
+                loader.bufferViews[view_idx].meshopt;
+
+            bool success = decodeMeshoptView(loader, meshopt,
+                loader.decodedData.data() + meshopt.decodedOffset);
+
+            if (!success) {
+                failed_view.store(view_idx, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    CountT num_threads = std::min(
+        (CountT)std::max(std::thread::hardware_concurrency(), 1u),
+        compressed_views.size());
+
+    // The calling thread is one of the workers
+    DynArray<std::thread> workers(num_threads - 1);
+    for (CountT i = 0; i < num_threads - 1; i++) {
+        workers.emplace_back(decodeWorker);
+    }
+
+    decodeWorker();
+
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    int64_t failed = failed_view.load(std::memory_order_relaxed);
+    if (failed != -1) {
+        loader.recordError("Corrupt meshopt compressed buffer view %ld",
+                           (long)failed);
+        return false;
+    }
+
+    return true;
+}
+
 template <typename T>
 static Optional<GLTFStridedSpan<T>> getGLTFBufferView(
     const LoaderData &loader,
@@ -1286,16 +1583,26 @@ static Optional<GLTFStridedSpan<T>> getGLTFBufferView(
     uint32_t num_elems = 0)
 {
     const GLTFBufferView &view = loader.bufferViews[view_idx];
-    const GLTFBuffer &buffer = loader.buffers[view.bufferIdx];
 
-    if (buffer.dataPtr == nullptr) {
-        loader.recordError(
-            "GLTF loading failed: external references not supported");
-        return Optional<GLTFStridedSpan<T>>::none();
-    }
+    const uint8_t *start_ptr;
+    uint32_t num_bytes;
+    if (view.meshopt.mode != GLTFMeshoptMode::NONE) {
+        start_ptr = loader.decodedData.data() + view.meshopt.decodedOffset +
+            start_offset;
+        num_bytes = view.meshopt.count * view.meshopt.stride;
+    } else {
+        const GLTFBuffer &buffer = loader.buffers[view.bufferIdx];
+
+        if (buffer.dataPtr == nullptr) {
+            loader.recordError(
+                "GLTF loading failed: external references not supported");
+            return Optional<GLTFStridedSpan<T>>::none();
+        }
 
-    size_t total_offset = start_offset + view.offset;
-    const uint8_t *start_ptr = buffer.dataPtr + total_offset;
+        size_t total_offset = start_offset + view.offset;
+        start_ptr = buffer.dataPtr + total_offset;
+        num_bytes = view.numBytes;
+    }
 
     uint32_t stride = view.stride;
     if (stride == 0) {
@@ -1303,7 +1610,7 @@ static Optional<GLTFStridedSpan<T>> getGLTFBufferView(
     }
 
     if (num_elems == 0) {
-        num_elems = view.numBytes / stride;
+        num_elems = num_bytes / stride;
     }
 
     return GLTFStridedSpan<T>(start_ptr, num_elems, stride);
@@ -1320,6 +1627,119 @@ static Optional<GLTFStridedSpan<T>> getGLTFAccessorView(
                                 accessor.numElems);
 }
 
+// Vertex attribute that may be stored as normalized or unnormalized
+// integers (KHR_mesh_quantization) rather than floats
+struct GLTFAttributeView {
+    const uint8_t *data;
+    uint32_t numElems;
+    uint32_t stride;
+    GLTFComponentType type;
+    bool normalized;
+
+    inline uint32_t size() const { return numElems; }
+};
+
+static uint32_t gltfComponentSize(GLTFComponentType type)
+{
+    switch (type) {
+    case GLTFComponentType::UINT32: return 4;
+    case GLTFComponentType::UINT16: return 2;
+    case GLTFComponentType::INT16: return 2;
+    case GLTFComponentType::UINT8: return 1;
+    case GLTFComponentType::INT8: return 1;
+    case GLTFComponentType::FLOAT: return 4;
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
+static Optional<GLTFAttributeView> getGLTFAttributeView(
+    const LoaderData &loader,
+    uint32_t accessor_idx,
+    uint32_t num_components)
+{
+    const GLTFAccessor &accessor = loader.accessors[accessor_idx];
+
+    if (accessor.type == GLTFComponentType::UINT32) {
+        loader.recordError(
+            "GLTF loading failed: unsupported vertex attribute type");
+        return Optional<GLTFAttributeView>::none();
+    }
+
+    auto bytes = getGLTFBufferView<const uint8_t>(
+        loader, accessor.viewIdx, accessor.offset, accessor.numElems);
+    if (!bytes.has_value()) {
+        return Optional<GLTFAttributeView>::none();
+    }
+
+    uint32_t stride = loader.bufferViews[accessor.viewIdx].stride;
+    if (stride == 0) {
+        stride = gltfComponentSize(accessor.type) * num_components;
+    }
+
+    return GLTFAttributeView {
+        .data = bytes->data(),
+        .numElems = accessor.numElems,
+        .stride = stride,
+        .type = accessor.type,
+        .normalized = accessor.normalized,
+    };
+}
+
+template <typename T, CountT num_components>
+static void convertGLTFAttribute(const GLTFAttributeView &view,
+                                 CountT num_elems,
+                                 float *out)
+{
+    // Normalized integers map to [0, 1] or [-1, 1] as in the GLTF spec
+    float scale = 1.f;
+    float min_val = -FLT_MAX;
+    if constexpr (!std::is_same_v<T, float>) {
+        if (view.normalized) {
+            scale = 1.f / float(std::numeric_limits<T>::max());
+            min_val = std::is_signed_v<T> ? -1.f : 0.f;
+        }
+    }
+
+    for (CountT i = 0; i < num_elems; i++) {
+        const uint8_t *elem = view.data + i * view.stride;
+
+        for (CountT c = 0; c < num_components; c++) {
+            T v;
+            memcpy(&v, elem + c * sizeof(T), sizeof(T));
+
+            out[i * num_components + c] = std::max(float(v) * scale, min_val);
+        }
+    }
+}
+
+// Converts the first num_elems elements of view to floats in out. The
+// component type is switched on once per attribute so each case is a
+// tight loop.
+template <CountT num_components>
+static void convertGLTFAttribute(const GLTFAttributeView &view,
+                                 CountT num_elems,
+                                 float *out)
+{
+    switch (view.type) {
+    case GLTFComponentType::FLOAT: {
+        convertGLTFAttribute<float, num_components>(view, num_elems, out);
+    } break;
+    case GLTFComponentType::UINT16: {
+        convertGLTFAttribute<uint16_t, num_components>(view, num_elems, out);
+    } break;
+    case GLTFComponentType::INT16: {
+        convertGLTFAttribute<int16_t, num_components>(view, num_elems, out);
+    } break;
+    case GLTFComponentType::UINT8: {
+        convertGLTFAttribute<uint8_t, num_components>(view, num_elems, out);
+    } break;
+    case GLTFComponentType::INT8: {
+        convertGLTFAttribute<int8_t, num_components>(view, num_elems, out);
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
 // GLTF Mesh = Madrona Object, Primitive = Madrona Mesh
 static bool gltfParseMesh(
     CountT mesh_idx,
@@ -1335,31 +1755,28 @@ static bool gltfParseMesh(
         CountT prim_idx = prim_offset + gltf_mesh.primOffset;
         const GLTFPrimitive &prim = loader.prims[prim_idx];
 
-        auto position_accessor = getGLTFAccessorView<const math::Vector3>(
-            loader, prim.positionIdx);
+        auto position_accessor = getGLTFAttributeView(
+            loader, prim.positionIdx, 3);
 
         if (!position_accessor.has_value()) {
             return false;
         }
 
-        auto normal_accessor =
-            Optional<GLTFStridedSpan<const math::Vector3>>::none();
+        auto normal_accessor = Optional<GLTFAttributeView>::none();
 
         if (prim.normalIdx.has_value()) {
-            normal_accessor = getGLTFAccessorView<const math::Vector3>(
-                loader, *prim.normalIdx);
+            normal_accessor = getGLTFAttributeView(
+                loader, *prim.normalIdx, 3);
 
             if (!normal_accessor.has_value()) {
                 return false;
             }
         }
 
-        auto uv_accessor =
-            Optional<GLTFStridedSpan<const math::Vector2>>::none();
+        auto uv_accessor = Optional<GLTFAttributeView>::none();
 
         if (prim.uvIdx.has_value()) {
-            uv_accessor = getGLTFAccessorView<const math::Vector2>(
-                loader, *prim.uvIdx);
+            uv_accessor = getGLTFAttributeView(loader, *prim.uvIdx, 2);
 
             if (!uv_accessor.has_value()) {
                 return false;
@@ -1442,6 +1859,10 @@ static bool gltfParseMesh(
         }
 
         uint32_t num_vertices = max_idx + 1;
+        if (num_vertices > position_accessor->size()) {
+            loader.recordError("Index out of range in mesh %d", mesh_idx);
+            return false;
+        }
 
         DynArray<math::Vector3> positions(num_vertices);
         auto normals = Optional<DynArray<math::Vector3>>::none();
@@ -1465,51 +1886,40 @@ static bool gltfParseMesh(
             uvs.emplace(num_vertices);
         }
 
-        for (uint32_t vert_idx = 0; vert_idx < num_vertices; vert_idx++) {
-            math::Vector3 pos = (*position_accessor)[vert_idx];
-            if (isnan(pos.x) || isinf(pos.x)) {
-                pos.x = 0;
-            }
-
-            if (isnan(pos.y) || isinf(pos.y)) {
-                pos.y = 0;
-            }
-
-            if (isnan(pos.z) || isinf(pos.z)) {
-                pos.z = 0;
-            }
-            positions.push_back(pos);
-
-            if (normal_accessor.has_value()) {
-                math::Vector3 normal = (*normal_accessor)[vert_idx];
+        auto sanitize = [](float v) {
+            return (isnan(v) || isinf(v)) ? 0.f : v;
+        };
 
-                if (isnan(normal.x) || isinf(normal.x)) {
-                    normal.x = 0;
-                }
+        positions.resize(num_vertices, [](math::Vector3 *) {});
+        convertGLTFAttribute<3>(*position_accessor, num_vertices,
+                                &positions[0].x);
 
-                if (isnan(normal.y) || isinf(normal.y)) {
-                    normal.y = 0;
-                }
-
-                if (isnan(normal.z) || isinf(normal.z)) {
-                    normal.z = 0;
-                }
+        for (math::Vector3 &pos : positions) {
+            pos.x = sanitize(pos.x);
+            pos.y = sanitize(pos.y);
+            pos.z = sanitize(pos.z);
+        }
 
-                normals->push_back(normal);
+        if (normal_accessor.has_value()) {
+            normals->resize(num_vertices, [](math::Vector3 *) {});
+            convertGLTFAttribute<3>(*normal_accessor, num_vertices,
+                                    &(*normals)[0].x);
+
+            for (math::Vector3 &normal : *normals) {
+                normal.x = sanitize(normal.x);
+                normal.y = sanitize(normal.y);
+                normal.z = sanitize(normal.z);
             }
+        }
 
-            if (uv_accessor.has_value()) {
-                math::Vector2 uv = (*uv_accessor)[vert_idx];
-
-                if (isnan(uv.x) || isinf(uv.x)) {
-                    uv.x = 0;
-                }
-
-                if (isnan(uv.y) || isinf(uv.y)) {
-                    uv.y = 0;
-                }
+        if (uv_accessor.has_value()) {
+            uvs->resize(num_vertices, [](math::Vector2 *) {});
+            convertGLTFAttribute<2>(*uv_accessor, num_vertices,
+                                    &(*uvs)[0].x);
 
-                uvs->push_back(uv);
+            for (math::Vector2 &uv : *uvs) {
+                uv.x = sanitize(uv.x);
+                uv.y = sanitize(uv.y);
             }
         }
 
@@ -1616,6 +2026,10 @@ static bool gltfImportAssets(LoaderData &loader,
     CountT new_objects_start = imported.objects.size();
     CountT new_instances_start = imported.instances.size();
 
+    if (!gltfDecodeCompressedViews(loader)) {
+        return false;
+    }
+
     for (CountT mesh_idx = 0; mesh_idx < loader.meshes.size();
          mesh_idx++) {
         bool mesh_valid = gltfParseMesh(mesh_idx, loader, imported);
@@ -1837,6 +2251,7 @@ GLTFLoader::Impl::Impl(ImageImporter &img_import, Span<char> err_buf)
       sceneDirectory(),
       sceneName(),
       internalData(0),
+      decodedData(0),
       buffers(0),
       bufferViews(0),
       accessors(0),
@@ -1910,6 +2325,7 @@ bool GLTFLoader::load(const char *path,
 
     // Clear tmp buffers
     impl_->internalData.clear();
+    impl_->decodedData.clear();
     impl_->buffers.clear();
     impl_->bufferViews.clear();
     impl_->accessors.clear();
@@ -1,12 +1,18 @@
 #include <madrona/importer.hpp>
 #include <madrona/io.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <string>
 #include <unordered_map>
 
 #include <stb_image.h>
 
+#ifdef MADRONA_BASISU_SUPPORT
+#include <basisu_transcoder.h>
+#endif
+
 namespace madrona::imp {
 
 namespace {
@@ -14,6 +20,7 @@ namespace {
 enum class DefaultTypeCode : int32_t {
     PNG,
     JPG,
+    KTX2,
     NumDefault,
 };
 
@@ -43,6 +50,236 @@ static Optional<SourceTexture> stbiImportR8G8B8A8(void *data, size_t num_bytes)
         .width = (uint32_t)width,
         .height = (uint32_t)height,
         .numBytes = (size_t)width * (size_t)height * 4,
+        .numLevels = 1,
+    };
+}
+
+#ifdef MADRONA_BASISU_SUPPORT
+// BasisLZ (ETC1S) and UASTC payloads, with or without Zstd, transcoded
+// level by level to BC7, or to RGBA8 if the transcoder was built without
+// BC7 support. Output uses the same largest first layout as ktx2Import.
+static Optional<SourceTexture> ktx2TranscodeBasis(void *data,
+                                                  size_t num_bytes)
+{
+    using namespace basist;
+
+    static const bool basisu_initialized = []() {
+        basisu_transcoder_init();
+        return true;
+    }();
+    (void)basisu_initialized;
+
+    if (num_bytes > UINT32_MAX) {
+        return Optional<SourceTexture>::none();
+    }
+
+    ktx2_transcoder transcoder;
+    if (!transcoder.init(data, (uint32_t)num_bytes)) {
+        return Optional<SourceTexture>::none();
+    }
+
+    // Only plain 2D textures, same as the uncompressed path
+    if (transcoder.get_layers() > 1 || transcoder.get_faces() != 1) {
+        return Optional<SourceTexture>::none();
+    }
+
+    SourceTextureFormat format;
+    transcoder_texture_format transcode_format;
+    if (basis_is_format_supported(transcoder_texture_format::cTFBC7_RGBA,
+                                  transcoder.get_format())) {
+        format = SourceTextureFormat::BC7;
+        transcode_format = transcoder_texture_format::cTFBC7_RGBA;
+    } else {
+        format = SourceTextureFormat::R8G8B8A8;
+        transcode_format = transcoder_texture_format::cTFRGBA32;
+    }
+
+    if (!transcoder.start_transcoding()) {
+        return Optional<SourceTexture>::none();
+    }
+
+    uint32_t width = transcoder.get_width();
+    uint32_t height = transcoder.get_height();
+    uint32_t num_levels = std::max(transcoder.get_levels(), 1u);
+
+    size_t total_bytes = 0;
+    for (uint32_t i = 0; i < num_levels; i++) {
+        uint32_t level_width = std::max(width >> i, 1u);
+        uint32_t level_height = std::max(height >> i, 1u);
+        total_bytes += sourceTextureLevelBytes(
+            format, level_width, level_height);
+    }
+
+    // Allocated with malloc to match deallocImportedImages
+    uint8_t *out = (uint8_t *)malloc(total_bytes);
+
+    size_t out_offset = 0;
+    for (uint32_t i = 0; i < num_levels; i++) {
+        uint32_t level_width = std::max(width >> i, 1u);
+        uint32_t level_height = std::max(height >> i, 1u);
+        size_t level_bytes =
+            sourceTextureLevelBytes(format, level_width, level_height);
+
+        // Buffer size is in blocks for BC7 and in pixels for RGBA32
+        uint32_t out_units = format == SourceTextureFormat::BC7 ?
+            (uint32_t)(level_bytes / 16) : level_width * level_height;
+
+        if (!transcoder.transcode_image_level(i, 0, 0, out + out_offset,
+                out_units, transcode_format)) {
+            free(out);
+            return Optional<SourceTexture>::none();
+        }
+
+        out_offset += level_bytes;
+    }
+
+    return SourceTexture {
+        .data = out,
+        .format = format,
+        .width = width,
+        .height = height,
+        .numBytes = total_bytes,
+        .numLevels = num_levels,
+    };
+}
+#endif
+
+// KTX2 files holding BC7 or RGBA8 data, with or without a mip chain.
+// Levels are copied as is, so there is no image decode at load time.
+// Basis Universal payloads (BasisLZ or UASTC) are transcoded to BC7 when
+// built with MADRONA_BASISU_SUPPORT, otherwise they're rejected.
+static Optional<SourceTexture> ktx2Import(void *data, size_t num_bytes)
+{
+    static constexpr uint8_t ktx2_identifier[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A,
+    };
+
+    // Header, index and level index layout from the KTX 2.0 spec
+    struct KTX2Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct KTX2Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    static_assert(sizeof(KTX2Header) == 80);
+    static_assert(sizeof(KTX2Level) == 24);
+
+    // VkFormat values, so vulkan headers aren't needed here
+    constexpr uint32_t vk_format_undefined = 0;
+    constexpr uint32_t vk_format_r8g8b8a8_unorm = 37;
+    constexpr uint32_t vk_format_r8g8b8a8_srgb = 43;
+    constexpr uint32_t vk_format_bc7_unorm = 145;
+    constexpr uint32_t vk_format_bc7_srgb = 146;
+
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    if (num_bytes < sizeof(KTX2Header)) {
+        return Optional<SourceTexture>::none();
+    }
+
+    KTX2Header hdr;
+    memcpy(&hdr, bytes, sizeof(KTX2Header));
+
+    if (memcmp(hdr.identifier, ktx2_identifier, sizeof(ktx2_identifier))) {
+        return Optional<SourceTexture>::none();
+    }
+
+    SourceTextureFormat format;
+    switch (hdr.vkFormat) {
+    case vk_format_r8g8b8a8_unorm:
+    case vk_format_r8g8b8a8_srgb: {
+        format = SourceTextureFormat::R8G8B8A8;
+    } break;
+    case vk_format_bc7_unorm:
+    case vk_format_bc7_srgb: {
+        format = SourceTextureFormat::BC7;
+    } break;
+    case vk_format_undefined: {
+        // BasisLZ / UASTC, the format is only known after transcoding
+#ifdef MADRONA_BASISU_SUPPORT
+        return ktx2TranscodeBasis(data, num_bytes);
+#else
+        return Optional<SourceTexture>::none();
+#endif
+    }
+    default: {
+        return Optional<SourceTexture>::none();
+    }
+    }
+
+    // Only plain 2D textures without supercompression
+    if (hdr.supercompressionScheme != 0 || hdr.pixelWidth == 0 ||
+            hdr.pixelHeight == 0 || hdr.pixelDepth > 1 ||
+            hdr.layerCount > 1 || hdr.faceCount != 1) {
+        return Optional<SourceTexture>::none();
+    }
+
+    // levelCount == 0 asks the loader to generate mips, just use level 0
+    uint32_t num_levels = hdr.levelCount == 0 ? 1 : hdr.levelCount;
+    if (num_levels > 32 || sizeof(KTX2Header) +
+            (size_t)num_levels * sizeof(KTX2Level) > num_bytes) {
+        return Optional<SourceTexture>::none();
+    }
+
+    size_t total_bytes = 0;
+    for (uint32_t i = 0; i < num_levels; i++) {
+        uint32_t level_width = std::max(hdr.pixelWidth >> i, 1u);
+        uint32_t level_height = std::max(hdr.pixelHeight >> i, 1u);
+        total_bytes += sourceTextureLevelBytes(
+            format, level_width, level_height);
+    }
+
+    // Allocated with malloc to match deallocImportedImages
+    uint8_t *out = (uint8_t *)malloc(total_bytes);
+
+    size_t out_offset = 0;
+    for (uint32_t i = 0; i < num_levels; i++) {
+        KTX2Level level;
+        memcpy(&level, bytes + sizeof(KTX2Header) + i * sizeof(KTX2Level),
+               sizeof(KTX2Level));
+
+        uint32_t level_width = std::max(hdr.pixelWidth >> i, 1u);
+        uint32_t level_height = std::max(hdr.pixelHeight >> i, 1u);
+        size_t level_bytes =
+            sourceTextureLevelBytes(format, level_width, level_height);
+
+        if (level.byteLength != level_bytes ||
+                level.byteOffset > num_bytes ||
+                level.byteLength > num_bytes - level.byteOffset) {
+            free(out);
+            return Optional<SourceTexture>::none();
+        }
+
+        memcpy(out + out_offset, bytes + level.byteOffset, level_bytes);
+        out_offset += level_bytes;
+    }
+
+    return SourceTexture {
+        .data = out,
+        .format = format,
+        .width = hdr.pixelWidth,
+        .height = hdr.pixelHeight,
+        .numBytes = total_bytes,
+        .numLevels = num_levels,
     };
 }
 
@@ -52,10 +289,12 @@ ImageImporter::Impl * ImageImporter::Impl::make()
         .extensionToTypeCode = {
             { "png", (int32_t)DefaultTypeCode::PNG },
             { "jpg", (int32_t)DefaultTypeCode::JPG },
+            { "ktx2", (int32_t)DefaultTypeCode::KTX2 },
         },
         .typeCodeToHandler = {
             { (int32_t)DefaultTypeCode::PNG, &stbiImportR8G8B8A8 },
             { (int32_t)DefaultTypeCode::JPG, &stbiImportR8G8B8A8 },
+            { (int32_t)DefaultTypeCode::KTX2, &ktx2Import },
         },
         .nextTypeCode = (int32_t)DefaultTypeCode::NumDefault,
     };
@@ -72,7 +311,8 @@ int32_t ImageImporter::addHandler(const char *extension, ImportHandler fn)
 {
     int32_t type_code = impl_->nextTypeCode++;
 
-    impl_->extensionToTypeCode.emplace(extension, type_code);
+    // Replaces the built in handler if the extension already has one
+    impl_->extensionToTypeCode[extension] = type_code;
     impl_->typeCodeToHandler.emplace(type_code, fn);
 
     return type_code;
@@ -2,10 +2,13 @@
 
 #include <madrona/dyn_array.hpp>
 #include <madrona/heap_array.hpp>
+#include <madrona/utils.hpp>
 
+#include <algorithm>
 #include <string_view>
 #include <filesystem>
 #include <string>
+#include <unordered_map>
 
 #include <meshoptimizer.h>
 
@@ -66,6 +69,222 @@ ImageImporter & AssetImporter::imageImporter()
     return impl_->imgImporter;
 }
 
+static CountT numMeshIndices(const SourceMesh &mesh)
+{
+    if (mesh.faceCounts == nullptr) {
+        return (CountT)mesh.numFaces * 3;
+    }
+
+    CountT num_indices = 0;
+    for (CountT i = 0; i < (CountT)mesh.numFaces; i++) {
+        num_indices += mesh.faceCounts[i];
+    }
+
+    return num_indices;
+}
+
+static uint32_t meshAttributeMask(const SourceMesh &mesh)
+{
+    return (mesh.normals ? 1_u32 : 0_u32) |
+        (mesh.tangentAndSigns ? 2_u32 : 0_u32) |
+        (mesh.uvs ? 4_u32 : 0_u32) |
+        (mesh.faceCounts ? 8_u32 : 0_u32) |
+        (mesh.faceMaterials ? 16_u32 : 0_u32);
+}
+
+template <typename T>
+static uint64_t hashMeshArray(const T *arr, CountT num_elems, uint64_t h)
+{
+    if (arr == nullptr) {
+        return h;
+    }
+
+    return utils::hashBytes(arr, sizeof(T) * num_elems, h);
+}
+
+static uint64_t hashMeshGeometry(const SourceMesh &mesh, CountT num_indices)
+{
+    uint32_t header[3] = {
+        mesh.numVertices,
+        mesh.numFaces,
+        meshAttributeMask(mesh),
+    };
+
+    uint64_t h = utils::hashBytes(header, sizeof(header));
+    h = hashMeshArray(mesh.positions, mesh.numVertices, h);
+    h = hashMeshArray(mesh.normals, mesh.numVertices, h);
+    h = hashMeshArray(mesh.tangentAndSigns, mesh.numVertices, h);
+    h = hashMeshArray(mesh.uvs, mesh.numVertices, h);
+    h = hashMeshArray(mesh.indices, num_indices, h);
+    h = hashMeshArray(mesh.faceCounts, mesh.numFaces, h);
+    h = hashMeshArray(mesh.faceMaterials, mesh.numFaces, h);
+
+    return h;
+}
+
+template <typename T>
+static bool meshArraysEqual(const T *a, const T *b, CountT num_elems)
+{
+    if (a == b) {
+        return true;
+    }
+
+    if (a == nullptr || b == nullptr) {
+        return false;
+    }
+
+    return memcmp(a, b, sizeof(T) * num_elems) == 0;
+}
+
+static bool meshGeometryEqual(const SourceMesh &a, const SourceMesh &b,
+                              CountT num_indices)
+{
+    if (a.numVertices != b.numVertices || a.numFaces != b.numFaces ||
+            meshAttributeMask(a) != meshAttributeMask(b)) {
+        return false;
+    }
+
+    // Compare face counts first so the index count is known to match
+    return meshArraysEqual(a.faceCounts, b.faceCounts, a.numFaces) &&
+        meshArraysEqual(a.indices, b.indices, num_indices) &&
+        meshArraysEqual(a.positions, b.positions, a.numVertices) &&
+        meshArraysEqual(a.normals, b.normals, a.numVertices) &&
+        meshArraysEqual(a.tangentAndSigns, b.tangentAndSigns,
+                        a.numVertices) &&
+        meshArraysEqual(a.uvs, b.uvs, a.numVertices) &&
+        meshArraysEqual(a.faceMaterials, b.faceMaterials, a.numFaces);
+}
+
+// Releases arrays that are no longer referenced by any mesh or object.
+// referenced must be sorted. Loaders may point meshes into the middle of an
+// array (merged glTF scenes), so any pointer inside the array keeps it alive.
+template <typename T>
+static void releaseUnreferencedArrays(DynArray<DynArray<T>> &arrays,
+                                      const DynArray<uintptr_t> &referenced)
+{
+    CountT num_kept = 0;
+    for (CountT i = 0; i < arrays.size(); i++) {
+        DynArray<T> &arr = arrays[i];
+
+        if (arr.data() != nullptr) {
+            uintptr_t start = (uintptr_t)arr.data();
+            uintptr_t end = (uintptr_t)(arr.data() + arr.size());
+
+            auto iter = std::lower_bound(
+                referenced.begin(), referenced.end(), start);
+            if (iter == referenced.end() || *iter >= end) {
+                continue;
+            }
+        }
+
+        if (num_kept != i) {
+            // Move assignment frees the unreferenced array being replaced
+            arrays[num_kept] = std::move(arr);
+        }
+        num_kept++;
+    }
+
+    arrays.resize(num_kept, [](auto *) {});
+}
+
+// Collapses byte-identical mesh geometry across every loaded asset.
+// Duplicate meshes are repointed at the first copy's arrays and objects whose
+// meshes become identical share a single SourceMesh array. Object indices are
+// unchanged, so instances and user-facing object IDs remain valid.
+static void deduplicateGeometry(ImportedAssets &imported)
+{
+    std::unordered_multimap<uint64_t, SourceMesh> unique_meshes;
+
+    for (SourceObject &obj : imported.objects) {
+        for (SourceMesh &mesh : obj.meshes) {
+            CountT num_indices = numMeshIndices(mesh);
+            uint64_t hash = hashMeshGeometry(mesh, num_indices);
+
+            auto [start, end] = unique_meshes.equal_range(hash);
+            bool found = false;
+            for (auto iter = start; iter != end; ++iter) {
+                const SourceMesh &canonical = iter->second;
+                if (!meshGeometryEqual(mesh, canonical, num_indices)) {
+                    continue;
+                }
+
+                mesh.positions = canonical.positions;
+                mesh.normals = canonical.normals;
+                mesh.tangentAndSigns = canonical.tangentAndSigns;
+                mesh.uvs = canonical.uvs;
+                mesh.indices = canonical.indices;
+                mesh.faceCounts = canonical.faceCounts;
+                mesh.faceMaterials = canonical.faceMaterials;
+                found = true;
+                break;
+            }
+
+            if (!found) {
+                unique_meshes.emplace(hash, mesh);
+            }
+        }
+    }
+
+    // After mesh deduplication identical objects have bitwise identical
+    // SourceMesh arrays (same geometry pointers and materials).
+    std::unordered_multimap<uint64_t, Span<SourceMesh>> unique_objects;
+    for (SourceObject &obj : imported.objects) {
+        uint64_t hash = utils::hashBytes(obj.meshes.data(),
+            sizeof(SourceMesh) * obj.meshes.size());
+
+        auto [start, end] = unique_objects.equal_range(hash);
+        bool found = false;
+        for (auto iter = start; iter != end; ++iter) {
+            Span<SourceMesh> canonical = iter->second;
+            if (canonical.size() != obj.meshes.size() ||
+                    memcmp(canonical.data(), obj.meshes.data(),
+                           sizeof(SourceMesh) * canonical.size()) != 0) {
+                continue;
+            }
+
+            obj.meshes = canonical;
+            found = true;
+            break;
+        }
+
+        if (!found) {
+            unique_objects.emplace(hash, obj.meshes);
+        }
+    }
+
+    DynArray<uintptr_t> referenced(imported.objects.size() * 8);
+    for (const SourceObject &obj : imported.objects) {
+        referenced.push_back((uintptr_t)obj.meshes.data());
+
+        for (const SourceMesh &mesh : obj.meshes) {
+            for (const void *ptr : {
+                    (const void *)mesh.positions,
+                    (const void *)mesh.normals,
+                    (const void *)mesh.tangentAndSigns,
+                    (const void *)mesh.uvs,
+                    (const void *)mesh.indices,
+                    (const void *)mesh.faceCounts,
+                    (const void *)mesh.faceMaterials,
+                }) {
+                if (ptr != nullptr) {
+                    referenced.push_back((uintptr_t)ptr);
+                }
+            }
+        }
+    }
+
+    std::sort(referenced.begin(), referenced.end());
+
+    auto &geo = imported.geoData;
+    releaseUnreferencedArrays(geo.positionArrays, referenced);
+    releaseUnreferencedArrays(geo.normalArrays, referenced);
+    releaseUnreferencedArrays(geo.tangentAndSignArrays, referenced);
+    releaseUnreferencedArrays(geo.uvArrays, referenced);
+    releaseUnreferencedArrays(geo.indexArrays, referenced);
+    releaseUnreferencedArrays(geo.faceCountArrays, referenced);
+    releaseUnreferencedArrays(geo.meshArrays, referenced);
+}
+
 Optional<ImportedAssets> AssetImporter::Impl::importFromDisk(
     Span<const char * const> asset_paths,
     Span<char> err_buf, bool one_object_per_asset)
@@ -143,6 +362,8 @@ Optional<ImportedAssets> AssetImporter::Impl::importFromDisk(
         return Optional<ImportedAssets>::none();
     }
 
+    deduplicateGeometry(imported);
+
     return imported;
 }
 
@@ -4,38 +4,975 @@
 
 #include "usd.hpp"
 
+#include <madrona/heap_array.hpp>
+#include <madrona/utils.hpp>
+
+#include <array>
+#include <cstdarg>
+#include <cstring>
 #include <string>
+#include <unordered_map>
+
+#include <meshoptimizer.h>
 
 namespace madrona::imp {
 
+using namespace math;
+
+namespace {
+
+// Geometry for a single USD mesh prim, held in scratch arrays until the
+// owning object is committed into ImportedAssets. Keeping the data pending
+// lets instance prototypes be hashed and discarded when an identical
+// prototype has already been imported.
+struct PendingMesh {
+    DynArray<Vector3> positions;
+    DynArray<Vector3> normals;
+    DynArray<Vector2> uvs;
+    DynArray<uint32_t> indices;
+    DynArray<uint32_t> faceCounts;
+    uint32_t numFaces;
+    uint32_t materialIdx;
+};
+
+struct PointInstance {
+    uint32_t protoIdx;
+    Mat3x4 txfm;
+};
+
+enum class AttrRate {
+    None,
+    Constant,
+    Uniform,
+    Vertex,
+    FaceVarying,
+};
+
+inline AttrRate toAttrRate(tinyusdz::Interpolation interp)
+{
+    using tinyusdz::Interpolation;
+
+    switch (interp) {
+    case Interpolation::Constant: return AttrRate::Constant;
+    case Interpolation::Uniform: return AttrRate::Uniform;
+    case Interpolation::Vertex:
+    case Interpolation::Varying: return AttrRate::Vertex;
+    case Interpolation::FaceVarying: return AttrRate::FaceVarying;
+    default: return AttrRate::None;
+    }
+}
+
+template <typename T>
+inline uint64_t hashArray(uint64_t h, const DynArray<T> &arr)
+{
+    return utils::hashBytes(arr.data(), sizeof(T) * arr.size(), h);
+}
+
+inline Mat3x4 toMat3x4(const tinyusdz::value::matrix4d &m)
+{
+    // USD matrices are row major and transform row vectors, so each row
+    // of the USD matrix is a column of the equivalent Mat3x4.
+    return Mat3x4 {{
+        Vector3 { (float)m.m[0][0], (float)m.m[0][1], (float)m.m[0][2] },
+        Vector3 { (float)m.m[1][0], (float)m.m[1][1], (float)m.m[1][2] },
+        Vector3 { (float)m.m[2][0], (float)m.m[2][1], (float)m.m[2][2] },
+        Vector3 { (float)m.m[3][0], (float)m.m[3][1], (float)m.m[3][2] },
+    }};
+}
+
+template <typename T>
+bool getAttrValue(const tinyusdz::TypedAttribute<tinyusdz::Animatable<T>> &attr,
+                  T *out)
+{
+    auto v = attr.get_value();
+    if (!v) {
+        return false;
+    }
+
+    return v.value().get_scalar(out);
+}
+
+template <typename T>
+bool getAttrValue(
+    const tinyusdz::TypedAttributeWithFallback<tinyusdz::Animatable<T>> &attr,
+    T *out)
+{
+    return attr.get_value().get_scalar(out);
+}
+
+}
+
 struct USDLoader::Impl {
     Span<char> errBuf;
+    const char *filePath;
+    const tinyusdz::Stage *stage;
+
+    // Prototype key (see prototypeKey) -> index of the object holding its
+    // geometry. All instances of a prototype reference this single
+    // SourceObject, and it is only baked for the first one.
+    std::unordered_map<std::string, uint32_t> prototypeObjects;
+
+    // Content hash -> objects built from instanceable prims, for prototypes
+    // without a reference to key on. Hits are compared byte by byte.
+    std::unordered_multimap<uint64_t, uint32_t> contentObjects;
+
+    // PointInstancer prototype prim path -> object index
+    std::unordered_map<std::string, uint32_t> pointProtoObjects;
+
+    // Material prim path -> index into ImportedAssets::materials
+    std::unordered_map<std::string, uint32_t> materialIndices;
+
+    // Meshes of the object currently being built
+    DynArray<PendingMesh> curMeshes;
+
+    // Temporary buffers kept around to avoid reallocations
+    DynArray<Vector3> unindexedPositions;
+    DynArray<Vector3> unindexedNormals;
+    DynArray<Vector2> unindexedUVs;
+    DynArray<uint32_t> fakeIndices;
+    DynArray<uint32_t> vertexRemap;
+
+    Impl(Span<char> err_buf);
+
+    void recordError(const char *fmt_string, ...) const;
+
+    uint32_t getMaterial(const tinyusdz::GeomMesh &mesh,
+                         ImportedAssets &imported);
+
+    bool convertMesh(const tinyusdz::GeomMesh &mesh,
+                     const Mat3x4 &txfm,
+                     ImportedAssets &imported);
+
+    bool bakeSubtree(const tinyusdz::Prim &prim,
+                     const Mat3x4 &txfm,
+                     ImportedAssets &imported);
 
-    static inline Impl * init(Span<char> err_buf);
+    bool readPointInstances(const tinyusdz::GeomPointInstancer &instancer,
+                            std::vector<tinyusdz::Path> *proto_paths,
+                            DynArray<PointInstance> *out_instances) const;
+
+    bool bakePointInstancer(const tinyusdz::GeomPointInstancer &instancer,
+                            const Mat3x4 &txfm,
+                            ImportedAssets &imported);
+
+    bool visitPointInstancer(const tinyusdz::GeomPointInstancer &instancer,
+                             const Mat3x4 &txfm,
+                             ImportedAssets &imported);
+
+    bool visit(const tinyusdz::Prim &prim,
+               const Mat3x4 &parent_txfm,
+               ImportedAssets &imported);
+
+    uint64_t hashCurrentObject() const;
+    bool currentObjectMatches(const ImportedAssets &imported,
+                              uint32_t obj_idx) const;
+    uint32_t commitObject(ImportedAssets &imported);
+    uint32_t findOrCommitObject(ImportedAssets &imported);
+
+    bool load(const char *path, ImportedAssets &imported, bool merge);
 };
 
-USDLoader::Impl * USDLoader::Impl::init(Span<char> err_buf)
+USDLoader::Impl::Impl(Span<char> err_buf)
+    : errBuf(err_buf),
+      filePath(nullptr),
+      stage(nullptr),
+      prototypeObjects(),
+      contentObjects(),
+      pointProtoObjects(),
+      materialIndices(),
+      curMeshes(0),
+      unindexedPositions(0),
+      unindexedNormals(0),
+      unindexedUVs(0),
+      fakeIndices(0),
+      vertexRemap(0)
+{}
+
+void USDLoader::Impl::recordError(const char *fmt_string, ...) const
+{
+    if (errBuf.data() == nullptr) {
+        return;
+    }
+
+    int prefix_chars_written = snprintf(errBuf.data(), errBuf.size(),
+        "Invalid USD File %s: ", filePath);
+
+    if (prefix_chars_written < errBuf.size()) {
+        va_list args;
+        va_start(args, fmt_string);
+
+        size_t remaining_data = errBuf.size() - prefix_chars_written;
+        vsnprintf(errBuf.data() + prefix_chars_written, remaining_data,
+                  fmt_string, args);
+
+        va_end(args);
+    }
+}
+
+static inline const tinyusdz::Xformable * getXformable(
+    const tinyusdz::Prim &prim)
 {
-    return new Impl {
-        .errBuf = err_buf,
+    if (auto *xform = prim.as<tinyusdz::Xform>()) {
+        return xform;
+    } else if (auto *mesh = prim.as<tinyusdz::GeomMesh>()) {
+        return mesh;
+    } else if (auto *instancer = prim.as<tinyusdz::GeomPointInstancer>()) {
+        return instancer;
+    }
+
+    return nullptr;
+}
+
+static inline Mat3x4 localTransform(const tinyusdz::Prim &prim)
+{
+    const tinyusdz::Xformable *xformable = getXformable(prim);
+    if (!xformable) {
+        return Mat3x4::identity();
+    }
+
+    bool reset_stack = false;
+    auto local = xformable->GetLocalMatrix(
+        tinyusdz::value::TimeCode::Default(),
+        tinyusdz::value::TimeSampleInterpolationType::Held,
+        &reset_stack);
+
+    if (!local) {
+        return Mat3x4::identity();
+    }
+
+    return toMat3x4(local.value());
+}
+
+static inline bool isInstanceable(const tinyusdz::Prim &prim)
+{
+    const auto &instanceable = prim.metas().instanceable;
+    return instanceable.has_value() && instanceable.value();
+}
+
+// Identity of an instanceable prim's prototype: the layers and prims it
+// references or loads as a payload. USD doesn't allow overrides below an
+// instance, so instances with the same arcs have the same geometry. Empty
+// if the prim has neither.
+static std::string prototypeKey(const tinyusdz::Prim &prim)
+{
+    const auto &metas = prim.metas();
+
+    std::string key;
+    auto appendArcs = [&key](const auto &arcs) {
+        for (const auto &arc : arcs) {
+            key += arc.asset_path.GetAssetPath();
+            key += '<';
+            key += arc.prim_path.full_path_name();
+            key += '>';
+        }
     };
+
+    if (metas.references.has_value()) {
+        appendArcs(metas.references.value().second);
+    }
+
+    if (metas.payload.has_value()) {
+        key += '|';
+        appendArcs(metas.payload.value().second);
+    }
+
+    return key;
 }
 
-USDLoader::USDLoader(ImageImporter &, Span<char> err_buf)
-    : impl_(Impl::init(err_buf))
-{}
+uint32_t USDLoader::Impl::getMaterial(const tinyusdz::GeomMesh &mesh,
+                                      ImportedAssets &imported)
+{
+    if (!mesh.materialBinding.has_value()) {
+        return 0xFFFF'FFFF;
+    }
 
-USDLoader::~USDLoader() = default;
+    const tinyusdz::Relationship &rel = mesh.materialBinding.value();
 
-bool USDLoader::load(const char *path,
-                     ImportedAssets &imported_assets,
-                     bool merge_and_flatten,
-                     ImageImporter &)
+    tinyusdz::Path mat_path;
+    if (rel.is_path()) {
+        mat_path = rel.targetPath;
+    } else if (rel.is_pathvector() && rel.targetPathVector.size() > 0) {
+        mat_path = rel.targetPathVector[0];
+    } else {
+        return 0xFFFF'FFFF;
+    }
+
+    std::string mat_name = mat_path.full_path_name();
+
+    auto iter = materialIndices.find(mat_name);
+    if (iter != materialIndices.end()) {
+        return iter->second;
+    }
+
+    SourceMaterial mat {
+        .color = { 0.18f, 0.18f, 0.18f, 1.f },
+        .textureIdx = -1,
+        .roughness = 0.5f,
+        .metalness = 0.f,
+    };
+
+    auto mat_prim = stage->GetPrimAtPath(mat_path);
+    if (mat_prim) {
+        // Only UsdPreviewSurface constant inputs are imported. Texture
+        // connections fall back to the shader's authored constant values.
+        for (const tinyusdz::Prim &child : mat_prim.value()->children()) {
+            auto *shader = child.as<tinyusdz::Shader>();
+            if (!shader) {
+                continue;
+            }
+
+            auto *surface = shader->value.as<tinyusdz::UsdPreviewSurface>();
+            if (!surface) {
+                continue;
+            }
+
+            tinyusdz::value::color3f diffuse;
+            if (getAttrValue(surface->diffuseColor, &diffuse)) {
+                mat.color.x = diffuse.r;
+                mat.color.y = diffuse.g;
+                mat.color.z = diffuse.b;
+            }
+
+            float opacity;
+            if (getAttrValue(surface->opacity, &opacity)) {
+                mat.color.w = opacity;
+            }
+
+            float roughness;
+            if (getAttrValue(surface->roughness, &roughness)) {
+                mat.roughness = roughness;
+            }
+
+            float metallic;
+            if (getAttrValue(surface->metallic, &metallic)) {
+                mat.metalness = metallic;
+            }
+
+            break;
+        }
+    }
+
+    uint32_t mat_idx = uint32_t(imported.materials.size());
+    imported.materials.push_back(mat);
+    materialIndices.emplace(std::move(mat_name), mat_idx);
+
+    return mat_idx;
+}
+
+bool USDLoader::Impl::convertMesh(const tinyusdz::GeomMesh &mesh,
+                                  const Mat3x4 &txfm,
+                                  ImportedAssets &imported)
 {
-    tinyusdz::Stage stage;
+    const std::vector<tinyusdz::value::point3f> points = mesh.get_points();
+    const std::vector<int32_t> face_counts = mesh.get_faceVertexCounts();
+    const std::vector<int32_t> face_indices = mesh.get_faceVertexIndices();
+
+    if (points.size() == 0 || face_counts.size() == 0) {
+        // Empty mesh, nothing to import
+        return true;
+    }
+
+    CountT num_points = (CountT)points.size();
+    CountT num_corners = 0;
+    bool fully_triangular = true;
+    for (int32_t c : face_counts) {
+        if (c < 3) {
+            recordError("Degenerate face with %d vertices.", c);
+            return false;
+        }
+
+        if (c != 3) {
+            fully_triangular = false;
+        }
+
+        num_corners += c;
+    }
+
+    if (num_corners != (CountT)face_indices.size()) {
+        recordError("faceVertexCounts doesn't match faceVertexIndices.");
+        return false;
+    }
+
+    for (int32_t idx : face_indices) {
+        if (idx < 0 || idx >= num_points) {
+            recordError("Out of range face vertex index %d.", idx);
+            return false;
+        }
+    }
+
+    const std::vector<tinyusdz::value::normal3f> normals = mesh.get_normals();
+    AttrRate normal_rate = normals.size() > 0 ?
+        toAttrRate(mesh.get_normalsInterpolation()) : AttrRate::None;
+
+    std::vector<tinyusdz::value::texcoord2f> uvs;
+    AttrRate uv_rate = AttrRate::None;
+    for (const char *uv_name : { "st", "st0", "UVMap" }) {
+        tinyusdz::GeomPrimvar primvar;
+        if (!mesh.get_primvar(uv_name, &primvar)) {
+            continue;
+        }
+
+        if (primvar.flatten_with_indices(&uvs)) {
+            uv_rate = toAttrRate(primvar.get_interpolation());
+            break;
+        }
+    }
+
+    auto checkAttrSize = [&](AttrRate rate, size_t num_elems) {
+        switch (rate) {
+        case AttrRate::None: return true;
+        case AttrRate::Constant: return num_elems >= 1;
+        case AttrRate::Uniform: return num_elems >= face_counts.size();
+        case AttrRate::Vertex: return num_elems >= points.size();
+        case AttrRate::FaceVarying: return num_elems >= face_indices.size();
+        }
+        return false;
+    };
+
+    if (!checkAttrSize(normal_rate, normals.size())) {
+        recordError("Fewer normals than required by their interpolation.");
+        return false;
+    }
+
+    if (!checkAttrSize(uv_rate, uvs.size())) {
+        recordError("Fewer UVs than required by their interpolation.");
+        return false;
+    }
+
+    auto attrIndex = [](AttrRate rate, CountT face_idx,
+                        CountT corner_idx, uint32_t vert_idx) -> CountT {
+        switch (rate) {
+        case AttrRate::Constant: return 0;
+        case AttrRate::Uniform: return face_idx;
+        case AttrRate::Vertex: return vert_idx;
+        case AttrRate::FaceVarying: return corner_idx;
+        default: return 0;
+        }
+    };
+
+    // Normals are transformed by the cofactor matrix so non-uniform scale
+    // baked into prototypes or flattened scenes stays correct.
+    Mat3x3 normal_txfm {{
+        cross(txfm.cols[1], txfm.cols[2]),
+        cross(txfm.cols[2], txfm.cols[0]),
+        cross(txfm.cols[0], txfm.cols[1]),
+    }};
+    bool flip_winding = dot(cross(txfm.cols[0], txfm.cols[1]),
+                            txfm.cols[2]) < 0.f;
+
+    // Unindex the mesh so that every face corner has its own attribute
+    // values, then reindex with meshoptimizer like the OBJ loader.
+    unindexedPositions.clear();
+    unindexedNormals.clear();
+    unindexedUVs.clear();
+    fakeIndices.clear();
+
+    CountT corner_offset = 0;
+    for (CountT face_idx = 0; face_idx < (CountT)face_counts.size();
+         face_idx++) {
+        CountT face_count = face_counts[face_idx];
+
+        for (CountT i = 0; i < face_count; i++) {
+            CountT corner_idx = corner_offset +
+                (flip_winding ? face_count - i - 1 : i);
+            uint32_t vert_idx = (uint32_t)face_indices[corner_idx];
+
+            fakeIndices.push_back(uint32_t(unindexedPositions.size()));
+
+            const auto &p = points[vert_idx];
+            unindexedPositions.push_back(
+                txfm.txfmPoint(Vector3 { p.x, p.y, p.z }));
+
+            if (normal_rate != AttrRate::None) {
+                const auto &n = normals[
+                    attrIndex(normal_rate, face_idx, corner_idx, vert_idx)];
+                unindexedNormals.push_back(
+                    normalize(normal_txfm * Vector3 { n.x, n.y, n.z }));
+            }
+
+            if (uv_rate != AttrRate::None) {
+                const auto &uv = uvs[
+                    attrIndex(uv_rate, face_idx, corner_idx, vert_idx)];
+                unindexedUVs.push_back(Vector2 { uv.s, uv.t });
+            }
+        }
+
+        corner_offset += face_count;
+    }
+
+    std::array<meshopt_Stream, 3> vertex_streams;
+    vertex_streams[0] = {
+        .data = unindexedPositions.data(),
+        .size = sizeof(Vector3),
+        .stride = sizeof(Vector3),
+    };
+
+    int64_t num_vert_streams = 1;
+
+    if (unindexedNormals.size() > 0) {
+        vertex_streams[num_vert_streams++] = {
+            .data = unindexedNormals.data(),
+            .size = sizeof(Vector3),
+            .stride = sizeof(Vector3),
+        };
+    }
+
+    if (unindexedUVs.size() > 0) {
+        vertex_streams[num_vert_streams++] = {
+            .data = unindexedUVs.data(),
+            .size = sizeof(Vector2),
+            .stride = sizeof(Vector2),
+        };
+    }
+
+    vertexRemap.resize(unindexedPositions.size(), [](uint32_t *) {});
+
+    CountT num_new_verts = meshopt_generateVertexRemapMulti(
+        vertexRemap.data(), nullptr, vertexRemap.size(),
+        vertexRemap.size(), vertex_streams.data(), num_vert_streams);
+
+    PendingMesh pending {
+        .positions = DynArray<Vector3>(0),
+        .normals = DynArray<Vector3>(0),
+        .uvs = DynArray<Vector2>(0),
+        .indices = DynArray<uint32_t>(0),
+        .faceCounts = DynArray<uint32_t>(0),
+        .numFaces = uint32_t(face_counts.size()),
+        .materialIdx = getMaterial(mesh, imported),
+    };
+
+    pending.positions.resize(num_new_verts, [](Vector3 *) {});
+    meshopt_remapVertexBuffer(pending.positions.data(),
+                              unindexedPositions.data(),
+                              unindexedPositions.size(),
+                              sizeof(Vector3),
+                              vertexRemap.data());
+
+    pending.indices.resize(fakeIndices.size(), [](uint32_t *) {});
+    meshopt_remapIndexBuffer(pending.indices.data(), fakeIndices.data(),
+                             fakeIndices.size(), vertexRemap.data());
+
+    if (unindexedNormals.size() > 0) {
+        pending.normals.resize(num_new_verts, [](Vector3 *) {});
+        meshopt_remapVertexBuffer(pending.normals.data(),
+                                  unindexedNormals.data(),
+                                  unindexedNormals.size(),
+                                  sizeof(Vector3),
+                                  vertexRemap.data());
+    }
+
+    if (unindexedUVs.size() > 0) {
+        pending.uvs.resize(num_new_verts, [](Vector2 *) {});
+        meshopt_remapVertexBuffer(pending.uvs.data(),
+                                  unindexedUVs.data(),
+                                  unindexedUVs.size(),
+                                  sizeof(Vector2),
+                                  vertexRemap.data());
+    }
+
+    if (!fully_triangular) {
+        pending.faceCounts.reserve(face_counts.size());
+        for (int32_t c : face_counts) {
+            pending.faceCounts.push_back(uint32_t(c));
+        }
+    }
+
+    curMeshes.emplace_back(std::move(pending));
+
+    return true;
+}
+
+bool USDLoader::Impl::readPointInstances(
+    const tinyusdz::GeomPointInstancer &instancer,
+    std::vector<tinyusdz::Path> *proto_paths,
+    DynArray<PointInstance> *out_instances) const
+{
+    if (!instancer.prototypes.has_value()) {
+        return true;
+    }
+
+    const tinyusdz::Relationship &protos_rel = instancer.prototypes.value();
+
+    if (protos_rel.is_path()) {
+        proto_paths->push_back(protos_rel.targetPath);
+    } else if (protos_rel.is_pathvector()) {
+        *proto_paths = protos_rel.targetPathVector;
+    }
+
+    std::vector<int32_t> proto_indices;
+    std::vector<tinyusdz::value::point3f> positions;
+    std::vector<tinyusdz::value::quath> orientations;
+    std::vector<tinyusdz::value::float3> scales;
+
+    getAttrValue(instancer.protoIndices, &proto_indices);
+    getAttrValue(instancer.positions, &positions);
+    getAttrValue(instancer.orientations, &orientations);
+    getAttrValue(instancer.scales, &scales);
+
+    if (positions.size() < proto_indices.size()) {
+        recordError("PointInstancer has fewer positions than protoIndices.");
+        return false;
+    }
+
+    out_instances->reserve(proto_indices.size());
+
+    for (CountT i = 0; i < (CountT)proto_indices.size(); i++) {
+        int32_t proto_idx = proto_indices[i];
+        if (proto_idx < 0 || proto_idx >= (int32_t)proto_paths->size()) {
+            recordError("Out of range PointInstancer prototype index %d.",
+                        proto_idx);
+            return false;
+        }
+
+        const auto &pos = positions[i];
+
+        Quat rot = Quat::id();
+        if (i < (CountT)orientations.size()) {
+            const auto &q = orientations[i];
+            rot = Quat {
+                tinyusdz::value::half_to_float(q.real),
+                tinyusdz::value::half_to_float(q.imag[0]),
+                tinyusdz::value::half_to_float(q.imag[1]),
+                tinyusdz::value::half_to_float(q.imag[2]),
+            }.normalize();
+        }
+
+        Diag3x3 scale = Diag3x3::id();
+        if (i < (CountT)scales.size()) {
+            const auto &s = scales[i];
+            scale = Diag3x3 { s[0], s[1], s[2] };
+        }
+
+        out_instances->push_back({
+            .protoIdx = uint32_t(proto_idx),
+            .txfm = Mat3x4::fromTRS(Vector3 { pos.x, pos.y, pos.z },
+                                    rot, scale),
+        });
+    }
+
+    return true;
+}
+
+bool USDLoader::Impl::bakePointInstancer(
+    const tinyusdz::GeomPointInstancer &instancer,
+    const Mat3x4 &txfm,
+    ImportedAssets &imported)
+{
+    std::vector<tinyusdz::Path> proto_paths;
+    DynArray<PointInstance> points(0);
+    if (!readPointInstances(instancer, &proto_paths, &points)) {
+        return false;
+    }
+
+    for (const PointInstance &point : points) {
+        const tinyusdz::Path &proto_path = proto_paths[point.protoIdx];
+
+        auto proto_prim = stage->GetPrimAtPath(proto_path);
+        if (!proto_prim) {
+            recordError("Missing PointInstancer prototype %s.",
+                        proto_path.full_path_name().c_str());
+            return false;
+        }
+
+        if (!bakeSubtree(*proto_prim.value(), txfm.compose(point.txfm),
+                         imported)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Appends the meshes of prim and all of its descendants to curMeshes with
+// transforms baked into the vertex data. Nested instancing inside a
+// prototype is flattened into the prototype itself.
+bool USDLoader::Impl::bakeSubtree(const tinyusdz::Prim &prim,
+                                  const Mat3x4 &txfm,
+                                  ImportedAssets &imported)
+{
+    if (auto *instancer = prim.as<tinyusdz::GeomPointInstancer>()) {
+        return bakePointInstancer(*instancer, txfm, imported);
+    }
+
+    if (auto *mesh = prim.as<tinyusdz::GeomMesh>()) {
+        if (!convertMesh(*mesh, txfm, imported)) {
+            return false;
+        }
+    }
+
+    for (const tinyusdz::Prim &child : prim.children()) {
+        if (!bakeSubtree(child, txfm.compose(localTransform(child)),
+                         imported)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint64_t USDLoader::Impl::hashCurrentObject() const
+{
+    uint64_t h = 0;
+    for (const PendingMesh &mesh : curMeshes) {
+        h = hashArray(h, mesh.positions);
+        h = hashArray(h, mesh.normals);
+        h = hashArray(h, mesh.uvs);
+        h = hashArray(h, mesh.indices);
+        h = hashArray(h, mesh.faceCounts);
+        h = utils::hashBytes(&mesh.materialIdx, sizeof(uint32_t), h);
+    }
+
+    return h;
+}
+
+template <typename T>
+static inline bool sameData(const DynArray<T> &arr, const T *ptr)
+{
+    if (arr.size() == 0) {
+        return ptr == nullptr;
+    }
+
+    return ptr != nullptr &&
+        memcmp(arr.data(), ptr, sizeof(T) * arr.size()) == 0;
+}
+
+bool USDLoader::Impl::currentObjectMatches(const ImportedAssets &imported,
+                                           uint32_t obj_idx) const
+{
+    Span<const SourceMesh> meshes = imported.objects[obj_idx].meshes;
+    if (meshes.size() != curMeshes.size()) {
+        return false;
+    }
+
+    for (CountT i = 0; i < curMeshes.size(); i++) {
+        const PendingMesh &pending = curMeshes[i];
+        const SourceMesh &mesh = meshes[i];
+
+        if (mesh.numVertices != (uint32_t)pending.positions.size() ||
+                mesh.numFaces != pending.numFaces ||
+                mesh.materialIDX != pending.materialIdx) {
+            return false;
+        }
+
+        // Index counts are equal once the face counts are
+        if (!sameData(pending.faceCounts, mesh.faceCounts) ||
+                (mesh.faceCounts == nullptr &&
+                 pending.indices.size() != CountT(mesh.numFaces) * 3)) {
+            return false;
+        }
+
+        if (!sameData(pending.positions, mesh.positions) ||
+                !sameData(pending.normals, mesh.normals) ||
+                !sameData(pending.uvs, mesh.uvs) ||
+                !sameData(pending.indices, mesh.indices)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t USDLoader::Impl::findOrCommitObject(ImportedAssets &imported)
+{
+    uint64_t hash = hashCurrentObject();
+
+    auto [begin, end] = contentObjects.equal_range(hash);
+    for (auto iter = begin; iter != end; ++iter) {
+        if (currentObjectMatches(imported, iter->second)) {
+            curMeshes.clear();
+            return iter->second;
+        }
+    }
+
+    uint32_t obj_idx = commitObject(imported);
+    contentObjects.emplace(hash, obj_idx);
+
+    return obj_idx;
+}
+
+uint32_t USDLoader::Impl::commitObject(ImportedAssets &imported)
+{
+    DynArray<SourceMesh> meshes(curMeshes.size());
+
+    for (PendingMesh &pending : curMeshes) {
+        SourceMesh src_mesh {
+            .positions = pending.positions.data(),
+            .normals = pending.normals.size() > 0 ?
+                pending.normals.data() : nullptr,
+            .tangentAndSigns = nullptr,
+            .uvs = pending.uvs.size() > 0 ? pending.uvs.data() : nullptr,
+            .indices = pending.indices.data(),
+            .faceCounts = pending.faceCounts.size() > 0 ?
+                pending.faceCounts.data() : nullptr,
+            .faceMaterials = nullptr,
+            .numVertices = uint32_t(pending.positions.size()),
+            .numFaces = pending.numFaces,
+            .materialIDX = pending.materialIdx,
+        };
+
+        meshes.push_back(src_mesh);
+
+        imported.geoData.positionArrays.emplace_back(
+            std::move(pending.positions));
+
+        if (src_mesh.normals) {
+            imported.geoData.normalArrays.emplace_back(
+                std::move(pending.normals));
+        }
+
+        if (src_mesh.uvs) {
+            imported.geoData.uvArrays.emplace_back(std::move(pending.uvs));
+        }
+
+        imported.geoData.indexArrays.emplace_back(
+            std::move(pending.indices));
+
+        if (src_mesh.faceCounts) {
+            imported.geoData.faceCountArrays.emplace_back(
+                std::move(pending.faceCounts));
+        }
+    }
+
+    curMeshes.clear();
+
+    uint32_t obj_idx = uint32_t(imported.objects.size());
+    imported.objects.push_back({
+        .meshes = { meshes.data(), meshes.size() },
+    });
+    imported.geoData.meshArrays.emplace_back(std::move(meshes));
+
+    return obj_idx;
+}
+
+static inline void addInstance(ImportedAssets &imported,
+                               const Mat3x4 &txfm,
+                               uint32_t obj_idx)
+{
+    SourceInstance inst;
+    txfm.decompose(&inst.translation, &inst.rotation, &inst.scale);
+    inst.objIDX = obj_idx;
+
+    imported.instances.push_back(inst);
+}
+
+bool USDLoader::Impl::visitPointInstancer(
+    const tinyusdz::GeomPointInstancer &instancer,
+    const Mat3x4 &txfm,
+    ImportedAssets &imported)
+{
+    std::vector<tinyusdz::Path> proto_paths;
+    DynArray<PointInstance> points(0);
+    if (!readPointInstances(instancer, &proto_paths, &points)) {
+        return false;
+    }
+
+    // Each prototype becomes a single object, shared by every point
+    HeapArray<uint32_t> proto_objs(proto_paths.size());
+    for (CountT i = 0; i < (CountT)proto_paths.size(); i++) {
+        std::string proto_name = proto_paths[i].full_path_name();
+
+        auto iter = pointProtoObjects.find(proto_name);
+        if (iter != pointProtoObjects.end()) {
+            proto_objs[i] = iter->second;
+            continue;
+        }
+
+        auto proto_prim = stage->GetPrimAtPath(proto_paths[i]);
+        if (!proto_prim) {
+            recordError("Missing PointInstancer prototype %s.",
+                        proto_name.c_str());
+            return false;
+        }
+
+        // The prototype root's own transform is applied per point, as
+        // specified by UsdGeomPointInstancer.
+        if (!bakeSubtree(*proto_prim.value(),
+                         localTransform(*proto_prim.value()), imported)) {
+            return false;
+        }
+
+        proto_objs[i] = commitObject(imported);
+        pointProtoObjects.emplace(std::move(proto_name), proto_objs[i]);
+    }
+
+    for (const PointInstance &point : points) {
+        addInstance(imported, txfm.compose(point.txfm),
+                    proto_objs[point.protoIdx]);
+    }
+
+    return true;
+}
+
+bool USDLoader::Impl::visit(const tinyusdz::Prim &prim,
+                            const Mat3x4 &parent_txfm,
+                            ImportedAssets &imported)
+{
+    Mat3x4 txfm = parent_txfm.compose(localTransform(prim));
+
+    if (isInstanceable(prim)) {
+        std::string proto_key = prototypeKey(prim);
+        if (!proto_key.empty()) {
+            auto iter = prototypeObjects.find(proto_key);
+            if (iter != prototypeObjects.end()) {
+                addInstance(imported, txfm, iter->second);
+                return true;
+            }
+        }
+
+        // First instance of this prototype: build it relative to the
+        // instance root. Prototypes without a reference can still match
+        // an existing object by content.
+        if (!bakeSubtree(prim, Mat3x4::identity(), imported)) {
+            return false;
+        }
+
+        if (curMeshes.size() == 0) {
+            return true;
+        }
+
+        uint32_t obj_idx = findOrCommitObject(imported);
+        if (!proto_key.empty()) {
+            prototypeObjects.emplace(std::move(proto_key), obj_idx);
+        }
+
+        addInstance(imported, txfm, obj_idx);
+
+        return true;
+    }
+
+    if (auto *instancer = prim.as<tinyusdz::GeomPointInstancer>()) {
+        return visitPointInstancer(*instancer, txfm, imported);
+    }
+
+    if (auto *mesh = prim.as<tinyusdz::GeomMesh>()) {
+        if (!convertMesh(*mesh, Mat3x4::identity(), imported)) {
+            return false;
+        }
+
+        if (curMeshes.size() > 0) {
+            addInstance(imported, txfm, commitObject(imported));
+        }
+    }
+
+    for (const tinyusdz::Prim &child : prim.children()) {
+        if (!visit(child, txfm, imported)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool USDLoader::Impl::load(const char *path,
+                           ImportedAssets &imported,
+                           bool merge)
+{
+    filePath = path;
+
+    tinyusdz::Stage usd_stage;
     std::string warn, err;
 
-    bool ret = tinyusdz::LoadUSDFromFile(path, &stage, &warn, &err, {
+    bool ret = tinyusdz::LoadUSDFromFile(path, &usd_stage, &warn, &err, {
         .load_assets = false,
         .do_composition = true,
         .load_sublayers = true,
@@ -48,16 +985,57 @@ bool USDLoader::load(const char *path,
     }
 
     if (!ret) {
-        if (!err.empty()) {
-            printf("USD Loader Error: %s\n", err.c_str());
+        recordError("%s", err.c_str());
+        return false;
+    }
+
+    stage = &usd_stage;
+    prototypeObjects.clear();
+    contentObjects.clear();
+    pointProtoObjects.clear();
+    materialIndices.clear();
+    curMeshes.clear();
+
+    bool success = true;
+    if (merge) {
+        for (const tinyusdz::Prim &root : usd_stage.root_prims()) {
+            success = bakeSubtree(root, localTransform(root), imported);
+            if (!success) {
+                break;
+            }
         }
 
-        return false;
+        if (success && curMeshes.size() > 0) {
+            addInstance(imported, Mat3x4::identity(),
+                        commitObject(imported));
+        }
+    } else {
+        for (const tinyusdz::Prim &root : usd_stage.root_prims()) {
+            success = visit(root, Mat3x4::identity(), imported);
+            if (!success) {
+                break;
+            }
+        }
     }
 
-    printf("USD File: %s\n", stage.ExportToString().c_str());
+    curMeshes.clear();
+    stage = nullptr;
+
+    return success;
+}
 
-    return false;
+USDLoader::USDLoader(ImageImporter &, Span<char> err_buf)
+    : impl_(new Impl(err_buf))
+{}
+
+USDLoader::~USDLoader() = default;
+
+bool USDLoader::load(const char *path,
+                     ImportedAssets &imported_assets,
+                     bool merge_and_flatten,
+                     ImageImporter &)
+{
+    return impl_->load(path, imported_assets, merge_and_flatten);
 }
 
 }
@@ -1,6 +1,11 @@
 #include <madrona/mw_cpu.hpp>
 #include "../core/worker_init.hpp"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+
 #if defined(MADRONA_LINUX) or defined(MADRONA_MACOS)
 #include <unistd.h>
 #elif defined(MADRONA_WINDOWS)
@@ -9,24 +14,98 @@
 
 namespace madrona {
 
+namespace {
+
+// Worlds per reduction chunk. Fixed (not derived from the thread count) so
+// the combination order, and therefore the result, never changes.
+constexpr CountT reduceChunkWorlds = 64;
+
+struct ReducePartial {
+    double sum;
+    float min;
+    float max;
+};
+
+}
+
 struct ThreadPoolExecutor::Impl {
     HeapArray<std::thread> workers;
-    alignas(MADRONA_CACHE_LINE) AtomicI32 workerWakeup;
+    HeapArray<int32_t> workerCPUs;
+    // Upper 32 bits: run counter, lower 32 bits: number of workers taking
+    // part in the run (0 = exit). Packing the worker count into the wakeup
+    // word means sleeping workers never read state the main thread may be
+    // rewriting for a later run.
+    alignas(MADRONA_CACHE_LINE) AtomicU64 workerWakeup;
     alignas(MADRONA_CACHE_LINE) AtomicI32 mainWakeup;
     ThreadPoolExecutor::Job *currentJobs;
     uint32_t numJobs;
+    uint32_t numActiveWorkers;
+    uint64_t runCounter;
+    std::chrono::microseconds spinWait;
+    uint32_t numWarmupStepsLeft;
+    float tableHeadroom;
     alignas(MADRONA_CACHE_LINE) AtomicU32 nextJob;
     alignas(MADRONA_CACHE_LINE) AtomicU32 numFinished;
     StateManager stateMgr;
     HeapArray<StateCache> stateCaches;
     HeapArray<void *> exportPtrs;
 
+    struct ReduceChunkJob {
+        Impl *impl;
+        CountT chunkIdx;
+    };
+
+    uint32_t numWorlds;
+    DynArray<Reduction> reductions;
+    DynArray<CountT> reduceOutputOffsets;
+    DynArray<float> reduceOutputs;
+    // Per chunk results, [chunk][reduction] and [chunk][output]
+    DynArray<ReducePartial> reducePartials;
+    DynArray<uint64_t> reduceHistPartials;
+    DynArray<ReduceChunkJob> reduceJobData;
+    DynArray<Job> reduceJobs;
+
     static Impl * make(const ThreadPoolExecutor::Config &cfg);
     ~Impl();
     void run(Job *jobs, CountT num_jobs);
+    void runJobs(Job *jobs, CountT num_jobs);
     void workerThread(CountT worker_id);
+    void reduceChunk(CountT chunk_idx);
+    void runReductions();
 };
 
+static inline void spinPause()
+{
+#if defined(MADRONA_X64)
+    __builtin_ia32_pause();
+#elif defined(MADRONA_ARM)
+    asm volatile("yield");
+#endif
+}
+
+// Spin for up to spin_wait until atomic no longer holds cur, then fall back
+// to sleeping in the kernel
+template <typename T>
+static inline void spinThenWait(Atomic<T> &atomic, T cur,
+                                std::chrono::microseconds spin_wait)
+{
+    if (spin_wait.count() > 0) {
+        auto start = std::chrono::steady_clock::now();
+
+        do {
+            for (CountT i = 0; i < 64; i++) {
+                if (atomic.load_relaxed() != cur) {
+                    return;
+                }
+
+                spinPause();
+            }
+        } while (std::chrono::steady_clock::now() - start < spin_wait);
+    }
+
+    atomic.template wait<sync::relaxed>(cur);
+}
+
 static CountT getNumCores()
 {
 #if defined(MADRONA_MACOS)
@@ -55,9 +134,28 @@ static CountT getNumCores()
 #endif
 }
 
-static inline void pinThread([[maybe_unused]] CountT worker_id)
+// cpu_id is an OS CPU ID, -1 selects the worker_id-th CPU in the
+// current affinity mask
+static inline void pinThread([[maybe_unused]] CountT worker_id,
+                             [[maybe_unused]] int32_t cpu_id)
 {
 #ifdef MADRONA_LINUX
+    if (cpu_id != -1) {
+        cpu_set_t worker_set;
+        CPU_ZERO(&worker_set);
+        CPU_SET(cpu_id, &worker_set);
+
+        int res = pthread_setaffinity_np(pthread_self(),
+                                         sizeof(worker_set),
+                                         &worker_set);
+
+        if (res != 0) {
+            FATAL("Failed to pin worker %d to CPU %d", worker_id, cpu_id);
+        }
+
+        return;
+    }
+
     cpu_set_t cpu_set;
     pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
 
@@ -97,18 +195,46 @@ static inline void pinThread([[maybe_unused]] CountT worker_id)
 ThreadPoolExecutor::Impl * ThreadPoolExecutor::Impl::make(
     const ThreadPoolExecutor::Config &cfg)
 {
+    CountT num_workers;
+    if (cfg.numWorkers != 0) {
+        num_workers = cfg.numWorkers;
+    } else if (cfg.cpuList.size() > 0) {
+        num_workers = cfg.cpuList.size();
+    } else {
+        num_workers = getNumCores();
+    }
+
+    HeapArray<int32_t> worker_cpus(num_workers);
+    for (CountT i = 0; i < num_workers; i++) {
+        worker_cpus[i] = cfg.cpuList.size() > 0 ?
+            cfg.cpuList[i % cfg.cpuList.size()] : -1;
+    }
+
     Impl *impl = new Impl {
-        .workers = HeapArray<std::thread>(
-            cfg.numWorkers == 0 ? getNumCores() : cfg.numWorkers),
+        .workers = HeapArray<std::thread>(num_workers),
+        .workerCPUs = std::move(worker_cpus),
         .workerWakeup = 0,
         .mainWakeup = 0,
         .currentJobs = nullptr,
         .numJobs = 0,
+        .numActiveWorkers = (uint32_t)num_workers,
+        .runCounter = 0,
+        .spinWait = std::chrono::microseconds(cfg.spinWaitMicroseconds),
+        .numWarmupStepsLeft = cfg.tableWarmupSteps,
+        .tableHeadroom = cfg.tableHeadroom,
         .nextJob = 0,
         .numFinished = 0,
         .stateMgr = StateManager(cfg.numWorlds),
         .stateCaches = HeapArray<StateCache>(cfg.numWorlds),
         .exportPtrs = HeapArray<void *>(cfg.numExportedBuffers),
+        .numWorlds = cfg.numWorlds,
+        .reductions = DynArray<Reduction>(0),
+        .reduceOutputOffsets = DynArray<CountT>(0),
+        .reduceOutputs = DynArray<float>(0),
+        .reducePartials = DynArray<ReducePartial>(0),
+        .reduceHistPartials = DynArray<uint64_t>(0),
+        .reduceJobData = DynArray<ReduceChunkJob>(0),
+        .reduceJobs = DynArray<Job>(0),
     };
 
     for (CountT i = 0; i < (CountT)cfg.numWorlds; i++) {
@@ -132,7 +258,8 @@ ThreadPoolExecutor::ThreadPoolExecutor(ThreadPoolExecutor &&o) = default;
 
 ThreadPoolExecutor::Impl::~Impl()
 {
-    workerWakeup.store_release(-1);
+    runCounter += 1;
+    workerWakeup.store_release(runCounter << 32);
     workerWakeup.notify_all();
 
     for (CountT i = 0; i < workers.size(); i++) {
@@ -146,17 +273,28 @@ void ThreadPoolExecutor::Impl::run(Job *jobs, CountT num_jobs)
 {
     stateMgr.copyInExportedColumns();
 
+    runJobs(jobs, num_jobs);
+
+    stateMgr.copyOutExportedColumns();
+
+    if (numWarmupStepsLeft > 0 && --numWarmupStepsLeft == 0) {
+        stateMgr.fixTableCapacities(tableHeadroom, 0);
+    }
+}
+
+void ThreadPoolExecutor::Impl::runJobs(Job *jobs, CountT num_jobs)
+{
     currentJobs = jobs;
     numJobs = uint32_t(num_jobs);
     nextJob.store_relaxed(0);
     numFinished.store_relaxed(0);
-    workerWakeup.store_release(1);
+    runCounter += 1;
+    workerWakeup.store_release((runCounter << 32) | numActiveWorkers);
     workerWakeup.notify_all();
 
-    mainWakeup.wait<sync::acquire>(0);
+    spinThenWait(mainWakeup, 0, spinWait);
+    mainWakeup.load_acquire();
     mainWakeup.store_relaxed(0);
-
-    stateMgr.copyOutExportedColumns();
 }
 
 void ThreadPoolExecutor::run(Job *jobs, CountT num_jobs)
@@ -164,11 +302,85 @@ void ThreadPoolExecutor::run(Job *jobs, CountT num_jobs)
     impl_->run(jobs, num_jobs);
 }
 
+void ThreadPoolExecutor::setNumActiveWorkers(CountT num_active)
+{
+    if (num_active < 1 || num_active > impl_->workers.size()) {
+        FATAL("Invalid number of active workers %ld, pool has %ld",
+              (long)num_active, (long)impl_->workers.size());
+    }
+
+    impl_->numActiveWorkers = (uint32_t)num_active;
+}
+
+CountT ThreadPoolExecutor::numWorkers() const
+{
+    return impl_->workers.size();
+}
+
 void * ThreadPoolExecutor::getExported(CountT slot) const
 {
     return impl_->exportPtrs[slot];
 }
 
+CountT ThreadPoolExecutor::addReduction(const Reduction &reduction)
+{
+    if (reduction.op == ReduceOp::Histogram &&
+        (reduction.numBins == 0 || reduction.histMax <= reduction.histMin)) {
+        FATAL("Invalid histogram reduction");
+    }
+
+    CountT num_outputs =
+        reduction.op == ReduceOp::Histogram ? reduction.numBins : 1;
+
+    CountT output_offset = impl_->reduceOutputs.size();
+    impl_->reductions.push_back(reduction);
+    impl_->reduceOutputOffsets.push_back(output_offset);
+    impl_->reduceOutputs.resize(output_offset + num_outputs, [](float *v) {
+        *v = 0.f;
+    });
+
+    CountT num_chunks = utils::divideRoundUp(
+        (CountT)impl_->numWorlds, reduceChunkWorlds);
+
+    impl_->reducePartials.resize(num_chunks * impl_->reductions.size(),
+                                 [](ReducePartial *) {});
+    impl_->reduceHistPartials.resize(
+        num_chunks * impl_->reduceOutputs.size(), [](uint64_t *) {});
+
+    if (impl_->reduceJobs.size() == 0) {
+        for (CountT i = 0; i < num_chunks; i++) {
+            impl_->reduceJobData.push_back({ impl_.get(), i });
+        }
+
+        for (CountT i = 0; i < num_chunks; i++) {
+            impl_->reduceJobs.push_back(Job {
+                .fn = [](void *ptr) {
+                    auto job = (Impl::ReduceChunkJob *)ptr;
+                    job->impl->reduceChunk(job->chunkIdx);
+                },
+                .data = &impl_->reduceJobData[i],
+            });
+        }
+    }
+
+    return output_offset;
+}
+
+void ThreadPoolExecutor::runReductions()
+{
+    impl_->runReductions();
+}
+
+float * ThreadPoolExecutor::reductionOutputs() const
+{
+    return impl_->reduceOutputs.data();
+}
+
+CountT ThreadPoolExecutor::numReductionOutputs() const
+{
+    return impl_->reduceOutputs.size();
+}
+
 void ThreadPoolExecutor::initializeContexts(
     Context & (*init_fn)(void *, const WorkerInit &, CountT),
     void *init_data, CountT num_worlds)
@@ -191,30 +403,36 @@ ECSRegistry ThreadPoolExecutor::getECSRegistry()
 
 void ThreadPoolExecutor::initExport()
 {
+    // Called once every world is set up, before the first step
+    impl_->stateMgr.sealSharedTemplates();
     impl_->stateMgr.copyOutExportedColumns();
 }
 
 void ThreadPoolExecutor::Impl::workerThread(CountT worker_id)
 {
-    pinThread(worker_id);
+    pinThread(worker_id, workerCPUs[worker_id]);
 
+    uint64_t cur_wakeup = 0;
     while (true) {
-        workerWakeup.wait<sync::relaxed>(0);
-        int32_t ctrl = workerWakeup.load_acquire();
+        spinThenWait(workerWakeup, cur_wakeup, spinWait);
+        cur_wakeup = workerWakeup.load_acquire();
 
-        if (ctrl == 0) {
-            continue;
-        } else if (ctrl == -1) {
+        uint32_t num_run_workers = uint32_t(cur_wakeup);
+        if (num_run_workers == 0) {
             break;
         }
 
+        if ((uint32_t)worker_id >= num_run_workers) {
+            continue;
+        }
+
+        // Every participating worker checks out exactly once per run, and
+        // the last one wakes the main thread. Waiting on workers rather
+        // than jobs guarantees no worker is still touching nextJob or
+        // currentJobs when the main thread starts the next run.
         while (true) {
             uint32_t job_idx = nextJob.fetch_add_relaxed(1);
 
-            if (job_idx == numJobs) {
-                workerWakeup.store_relaxed(0);
-            }
-
             assert(job_idx < 0xFFFF'FFFF);
 
             if (job_idx >= numJobs) {
@@ -222,16 +440,168 @@ void ThreadPoolExecutor::Impl::workerThread(CountT worker_id)
             }
 
             currentJobs[job_idx].fn(currentJobs[job_idx].data);
+        }
+
+        // This has to be acq_rel so the finishing thread has seen
+        // all the other threads' effects
+        uint32_t prev_finished = numFinished.fetch_add_acq_rel(1);
+
+        if (prev_finished == num_run_workers - 1) {
+            mainWakeup.store_release(1);
+            mainWakeup.notify_one();
+        }
+    }
+}
+
+void ThreadPoolExecutor::Impl::reduceChunk(CountT chunk_idx)
+{
+    CountT world_start = chunk_idx * reduceChunkWorlds;
+    CountT world_end = std::min(world_start + reduceChunkWorlds,
+                                (CountT)numWorlds);
+
+    const CountT num_reductions = reductions.size();
+    const CountT num_outputs = reduceOutputs.size();
+
+    for (CountT reduce_idx = 0; reduce_idx < num_reductions; reduce_idx++) {
+        const Reduction &reduction = reductions[reduce_idx];
+
+        const char *base = (const char *)exportPtrs[reduction.exportSlot] +
+            reduction.valueOffset;
+        CountT row_start = world_start * reduction.numRowsPerWorld;
+        CountT row_end = world_end * reduction.numRowsPerWorld;
+
+        auto readValue = [&](CountT row) {
+            const char *ptr = base + row * reduction.rowStride;
+
+            if (reduction.valueType == ReduceValueType::Int32) {
+                int32_t v;
+                memcpy(&v, ptr, sizeof(int32_t));
+                return (float)v;
+            } else {
+                float v;
+                memcpy(&v, ptr, sizeof(float));
+                return v;
+            }
+        };
+
+        if (reduction.op == ReduceOp::Histogram) {
+            uint64_t *bins = &reduceHistPartials[chunk_idx * num_outputs +
+                reduceOutputOffsets[reduce_idx]];
+            for (CountT i = 0; i < (CountT)reduction.numBins; i++) {
+                bins[i] = 0;
+            }
+
+            float bin_scale = (float)reduction.numBins /
+                (reduction.histMax - reduction.histMin);
+            float max_bin_f = (float)(reduction.numBins - 1);
 
-            // This has to be acq_rel so the finishing thread has seen
-            // all the other threads' effects
-            uint32_t prev_finished =
-                numFinished.fetch_add_acq_rel(1);
+            reducePartials[chunk_idx * num_reductions + reduce_idx] = {};
+
+            for (CountT row = row_start; row < row_end; row++) {
+                float bin_f = (readValue(row) - reduction.histMin) * bin_scale;
+                if (std::isnan(bin_f)) {
+                    continue;
+                }
+
+                // Clamp before converting: the cast is undefined for values
+                // outside CountT's range (including infinities). max_bin_f
+                // may round up for huge numBins, so clamp again after.
+                bin_f = std::clamp(bin_f, 0.f, max_bin_f);
+                CountT bin = std::min((CountT)bin_f,
+                                      (CountT)reduction.numBins - 1);
+
+                bins[bin] += 1;
+            }
+        } else {
+            ReducePartial partial {
+                .sum = 0.0,
+                .min = FLT_MAX,
+                .max = -FLT_MAX,
+            };
+
+            for (CountT row = row_start; row < row_end; row++) {
+                float v = readValue(row);
+                partial.sum += (double)v;
+                partial.min = std::min(partial.min, v);
+                partial.max = std::max(partial.max, v);
+            }
+
+            reducePartials[chunk_idx * num_reductions + reduce_idx] = partial;
+        }
+    }
+}
+
+void ThreadPoolExecutor::Impl::runReductions()
+{
+    if (reductions.size() == 0) {
+        return;
+    }
+
+    // No worlds means no chunks and no partials to combine
+    if (reduceJobs.size() == 0) {
+        for (CountT i = 0; i < reduceOutputs.size(); i++) {
+            reduceOutputs[i] = 0.f;
+        }
+        return;
+    }
+
+    // Exported buffers are already up to date, skip the copy in / out
+    runJobs(reduceJobs.data(), reduceJobs.size());
+
+    const CountT num_chunks = reduceJobs.size();
+    const CountT num_reductions = reductions.size();
+    const CountT num_outputs = reduceOutputs.size();
+
+    // Pairwise tree over chunks, chunk 0 ends up with the total
+    for (CountT stride = 1; stride < num_chunks; stride *= 2) {
+        for (CountT i = 0; i + stride < num_chunks; i += 2 * stride) {
+            ReducePartial *dst = &reducePartials[i * num_reductions];
+            const ReducePartial *src =
+                &reducePartials[(i + stride) * num_reductions];
+
+            for (CountT j = 0; j < num_reductions; j++) {
+                dst[j].sum += src[j].sum;
+                dst[j].min = std::min(dst[j].min, src[j].min);
+                dst[j].max = std::max(dst[j].max, src[j].max);
+            }
+
+            uint64_t *dst_bins = &reduceHistPartials[i * num_outputs];
+            const uint64_t *src_bins =
+                &reduceHistPartials[(i + stride) * num_outputs];
+
+            for (CountT j = 0; j < num_outputs; j++) {
+                dst_bins[j] += src_bins[j];
+            }
+        }
+    }
 
-            if (prev_finished == numJobs - 1) {
-                mainWakeup.store_release(1);
-                mainWakeup.notify_one();
+    for (CountT reduce_idx = 0; reduce_idx < num_reductions; reduce_idx++) {
+        const Reduction &reduction = reductions[reduce_idx];
+        const ReducePartial &total = reducePartials[reduce_idx];
+        float *out = &reduceOutputs[reduceOutputOffsets[reduce_idx]];
+
+        switch (reduction.op) {
+        case ReduceOp::Sum: {
+            out[0] = (float)total.sum;
+        } break;
+        case ReduceOp::Mean: {
+            double num_values =
+                (double)numWorlds * (double)reduction.numRowsPerWorld;
+            out[0] = num_values > 0.0 ? (float)(total.sum / num_values) : 0.f;
+        } break;
+        case ReduceOp::Min: {
+            out[0] = total.min;
+        } break;
+        case ReduceOp::Max: {
+            out[0] = total.max;
+        } break;
+        case ReduceOp::Histogram: {
+            const uint64_t *bins =
+                &reduceHistPartials[reduceOutputOffsets[reduce_idx]];
+            for (CountT i = 0; i < (CountT)reduction.numBins; i++) {
+                out[i] = (float)bins[i];
             }
+        } break;
         }
     }
 }
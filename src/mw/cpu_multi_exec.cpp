@@ -0,0 +1,495 @@
+#include <madrona/mw_cpu.hpp>
+#include <madrona/dyn_array.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef MADRONA_LINUX
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace madrona {
+
+namespace {
+
+// Lives at the start of the shared mapping. Every field that is written by
+// one side and polled by the other gets its own cache line.
+struct SharedControl {
+    static constexpr uint32_t exitCommand = 0xFFFF'FFFF;
+
+    alignas(MADRONA_CACHE_LINE) AtomicU32 stepGeneration;
+    uint32_t command;
+    alignas(MADRONA_CACHE_LINE) AtomicU32 numFinished;
+    alignas(MADRONA_CACHE_LINE) AtomicU32 numReady;
+};
+
+static_assert(sizeof(AtomicU32) == sizeof(uint32_t));
+
+}
+
+struct MultiProcessExecutor::Impl {
+    uint32_t numWorlds;
+    uint32_t numExportedBuffers;
+    HeapArray<uint64_t> exportedBytesPerWorld;
+    HeapArray<void *> exportPtrs;
+    SharedControl *ctrl;
+    void *sharedMem;
+    uint64_t numSharedBytes;
+    HeapArray<DynArray<int32_t>> processCPUs;
+    HeapArray<int32_t> pids;
+
+    static Impl * make(const MultiProcessExecutor::Config &cfg);
+    ~Impl();
+
+    void launch(Shard (*make_shard)(void *, const ShardInit &),
+                void *make_data);
+    [[noreturn]] void shardMain(CountT shard_idx,
+                                Shard (*make_shard)(void *, const ShardInit &),
+                                void *make_data);
+    void run(uint32_t command);
+    void waitForCount(AtomicU32 &counter, uint32_t target);
+};
+
+#ifdef MADRONA_LINUX
+// The futex calls have to use the shared (non _PRIVATE) variants, which
+// std::atomic::wait doesn't, because the waiters live in other processes.
+static void futexWait(AtomicU32 &word, uint32_t expected,
+                      const timespec *timeout)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAIT, expected,
+            timeout, nullptr, 0);
+}
+
+static void futexWakeAll(AtomicU32 &word)
+{
+    syscall(SYS_futex, (uint32_t *)&word, FUTEX_WAKE, INT32_MAX,
+            nullptr, nullptr, 0);
+}
+
+static inline void spinPause()
+{
+#if defined(MADRONA_X64)
+    __builtin_ia32_pause();
+#elif defined(MADRONA_ARM)
+    asm volatile("yield");
+#endif
+}
+
+// Steps are short, so spin for a while before sleeping in the kernel
+static constexpr CountT numSpinsBeforeSleep = 1 << 14;
+
+// Parses the sysfs list format, for example "0-7,16-23"
+static bool parseCPUList(const char *path, DynArray<int32_t> &out)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char buf[4096];
+    size_t num_read = fread(buf, 1, sizeof(buf) - 1, file);
+    fclose(file);
+    buf[num_read] = '\0';
+
+    char *cur = buf;
+    while (*cur != '\0' && *cur != '\n') {
+        char *end;
+        long range_start = strtol(cur, &end, 10);
+        if (end == cur) {
+            break;
+        }
+
+        long range_end = range_start;
+        if (*end == '-') {
+            cur = end + 1;
+            range_end = strtol(cur, &end, 10);
+        }
+
+        for (long i = range_start; i <= range_end; i++) {
+            out.push_back((int32_t)i);
+        }
+
+        cur = *end == ',' ? end + 1 : end;
+    }
+
+    return true;
+}
+
+// Returns the CPUs this process may run on, grouped by NUMA node. Nodes
+// with no allowed CPUs are skipped. Falls back to a single node when sysfs
+// doesn't expose the topology.
+static DynArray<DynArray<int32_t>> getNUMANodeCPUs()
+{
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    DynArray<DynArray<int32_t>> nodes(2);
+
+    DynArray<int32_t> node_ids(8);
+    parseCPUList("/sys/devices/system/node/online", node_ids);
+
+    for (int32_t node_id : node_ids) {
+        char path[128];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node_id);
+
+        DynArray<int32_t> node_cpus(64);
+        if (!parseCPUList(path, node_cpus)) {
+            continue;
+        }
+
+        DynArray<int32_t> allowed_cpus(node_cpus.size());
+        for (int32_t cpu : node_cpus) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                allowed_cpus.push_back(cpu);
+            }
+        }
+
+        if (allowed_cpus.size() > 0) {
+            nodes.push_back(std::move(allowed_cpus));
+        }
+    }
+
+    if (nodes.size() == 0) {
+        DynArray<int32_t> all_cpus(64);
+        for (int32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                all_cpus.push_back(cpu);
+            }
+        }
+
+        nodes.push_back(std::move(all_cpus));
+    }
+
+    return nodes;
+}
+#endif
+
+MultiProcessExecutor::Impl * MultiProcessExecutor::Impl::make(
+    const MultiProcessExecutor::Config &cfg)
+{
+#ifdef MADRONA_LINUX
+    DynArray<DynArray<int32_t>> nodes = getNUMANodeCPUs();
+
+    CountT num_processes = cfg.numProcesses == 0 ?
+        nodes.size() : (CountT)cfg.numProcesses;
+
+    if (num_processes > (CountT)cfg.numWorlds) {
+        num_processes = cfg.numWorlds;
+    }
+
+    // Processes are dealt to nodes round robin, then each node's CPUs are
+    // split evenly between the processes assigned to it.
+    HeapArray<DynArray<int32_t>> process_cpus(num_processes);
+    for (CountT node_idx = 0; node_idx < nodes.size(); node_idx++) {
+        const DynArray<int32_t> &node_cpus = nodes[node_idx];
+
+        CountT num_node_processes = 0;
+        for (CountT i = node_idx; i < num_processes; i += nodes.size()) {
+            num_node_processes++;
+        }
+
+        CountT node_process_idx = 0;
+        for (CountT i = node_idx; i < num_processes; i += nodes.size()) {
+            CountT cpu_start = node_cpus.size() * node_process_idx /
+                num_node_processes;
+            CountT cpu_end = node_cpus.size() * (node_process_idx + 1) /
+                num_node_processes;
+
+            if (cpu_end == cpu_start) {
+                FATAL("Not enough CPUs on NUMA node for %ld processes",
+                      (long)num_node_processes);
+            }
+
+            process_cpus.emplace(i, cpu_end - cpu_start);
+            for (CountT cpu_idx = cpu_start; cpu_idx < cpu_end; cpu_idx++) {
+                process_cpus[i].push_back(node_cpus[cpu_idx]);
+            }
+
+            node_process_idx++;
+        }
+    }
+
+    HeapArray<uint64_t> exported_bytes_per_world(cfg.numExportedBuffers);
+    HeapArray<int64_t> buffer_sizes(cfg.numExportedBuffers + 1);
+    HeapArray<int64_t> buffer_offsets(cfg.numExportedBuffers);
+
+    buffer_sizes[0] = sizeof(SharedControl);
+    for (CountT i = 0; i < (CountT)cfg.numExportedBuffers; i++) {
+        exported_bytes_per_world[i] = cfg.exportedBytesPerWorld[i];
+        buffer_sizes[i + 1] =
+            (int64_t)cfg.exportedBytesPerWorld[i] * (int64_t)cfg.numWorlds;
+    }
+
+    int64_t num_shared_bytes = utils::computeBufferOffsets(
+        buffer_sizes,
+        Span<int64_t>(buffer_offsets.data(), buffer_offsets.size()),
+        MADRONA_CACHE_LINE);
+
+    // Nothing touches the export pages until each process copies out its
+    // own slice, so first touch places every slice on its owner's node.
+    void *shared_mem = mmap(nullptr, num_shared_bytes,
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared_mem == MAP_FAILED) {
+        FATAL("Failed to map %ld bytes of shared memory",
+              (long)num_shared_bytes);
+    }
+
+    SharedControl *ctrl = new (shared_mem) SharedControl {
+        .stepGeneration = 0,
+        .command = 0,
+        .numFinished = 0,
+        .numReady = 0,
+    };
+
+    HeapArray<void *> export_ptrs(cfg.numExportedBuffers);
+    for (CountT i = 0; i < (CountT)cfg.numExportedBuffers; i++) {
+        export_ptrs[i] = (char *)shared_mem + buffer_offsets[i];
+    }
+
+    HeapArray<int32_t> pids(num_processes);
+    for (CountT i = 0; i < num_processes; i++) {
+        pids[i] = -1;
+    }
+
+    return new Impl {
+        .numWorlds = cfg.numWorlds,
+        .numExportedBuffers = cfg.numExportedBuffers,
+        .exportedBytesPerWorld = std::move(exported_bytes_per_world),
+        .exportPtrs = std::move(export_ptrs),
+        .ctrl = ctrl,
+        .sharedMem = shared_mem,
+        .numSharedBytes = (uint64_t)num_shared_bytes,
+        .processCPUs = std::move(process_cpus),
+        .pids = std::move(pids),
+    };
+#else
+    (void)cfg;
+    FATAL("MultiProcessExecutor is only supported on Linux");
+#endif
+}
+
+MultiProcessExecutor::Impl::~Impl()
+{
+#ifdef MADRONA_LINUX
+    bool launched = false;
+    for (int32_t pid : pids) {
+        launched = launched || pid != -1;
+    }
+
+    if (launched) {
+        ctrl->command = SharedControl::exitCommand;
+        ctrl->stepGeneration.fetch_add_release(1);
+        futexWakeAll(ctrl->stepGeneration);
+
+        for (int32_t pid : pids) {
+            if (pid != -1) {
+                waitpid(pid, nullptr, 0);
+            }
+        }
+    }
+
+    munmap(sharedMem, numSharedBytes);
+#endif
+}
+
+void MultiProcessExecutor::Impl::launch(
+    Shard (*make_shard)(void *, const ShardInit &),
+    void *make_data)
+{
+#ifdef MADRONA_LINUX
+    // Flush stdio so buffered output isn't duplicated into the children
+    fflush(nullptr);
+
+    for (CountT shard_idx = 0; shard_idx < pids.size(); shard_idx++) {
+        pid_t pid = fork();
+        if (pid == -1) {
+            FATAL("Failed to fork simulation process %ld", (long)shard_idx);
+        }
+
+        if (pid == 0) {
+            shardMain(shard_idx, make_shard, make_data);
+        }
+
+        pids[shard_idx] = pid;
+    }
+
+    waitForCount(ctrl->numReady, (uint32_t)pids.size());
+#else
+    (void)make_shard;
+    (void)make_data;
+#endif
+}
+
+void MultiProcessExecutor::Impl::shardMain(
+    CountT shard_idx,
+    Shard (*make_shard)(void *, const ShardInit &),
+    void *make_data)
+{
+#ifdef MADRONA_LINUX
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int32_t cpu : processCPUs[shard_idx]) {
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    // ThreadPoolExecutor sizes and pins its workers from this mask
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        FATAL("Failed to pin simulation process %ld", (long)shard_idx);
+    }
+
+    const CountT num_shards = pids.size();
+    uint32_t world_offset = uint32_t(numWorlds * shard_idx / num_shards);
+    uint32_t world_end = uint32_t(numWorlds * (shard_idx + 1) / num_shards);
+    uint32_t num_shard_worlds = world_end - world_offset;
+
+    Shard shard = make_shard(make_data, ShardInit {
+        .worldOffset = world_offset,
+        .numWorlds = num_shard_worlds,
+    });
+
+    auto copyExports = [&](bool to_shared) {
+        for (CountT i = 0; i < (CountT)numExportedBuffers; i++) {
+            uint64_t bytes_per_world = exportedBytesPerWorld[i];
+            char *shared_ptr = (char *)exportPtrs[i] +
+                bytes_per_world * world_offset;
+            char *local_ptr = (char *)shard.getExported(shard.data, i);
+            uint64_t num_bytes = bytes_per_world * num_shard_worlds;
+
+            if (to_shared) {
+                memcpy(shared_ptr, local_ptr, num_bytes);
+            } else {
+                memcpy(local_ptr, shared_ptr, num_bytes);
+            }
+        }
+    };
+
+    copyExports(true);
+
+    uint32_t cur_generation = ctrl->stepGeneration.load_acquire();
+    if (ctrl->numReady.fetch_add_acq_rel(1) == num_shards - 1) {
+        futexWakeAll(ctrl->numReady);
+    }
+
+    while (true) {
+        uint32_t next_generation;
+        CountT num_spins = 0;
+        while ((next_generation = ctrl->stepGeneration.load_acquire()) ==
+               cur_generation) {
+            if (num_spins++ < numSpinsBeforeSleep) {
+                spinPause();
+            } else {
+                futexWait(ctrl->stepGeneration, cur_generation, nullptr);
+            }
+        }
+        cur_generation = next_generation;
+
+        uint32_t command = ctrl->command;
+        if (command == SharedControl::exitCommand) {
+            break;
+        }
+
+        copyExports(false);
+        shard.run(shard.data, command);
+        copyExports(true);
+
+        if (ctrl->numFinished.fetch_add_acq_rel(1) == num_shards - 1) {
+            futexWakeAll(ctrl->numFinished);
+        }
+    }
+
+    shard.destroy(shard.data);
+
+    // Skip atexit handlers and static destructors registered by the parent
+    _exit(0);
+#else
+    (void)shard_idx;
+    (void)make_shard;
+    (void)make_data;
+    MADRONA_UNREACHABLE();
+#endif
+}
+
+void MultiProcessExecutor::Impl::waitForCount(AtomicU32 &counter,
+                                              uint32_t target)
+{
+#ifdef MADRONA_LINUX
+    CountT num_spins = 0;
+    uint32_t cur;
+    while ((cur = counter.load_acquire()) != target) {
+        if (num_spins++ < numSpinsBeforeSleep) {
+            spinPause();
+            continue;
+        }
+
+        // Wake up periodically to notice a simulation process dying
+        timespec timeout {
+            .tv_sec = 0,
+            .tv_nsec = 100'000'000,
+        };
+        futexWait(counter, cur, &timeout);
+
+        for (CountT i = 0; i < pids.size(); i++) {
+            if (waitpid(pids[i], nullptr, WNOHANG) != 0) {
+                pids[i] = -1;
+                FATAL("Simulation process %ld exited unexpectedly", (long)i);
+            }
+        }
+    }
+#else
+    (void)counter;
+    (void)target;
+#endif
+}
+
+void MultiProcessExecutor::Impl::run(uint32_t command)
+{
+#ifdef MADRONA_LINUX
+    ctrl->command = command;
+    ctrl->numFinished.store_relaxed(0);
+    ctrl->stepGeneration.fetch_add_release(1);
+    futexWakeAll(ctrl->stepGeneration);
+
+    waitForCount(ctrl->numFinished, (uint32_t)pids.size());
+#else
+    (void)command;
+#endif
+}
+
+MultiProcessExecutor::MultiProcessExecutor(const Config &cfg)
+    : impl_(Impl::make(cfg))
+{}
+
+MultiProcessExecutor::MultiProcessExecutor(MultiProcessExecutor &&o) = default;
+MultiProcessExecutor::~MultiProcessExecutor() = default;
+
+void MultiProcessExecutor::run(uint32_t taskgraph_idx)
+{
+    impl_->run(taskgraph_idx);
+}
+
+void * MultiProcessExecutor::getExported(CountT slot) const
+{
+    return impl_->exportPtrs[slot];
+}
+
+CountT MultiProcessExecutor::numProcesses() const
+{
+    return impl_->pids.size();
+}
+
+void MultiProcessExecutor::launchShards(
+    Shard (*make_shard)(void *, const ShardInit &),
+    void *make_data)
+{
+    impl_->launch(make_shard, make_data);
+}
+
+}
@@ -170,9 +170,9 @@ static uint32_t getTrianglePresentBits(NodeGroup grp)
 static Vector3 getDirQuant(QBVHNode node, Diag3x3 inv_ray_d)
 {
     return Vector3 {
-        __uint_as_float((node.expX + 127) << 23) * inv_ray_d.d0,
-        __uint_as_float((node.expY + 127) << 23) * inv_ray_d.d1,
-        __uint_as_float((node.expZ + 127) << 23) * inv_ray_d.d2,
+        QBVHNode::exponentScale(node.expX) * inv_ray_d.d0,
+        QBVHNode::exponentScale(node.expY) * inv_ray_d.d1,
+        QBVHNode::exponentScale(node.expZ) * inv_ray_d.d2,
     };
 }
 
@@ -1,10 +1,8 @@
-#include <madrona/context.hpp>
 #include <madrona/physics.hpp>
+#include <madrona/crash.hpp>
 
 #include <algorithm>
 
-#include "physics_impl.hpp"
-
 namespace madrona::phys::broadphase {
 
 using namespace base;
@@ -14,7 +12,8 @@ using namespace geo;
 BVH::BVH(const ObjectManager *obj_mgr,
          CountT max_leaves,
          float leaf_velocity_expansion,
-         float leaf_accel_expansion)
+         float leaf_accel_expansion,
+         float rebuild_cost_threshold)
     : nodes_((Node *)rawAlloc(sizeof(Node) *
                             numInternalNodes(max_leaves))),
       num_nodes_(0),
@@ -32,7 +31,14 @@ BVH::BVH(const ObjectManager *obj_mgr,
       num_allocated_leaves_(max_leaves),
       leaf_velocity_expansion_(leaf_velocity_expansion),
       leaf_accel_expansion_(leaf_accel_expansion),
-      force_rebuild_(true)
+      node_dirty_((uint32_t *)rawAlloc(sizeof(uint32_t) *
+                                       numInternalNodes(max_leaves))),
+      num_tree_leaves_(0),
+      rebuild_cost_(0.f),
+      rebuild_cost_threshold_(rebuild_cost_threshold),
+      force_rebuild_(true),
+      static_tree_(nullptr),
+      static_entities_(nullptr)
 {}
 
 CountT BVH::numInternalNodes(CountT num_leaves) const
@@ -284,6 +290,18 @@ void BVH::rebuild()
         parent.maxZ[child_offset] = combined_aabb.pMax.z;
     }
 
+    // numInternalNodes() is only an upper bound, refit only needs to
+    // visit the nodes that were actually built.
+    num_nodes_ = cur_node_offset;
+    num_tree_leaves_ = num_leaves_.load_relaxed();
+
+    float total_child_area = 0.f;
+    for (CountT i = 0; i < num_nodes_; i++) {
+        node_dirty_[i] = 0;
+        total_child_area += nodes_[i].childAreaSum();
+    }
+    rebuild_cost_ = treeCost(total_child_area);
+
 #if 0
     {
         // validate tree bottom up
@@ -463,6 +481,13 @@ static inline AABB expandAABBWithMotion(
     return aabb;
 }
 
+static inline bool aabbEqual(const AABB &a, const AABB &b)
+{
+    return a.pMin.x == b.pMin.x && a.pMin.y == b.pMin.y &&
+        a.pMin.z == b.pMin.z && a.pMax.x == b.pMax.x &&
+        a.pMax.y == b.pMax.y && a.pMax.z == b.pMax.z;
+}
+
 void BVH::updateLeafPosition(LeafID leaf_id,
                              const Vector3 &pos,
                              const Quat &rot,
@@ -475,7 +500,17 @@ void BVH::updateLeafPosition(LeafID leaf_id,
                                               leaf_velocity_expansion_,
                                               leaf_accel_expansion_);
 
-    leaf_aabbs_[leaf_id.id] = expanded_aabb;
+    AABB &leaf_aabb = leaf_aabbs_[leaf_id.id];
+
+    // Leaves added since the last rebuild aren't in the tree yet,
+    // updateTree() will rebuild to insert them.
+    if (leaf_id.id < num_tree_leaves_ &&
+            !aabbEqual(expanded_aabb, leaf_aabb)) {
+        uint32_t leaf_parent = leaf_parents_[leaf_id.id];
+        AtomicU32Ref(node_dirty_[leaf_parent >> 2_u32]).store<sync::relaxed>(1);
+    }
+
+    leaf_aabb = expanded_aabb;
     leaf_transforms_[leaf_id.id] = {
         pos,
         rot,
@@ -484,182 +519,150 @@ void BVH::updateLeafPosition(LeafID leaf_id,
     sorted_leaves_[leaf_id.id] = leaf_id.id;
 }
 
-AABB BVH::expandLeaf(LeafID leaf_id,
-                     const math::Vector3 &linear_vel)
+float BVH::treeCost(float total_child_area) const
 {
-    AABB aabb = leaf_aabbs_[leaf_id.id];
-    AABB expanded_aabb = expandAABBWithMotion(aabb, linear_vel,
-        leaf_velocity_expansion_, leaf_accel_expansion_);
-
-    leaf_aabbs_[leaf_id.id] = expanded_aabb;
+    // Sum of the surface areas of every node's child bounds relative to the
+    // root bounds: proportional to the expected number of child tests for a
+    // random query, and independent of where the scene is.
+    AABB root_aabb = AABB::invalid();
+    const Node &root = nodes_[0];
+    for (CountT i = 0; i < 4; i++) {
+        if (!root.hasChild(i)) {
+            break;
+        }
 
-    return expanded_aabb;
-}
+        root_aabb = AABB::merge(root_aabb, root.childAABB(i));
+    }
 
-MADRONA_ALWAYS_INLINE static inline float atomicMinF(float *addr, float value)
-{
-#ifdef MADRONA_GPU_MODE
-    float old;
-    if (!signbit(value)) {
-        old = __int_as_float(atomicMin((int *)addr, __float_as_int(value)));
-    } else {
-        old = __uint_as_float(
-            atomicMax((unsigned int *)addr, __float_as_uint(value)));
+    if (root_aabb.pMin.x > root_aabb.pMax.x) {
+        return 0.f;
     }
 
-    return old;
-#else
-    AtomicFloatRef a(*addr);
-    float old = a.load<sync::relaxed>();
+    float root_area = root_aabb.surfaceArea();
+    if (root_area <= 0.f) {
+        return 0.f;
+    }
 
-    while (old > value &&
-           !a.compare_exchange_weak<sync::relaxed, sync::relaxed>(old, value))
-    {}
-           
-    return old;
-#endif
+    return total_child_area / root_area;
 }
 
-MADRONA_ALWAYS_INLINE static inline float atomicMaxF(float *addr, float value)
+void BVH::refit()
 {
-#ifdef MADRONA_GPU_MODE
-    float old;
-
-    // cuda::atomic::fetch_max does not seem to work properly (cuda 11.8)
-    if (!signbit(value)) {
-        old = __int_as_float(
-            atomicMax((int *)addr, __float_as_int(value)));
-    } else {
-        old = __uint_as_float(
-            atomicMin((unsigned int *)addr, __float_as_uint(value)));
+    // rebuild() numbers nodes depth first, so every child has a higher index
+    // than its parent and a single reverse pass over the nodes visits every
+    // level bottom up. Only dirty nodes are recomputed: their leaf children
+    // from leaf_aabbs_, their internal children from the (already refit)
+    // child node's slots. A node whose bounds changed dirties its parent.
+    if (num_nodes_ == 0) {
+        return;
     }
 
-    return old;
-#else
-    AtomicFloatRef a(*addr);
-    float old = a.load<sync::relaxed>();
+    float total_child_area = 0.f;
+    for (CountT node_idx = num_nodes_ - 1; node_idx >= 0; node_idx--) {
+        Node &node = nodes_[node_idx];
 
-    while (old < value &&
-           !a.compare_exchange_weak<sync::relaxed, sync::relaxed>(old, value))
-    {}
-           
-    return old;
-#endif
-}
+        if (node_dirty_[node_idx] != 0) {
+            node_dirty_[node_idx] = 0;
 
-void BVH::refitLeaf(LeafID leaf_id, const AABB &leaf_aabb)
-{
-    uint32_t leaf_parent = leaf_parents_[leaf_id.id];
+            bool changed = false;
+            for (CountT i = 0; i < 4; i++) {
+                if (!node.hasChild(i)) {
+                    break;
+                }
 
-    int32_t node_idx = int32_t(leaf_parent >> 2_u32);
-    int32_t sub_idx = int32_t(leaf_parent & 3);
+                AABB child_aabb;
+                if (node.isLeaf(i)) {
+                    child_aabb = leaf_aabbs_[node.leafIDX(i)];
+                } else {
+                    const Node &child = nodes_[node.children[i]];
 
-    Node &leaf_node = nodes_[node_idx];
+                    child_aabb = AABB::invalid();
+                    for (CountT j = 0; j < 4; j++) {
+                        if (!child.hasChild(j)) {
+                            break;
+                        }
 
-    {
-        auto nonAtomicMinF = [](float *ptr, float v) {
-            AtomicFloatRef a(*ptr);
-            float old = a.load<sync::relaxed>();
-            if (v < old) {
-                a.store<sync::relaxed>(v);
-            }
-            return old;
-        };
+                        child_aabb =
+                            AABB::merge(child_aabb, child.childAABB(j));
+                    }
+                }
 
-        auto nonAtomicMaxF = [](float *ptr, float v) {
-            AtomicFloatRef a(*ptr);
-            float old = a.load<sync::relaxed>();
-            if (v > old) {
-                a.store<sync::relaxed>(v);
+                if (!aabbEqual(child_aabb, node.childAABB(i))) {
+                    node.setChildAABB(i, child_aabb);
+                    changed = true;
+                }
             }
-            return old;
-        };
 
-        float x_min_prev = 
-            nonAtomicMinF(&leaf_node.minX[sub_idx], leaf_aabb.pMin.x);
-        float y_min_prev =
-            nonAtomicMinF(&leaf_node.minY[sub_idx], leaf_aabb.pMin.y);
-        float z_min_prev =
-            nonAtomicMinF(&leaf_node.minZ[sub_idx], leaf_aabb.pMin.z);
-        float x_max_prev =
-            nonAtomicMaxF(&leaf_node.maxX[sub_idx], leaf_aabb.pMax.x);
-        float y_max_prev =
-            nonAtomicMaxF(&leaf_node.maxY[sub_idx], leaf_aabb.pMax.y);
-        float z_max_prev =
-            nonAtomicMaxF(&leaf_node.maxZ[sub_idx], leaf_aabb.pMax.z);
-
-        bool expanded = leaf_aabb.pMin.x < x_min_prev ||
-                        leaf_aabb.pMin.y < y_min_prev ||
-                        leaf_aabb.pMin.z < z_min_prev ||
-                        leaf_aabb.pMax.x > x_max_prev ||
-                        leaf_aabb.pMax.y > y_max_prev ||
-                        leaf_aabb.pMax.z > z_max_prev;
-
-        if (!expanded) return;
-    }
-
-    int32_t child_idx = node_idx;
-    node_idx = leaf_node.parentID;
-
-    while (node_idx != sentinel_) {
-        Node &node = nodes_[node_idx];
-        int child_offset = -1;
-        for (int j = 0; j < 4; j++) {
-            if (node.children[j] == child_idx) {
-                child_offset = j;
-                break;
+            if (changed && node.parentID != sentinel_) {
+                node_dirty_[node.parentID] = 1;
             }
         }
-        assert(child_offset != -1);
-
-        float x_min_prev =
-            atomicMinF(&node.minX[child_offset], leaf_aabb.pMin.x);
 
-        float y_min_prev =
-            atomicMinF(&node.minY[child_offset], leaf_aabb.pMin.y);
+        total_child_area += node.childAreaSum();
+    }
 
-        float z_min_prev =
-            atomicMinF(&node.minZ[child_offset], leaf_aabb.pMin.z);
+    float cost = treeCost(total_child_area);
+    if (cost > rebuild_cost_ * rebuild_cost_threshold_) {
+        force_rebuild_ = true;
+    }
+}
 
-        float x_max_prev =
-            atomicMaxF(&node.maxX[child_offset], leaf_aabb.pMax.x);
+void BVH::updateTree()
+{
+    if (force_rebuild_ || num_leaves_.load_relaxed() != num_tree_leaves_) {
+        force_rebuild_ = false;
+        rebuild();
+    } else {
+        refit();
+    }
+}
 
-        float y_max_prev =
-            atomicMaxF(&node.maxY[child_offset], leaf_aabb.pMax.y);
+void BVH::shiftOrigin(Vector3 delta)
+{
+    if (static_tree_ != nullptr) {
+        FATAL("Can't move the origin of a world using a shared static tree");
+    }
 
-        float z_max_prev =
-            atomicMaxF(&node.maxZ[child_offset], leaf_aabb.pMax.z);
+    CountT num_leaves = num_leaves_.load_relaxed();
+    for (CountT i = 0; i < num_leaves; i++) {
+        leaf_transforms_[i].pos -= delta;
 
-        bool expanded = leaf_aabb.pMin.x < x_min_prev ||
-                        leaf_aabb.pMin.y < y_min_prev ||
-                        leaf_aabb.pMin.z < z_min_prev ||
-                        leaf_aabb.pMax.x > x_max_prev ||
-                        leaf_aabb.pMax.y > y_max_prev ||
-                        leaf_aabb.pMax.z > z_max_prev;
+        AABB &leaf_aabb = leaf_aabbs_[i];
+        leaf_aabb.pMin -= delta;
+        leaf_aabb.pMax -= delta;
+    }
 
-        if (!expanded) {
-            break;
+    // Empty child slots are skipped by every traversal, so their bounds
+    // can be shifted along with the rest.
+    for (CountT i = 0; i < num_nodes_; i++) {
+        Node &node = nodes_[i];
+        for (CountT j = 0; j < 4; j++) {
+            node.minX[j] -= delta.x;
+            node.minY[j] -= delta.y;
+            node.minZ[j] -= delta.z;
+            node.maxX[j] -= delta.x;
+            node.maxY[j] -= delta.y;
+            node.maxZ[j] -= delta.z;
         }
-
-        child_idx = node_idx;
-        node_idx = node.parentID;
     }
 }
 
-void BVH::updateTree()
+void BVH::setStaticTree(const BVH *static_tree)
 {
-    if (force_rebuild_) {
-        force_rebuild_ = false;
-        rebuild();
+    CountT num_static = static_tree->num_leaves_.load_relaxed();
+
+    static_tree_ = static_tree;
+    static_entities_ = (Entity *)rawAlloc(sizeof(Entity) * num_static);
+
+    for (CountT i = 0; i < num_static; i++) {
+        static_entities_[i] = Entity::none();
     }
-    //rebuild();
 }
 
-Entity BVH::traceRay(Vector3 o,
-                     Vector3 d,
-                     float *out_hit_t,
-                     Vector3 *out_hit_normal,
-                     float t_max)
+int32_t BVH::traceClosestLeaf(Vector3 o,
+                              Vector3 d,
+                              float *t_max,
+                              Vector3 *hit_normal) const
 {
     using namespace math;
 
@@ -669,8 +672,8 @@ Entity BVH::traceRay(Vector3 o,
     stack[0] = 0;
     CountT stack_size = 1;
 
-    Entity closest_hit_entity = Entity::none();
-    Vector3 closest_hit_normal;
+    int32_t closest_hit_leaf = -1;
+    float closest_t = *t_max;
 
     while (stack_size > 0) { 
         int32_t node_idx = stack[--stack_size];
@@ -693,19 +696,20 @@ Entity BVH::traceRay(Vector3 o,
                 },
             };
 
-            if (child_aabb.rayIntersects(o, inv_d, 0.f, t_max)) {
+            if (child_aabb.rayIntersects(o, inv_d, 0.f, closest_t)) {
                 if (node.isLeaf(i)) {
                     int32_t leaf_idx = node.leafIDX(i);
                     
                     float hit_t;
                     Vector3 leaf_hit_normal;
                     bool leaf_hit = traceRayIntoLeaf(
-                        leaf_idx, o, d, 0.f, t_max, &hit_t, &leaf_hit_normal);
+                        leaf_idx, o, d, 0.f, closest_t, &hit_t,
+                        &leaf_hit_normal);
 
                     if (leaf_hit) {
-                        t_max = hit_t;
-                        closest_hit_entity = leaf_entities_[leaf_idx];
-                        closest_hit_normal = leaf_hit_normal;
+                        closest_t = hit_t;
+                        closest_hit_leaf = leaf_idx;
+                        *hit_normal = leaf_hit_normal;
                     }
                 } else {
                     stack[stack_size++] = node.children[i];
@@ -713,6 +717,34 @@ Entity BVH::traceRay(Vector3 o,
             }
         }
     }
+
+    *t_max = closest_t;
+    return closest_hit_leaf;
+}
+
+Entity BVH::traceRay(Vector3 o,
+                     Vector3 d,
+                     float *out_hit_t,
+                     Vector3 *out_hit_normal,
+                     float t_max)
+{
+    Entity closest_hit_entity = Entity::none();
+    Vector3 closest_hit_normal;
+
+    int32_t hit_leaf = traceClosestLeaf(o, d, &t_max, &closest_hit_normal);
+    if (hit_leaf != -1) {
+        closest_hit_entity = leaf_entities_[hit_leaf];
+    }
+
+    // t_max is already the closest dynamic hit, so the static tree only
+    // reports closer hits
+    if (static_tree_ != nullptr) {
+        int32_t static_hit_leaf = static_tree_->traceClosestLeaf(
+            o, d, &t_max, &closest_hit_normal);
+        if (static_hit_leaf != -1) {
+            closest_hit_entity = static_entities_[static_hit_leaf];
+        }
+    }
     
     if (closest_hit_entity == Entity::none()) {
         return Entity::none();
@@ -723,6 +755,71 @@ Entity BVH::traceRay(Vector3 o,
     return closest_hit_entity;
 }
 
+bool BVH::traceAnyLeaf(Vector3 o,
+                       Vector3 d,
+                       float t_max,
+                       const Entity *leaf_entities,
+                       Entity ignore_a,
+                       Entity ignore_b) const
+{
+    using namespace math;
+
+    Diag3x3 inv_d = Diag3x3::fromVec(d).inv();
+
+    int32_t stack[32];
+    stack[0] = 0;
+    CountT stack_size = 1;
+
+    while (stack_size > 0) { 
+        int32_t node_idx = stack[--stack_size];
+        const Node &node = nodes_[node_idx];
+        for (int i = 0; i < 4; i++) {
+            if (!node.hasChild(i)) {
+                continue;
+            };
+
+            if (!node.childAABB(i).rayIntersects(o, inv_d, 0.f, t_max)) {
+                continue;
+            }
+
+            if (!node.isLeaf(i)) {
+                stack[stack_size++] = node.children[i];
+                continue;
+            }
+
+            int32_t leaf_idx = node.leafIDX(i);
+            Entity leaf_entity = leaf_entities[leaf_idx];
+            if (leaf_entity == ignore_a || leaf_entity == ignore_b) {
+                continue;
+            }
+
+            float hit_t;
+            Vector3 hit_normal;
+            if (traceRayIntoLeaf(leaf_idx, o, d, 0.f, t_max,
+                                 &hit_t, &hit_normal)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool BVH::traceOcclusion(Vector3 o,
+                         Vector3 d,
+                         float t_max,
+                         Entity ignore_a,
+                         Entity ignore_b)
+{
+    if (traceAnyLeaf(o, d, t_max, leaf_entities_, ignore_a, ignore_b)) {
+        return true;
+    }
+
+    return static_tree_ != nullptr &&
+        static_tree_->traceAnyLeaf(o, d, t_max, static_entities_,
+                                   ignore_a, ignore_b);
+}
+
 static inline bool traceRayIntoPlane(
     Vector3 ray_o, Vector3 ray_d,
     float t_min, float t_max,
@@ -822,7 +919,7 @@ bool BVH::traceRayIntoLeaf(int32_t leaf_idx,
                            float t_min,
                            float t_max,
                            float *hit_t,
-                           math::Vector3 *hit_normal)
+                           math::Vector3 *hit_normal) const
 {
     ObjectID obj_id = leaf_obj_ids_[leaf_idx];
     LeafTransform leaf_txfm = leaf_transforms_[leaf_idx];
@@ -889,166 +986,4 @@ bool BVH::traceRayIntoLeaf(int32_t leaf_idx,
     }
 }
 
-inline void updateLeafPositionsEntry(
-    Context &ctx,
-    const LeafID &leaf_id,
-    const Position &pos,
-    const Rotation &rot,
-    const Scale &scale,
-    const ObjectID &obj_id,
-    const Velocity &vel)
-{
-    BVH &bvh = ctx.singleton<BVH>();
-    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
-    AABB obj_aabb = obj_mgr.rigidBodyAABBs[obj_id.idx];
-
-    bvh.updateLeafPosition(leaf_id, pos, rot, scale, vel.linear, obj_aabb);
-}
-
-// FIXME currently unused
-inline void expandLeavesEntry(
-    Context &ctx,
-    const LeafID &leaf_id,
-    const Velocity &vel)
-{
-    BVH &bvh = ctx.singleton<BVH>();
-    AABB expanded = bvh.expandLeaf(leaf_id, vel.linear);
-    bvh.refitLeaf(leaf_id, expanded);
-}
-
-inline void updateBVHEntry(Context &, BVH &bvh)
-{
-    bvh.updateTree();
-}
-
-inline void refitEntry(Context &ctx, LeafID leaf_id)
-{
-    BVH &bvh = ctx.singleton<BVH>();
-    bvh.refitLeaf(leaf_id, bvh.getLeafAABB(leaf_id));
-}
-
-inline void findIntersectingEntry(
-    Context &ctx,
-    const Entity &e,
-    LeafID leaf_id)
-{
-    BVH &bvh = ctx.singleton<BVH>();
-    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
-
-    // FIXME: should have a flag for passing this
-    // directly into the system
-    Loc a_loc = ctx.loc(e);
-    bool a_is_static = 
-        ctx.getDirect<ResponseType>(RGDCols::ResponseType, a_loc) ==
-        ResponseType::Static;
-
-    ObjectID a_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, a_loc);
-
-    CountT a_num_prims = obj_mgr.rigidBodyPrimitiveCounts[a_obj.idx];
-
-    bvh.findLeafIntersecting(leaf_id, [&](Entity intersecting_entity) {
-        if (e.id < intersecting_entity.id) {
-            Loc b_loc = ctx.loc(intersecting_entity);
-
-            // FIXME: Change this so static objects are kept in a separate BVH
-            // and this check can be removed.
-            if (a_is_static &&
-                ctx.getDirect<ResponseType>(RGDCols::ResponseType, b_loc) ==
-                    ResponseType::Static) {
-                return;
-            }
-
-            // We don't expand the primitive AABBs by movement (only object
-            // AABBs) so we just unconditionally emit narrowphase checks
-            // between each pair of primitives in the entity. Narrowphase
-            // will check transformed AABBs.
-            
-            ObjectID b_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, b_loc);
-            CountT b_num_prims =
-                obj_mgr.rigidBodyPrimitiveCounts[b_obj.idx];
-
-            // FIXME: would be nice to be able to make N temporaries all at
-            // once
-            
-            CountT total_narrowphase_checks = a_num_prims * b_num_prims;
-
-            for (CountT prim_check_idx = 0;
-                 prim_check_idx < total_narrowphase_checks;
-                 prim_check_idx++) {
-                CountT a_prim_idx = prim_check_idx / b_num_prims;
-                CountT b_prim_idx = prim_check_idx % b_num_prims;
-
-                Loc candidate_loc = ctx.makeTemporary<CandidateTemporary>();
-                CandidateCollision &candidate =
-                    ctx.getDirect<CandidateCollision>(
-                        RGDCols::CandidateCollision, candidate_loc);
-
-                candidate.a = a_loc;
-                candidate.b = b_loc;
-                candidate.aPrim = a_prim_idx;
-                candidate.bPrim = b_prim_idx;
-            }
-        }
-    });
-}
-
-TaskGraphNodeID setupBVHTasks(
-    TaskGraphBuilder &builder,
-    Span<const TaskGraphNodeID> deps)
-{
-    auto update_leaves =
-        builder.addToGraph<ParallelForNode<Context, updateLeafPositionsEntry,
-            LeafID, 
-            Position,
-            Rotation,
-            Scale,
-            ObjectID,
-            Velocity>>(deps);
-
-    auto bvh_update = builder.addToGraph<ParallelForNode<Context,
-        broadphase::updateBVHEntry, broadphase::BVH>>({update_leaves});
-
-    // FIXME Unfortunately need to call refit here, because update
-    // won't necessarily do anything
-    auto refit = builder.addToGraph<ParallelForNode<Context,
-        broadphase::refitEntry, broadphase::LeafID>>({bvh_update});
-
-    return refit;
-}
-
-TaskGraphNodeID setupPreIntegrationTasks(
-    TaskGraphBuilder &builder,
-    Span<const TaskGraphNodeID> deps)
-{
-    auto find_intersects = builder.addToGraph<ParallelForNode<Context,
-        broadphase::findIntersectingEntry, Entity, LeafID>>(deps);
-
-    return find_intersects;
-}
-
-TaskGraphNodeID setupPostIntegrationTasks(
-    TaskGraphBuilder &builder,
-    Span<const TaskGraphNodeID> deps)
-{
-#if 0
-    auto expand_leaves = builder.addToGraph<ParallelForNode<Context,
-        expandLeavesEntry, LeafID, Velocity>>({deps});
-#endif
-
-    // FIXME: can we avoid doing a full tree refit here?
-    auto update_leaves =
-        builder.addToGraph<ParallelForNode<Context, updateLeafPositionsEntry,
-            LeafID, 
-            Position,
-            Rotation,
-            Scale,
-            ObjectID,
-            Velocity>>(deps);
-
-    auto refit = builder.addToGraph<ParallelForNode<Context,
-        broadphase::refitEntry, broadphase::LeafID>>({update_leaves});
-
-    return refit;
-}
-
 }
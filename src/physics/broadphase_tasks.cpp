@@ -0,0 +1,181 @@
+#include <madrona/context.hpp>
+#include <madrona/physics.hpp>
+
+#include "physics_impl.hpp"
+
+namespace madrona::phys::broadphase {
+
+using namespace base;
+using namespace math;
+
+inline void updateLeafPositionsEntry(
+    Context &ctx,
+    const LeafID &leaf_id,
+    const Position &pos,
+    const Rotation &rot,
+    const Scale &scale,
+    const ObjectID &obj_id,
+    const Velocity &vel)
+{
+    // Bound to the shared static tree
+    if (leaf_id.id < 0) {
+        return;
+    }
+
+    BVH &bvh = ctx.singleton<BVH>();
+    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+    AABB obj_aabb = obj_mgr.rigidBodyAABBs[obj_id.idx];
+
+    bvh.updateLeafPosition(leaf_id, pos, rot, scale, vel.linear, obj_aabb);
+}
+
+inline void updateBVHEntry(Context &, BVH &bvh)
+{
+    bvh.updateTree();
+}
+
+inline void refitEntry(Context &, BVH &bvh)
+{
+    bvh.refit();
+}
+
+// We don't expand the primitive AABBs by movement (only object AABBs) so we
+// just unconditionally emit narrowphase checks between each pair of
+// primitives in the entity. Narrowphase will check transformed AABBs.
+static inline void emitCandidates(Context &ctx,
+                                  const ObjectManager &obj_mgr,
+                                  Loc a_loc,
+                                  CountT a_num_prims,
+                                  Loc b_loc)
+{
+    ObjectID b_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, b_loc);
+    CountT b_num_prims =
+        obj_mgr.rigidBodyPrimitiveCounts[b_obj.idx];
+
+    // FIXME: would be nice to be able to make N temporaries all at
+    // once
+    
+    CountT total_narrowphase_checks = a_num_prims * b_num_prims;
+
+    for (CountT prim_check_idx = 0;
+         prim_check_idx < total_narrowphase_checks;
+         prim_check_idx++) {
+        CountT a_prim_idx = prim_check_idx / b_num_prims;
+        CountT b_prim_idx = prim_check_idx % b_num_prims;
+
+        Loc candidate_loc = ctx.makeTemporary<CandidateTemporary>();
+        CandidateCollision &candidate =
+            ctx.getDirect<CandidateCollision>(
+                RGDCols::CandidateCollision, candidate_loc);
+
+        candidate.a = a_loc;
+        candidate.b = b_loc;
+        candidate.aPrim = a_prim_idx;
+        candidate.bPrim = b_prim_idx;
+    }
+}
+
+inline void findIntersectingEntry(
+    Context &ctx,
+    const Entity &e,
+    LeafID leaf_id)
+{
+    // Entities in the shared static tree are only found by the other side
+    if (leaf_id.id < 0) {
+        return;
+    }
+
+    BVH &bvh = ctx.singleton<BVH>();
+    ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+
+    // FIXME: should have a flag for passing this
+    // directly into the system
+    Loc a_loc = ctx.loc(e);
+    bool a_is_static = 
+        ctx.getDirect<ResponseType>(RGDCols::ResponseType, a_loc) ==
+        ResponseType::Static;
+
+    ObjectID a_obj = ctx.getDirect<ObjectID>(RGDCols::ObjectID, a_loc);
+
+    CountT a_num_prims = obj_mgr.rigidBodyPrimitiveCounts[a_obj.idx];
+
+    bvh.findLeafIntersecting(leaf_id, [&](Entity intersecting_entity) {
+        if (e.id < intersecting_entity.id) {
+            Loc b_loc = ctx.loc(intersecting_entity);
+
+            // Static colliders not bound to a shared static tree still
+            // have leaves in this BVH, don't pair them with each other.
+            if (a_is_static &&
+                ctx.getDirect<ResponseType>(RGDCols::ResponseType, b_loc) ==
+                    ResponseType::Static) {
+                return;
+            }
+
+            emitCandidates(ctx, obj_mgr, a_loc, a_num_prims, b_loc);
+        }
+    });
+
+    if (a_is_static) {
+        return;
+    }
+
+    // Only this side of the pair queries the static tree, so no ordering
+    // check is needed
+    bvh.findStaticIntersecting(bvh.getLeafAABB(leaf_id),
+                               [&](Entity static_entity) {
+        emitCandidates(ctx, obj_mgr, a_loc, a_num_prims,
+                       ctx.loc(static_entity));
+    });
+}
+
+TaskGraphNodeID setupBVHTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    auto update_leaves =
+        builder.addToGraph<ParallelForNode<Context, updateLeafPositionsEntry,
+            LeafID, 
+            Position,
+            Rotation,
+            Scale,
+            ObjectID,
+            Velocity>>(deps);
+
+    // Rebuilds or refits, depending on how degraded the tree is
+    auto bvh_update = builder.addToGraph<ParallelForNode<Context,
+        broadphase::updateBVHEntry, broadphase::BVH>>({update_leaves});
+
+    return bvh_update;
+}
+
+TaskGraphNodeID setupPreIntegrationTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    auto find_intersects = builder.addToGraph<ParallelForNode<Context,
+        broadphase::findIntersectingEntry, Entity, LeafID>>(deps);
+
+    return find_intersects;
+}
+
+TaskGraphNodeID setupPostIntegrationTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    // FIXME: can we avoid doing a full tree refit here?
+    auto update_leaves =
+        builder.addToGraph<ParallelForNode<Context, updateLeafPositionsEntry,
+            LeafID, 
+            Position,
+            Rotation,
+            Scale,
+            ObjectID,
+            Velocity>>(deps);
+
+    auto refit = builder.addToGraph<ParallelForNode<Context,
+        broadphase::refitEntry, broadphase::BVH>>({update_leaves});
+
+    return refit;
+}
+
+}
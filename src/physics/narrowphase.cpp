@@ -209,6 +209,7 @@ static HullState makeHullState(
         .faceBaseHalfEdges = mesh.faceBaseHalfEdges,
         .facePlanes = dst_planes,
         .vertices = dst_vertices,
+        .edges = mesh.edges,
         .numHalfEdges = mesh.numHalfEdges,
         .numFaces = uint32_t(num_faces),
         .numVertices = uint32_t(num_vertices),
@@ -380,35 +381,28 @@ static bool isMinkowskiFace(
 }
 
 static inline std::pair<Vector3, Vector3> getEdgeNormals(
-        const HalfEdgeMesh &mesh, HalfEdge cur_hedge, HalfEdge twin_hedge)
+        const HalfEdgeMesh &mesh, HullEdge edge)
 {
-    Vector3 normal1 = mesh.facePlanes[cur_hedge.face].normal;
-    Vector3 normal2 = mesh.facePlanes[twin_hedge.face].normal;
+    Vector3 normal1 = mesh.facePlanes[edge.face1].normal;
+    Vector3 normal2 = mesh.facePlanes[edge.face2].normal;
 
     return { normal1, normal2 };
 }
 
-static inline Segment getEdgeSegment(const Vector3 *vertices,
-                                     const HalfEdge *hedges,
-                                     HalfEdge start)
+static inline Segment getEdgeSegment(const HalfEdgeMesh &mesh, HullEdge edge)
 {
-    Vector3 a = vertices[start.rootVertex];
-    
-    // FIXME: probably should put both vertex indices inline in the half edge
-    Vector3 b = vertices[hedges[start.next].rootVertex];
+    Vector3 a = mesh.vertices[edge.v1];
+    Vector3 b = mesh.vertices[edge.v2];
 
     return { a, b };
 }
 
 static inline bool buildsMinkowskiFace(
         const HalfEdgeMesh &a_mesh, const HalfEdgeMesh &b_mesh,
-        HalfEdge cur_hedge_a, HalfEdge twin_hedge_a,
-        HalfEdge cur_hedge_b, HalfEdge twin_hedge_b)
+        HullEdge edge_a, HullEdge edge_b)
 {
-    auto [aNormal1, aNormal2] =
-        getEdgeNormals(a_mesh, cur_hedge_a, twin_hedge_a);
-    auto [bNormal1, bNormal2] =
-        getEdgeNormals(b_mesh, cur_hedge_b, twin_hedge_b);
+    auto [aNormal1, aNormal2] = getEdgeNormals(a_mesh, edge_a);
+    auto [bNormal1, bNormal2] = getEdgeNormals(b_mesh, edge_b);
 
     return isMinkowskiFace(aNormal1, aNormal2, -bNormal1, -bNormal2);
 }
@@ -420,12 +414,10 @@ struct EdgeTestResult {
 
 static inline EdgeTestResult edgeDistance(
         const HullState &a, const HullState &b,
-        HalfEdge hedge_a, HalfEdge hedge_b)
+        HullEdge edge_a, HullEdge edge_b)
 {
-    Segment segment_a =
-        getEdgeSegment(a.mesh.vertices, a.mesh.halfEdges, hedge_a);
-    Segment segment_b =
-        getEdgeSegment(b.mesh.vertices, b.mesh.halfEdges, hedge_b);
+    Segment segment_a = getEdgeSegment(a.mesh, edge_a);
+    Segment segment_b = getEdgeSegment(b.mesh, edge_b);
 
     Vector3 dir_a = segment_a.p2 - segment_a.p1;
     Vector3 dir_b = segment_b.p2 - segment_b.p1;
@@ -470,16 +462,12 @@ static EdgeQuery queryEdgeDirections(
     int edgeBMaxDistance = 0;
     float maxDistance = -FLT_MAX;
 
-    auto testEdgeSeparation = [&a, &b](uint32_t hedge_idx_a,
-                                       uint32_t hedge_idx_b) {
-        HalfEdge cur_hedge_a = a.mesh.halfEdges[hedge_idx_a];
-        HalfEdge twin_hedge_a = a.mesh.halfEdges[a.mesh.twinIDX(hedge_idx_a)];
-        HalfEdge cur_hedge_b = b.mesh.halfEdges[hedge_idx_b];
-        HalfEdge twin_hedge_b = b.mesh.halfEdges[b.mesh.twinIDX(hedge_idx_b)];
+    auto testEdgeSeparation = [&a, &b](CountT edge_idx_a, CountT edge_idx_b) {
+        HullEdge edge_a = a.mesh.edges[edge_idx_a];
+        HullEdge edge_b = b.mesh.edges[edge_idx_b];
 
-        if (buildsMinkowskiFace(a.mesh, b.mesh, cur_hedge_a, twin_hedge_a,
-                                cur_hedge_b, twin_hedge_b)) {
-            return edgeDistance(a, b, cur_hedge_a, cur_hedge_b);
+        if (buildsMinkowskiFace(a.mesh, b.mesh, edge_a, edge_b)) {
+            return edgeDistance(a, b, edge_a, edge_b);
         } else {
             EdgeTestResult result;
             result.separation = -FLT_MAX;
@@ -510,7 +498,7 @@ static EdgeQuery queryEdgeDirections(
             he_a_idx = a.mesh.edgeToHalfEdge(edge_idx_a);
             he_b_idx = b.mesh.edgeToHalfEdge(edge_idx_b);
 
-            edge_cmp = testEdgeSeparation(he_a_idx, he_b_idx);
+            edge_cmp = testEdgeSeparation(edge_idx_a, edge_idx_b);
         }
 
         if (edge_cmp.separation > maxDistance) {
@@ -544,7 +532,8 @@ static EdgeQuery queryEdgeDirections(
         for (CountT edge_idx_b = 0; edge_idx_b < b_num_edges; edge_idx_b++) {
             int32_t he_idx_b = b.mesh.edgeToHalfEdge(edge_idx_b);
 
-            EdgeTestResult edge_cmp = testEdgeSeparation(he_idx_a, he_idx_b);
+            EdgeTestResult edge_cmp =
+                testEdgeSeparation(edge_idx_a, edge_idx_b);
 
             if (edge_cmp.separation > maxDistance) {
                 maxDistance = edge_cmp.separation;
@@ -1120,10 +1109,18 @@ static Manifold createEdgeContact(Vector3 normal,
                                   Vector3 world_offset,
                                   Quat to_world_frame)
 {
-    Segment segA = getEdgeSegment(a_vertices, a_hedges,
-                                  a_hedges[hedge_idx_a]);
-    Segment segB = getEdgeSegment(b_vertices, b_hedges,
-                                  b_hedges[hedge_idx_b]);
+    auto getHalfEdgeSegment = [](const Vector3 *vertices,
+                                 const HalfEdge *hedges,
+                                 int32_t hedge_idx) {
+        HalfEdge start = hedges[hedge_idx];
+        return Segment {
+            vertices[start.rootVertex],
+            vertices[hedges[start.next].rootVertex],
+        };
+    };
+
+    Segment segA = getHalfEdgeSegment(a_vertices, a_hedges, hedge_idx_a);
+    Segment segB = getHalfEdgeSegment(b_vertices, b_hedges, hedge_idx_b);
 
 #ifdef MADRONA_GPU_MODE
     segA.p1 = a_rot.rotateVec(a_scale * segA.p1) + a_pos;
@@ -1936,10 +1933,20 @@ inline void runNarrowphaseSystem(
     Context ctx = TaskGraph::makeContext<Context>(world_id);
     PROF_END(world_get_ctr);
 
+    // Worlds running fewer substeps than the graph skip the rest
+    if (lane_active &&
+            !ctx.singleton<PhysicsSystemState>().substepActive()) {
+        lane_active = false;
+    }
+
     runNarrowphase(ctx, candidate_collisions[candidate_idx],
                    mwgpu_warp_id, mwgpu_lane_id, lane_active);
     
 #else
+    if (!ctx.singleton<PhysicsSystemState>().substepActive()) {
+        return;
+    }
+
     runNarrowphase(ctx, candidate_collision);
 #endif
 }
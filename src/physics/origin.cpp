@@ -0,0 +1,163 @@
+#include <madrona/origin.hpp>
+#include <madrona/physics.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/crash.hpp>
+
+#include <cmath>
+
+#include "physics_impl.hpp"
+
+namespace madrona::origin {
+
+using namespace base;
+using namespace math;
+using namespace phys;
+
+struct OriginState {
+    Entity anchor;
+    float rebaseDistance;
+    bool shiftPhysics;
+    bool resetPending;
+
+    // Subtracted from every Position by this step's shift task, zero on
+    // steps without a rebase
+    Vector3 shift;
+    bool shifting;
+};
+
+void registerTypes(ECSRegistry &registry)
+{
+    registry.registerSingleton<WorldOrigin>();
+    registry.registerSingleton<OriginState>();
+}
+
+void init(Context &ctx, const Config &cfg)
+{
+    int exp;
+    if (cfg.cellSize <= 0.f || frexpf(cfg.cellSize, &exp) != 0.5f) {
+        FATAL("Origin rebasing: cellSize %f is not a power of two",
+              cfg.cellSize);
+    }
+
+    ctx.singleton<WorldOrigin>() = WorldOrigin {
+        .cellX = 0,
+        .cellY = 0,
+        .cellZ = 0,
+        .cellSize = cfg.cellSize,
+    };
+
+    ctx.singleton<OriginState>() = OriginState {
+        .anchor = Entity::none(),
+        .rebaseDistance = cfg.rebaseDistance,
+        .shiftPhysics = cfg.shiftPhysics,
+        .resetPending = false,
+        .shift = Vector3::zero(),
+        .shifting = false,
+    };
+}
+
+void setAnchor(Context &ctx, Entity anchor)
+{
+    ctx.singleton<OriginState>().anchor = anchor;
+}
+
+void resetOrigin(Context &ctx)
+{
+    ctx.singleton<OriginState>().resetPending = true;
+}
+
+static inline int32_t cellsOutside(float x, float rebase_dist,
+                                   float inv_cell_size)
+{
+    if (fabsf(x) <= rebase_dist) {
+        return 0;
+    }
+
+    return int32_t(roundf(x * inv_cell_size));
+}
+
+inline void chooseShiftEntry(Context &ctx, OriginState &state)
+{
+    state.shifting = false;
+
+    WorldOrigin &origin = ctx.singleton<WorldOrigin>();
+
+    if (state.resetPending) {
+        // Entities were placed at absolute coordinates, which are already
+        // local to a zero origin, so nothing is shifted
+        state.resetPending = false;
+
+        origin.cellX = 0;
+        origin.cellY = 0;
+        origin.cellZ = 0;
+
+        return;
+    }
+
+    if (state.anchor == Entity::none()) {
+        return;
+    }
+
+    auto anchor_pos = ctx.getSafe<Position>(state.anchor);
+    if (!anchor_pos.valid()) {
+        return;
+    }
+
+    Vector3 p = anchor_pos.value();
+    float inv_cell_size = 1.f / origin.cellSize;
+
+    // Only axes past the threshold move, so an anchor walking along X
+    // never perturbs Y and Z.
+    int32_t dx = cellsOutside(p.x, state.rebaseDistance, inv_cell_size);
+    int32_t dy = cellsOutside(p.y, state.rebaseDistance, inv_cell_size);
+    int32_t dz = cellsOutside(p.z, state.rebaseDistance, inv_cell_size);
+
+    if (dx == 0 && dy == 0 && dz == 0) {
+        return;
+    }
+
+    origin.cellX += dx;
+    origin.cellY += dy;
+    origin.cellZ += dz;
+
+    // Exact as long as the cell counts fit in the 24 bit mantissa
+    Vector3 shift {
+        float(dx) * origin.cellSize,
+        float(dy) * origin.cellSize,
+        float(dz) * origin.cellSize,
+    };
+
+    state.shift = shift;
+    state.shifting = true;
+
+    if (state.shiftPhysics) {
+        ctx.singleton<broadphase::BVH>().shiftOrigin(shift);
+        particles::shiftOrigin(ctx, shift);
+    }
+}
+
+inline void shiftPositionsEntry(Context &ctx, Position &pos)
+{
+    const OriginState &state = ctx.singleton<OriginState>();
+    if (!state.shifting) {
+        return;
+    }
+
+    pos -= state.shift;
+}
+
+TaskGraphNodeID setupRebaseTasks(TaskGraphBuilder &builder,
+                                 Span<const TaskGraphNodeID> deps)
+{
+    auto choose_shift = builder.addToGraph<ParallelForNode<Context,
+        chooseShiftEntry,
+            OriginState
+        >>(deps);
+
+    return builder.addToGraph<ParallelForNode<Context,
+        shiftPositionsEntry,
+            Position
+        >>({choose_shift});
+}
+
+}
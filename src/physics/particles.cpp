@@ -0,0 +1,500 @@
+#include <madrona/particles.hpp>
+#include <madrona/physics.hpp>
+#include <madrona/memory.hpp>
+#include <madrona/impl/hash_grid.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+
+#include "physics_impl.hpp"
+#include "xpbd.hpp"
+
+namespace madrona::phys::particles {
+
+using namespace base;
+using namespace math;
+
+namespace {
+
+// Overlap tests against a bucket run over blocks of this many sorted
+// particles at a time, see solveParticle
+constexpr CountT testBlockSize = 32;
+
+}
+
+void initEmpty(Context &ctx)
+{
+    new (&ctx.singleton<ParticleState>()) ParticleState {};
+}
+
+void init(Context &ctx, const Config &cfg)
+{
+    uint32_t xpbd_contact_id, xpbd_joint_id;
+    xpbd::getSolverArchetypeIDs(&xpbd_contact_id, &xpbd_joint_id);
+    if (ctx.singleton<PhysicsSystemState>().contactArchetypeID !=
+            xpbd_contact_id) {
+        FATAL("Particles require the XPBD solver");
+    }
+
+    if (cfg.maxRadius <= 0.f) {
+        FATAL("Particles: maxRadius must be positive");
+    }
+
+    uint32_t num_cells = numHashCells(cfg.maxParticles);
+
+    const CountT max_particles = cfg.maxParticles;
+
+    ParticleState &state = ctx.singleton<ParticleState>();
+    new (&state) ParticleState {
+        .maxParticles = max_particles,
+        .numParticles = 0,
+        .friction = cfg.friction,
+        .posX = allocArray<float>(max_particles),
+        .posY = allocArray<float>(max_particles),
+        .posZ = allocArray<float>(max_particles),
+        .prevX = allocArray<float>(max_particles),
+        .prevY = allocArray<float>(max_particles),
+        .prevZ = allocArray<float>(max_particles),
+        .velX = allocArray<float>(max_particles),
+        .velY = allocArray<float>(max_particles),
+        .velZ = allocArray<float>(max_particles),
+        .radii = allocArray<float>(max_particles),
+        .invMasses = allocArray<float>(max_particles),
+        .cellSize = 2.f * cfg.maxRadius,
+        .numCells = num_cells,
+        .cellStarts = allocArray<uint32_t>(num_cells + 1),
+        .cellCounts = allocArray<uint32_t>(num_cells),
+        .particleCells = allocArray<uint32_t>(max_particles),
+        .sortedParticles = allocArray<uint32_t>(max_particles),
+        .sortedX = allocArray<float>(max_particles),
+        .sortedY = allocArray<float>(max_particles),
+        .sortedZ = allocArray<float>(max_particles),
+        .sortedPrevX = allocArray<float>(max_particles),
+        .sortedPrevY = allocArray<float>(max_particles),
+        .sortedPrevZ = allocArray<float>(max_particles),
+        .sortedRadii = allocArray<float>(max_particles),
+        .sortedInvMasses = allocArray<float>(max_particles),
+        .maxRigidPairs = cfg.maxRigidPairs,
+        .numRigidPairs = 0,
+        .rigidPairParticles = allocArray<uint32_t>(cfg.maxRigidPairs),
+        .rigidPairBodies = allocArray<Loc>(cfg.maxRigidPairs),
+    };
+}
+
+CountT spawn(Context &ctx,
+             Vector3 position,
+             Vector3 velocity,
+             float radius,
+             float mass)
+{
+    ParticleState &state = ctx.singleton<ParticleState>();
+    if (state.numParticles == state.maxParticles) {
+        FATAL("Particles: more than %ld particles",
+              (long)state.maxParticles);
+    }
+
+    if (2.f * radius > state.cellSize) {
+        FATAL("Particles: radius %f is larger than maxRadius", radius);
+    }
+
+    CountT idx = state.numParticles++;
+
+    state.posX[idx] = position.x;
+    state.posY[idx] = position.y;
+    state.posZ[idx] = position.z;
+    state.prevX[idx] = position.x;
+    state.prevY[idx] = position.y;
+    state.prevZ[idx] = position.z;
+    state.radii[idx] = radius;
+
+    if (mass > 0.f) {
+        state.velX[idx] = velocity.x;
+        state.velY[idx] = velocity.y;
+        state.velZ[idx] = velocity.z;
+        state.invMasses[idx] = 1.f / mass;
+    } else {
+        state.velX[idx] = 0.f;
+        state.velY[idx] = 0.f;
+        state.velZ[idx] = 0.f;
+        state.invMasses[idx] = 0.f;
+    }
+
+    return idx;
+}
+
+void clear(Context &ctx)
+{
+    ParticleState &state = ctx.singleton<ParticleState>();
+    state.numParticles = 0;
+    state.numRigidPairs = 0;
+}
+
+void shiftOrigin(Context &ctx, Vector3 delta)
+{
+    ParticleState &state = ctx.singleton<ParticleState>();
+
+    for (CountT i = 0; i < state.numParticles; i++) {
+        state.posX[i] -= delta.x;
+        state.posY[i] -= delta.y;
+        state.posZ[i] -= delta.z;
+    }
+}
+
+ParticleData getParticles(Context &ctx)
+{
+    const ParticleState &state = ctx.singleton<ParticleState>();
+
+    return ParticleData {
+        .numParticles = state.numParticles,
+        .posX = state.posX,
+        .posY = state.posY,
+        .posZ = state.posZ,
+        .velX = state.velX,
+        .velY = state.velY,
+        .velZ = state.velZ,
+        .radii = state.radii,
+    };
+}
+
+inline void findRigidPairsEntry(Context &ctx, ParticleState &state)
+{
+    state.numRigidPairs = 0;
+
+    const CountT num_particles = state.numParticles;
+    if (num_particles == 0) {
+        return;
+    }
+
+    const PhysicsSystemState &physics_sys =
+        ctx.singleton<PhysicsSystemState>();
+    const broadphase::BVH &bvh = ctx.singleton<broadphase::BVH>();
+
+    // Rigid body leaves are already expanded by their own motion, so
+    // particles only need to cover theirs
+    float delta_t = physics_sys.deltaT;
+    float accel_margin = physics_sys.gMagnitude * delta_t * delta_t;
+
+    CountT num_pairs = 0;
+    for (CountT i = 0; i < num_particles; i++) {
+        Vector3 pos { state.posX[i], state.posY[i], state.posZ[i] };
+        Vector3 vel { state.velX[i], state.velY[i], state.velZ[i] };
+
+        float margin = state.radii[i] + vel.length() * delta_t + accel_margin;
+
+        AABB particle_aabb {
+            .pMin = pos - Vector3 { margin, margin, margin },
+            .pMax = pos + Vector3 { margin, margin, margin },
+        };
+
+        bvh.findIntersecting(particle_aabb, [&](Entity e) {
+            if (num_pairs == state.maxRigidPairs) {
+                FATAL("Particles: more than %ld particle - rigid body pairs",
+                      (long)state.maxRigidPairs);
+            }
+
+            state.rigidPairParticles[num_pairs] = (uint32_t)i;
+            state.rigidPairBodies[num_pairs] = ctx.loc(e);
+            num_pairs += 1;
+        });
+    }
+
+    state.numRigidPairs = num_pairs;
+}
+
+inline void integrateEntry(Context &ctx, ParticleState &state)
+{
+    const PhysicsSystemState &physics_sys =
+        ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
+    const CountT num_particles = state.numParticles;
+    const float h = physics_sys.h;
+    const Vector3 g = physics_sys.g;
+
+    float *pos_x = state.posX;
+    float *pos_y = state.posY;
+    float *pos_z = state.posZ;
+    float *prev_x = state.prevX;
+    float *prev_y = state.prevY;
+    float *prev_z = state.prevZ;
+    float *vel_x = state.velX;
+    float *vel_y = state.velY;
+    float *vel_z = state.velZ;
+    const float *inv_masses = state.invMasses;
+
+    for (CountT i = 0; i < num_particles; i++) {
+        // Pinned particles have zero velocity and ignore gravity
+        float movable = inv_masses[i] > 0.f ? 1.f : 0.f;
+
+        prev_x[i] = pos_x[i];
+        prev_y[i] = pos_y[i];
+        prev_z[i] = pos_z[i];
+
+        vel_x[i] += movable * h * g.x;
+        vel_y[i] += movable * h * g.y;
+        vel_z[i] += movable * h * g.z;
+
+        pos_x[i] += h * vel_x[i];
+        pos_y[i] += h * vel_y[i];
+        pos_z[i] += h * vel_z[i];
+    }
+}
+
+// Copies the particles into the sorted arrays in hash grid bucket order
+static void sortParticles(ParticleState &state)
+{
+    const float inv_cell_size = 1.f / state.cellSize;
+
+    buildGrid(state.numParticles, state.numCells, state.cellStarts,
+              state.cellCounts, state.particleCells, state.sortedParticles,
+              [&](CountT i) {
+        return hashCell(cellCoord(state.posX[i], inv_cell_size),
+                        cellCoord(state.posY[i], inv_cell_size),
+                        cellCoord(state.posZ[i], inv_cell_size),
+                        state.numCells);
+    });
+
+    for (CountT s = 0; s < state.numParticles; s++) {
+        uint32_t i = state.sortedParticles[s];
+
+        state.sortedX[s] = state.posX[i];
+        state.sortedY[s] = state.posY[i];
+        state.sortedZ[s] = state.posZ[i];
+        state.sortedPrevX[s] = state.prevX[i];
+        state.sortedPrevY[s] = state.prevY[i];
+        state.sortedPrevZ[s] = state.prevZ[i];
+        state.sortedRadii[s] = state.radii[i];
+        state.sortedInvMasses[s] = state.invMasses[i];
+    }
+}
+
+// Pushes sorted particles a and b apart along the line between them, and
+// removes their relative tangential motion over the substep up to the
+// friction cone
+static inline void resolveContact(ParticleState &state,
+                                  uint32_t a, uint32_t b)
+{
+    float w_a = state.sortedInvMasses[a];
+    float w_b = state.sortedInvMasses[b];
+    float w_sum = w_a + w_b;
+    if (w_sum == 0.f) {
+        return;
+    }
+
+    Vector3 x_a { state.sortedX[a], state.sortedY[a], state.sortedZ[a] };
+    Vector3 x_b { state.sortedX[b], state.sortedY[b], state.sortedZ[b] };
+
+    Vector3 to_b = x_b - x_a;
+    float dist = to_b.length();
+    float penetration = state.sortedRadii[a] + state.sortedRadii[b] - dist;
+    if (penetration <= 0.f) {
+        return;
+    }
+
+    Vector3 n = dist > 0.f ? to_b / dist : math::up;
+
+    float inv_w_sum = 1.f / w_sum;
+    x_a -= (penetration * w_a * inv_w_sum) * n;
+    x_b += (penetration * w_b * inv_w_sum) * n;
+
+    Vector3 prev_a {
+        state.sortedPrevX[a], state.sortedPrevY[a], state.sortedPrevZ[a] };
+    Vector3 prev_b {
+        state.sortedPrevX[b], state.sortedPrevY[b], state.sortedPrevZ[b] };
+
+    Vector3 delta_p = (x_b - prev_b) - (x_a - prev_a);
+    Vector3 delta_p_t = delta_p - dot(delta_p, n) * n;
+
+    float tangential_magnitude = delta_p_t.length();
+    if (tangential_magnitude > 0.f) {
+        // Static friction removes all of the sliding, otherwise it's
+        // limited to mu times the normal correction
+        float max_friction = state.friction * penetration;
+        float scale = fminf(max_friction / tangential_magnitude, 1.f);
+
+        Vector3 friction = (scale * inv_w_sum) * delta_p_t;
+        x_a += w_a * friction;
+        x_b -= w_b * friction;
+    }
+
+    state.sortedX[a] = x_a.x;
+    state.sortedY[a] = x_a.y;
+    state.sortedZ[a] = x_a.z;
+    state.sortedX[b] = x_b.x;
+    state.sortedY[b] = x_b.y;
+    state.sortedZ[b] = x_b.z;
+}
+
+// Resolves contacts between sorted particle s and every sorted particle
+// after it in the 3x3x3 block of cells around it, so each pair is handled
+// once per substep. Buckets are contiguous in the sorted arrays, so the
+// overlap test is a branch free loop over a block of them (vectorized by
+// the compiler on the CPU backend) that compacts the hits, and only the
+// hits go through the scalar contact resolution.
+static void solveParticle(ParticleState &state, uint32_t s)
+{
+    const float inv_cell_size = 1.f / state.cellSize;
+
+    float x = state.sortedX[s];
+    float y = state.sortedY[s];
+    float z = state.sortedZ[s];
+    float radius = state.sortedRadii[s];
+
+    int32_t cell_x = cellCoord(x, inv_cell_size);
+    int32_t cell_y = cellCoord(y, inv_cell_size);
+    int32_t cell_z = cellCoord(z, inv_cell_size);
+
+    // Different cells can hash to the same bucket, visit each bucket once
+    uint32_t visited[27];
+    CountT num_visited = 0;
+
+    const float *sorted_x = state.sortedX;
+    const float *sorted_y = state.sortedY;
+    const float *sorted_z = state.sortedZ;
+    const float *sorted_radii = state.sortedRadii;
+
+    for (int32_t dz = -1; dz <= 1; dz++) {
+        for (int32_t dy = -1; dy <= 1; dy++) {
+            for (int32_t dx = -1; dx <= 1; dx++) {
+                uint32_t bucket = hashCell(cell_x + dx, cell_y + dy,
+                                           cell_z + dz, state.numCells);
+
+                bool seen = false;
+                for (CountT i = 0; i < num_visited; i++) {
+                    seen |= visited[i] == bucket;
+                }
+                if (seen) {
+                    continue;
+                }
+                visited[num_visited++] = bucket;
+
+                uint32_t start = std::max(state.cellStarts[bucket], s + 1);
+                uint32_t end = state.cellStarts[bucket + 1];
+
+                for (uint32_t block = start; block < end;
+                     block += testBlockSize) {
+                    uint32_t block_end = std::min(
+                        block + (uint32_t)testBlockSize, end);
+
+                    uint32_t hits[testBlockSize];
+                    uint32_t num_hits = 0;
+                    for (uint32_t k = block; k < block_end; k++) {
+                        float ox = sorted_x[k] - x;
+                        float oy = sorted_y[k] - y;
+                        float oz = sorted_z[k] - z;
+                        float combined_radius = sorted_radii[k] + radius;
+
+                        float dist_sq = ox * ox + oy * oy + oz * oz;
+                        hits[num_hits] = k;
+                        num_hits += dist_sq < combined_radius * combined_radius ?
+                            1 : 0;
+                    }
+
+                    for (uint32_t i = 0; i < num_hits; i++) {
+                        resolveContact(state, s, hits[i]);
+                    }
+
+                    // s may have been moved by its contacts
+                    x = state.sortedX[s];
+                    y = state.sortedY[s];
+                    z = state.sortedZ[s];
+                }
+            }
+        }
+    }
+}
+
+inline void solveEntry(Context &ctx, ParticleState &state)
+{
+    const PhysicsSystemState &physics_sys =
+        ctx.singleton<PhysicsSystemState>();
+    const CountT num_particles = state.numParticles;
+    if (!physics_sys.substepActive() || num_particles == 0) {
+        return;
+    }
+
+    sortParticles(state);
+
+    for (CountT s = 0; s < num_particles; s++) {
+        solveParticle(state, (uint32_t)s);
+    }
+
+    for (CountT s = 0; s < num_particles; s++) {
+        uint32_t i = state.sortedParticles[s];
+        state.posX[i] = state.sortedX[s];
+        state.posY[i] = state.sortedY[s];
+        state.posZ[i] = state.sortedZ[s];
+    }
+}
+
+inline void velocityEntry(Context &ctx, ParticleState &state)
+{
+    const PhysicsSystemState &physics_sys =
+        ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
+    const CountT num_particles = state.numParticles;
+    const float inv_h = 1.f / physics_sys.h;
+
+    const float *pos_x = state.posX;
+    const float *pos_y = state.posY;
+    const float *pos_z = state.posZ;
+    const float *prev_x = state.prevX;
+    const float *prev_y = state.prevY;
+    const float *prev_z = state.prevZ;
+    float *vel_x = state.velX;
+    float *vel_y = state.velY;
+    float *vel_z = state.velZ;
+
+    for (CountT i = 0; i < num_particles; i++) {
+        vel_x[i] = (pos_x[i] - prev_x[i]) * inv_h;
+        vel_y[i] = (pos_y[i] - prev_y[i]) * inv_h;
+        vel_z[i] = (pos_z[i] - prev_z[i]) * inv_h;
+    }
+}
+
+TaskGraphNodeID setupRigidPairTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        findRigidPairsEntry,
+            ParticleState
+        >>(deps);
+}
+
+TaskGraphNodeID setupIntegrateTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        integrateEntry,
+            ParticleState
+        >>(deps);
+}
+
+TaskGraphNodeID setupSolveTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        solveEntry,
+            ParticleState
+        >>(deps);
+}
+
+TaskGraphNodeID setupVelocityTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        velocityEntry,
+            ParticleState
+        >>(deps);
+}
+
+}
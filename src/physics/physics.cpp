@@ -1,5 +1,8 @@
 #include <madrona/physics.hpp>
 #include <madrona/context.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
 
 #include "physics_impl.hpp"
 #include "xpbd.hpp"
@@ -88,7 +91,103 @@ static void initPhysicsState(Context &ctx,
         .restitutionThreshold = 2.f * g_mag * h,
         .contactArchetypeID = contact_archetype_id,
         .jointArchetypeID = joint_archetype_id,
+        .maxSubsteps = (uint32_t)num_substeps,
+        .numSubsteps = (uint32_t)num_substeps,
+        .curSubstep = 0,
+        .adaptiveSubsteps = false,
+        .substepConfig = {},
+        .stepMotionRatio = 0.f,
+        .stepPenetration = 0.f,
+        .stepJointError = 0.f,
     };
+
+    ctx.singleton<SubstepCount>().numSubsteps = (int32_t)num_substeps;
+}
+
+inline void measureMotionEntry(Context &ctx,
+                               const Velocity &vel,
+                               const ObjectID &obj_id,
+                               ResponseType response_type,
+                               const Scale &scale)
+{
+    PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.adaptiveSubsteps ||
+            response_type == ResponseType::Static) {
+        return;
+    }
+
+    const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+    AABB obj_aabb = obj_mgr.rigidBodyAABBs[obj_id.idx];
+
+    Vector3 extent = obj_aabb.pMax - obj_aabb.pMin;
+    extent.x *= fabsf(scale.d0);
+    extent.y *= fabsf(scale.d1);
+    extent.z *= fabsf(scale.d2);
+
+    float min_extent = fmaxf(fminf(fminf(extent.x, extent.y), extent.z),
+                             1e-3f);
+    float max_extent = fmaxf(fmaxf(extent.x, extent.y), extent.z);
+
+    // Distance the fastest point on the body covers over the whole step
+    float speed = vel.linear.length() + 0.5f * max_extent * vel.angular.length();
+    float ratio = speed * physics_sys.deltaT / min_extent;
+
+    AtomicFloatRef max_ratio(physics_sys.stepMotionRatio);
+    float old = max_ratio.load<sync::relaxed>();
+    while (old < ratio && !max_ratio.compare_exchange_weak<
+            sync::relaxed, sync::relaxed>(old, ratio))
+    {}
+}
+
+inline void chooseSubstepsEntry(Context &ctx,
+                                PhysicsSystemState &physics_sys)
+{
+    uint32_t num_substeps = physics_sys.maxSubsteps;
+
+    if (physics_sys.adaptiveSubsteps) {
+        const PhysicsSystem::AdaptiveSubstepConfig &cfg =
+            physics_sys.substepConfig;
+
+        // Penetration and joint error scale roughly with the substep length,
+        // so scale last step's count by how far over the limit they were.
+        float prev_substeps = (float)physics_sys.numSubsteps;
+
+        float needed = physics_sys.stepMotionRatio / cfg.maxMotionRatio;
+        needed = fmaxf(needed, prev_substeps *
+            physics_sys.stepPenetration / cfg.maxPenetration);
+        needed = fmaxf(needed, prev_substeps *
+            physics_sys.stepJointError / cfg.maxJointError);
+
+        uint32_t min_substeps = (uint32_t)cfg.minSubsteps;
+        if (needed < (float)num_substeps) {
+            num_substeps = std::max((uint32_t)ceilf(needed), min_substeps);
+        }
+    }
+
+    physics_sys.numSubsteps = num_substeps;
+    physics_sys.curSubstep = 0;
+    physics_sys.h = physics_sys.deltaT / (float)num_substeps;
+    physics_sys.restitutionThreshold =
+        2.f * physics_sys.gMagnitude * physics_sys.h;
+
+    physics_sys.stepMotionRatio = 0.f;
+    physics_sys.stepPenetration = 0.f;
+    physics_sys.stepJointError = 0.f;
+
+    ctx.singleton<SubstepCount>().numSubsteps = (int32_t)num_substeps;
+}
+
+inline void endSubstepEntry(Context &, PhysicsSystemState &physics_sys)
+{
+    physics_sys.curSubstep += 1;
+}
+
+TaskGraphNodeID setupSubstepEndTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        endSubstepEntry, PhysicsSystemState>>(deps);
 }
 
 namespace PhysicsSystem {
@@ -138,6 +237,26 @@ void init(Context &ctx,
     }
 
     ctx.singleton<ObjectData>() = { obj_mgr };
+
+    particles::initEmpty(ctx);
+}
+
+void setAdaptiveSubsteps(Context &ctx,
+                         const AdaptiveSubstepConfig &config)
+{
+    // These divide the measured error, so 0 (or NaN) gives inf / NaN
+    // substep counts
+    if (!(config.maxMotionRatio > 0.f) || !(config.maxPenetration > 0.f) ||
+            !(config.maxJointError > 0.f)) {
+        FATAL("Adaptive substeps: maxMotionRatio, maxPenetration and "
+              "maxJointError must be positive");
+    }
+
+    PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+    physics_sys.adaptiveSubsteps = true;
+    physics_sys.substepConfig = config;
+    physics_sys.substepConfig.minSubsteps = std::clamp(
+        config.minSubsteps, CountT(1), CountT(physics_sys.maxSubsteps));
 }
 
 void reset(Context &ctx)
@@ -156,6 +275,20 @@ broadphase::LeafID registerEntity(Context &ctx,
     return bvh.reserveLeaf(e, obj_id);
 }
 
+void setStaticBVH(Context &ctx, const broadphase::BVH *static_bvh)
+{
+    ctx.singleton<broadphase::BVH>().setStaticTree(static_bvh);
+}
+
+broadphase::LeafID registerStaticEntity(Context &ctx,
+                                        Entity e,
+                                        CountT static_idx)
+{
+    auto &bvh = ctx.singleton<broadphase::BVH>();
+
+    return bvh.bindStaticEntity(e, static_idx);
+}
+
 bool checkEntityAABBOverlap(
     Context &ctx, math::AABB aabb, Entity e)
 {
@@ -252,6 +385,53 @@ bool checkEntityAABBOverlap(
 }
 
 
+void checkLineOfSight(Context &ctx,
+                      Span<const LineOfSightQuery> queries,
+                      bool *out_visible)
+{
+    auto &bvh = ctx.singleton<broadphase::BVH>();
+
+    Entity cur_viewer = Entity::none();
+    Vector3 viewer_pos {};
+    Vector3 viewer_fwd {};
+    ViewCone viewer_cone {};
+    bool has_cone = false;
+
+    for (CountT i = 0; i < queries.size(); i++) {
+        const LineOfSightQuery &query = queries[i];
+
+        if (query.viewer != cur_viewer) {
+            cur_viewer = query.viewer;
+            viewer_pos = ctx.get<Position>(cur_viewer);
+
+            auto cone = ctx.getSafe<ViewCone>(cur_viewer);
+            has_cone = cone.valid();
+            if (has_cone) {
+                viewer_cone = cone.value();
+                viewer_fwd =
+                    ctx.get<Rotation>(cur_viewer).rotateVec(math::fwd);
+            }
+        }
+
+        Vector3 to_target = ctx.get<Position>(query.target) - viewer_pos;
+        float dist = to_target.length();
+
+        if (has_cone && (dist > viewer_cone.maxDistance ||
+                dot(viewer_fwd, to_target) < viewer_cone.cosHalfAngle * dist)) {
+            out_visible[i] = false;
+            continue;
+        }
+
+        if (dist == 0.f) {
+            out_visible[i] = true;
+            continue;
+        }
+
+        out_visible[i] = !bvh.traceOcclusion(viewer_pos, to_target / dist,
+            dist, query.viewer, query.target);
+    }
+}
+
 Entity makeFixedJoint(
     Context &ctx,
     Entity e1, Entity e2,
@@ -313,20 +493,27 @@ void registerTypes(ECSRegistry &registry,
     registry.registerComponent<Velocity>();
     registry.registerComponent<ExternalForce>();
     registry.registerComponent<ExternalTorque>();
+    registry.registerComponent<ViewCone>();
 
     registry.registerSingleton<broadphase::BVH>();
 
     registry.registerComponent<CollisionEvent>();
-    registry.registerArchetype<CollisionEventTemporary>();
+    registry.registerArchetype<CollisionEventTemporary>(
+        ComponentMetadataSelector<> {},
+        ArchetypeFlags::ExcludeFromInitialState);
 
     registry.registerComponent<CandidateCollision>();
-    registry.registerArchetype<CandidateTemporary>();
+    registry.registerArchetype<CandidateTemporary>(
+        ComponentMetadataSelector<> {},
+        ArchetypeFlags::ExcludeFromInitialState);
 
     registry.registerComponent<JointConstraint>();
     registry.registerComponent<ContactConstraint>();
 
     registry.registerSingleton<PhysicsSystemState>();
     registry.registerSingleton<ObjectData>();
+    registry.registerSingleton<SubstepCount>();
+    registry.registerSingleton<ParticleState>();
 
     switch (solver) {
     case Solver::XPBD: {
@@ -354,8 +541,14 @@ TaskGraphNodeID setupPhysicsStepTasks(
     CountT num_substeps,
     Solver solver)
 {
+    auto measure_motion = builder.addToGraph<ParallelForNode<Context,
+        measureMotionEntry, Velocity, ObjectID, ResponseType, Scale>>(deps);
+
+    auto choose_substeps = builder.addToGraph<ParallelForNode<Context,
+        chooseSubstepsEntry, PhysicsSystemState>>({measure_motion});
+
     auto broadphase_prep =
-        broadphase::setupPreIntegrationTasks(builder, deps);
+        broadphase::setupPreIntegrationTasks(builder, {choose_substeps});
 
     TaskGraphNodeID solver_finished;
     switch (solver) {
@@ -773,20 +773,38 @@ static bool processConvexHull(const imp::SourceMesh &src_mesh,
     return true;
 }
 
+// Hulls with geometry shared by an earlier mesh (see imp::sharesGeometry)
+// aren't rebuilt, out_canonical_hulls[i] is the index of the hull whose
+// data hull i reuses.
 static bool processConvexHulls(
     Span<const imp::SourceMesh> in_meshes,
     bool build_convex_hulls,
     StackAlloc &tmp_alloc,
-    HalfEdgeMesh *out_meshes)
+    HalfEdgeMesh *out_meshes,
+    uint32_t *out_canonical_hulls)
 {
+    std::unordered_map<const Vector3 *, uint32_t> hulls_by_positions;
+
     for (CountT hull_idx = 0; hull_idx < in_meshes.size(); hull_idx++) {
         const imp::SourceMesh &mesh = in_meshes[hull_idx];
+
+        auto iter = hulls_by_positions.find(mesh.positions);
+        if (iter != hulls_by_positions.end() &&
+                imp::sharesGeometry(mesh, in_meshes[iter->second])) {
+            out_meshes[hull_idx] = out_meshes[iter->second];
+            out_canonical_hulls[hull_idx] = iter->second;
+            continue;
+        }
+
         bool success = processConvexHull(
             mesh, build_convex_hulls, tmp_alloc, &out_meshes[hull_idx]);
 
         if (!success) {
             return false;
         }
+
+        hulls_by_positions.emplace(mesh.positions, (uint32_t)hull_idx);
+        out_canonical_hulls[hull_idx] = (uint32_t)hull_idx;
     }
     
     return true;
@@ -1277,13 +1295,16 @@ void * RigidBodyAssets::processRigidBodyAssets(
 
     HalfEdgeMesh *built_hulls =
         tmp_alloc.allocN<HalfEdgeMesh>(convex_hull_meshes.size());
+    uint32_t *canonical_hulls =
+        tmp_alloc.allocN<uint32_t>(convex_hull_meshes.size());
 
     auto hull_build_frame = tmp_alloc.push();
 
     bool hull_success = processConvexHulls(convex_hull_meshes,
                                            build_convex_hulls,
                                            tmp_alloc,
-                                           built_hulls);
+                                           built_hulls,
+                                           canonical_hulls);
 
     if (!hull_success) {
         tmp_alloc.pop(hull_build_frame);
@@ -1303,6 +1324,10 @@ void * RigidBodyAssets::processRigidBodyAssets(
     CountT total_num_verts = 0;
     for (CountT hull_idx = 0; hull_idx < convex_hull_meshes.size();
          hull_idx++) {
+        if (canonical_hulls[hull_idx] != hull_idx) {
+            continue;
+        }
+
         const HalfEdgeMesh &hull_mesh = built_hulls[hull_idx];
 
         total_num_halfedges += hull_mesh.numHalfEdges;
@@ -1360,6 +1385,14 @@ void * RigidBodyAssets::processRigidBodyAssets(
          hull_idx++) {
         HalfEdgeMesh &hull_mesh = built_hulls[hull_idx];
 
+        // Canonical hulls always precede their duplicates, so the shared
+        // data has already been copied into the output buffer.
+        uint32_t canonical_idx = canonical_hulls[hull_idx];
+        if (canonical_idx != hull_idx) {
+            hull_mesh = built_hulls[canonical_idx];
+            continue;
+        }
+
         HalfEdge *he_out = &assets.hullData.halfEdges[cur_halfedge_offset];
         uint32_t *face_bases_out =
             &assets.hullData.faceBaseHalfEdges[cur_face_offset];
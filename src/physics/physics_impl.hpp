@@ -12,10 +12,75 @@ struct PhysicsSystemState {
     float restitutionThreshold;
     uint32_t contactArchetypeID;
     uint32_t jointArchetypeID;
+
+    // Substeps built into the taskgraph, of which this world runs the
+    // first numSubsteps this step. h is deltaT / numSubsteps.
+    uint32_t maxSubsteps;
+    uint32_t numSubsteps;
+    uint32_t curSubstep;
+    bool adaptiveSubsteps;
+    PhysicsSystem::AdaptiveSubstepConfig substepConfig;
+
+    // Measured since the substep count was last chosen
+    float stepMotionRatio;
+    float stepPenetration;
+    float stepJointError;
+
+    inline bool substepActive() const
+    {
+        return curSubstep < numSubsteps;
+    }
 };
 
 struct CandidateTemporary : Archetype<CandidateCollision> {};
 
+// Per world particle storage, see madrona/particles.hpp. Registered and
+// zeroed by PhysicsSystem so the solver's particle tasks exist in every
+// graph and do nothing until particles::init.
+struct ParticleState {
+    CountT maxParticles;
+    CountT numParticles;
+    float friction;
+
+    float *posX;
+    float *posY;
+    float *posZ;
+    // Positions at the start of the current substep
+    float *prevX;
+    float *prevY;
+    float *prevZ;
+    float *velX;
+    float *velY;
+    float *velZ;
+    float *radii;
+    float *invMasses;
+
+    // Hash grid rebuilt every substep. The solve runs on copies of the
+    // particles sorted by bucket so each bucket's particles are
+    // contiguous, and the results are scattered back afterwards.
+    float cellSize;
+    uint32_t numCells;
+    uint32_t *cellStarts;
+    uint32_t *cellCounts;
+    uint32_t *particleCells;
+    uint32_t *sortedParticles;
+    float *sortedX;
+    float *sortedY;
+    float *sortedZ;
+    float *sortedPrevX;
+    float *sortedPrevY;
+    float *sortedPrevZ;
+    float *sortedRadii;
+    float *sortedInvMasses;
+
+    // Particle - rigid body pairs whose bounds overlap this step, found
+    // once before the substeps like CandidateTemporary
+    CountT maxRigidPairs;
+    CountT numRigidPairs;
+    uint32_t *rigidPairParticles;
+    Loc *rigidPairBodies;
+};
+
 namespace broadphase {
 
 TaskGraphNodeID setupBVHTasks(
@@ -32,6 +97,41 @@ TaskGraphNodeID setupPostIntegrationTasks(
 
 }
 
+// Adds the node that ends a substep, call at the end of each iteration of
+// the solver's substep loop.
+TaskGraphNodeID setupSubstepEndTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+namespace particles {
+
+void initEmpty(Context &ctx);
+
+// Origin rebasing, subtracts delta from every particle position. Runs at
+// the start of the step, so only the current positions need to move.
+void shiftOrigin(Context &ctx, math::Vector3 delta);
+
+// Finds the particle - rigid body pairs for this step, after the BVH has
+// been updated and before the substeps
+TaskGraphNodeID setupRigidPairTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+TaskGraphNodeID setupIntegrateTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+// Particle - particle contacts
+TaskGraphNodeID setupSolveTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+TaskGraphNodeID setupVelocityTasks(
+    TaskGraphBuilder &builder,
+    Span<const TaskGraphNodeID> deps);
+
+}
+
 namespace narrowphase {
 
 TaskGraphNodeID setupTasks(
@@ -1,5 +1,8 @@
 #include <madrona/physics_loader.hpp>
 #include <madrona/importer.hpp>
+#include <madrona/dyn_array.hpp>
+#include <madrona/utils.hpp>
+#include <madrona/memory.hpp>
 
 #ifdef MADRONA_CUDA_SUPPORT
 #include <madrona/cuda_utils.hpp>
@@ -35,6 +38,15 @@ struct PhysicsLoader::Impl {
     CountT maxObjs;
     ExecMode execMode;
 
+    // One arena per loadRigidBodies call holding every hull's packed data
+    DynArray<void *> hullArenas;
+
+    // Host copy of objAABBs for building static trees
+    DynArray<AABB> hostObjAABBs;
+    // CPU: BVHs from buildStaticBVH. CUDA: their device allocations.
+    DynArray<broadphase::BVH *> staticBVHs;
+    DynArray<void *> staticBVHAllocs;
+
     static Impl * init(ExecMode exec_mode, CountT max_objects)
     {
         constexpr CountT max_prims_per_object = 20;
@@ -141,6 +153,10 @@ struct PhysicsLoader::Impl {
             .maxPrims = max_objects * max_prims_per_object,
             .maxObjs = max_objects,
             .execMode = exec_mode,
+            .hullArenas = DynArray<void *>(0),
+            .hostObjAABBs = DynArray<AABB>(0),
+            .staticBVHs = DynArray<broadphase::BVH *>(0),
+            .staticBVHAllocs = DynArray<void *>(0),
         };
     }
 };
@@ -164,6 +180,14 @@ PhysicsLoader::~PhysicsLoader()
         free(impl_->rigidBodyPrimitiveOffsets);
         free(impl_->rigidBodyPrimitiveCounts);
         free(impl_->metadatas);
+
+        for (void *arena : impl_->hullArenas) {
+            rawDeallocAligned(arena);
+        }
+
+        for (broadphase::BVH *bvh : impl_->staticBVHs) {
+            freeHostBVH(bvh);
+        }
     } break;
     case ExecMode::CUDA: {
 #ifndef MADRONA_CUDA_SUPPORT
@@ -175,6 +199,14 @@ PhysicsLoader::~PhysicsLoader()
         cu::deallocGPU(impl_->rigidBodyPrimitiveOffsets);
         cu::deallocGPU(impl_->rigidBodyPrimitiveCounts);
         cu::deallocGPU(impl_->metadatas);
+
+        for (void *arena : impl_->hullArenas) {
+            cu::deallocGPU(arena);
+        }
+
+        for (void *alloc : impl_->staticBVHAllocs) {
+            cu::deallocGPU(alloc);
+        }
 #endif
     } break;
     }
@@ -186,6 +218,10 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
 {
     CountT cur_obj_offset = impl_->curObjOffset;
     impl_->curObjOffset += assets.numObjs;
+
+    for (CountT i = 0; i < (CountT)assets.numObjs; i++) {
+        impl_->hostObjAABBs.push_back(assets.objAABBs[i]);
+    }
     CountT cur_prim_offset = impl_->curPrimOffset;
     impl_->curPrimOffset += assets.totalNumPrimitives;
     assert(impl_->curObjOffset <= impl_->maxObjs);
@@ -199,19 +235,124 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
     uint32_t *counts_dst = &impl_->rigidBodyPrimitiveCounts[cur_obj_offset];
     RigidBodyMetadata *metadatas_dst = &impl_->metadatas[cur_obj_offset];
 
-    // FIXME: redo all this, leaks memory, slow, etc. Very non optimal on the
-    // CPU.
-
     uint32_t *offsets_tmp = (uint32_t *)malloc(
         sizeof(uint32_t) * assets.numObjs);
     for (CountT i = 0; i < (CountT)assets.numObjs; i++) {
         offsets_tmp[i] = assets.primOffsets[i] + cur_prim_offset;
     }
 
-    HalfEdge *hull_halfedges;
-    uint32_t *hull_face_base_halfedges;
-    Plane *hull_face_planes;
-    Vector3 *hull_verts;
+    auto primitives_tmp = (CollisionPrimitive *)malloc(
+        sizeof(CollisionPrimitive) * assets.totalNumPrimitives);
+    memcpy(primitives_tmp, assets.primitives,
+           sizeof(CollisionPrimitive) * assets.totalNumPrimitives);
+
+    // Each unique hull is packed into a single cache line aligned block
+    // (vertices, planes, edges, half edges, face bases) so the narrowphase
+    // touches one contiguous range per hull rather than four arrays spread
+    // across the whole asset set. Primitives sharing a hull share the block.
+    struct PackedHull {
+        const HalfEdgeMesh *src;
+        int64_t arenaOffset;
+        int64_t offsets[4];
+    };
+
+    DynArray<PackedHull> packed_hulls(0);
+    std::unordered_map<const HalfEdge *, CountT> hull_lookup;
+    int64_t total_hull_bytes = 0;
+
+    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
+        const CollisionPrimitive &cur_primitive = primitives_tmp[i];
+        if (cur_primitive.type != CollisionPrimitive::Type::Hull) continue;
+
+        const HalfEdgeMesh &he_mesh = cur_primitive.hull.halfEdgeMesh;
+        if (hull_lookup.count(he_mesh.halfEdges)) {
+            continue;
+        }
+
+        hull_lookup.emplace(he_mesh.halfEdges, packed_hulls.size());
+
+        int64_t buffer_sizes[] = {
+            int64_t(sizeof(Vector3) * he_mesh.numVertices),
+            int64_t(sizeof(Plane) * he_mesh.numFaces),
+            int64_t(sizeof(HullEdge) * he_mesh.numEdges()),
+            int64_t(sizeof(HalfEdge) * he_mesh.numHalfEdges),
+            int64_t(sizeof(uint32_t) * he_mesh.numFaces),
+        };
+
+        PackedHull packed;
+        packed.src = &he_mesh;
+        packed.arenaOffset = total_hull_bytes;
+
+        int64_t num_hull_bytes = utils::computeBufferOffsets(
+            buffer_sizes, packed.offsets, 16);
+        total_hull_bytes += utils::roundUpPow2(num_hull_bytes,
+            (int64_t)MADRONA_CACHE_LINE);
+
+        packed_hulls.push_back(packed);
+    }
+
+    char *hull_staging = nullptr;
+    char *hull_arena = nullptr;
+    if (total_hull_bytes > 0) {
+        hull_staging = (char *)rawAllocAligned(total_hull_bytes,
+                                               MADRONA_CACHE_LINE);
+
+        if (impl_->execMode == ExecMode::CUDA) {
+#ifdef MADRONA_CUDA_SUPPORT
+            hull_arena = (char *)cu::allocGPU(total_hull_bytes);
+#endif
+        } else {
+            hull_arena = hull_staging;
+        }
+
+        impl_->hullArenas.push_back(hull_arena);
+    }
+
+    for (const PackedHull &packed : packed_hulls) {
+        const HalfEdgeMesh &src = *packed.src;
+        char *base = hull_staging + packed.arenaOffset;
+
+        auto *verts = (Vector3 *)base;
+        auto *planes = (Plane *)(base + packed.offsets[0]);
+        auto *edges = (HullEdge *)(base + packed.offsets[1]);
+        auto *hedges = (HalfEdge *)(base + packed.offsets[2]);
+        auto *face_bases = (uint32_t *)(base + packed.offsets[3]);
+
+        memcpy(verts, src.vertices, sizeof(Vector3) * src.numVertices);
+        memcpy(planes, src.facePlanes, sizeof(Plane) * src.numFaces);
+        memcpy(hedges, src.halfEdges, sizeof(HalfEdge) * src.numHalfEdges);
+        memcpy(face_bases, src.faceBaseHalfEdges,
+               sizeof(uint32_t) * src.numFaces);
+
+        for (CountT e = 0; e < (CountT)src.numEdges(); e++) {
+            const HalfEdge &cur = hedges[2 * e];
+            const HalfEdge &twin = hedges[2 * e + 1];
+
+            edges[e] = HullEdge {
+                .v1 = cur.rootVertex,
+                .v2 = hedges[cur.next].rootVertex,
+                .face1 = cur.face,
+                .face2 = twin.face,
+            };
+        }
+    }
+
+    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
+        CollisionPrimitive &cur_primitive = primitives_tmp[i];
+        if (cur_primitive.type != CollisionPrimitive::Type::Hull) continue;
+
+        HalfEdgeMesh &he_mesh = cur_primitive.hull.halfEdgeMesh;
+        const PackedHull &packed =
+            packed_hulls[hull_lookup.find(he_mesh.halfEdges)->second];
+
+        char *base = hull_arena + packed.arenaOffset;
+        he_mesh.vertices = (Vector3 *)base;
+        he_mesh.facePlanes = (Plane *)(base + packed.offsets[0]);
+        he_mesh.edges = (HullEdge *)(base + packed.offsets[1]);
+        he_mesh.halfEdges = (HalfEdge *)(base + packed.offsets[2]);
+        he_mesh.faceBaseHalfEdges = (uint32_t *)(base + packed.offsets[3]);
+    }
+
     switch (impl_->execMode) {
     case ExecMode::CPU: {
         memcpy(prim_aabbs_dst, assets.primitiveAABBs,
@@ -225,24 +366,6 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
                sizeof(uint32_t) * assets.numObjs);
         memcpy(metadatas_dst, assets.metadatas,
                sizeof(RigidBodyMetadata) * assets.numObjs);
-
-        hull_halfedges = (HalfEdge *)malloc(
-            sizeof(HalfEdge) * assets.hullData.numHalfEdges);
-        hull_face_base_halfedges = (uint32_t *)malloc(
-            sizeof(uint32_t) * assets.hullData.numFaces);
-        hull_face_planes = (Plane *)malloc(
-            sizeof(Plane) * assets.hullData.numFaces);
-        hull_verts = (Vector3 *)malloc(
-            sizeof(Vector3) * assets.hullData.numVerts);
-
-        memcpy(hull_halfedges, assets.hullData.halfEdges,
-               sizeof(HalfEdge) * assets.hullData.numHalfEdges);
-        memcpy(hull_face_base_halfedges, assets.hullData.faceBaseHalfEdges,
-               sizeof(uint32_t) * assets.hullData.numFaces);
-        memcpy(hull_face_planes, assets.hullData.facePlanes,
-               sizeof(Plane) * assets.hullData.numFaces);
-        memcpy(hull_verts, assets.hullData.vertices,
-               sizeof(Vector3) * assets.hullData.numVerts);
     } break;
     case ExecMode::CUDA: {
 #ifndef MADRONA_CUDA_SUPPORT
@@ -265,52 +388,14 @@ CountT PhysicsLoader::loadRigidBodies(const RigidBodyAssets &assets)
                    sizeof(RigidBodyMetadata) * assets.numObjs,
                    cudaMemcpyHostToDevice);
 
-        hull_halfedges = (HalfEdge *)cu::allocGPU(
-            sizeof(HalfEdge) * assets.hullData.numHalfEdges);
-        hull_face_base_halfedges = (uint32_t *)cu::allocGPU(
-            sizeof(uint32_t) * assets.hullData.numFaces);
-        hull_face_planes = (Plane *)cu::allocGPU(
-            sizeof(Plane) * assets.hullData.numFaces);
-        hull_verts = (Vector3 *)cu::allocGPU(
-            sizeof(Vector3) * assets.hullData.numVerts);
-
-        cudaMemcpy(hull_halfedges, assets.hullData.halfEdges,
-                   sizeof(HalfEdge) * assets.hullData.numHalfEdges,
-                   cudaMemcpyHostToDevice);
-        cudaMemcpy(hull_face_base_halfedges, assets.hullData.faceBaseHalfEdges,
-                   sizeof(uint32_t) * assets.hullData.numFaces,
-                   cudaMemcpyHostToDevice);
-        cudaMemcpy(hull_face_planes, assets.hullData.facePlanes,
-                   sizeof(Plane) * assets.hullData.numFaces,
-                   cudaMemcpyHostToDevice);
-        cudaMemcpy(hull_verts, assets.hullData.vertices,
-                   sizeof(Vector3) * assets.hullData.numVerts,
-                   cudaMemcpyHostToDevice);
+        if (total_hull_bytes > 0) {
+            cudaMemcpy(hull_arena, hull_staging, total_hull_bytes,
+                       cudaMemcpyHostToDevice);
+            rawDeallocAligned(hull_staging);
+        }
 #endif
-    }
-    }
-
-    auto primitives_tmp = (CollisionPrimitive *)malloc(
-        sizeof(CollisionPrimitive) * assets.totalNumPrimitives);
-    memcpy(primitives_tmp, assets.primitives,
-           sizeof(CollisionPrimitive) * assets.totalNumPrimitives);
-
-    for (CountT i = 0; i < (CountT)assets.totalNumPrimitives; i++) {
-        CollisionPrimitive &cur_primitive = primitives_tmp[i];
-        if (cur_primitive.type != CollisionPrimitive::Type::Hull) continue;
-
-        HalfEdgeMesh &he_mesh = cur_primitive.hull.halfEdgeMesh;
-
-        // FIXME: incoming HalfEdgeMeshes should have offsets or something
-        CountT hedge_offset = he_mesh.halfEdges - assets.hullData.halfEdges;
-        CountT face_offset =
-            he_mesh.facePlanes - assets.hullData.facePlanes;
-        CountT vert_offset = he_mesh.vertices - assets.hullData.vertices;
-
-        he_mesh.halfEdges = hull_halfedges + hedge_offset;
-        he_mesh.faceBaseHalfEdges = hull_face_base_halfedges + face_offset;
-        he_mesh.facePlanes = hull_face_planes + face_offset;
-        he_mesh.vertices = hull_verts + vert_offset;
+    } break;
+    default: MADRONA_UNREACHABLE();
     }
 
     switch (impl_->execMode) {
@@ -338,4 +423,90 @@ ObjectManager & PhysicsLoader::getObjectManager()
     return *impl_->mgr;
 }
 
+void PhysicsLoader::freeHostBVH(broadphase::BVH *bvh)
+{
+    rawDealloc(bvh->nodes_);
+    rawDealloc(bvh->leaf_entities_);
+    rawDealloc(bvh->leaf_obj_ids_);
+    rawDealloc(bvh->leaf_aabbs_);
+    rawDealloc(bvh->leaf_transforms_);
+    rawDealloc(bvh->leaf_parents_);
+    rawDealloc(bvh->sorted_leaves_);
+    rawDealloc(bvh->node_dirty_);
+    rawDealloc(bvh);
+}
+
+const broadphase::BVH * PhysicsLoader::buildStaticBVH(
+    Span<const StaticInstance> instances)
+{
+    using broadphase::BVH;
+
+    CountT num_instances = instances.size();
+    if (num_instances == 0) {
+        FATAL("PhysicsLoader: static BVH needs at least one instance");
+    }
+
+    // Static leaves never move, so no motion expansion
+    BVH *host_bvh = (BVH *)rawAlloc(sizeof(BVH));
+    new (host_bvh) BVH(impl_->mgr, num_instances, 0.f, 0.f);
+
+    for (const StaticInstance &inst : instances) {
+        broadphase::LeafID leaf_id =
+            host_bvh->reserveLeaf(Entity::none(), inst.objID);
+
+        host_bvh->updateLeafPosition(leaf_id, inst.position, inst.rotation,
+            inst.scale, Vector3::zero(),
+            impl_->hostObjAABBs[inst.objID.idx]);
+    }
+
+    host_bvh->updateTree();
+
+    switch (impl_->execMode) {
+    case ExecMode::CPU: {
+        impl_->staticBVHs.push_back(host_bvh);
+        return host_bvh;
+    } break;
+    case ExecMode::CUDA: {
+#ifndef MADRONA_CUDA_SUPPORT
+        noCUDA();
+#else
+        auto toGPU = [this](const void *src, size_t num_bytes) {
+            void *dst = cu::allocGPU(num_bytes);
+            REQ_CUDA(cudaMemcpy(dst, src, num_bytes,
+                                cudaMemcpyHostToDevice));
+            impl_->staticBVHAllocs.push_back(dst);
+            return dst;
+        };
+
+        // Queries only read the nodes and per leaf object IDs, AABBs and
+        // transforms. The rest of the build state stays on the host.
+        alignas(BVH) char staged_bytes[sizeof(BVH)];
+        memcpy((void *)staged_bytes, (const void *)host_bvh, sizeof(BVH));
+        BVH *staged = (BVH *)staged_bytes;
+
+        staged->nodes_ = (BVH::Node *)toGPU(host_bvh->nodes_,
+            sizeof(BVH::Node) * host_bvh->num_nodes_);
+        staged->leaf_obj_ids_ = (base::ObjectID *)toGPU(
+            host_bvh->leaf_obj_ids_, sizeof(base::ObjectID) * num_instances);
+        staged->leaf_aabbs_ = (AABB *)toGPU(
+            host_bvh->leaf_aabbs_, sizeof(AABB) * num_instances);
+        staged->leaf_transforms_ = (BVH::LeafTransform *)toGPU(
+            host_bvh->leaf_transforms_,
+            sizeof(BVH::LeafTransform) * num_instances);
+        staged->leaf_entities_ = nullptr;
+        staged->leaf_parents_ = nullptr;
+        staged->sorted_leaves_ = nullptr;
+        staged->node_dirty_ = nullptr;
+
+        BVH *dev_bvh = (BVH *)toGPU(staged_bytes, sizeof(BVH));
+
+        freeHostBVH(host_bvh);
+
+        return dev_bvh;
+#endif
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+}
+
 }
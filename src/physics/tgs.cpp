@@ -28,7 +28,9 @@ using namespace math;
 void registerTypes(ECSRegistry &registry)
 {
     registry.registerArchetype<Joint>();
-    registry.registerArchetype<Contact>();
+    registry.registerArchetype<Contact>(
+        ComponentMetadataSelector<> {},
+        ArchetypeFlags::ExcludeFromInitialState);
 
     // Any components in the bundle specific to this solver must be
     // registered first.
@@ -69,6 +71,10 @@ static inline void solveContacts(Context &ctx,
                                  SolverState &solver,
                                  bool use_bias)
 {
+    if (!ctx.singleton<PhysicsSystemState>().substepActive()) {
+        return;
+    }
+
     ctx.iterateQuery(solver.contactQuery, [&](ContactConstraint &contact) {
         // Solve contact
         (void)contact;
@@ -98,14 +104,15 @@ inline void integrateVelocities(Context &ctx,
                                 ObjectID obj_id,
                                 Velocity &vel)
 {
-    if (response_type == ResponseType::Static) {
+    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (response_type == ResponseType::Static ||
+            !physics_sys.substepActive()) {
         return;
     }
 
     Vector3 v = vel.linear;
     Vector3 omega = vel.angular;
 
-    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
     const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
     const RigidBodyMetadata &metadata = obj_mgr.metadata[obj_id.idx];
 
@@ -174,13 +181,17 @@ inline void integratePositions(Context &ctx,
                                Rotation &rot,
                                Velocity vel)
 {
+    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
     Vector3 x = pos;
     Quat q = rot;
 
     Vector3 v = vel.linear;
     Vector3 omega = vel.angular;
 
-    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
     float h = physics_sys.h;
 
     x += h * v;
@@ -291,6 +302,8 @@ TaskGraphNodeID setupTGSSolverTasks(
             solveContactsUnbiased,
                 SolverState
             >>({cur_node});
+
+        cur_node = setupSubstepEndTasks(builder, {cur_node});
     }
 
     // For now, we don't have any persistent contacts support, so clear
@@ -0,0 +1,439 @@
+#include <madrona/topdown.hpp>
+#include <madrona/physics.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/memory.hpp>
+#include <madrona/impl/hash_grid.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+#include <cfloat>
+
+namespace madrona::topdown {
+
+using namespace base;
+using namespace math;
+using namespace phys;
+
+namespace {
+
+// Outlines with more vertices fall back to the AABB outline
+constexpr CountT maxOutlineVerts = 16;
+// Objects whose hulls have more vertices in total than this fall back to
+// the AABB outline
+constexpr CountT maxHullPoints = 64;
+// Spheres are outlined as this many points on their circle
+constexpr CountT numSpherePoints = 8;
+
+}
+
+struct TopDownState {
+    Query<Entity, Position, Rotation, Scale, Footprint> footprintQuery;
+    float cellSize;
+    int32_t rowsBehind;
+    CountT maxFootprints;
+    CountT numOutlines;
+
+    // Outline i is a convex polygon with outlineNumVerts[i] vertices in
+    // counter clockwise order, starting at outlineVerts[i * maxOutlineVerts]
+    Vector2 *outlineVerts;
+    int32_t *outlineNumVerts;
+    uint8_t *outlineMasks;
+    // Bounding circles, to skip outlines outside an observer's grid
+    Vector2 *outlineCenters;
+    float *outlineRadii;
+};
+
+void registerTypes(ECSRegistry &registry)
+{
+    registry.registerComponent<Footprint>();
+    registry.registerSingleton<TopDownState>();
+}
+
+void init(Context &ctx, const Config &cfg)
+{
+    new (&ctx.singleton<TopDownState>()) TopDownState {
+        .footprintQuery =
+            ctx.query<Entity, Position, Rotation, Scale, Footprint>(),
+        .cellSize = cfg.cellSize,
+        .rowsBehind = cfg.rowsBehind,
+        .maxFootprints = cfg.maxFootprints,
+        .numOutlines = 0,
+        .outlineVerts = allocArray<Vector2>(
+            cfg.maxFootprints * maxOutlineVerts),
+        .outlineNumVerts = allocArray<int32_t>(cfg.maxFootprints),
+        .outlineMasks = allocArray<uint8_t>(cfg.maxFootprints),
+        .outlineCenters = allocArray<Vector2>(cfg.maxFootprints),
+        .outlineRadii = allocArray<float>(cfg.maxFootprints),
+    };
+}
+
+static inline float cross2D(Vector2 o, Vector2 a, Vector2 b)
+{
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// Andrew's monotone chain. Sorts pts in place, out needs room for
+// num_pts + 1 points. Returns the number of hull vertices, in counter
+// clockwise order.
+static int32_t convexHull2D(Vector2 *pts, int32_t num_pts, Vector2 *out)
+{
+    // Insertion sort, inputs are small
+    for (int32_t i = 1; i < num_pts; i++) {
+        Vector2 p = pts[i];
+        int32_t j = i - 1;
+        while (j >= 0 && (pts[j].x > p.x ||
+                (pts[j].x == p.x && pts[j].y > p.y))) {
+            pts[j + 1] = pts[j];
+            j -= 1;
+        }
+        pts[j + 1] = p;
+    }
+
+    if (num_pts < 3) {
+        for (int32_t i = 0; i < num_pts; i++) {
+            out[i] = pts[i];
+        }
+        return num_pts;
+    }
+
+    int32_t num_out = 0;
+    for (int32_t i = 0; i < num_pts; i++) {
+        while (num_out >= 2 &&
+                cross2D(out[num_out - 2], out[num_out - 1], pts[i]) <= 0.f) {
+            num_out -= 1;
+        }
+        out[num_out++] = pts[i];
+    }
+
+    int32_t lower_size = num_out + 1;
+    for (int32_t i = num_pts - 2; i >= 0; i--) {
+        while (num_out >= lower_size &&
+                cross2D(out[num_out - 2], out[num_out - 1], pts[i]) <= 0.f) {
+            num_out -= 1;
+        }
+        out[num_out++] = pts[i];
+    }
+
+    // The last point repeats the first
+    return num_out - 1;
+}
+
+static inline Vector2 projectXY(Vector3 v)
+{
+    return Vector2 { v.x, v.y };
+}
+
+static int32_t aabbOutlinePoints(const AABB &aabb,
+                                 Vector3 pos,
+                                 Quat rot,
+                                 Diag3x3 scale,
+                                 Vector2 *pts)
+{
+    for (int32_t i = 0; i < 8; i++) {
+        Vector3 corner {
+            (i & 1) ? aabb.pMax.x : aabb.pMin.x,
+            (i & 2) ? aabb.pMax.y : aabb.pMin.y,
+            (i & 4) ? aabb.pMax.z : aabb.pMin.z,
+        };
+
+        pts[i] = projectXY(pos + rot.rotateVec(scale * corner));
+    }
+
+    return 8;
+}
+
+// Returns -1 if the object's primitives have too many points
+static int32_t hullOutlinePoints(const ObjectManager &obj_mgr,
+                                 int32_t obj_id,
+                                 Vector3 pos,
+                                 Quat rot,
+                                 Diag3x3 scale,
+                                 Vector2 *pts)
+{
+    uint32_t prim_offset = obj_mgr.rigidBodyPrimitiveOffsets[obj_id];
+    uint32_t num_prims = obj_mgr.rigidBodyPrimitiveCounts[obj_id];
+
+    int32_t num_pts = 0;
+    for (uint32_t i = 0; i < num_prims; i++) {
+        const CollisionPrimitive &prim =
+            obj_mgr.collisionPrimitives[prim_offset + i];
+
+        if (prim.type == CollisionPrimitive::Type::Hull) {
+            const geo::HalfEdgeMesh &mesh = prim.hull.halfEdgeMesh;
+            if (num_pts + (int32_t)mesh.numVertices > maxHullPoints) {
+                return -1;
+            }
+
+            for (uint32_t j = 0; j < mesh.numVertices; j++) {
+                pts[num_pts++] = projectXY(
+                    pos + rot.rotateVec(scale * mesh.vertices[j]));
+            }
+        } else if (prim.type == CollisionPrimitive::Type::Sphere) {
+            if (num_pts + numSpherePoints > maxHullPoints) {
+                return -1;
+            }
+
+            // Spheres are scaled uniformly by the x scale
+            float radius = prim.sphere.radius * scale.d0;
+            // Circumscribe the circle so the outline stays conservative
+            float outer_radius = radius / cosf(math::pi / numSpherePoints);
+
+            for (CountT j = 0; j < numSpherePoints; j++) {
+                float theta = 2.f * math::pi * float(j) / numSpherePoints;
+                pts[num_pts++] = Vector2 {
+                    pos.x + outer_radius * cosf(theta),
+                    pos.y + outer_radius * sinf(theta),
+                };
+            }
+        }
+        // Planes are unbounded and have no outline
+    }
+
+    return num_pts;
+}
+
+inline void collectEntry(Context &ctx, TopDownState &state)
+{
+    const ObjectManager *obj_mgr = nullptr;
+
+    CountT num_outlines = 0;
+    ctx.iterateQuery(state.footprintQuery,
+    [&](Entity e,
+        Position pos,
+        Rotation rot,
+        Scale scale,
+        const Footprint &footprint)
+    {
+        Vector2 pts[maxHullPoints];
+        int32_t num_pts = 0;
+
+        const AABB *obj_aabb = nullptr;
+        int32_t obj_id = -1;
+        if (footprint.shape != FootprintShape::Box) {
+            auto obj_id_ref = ctx.getSafe<ObjectID>(e);
+            if (!obj_id_ref.valid()) {
+                return;
+            }
+
+            if (obj_mgr == nullptr) {
+                obj_mgr = ctx.singleton<ObjectData>().mgr;
+            }
+
+            obj_id = obj_id_ref.value().idx;
+            obj_aabb = &obj_mgr->rigidBodyAABBs[obj_id];
+        }
+
+        switch (footprint.shape) {
+        case FootprintShape::ObjectAABB: {
+            num_pts = aabbOutlinePoints(*obj_aabb, pos, rot, scale, pts);
+        } break;
+        case FootprintShape::ObjectHull: {
+            num_pts = hullOutlinePoints(
+                *obj_mgr, obj_id, pos, rot, scale, pts);
+        } break;
+        case FootprintShape::Box: {
+            Vector2 half = footprint.halfExtents;
+            for (int32_t i = 0; i < 4; i++) {
+                Vector3 corner {
+                    (i & 1) ? half.x : -half.x,
+                    (i & 2) ? half.y : -half.y,
+                    0.f,
+                };
+
+                pts[i] = projectXY(pos + rot.rotateVec(corner));
+            }
+            num_pts = 4;
+        } break;
+        default: MADRONA_UNREACHABLE();
+        }
+
+        Vector2 hull[maxHullPoints + 1];
+        int32_t num_verts = -1;
+        if (num_pts > 0) {
+            num_verts = convexHull2D(pts, num_pts, hull);
+        }
+
+        if ((num_pts < 0 || num_verts > maxOutlineVerts) &&
+                obj_aabb != nullptr) {
+            num_pts = aabbOutlinePoints(*obj_aabb, pos, rot, scale, pts);
+            num_verts = convexHull2D(pts, num_pts, hull);
+        }
+
+        if (num_verts <= 0 || num_verts > maxOutlineVerts) {
+            return;
+        }
+
+        if (num_outlines == state.maxFootprints) {
+            FATAL("Top-down grids: more than %ld footprints",
+                  (long)state.maxFootprints);
+        }
+
+        Vector2 center { 0.f, 0.f };
+        for (int32_t i = 0; i < num_verts; i++) {
+            center += hull[i];
+        }
+        center /= float(num_verts);
+
+        float radius = 0.f;
+        Vector2 *out_verts = state.outlineVerts + num_outlines * maxOutlineVerts;
+        for (int32_t i = 0; i < num_verts; i++) {
+            out_verts[i] = hull[i];
+            radius = fmaxf(radius, (hull[i] - center).length());
+        }
+
+        state.outlineNumVerts[num_outlines] = num_verts;
+        state.outlineMasks[num_outlines] = footprint.mask;
+        state.outlineCenters[num_outlines] = center;
+        state.outlineRadii[num_outlines] = radius;
+        num_outlines += 1;
+    });
+
+    state.numOutlines = num_outlines;
+}
+
+// Cells are unit squares, cell (r, c) covers [c, c + 1] x [r, r + 1].
+// Marks every cell the convex polygon overlaps.
+static void fillConvex(uint8_t *cells,
+                       int32_t width,
+                       int32_t height,
+                       const Vector2 *verts,
+                       int32_t num_verts,
+                       uint8_t mask)
+{
+    float min_y = FLT_MAX;
+    float max_y = -FLT_MAX;
+    for (int32_t i = 0; i < num_verts; i++) {
+        min_y = fminf(min_y, verts[i].y);
+        max_y = fmaxf(max_y, verts[i].y);
+    }
+
+    min_y = fmaxf(min_y, -1.f);
+    max_y = fminf(max_y, float(height + 1));
+
+    int32_t row_start = std::max((int32_t)floorf(min_y), 0);
+    int32_t row_end = std::min(
+        std::max((int32_t)floorf(min_y), (int32_t)ceilf(max_y) - 1),
+        height - 1);
+
+    for (int32_t row = row_start; row <= row_end; row++) {
+        float slab_min = float(row);
+        float slab_max = float(row + 1);
+
+        // x extent of the polygon clipped to this row: vertices inside the
+        // row plus edge crossings of the row's boundaries
+        float min_x = FLT_MAX;
+        float max_x = -FLT_MAX;
+        for (int32_t i = 0; i < num_verts; i++) {
+            Vector2 a = verts[i];
+            Vector2 b = verts[i == num_verts - 1 ? 0 : i + 1];
+
+            if (a.y >= slab_min && a.y <= slab_max) {
+                min_x = fminf(min_x, a.x);
+                max_x = fmaxf(max_x, a.x);
+            }
+
+            float boundaries[2] = { slab_min, slab_max };
+            for (float boundary : boundaries) {
+                if ((a.y - boundary) * (b.y - boundary) < 0.f) {
+                    float t = (boundary - a.y) / (b.y - a.y);
+                    float x = a.x + t * (b.x - a.x);
+                    min_x = fminf(min_x, x);
+                    max_x = fmaxf(max_x, x);
+                }
+            }
+        }
+
+        if (min_x > max_x) {
+            continue;
+        }
+
+        min_x = fmaxf(min_x, -1.f);
+        max_x = fminf(max_x, float(width + 1));
+
+        int32_t col_start = std::max((int32_t)floorf(min_x), 0);
+        int32_t col_end = std::min(
+            std::max((int32_t)floorf(min_x), (int32_t)ceilf(max_x) - 1),
+            width - 1);
+
+        // Contiguous span, vectorized by the compiler
+        uint8_t *row_cells = cells + row * width;
+        for (int32_t col = col_start; col <= col_end; col++) {
+            row_cells[col] |= mask;
+        }
+    }
+}
+
+void rasterize(Context &ctx,
+               Vector3 pos,
+               Quat rot,
+               uint8_t *cells,
+               int32_t width,
+               int32_t height)
+{
+    const TopDownState &state = ctx.singleton<TopDownState>();
+
+    for (int32_t i = 0; i < width * height; i++) {
+        cells[i] = 0;
+    }
+
+    Vector3 heading = rot.rotateVec(math::fwd);
+    Vector2 fwd { heading.x, heading.y };
+    float fwd_len = fwd.length();
+    if (fwd_len < 1e-5f) {
+        // Looking straight up or down, no meaningful heading
+        fwd = Vector2 { 0.f, 1.f };
+    } else {
+        fwd /= fwd_len;
+    }
+    Vector2 right { fwd.y, -fwd.x };
+
+    float cell_size = state.cellSize;
+    float inv_cell_size = 1.f / cell_size;
+
+    // Grid space: x grows to the right, y grows backwards, one unit per
+    // cell. The observer is at the center of its cell.
+    float observer_x = float(width / 2) + 0.5f;
+    float observer_y = float(height - 1 - state.rowsBehind) + 0.5f;
+
+    Vector2 observer_pos { pos.x, pos.y };
+    Vector2 grid_center = observer_pos +
+        right * ((0.5f * width - observer_x) * cell_size) +
+        fwd * ((observer_y - 0.5f * height) * cell_size);
+    float grid_radius = 0.5f * cell_size *
+        sqrtf(float(width * width + height * height));
+
+    for (CountT i = 0; i < state.numOutlines; i++) {
+        float max_dist = grid_radius + state.outlineRadii[i];
+        if ((state.outlineCenters[i] - grid_center).length2() >
+                max_dist * max_dist) {
+            continue;
+        }
+
+        const Vector2 *world_verts =
+            state.outlineVerts + i * maxOutlineVerts;
+        int32_t num_verts = state.outlineNumVerts[i];
+
+        Vector2 grid_verts[maxOutlineVerts];
+        for (int32_t j = 0; j < num_verts; j++) {
+            Vector2 d = world_verts[j] - observer_pos;
+            grid_verts[j] = Vector2 {
+                observer_x + d.dot(right) * inv_cell_size,
+                observer_y - d.dot(fwd) * inv_cell_size,
+            };
+        }
+
+        fillConvex(cells, width, height, grid_verts, num_verts,
+                   state.outlineMasks[i]);
+    }
+}
+
+TaskGraphNodeID setupCollectTasks(TaskGraphBuilder &builder,
+                                  Span<const TaskGraphNodeID> deps)
+{
+    return builder.addToGraph<ParallelForNode<Context,
+        collectEntry,
+            TopDownState
+        >>(deps);
+}
+
+}
@@ -109,6 +109,11 @@ inline void substepRigidBodies(Context &ctx,
                                PreSolvePositional &presolve_pos,
                                PreSolveVelocity &presolve_vel)
 {
+    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
     Vector3 x = pos;
     Quat q = rot;
 
@@ -135,7 +140,6 @@ inline void substepRigidBodies(Context &ctx,
     prev_state.prevPosition = x;
     prev_state.prevRotation = q;
 
-    const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
     const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
     const RigidBodyMetadata &metadata = obj_mgr.metadata[obj_id.idx];
 
@@ -549,6 +553,258 @@ static inline void handleContact(Context &ctx,
     *q2_ptr = q2;
 }
 
+namespace {
+
+// Hull primitives tested against particles are transformed into this many
+// vertices on the stack, same limit as the CPU narrowphase
+constexpr CountT maxParticleHullVertices = 512;
+
+// Closest feature of a rigid body primitive to a particle
+struct ParticlePrimitiveContact {
+    // Signed distance from the particle center to the primitive's
+    // surface, negative inside
+    float dist;
+    // Outward surface normal at the closest point
+    Vector3 normal;
+    Vector3 surfacePoint;
+};
+
+}
+
+static bool particlePrimitiveContact(const CollisionPrimitive &prim,
+                                     AABB prim_aabb,
+                                     Vector3 center,
+                                     float radius,
+                                     Vector3 body_pos,
+                                     Quat body_rot,
+                                     Diag3x3 body_scale,
+                                     ParticlePrimitiveContact *out)
+{
+    switch (prim.type) {
+    case CollisionPrimitive::Type::Sphere: {
+        float sphere_radius = body_scale.d0 * prim.sphere.radius;
+
+        Vector3 to_center = center - body_pos;
+        float center_dist = to_center.length();
+
+        Vector3 normal = center_dist > 0.f ?
+            to_center / center_dist : math::up;
+
+        out->dist = center_dist - sphere_radius;
+        out->normal = normal;
+        out->surfacePoint = body_pos + sphere_radius * normal;
+    } break;
+    case CollisionPrimitive::Type::Plane: {
+        Vector3 normal = body_rot.rotateVec(math::up);
+        float dist = dot(normal, center - body_pos);
+
+        out->dist = dist;
+        out->normal = normal;
+        out->surfacePoint = center - dist * normal;
+    } break;
+    case CollisionPrimitive::Type::Hull: {
+        AABB particle_aabb {
+            .pMin = center - Vector3 { radius, radius, radius },
+            .pMax = center + Vector3 { radius, radius, radius },
+        };
+
+        if (!prim_aabb.applyTRS(body_pos, body_rot, body_scale).overlaps(
+                particle_aabb)) {
+            return false;
+        }
+
+        const geo::HalfEdgeMesh &src_mesh = prim.hull.halfEdgeMesh;
+        assert(src_mesh.numVertices <= maxParticleHullVertices);
+
+        // GJK against the hull moved so the particle is at the origin
+        Vector3 txfm_vertices[maxParticleHullVertices];
+        for (CountT i = 0; i < (CountT)src_mesh.numVertices; i++) {
+            txfm_vertices[i] = body_rot.rotateVec(
+                body_scale * src_mesh.vertices[i]) + body_pos - center;
+        }
+
+        geo::HalfEdgeMesh txfm_mesh = src_mesh;
+        txfm_mesh.vertices = txfm_vertices;
+
+        Vector3 to_closest;
+        float dist2 = geo::hullClosestPointToOriginGJK(
+            txfm_mesh, 1e-10f, &to_closest);
+
+        if (dist2 > radius * radius) {
+            return false;
+        }
+
+        if (dist2 > 0.f) {
+            float dist = sqrtf(dist2);
+
+            out->dist = dist;
+            out->normal = -to_closest / dist;
+            out->surfacePoint = center + to_closest;
+            break;
+        }
+
+        // The center is inside, push out through the closest face. Face
+        // planes are transformed by the inverse transpose of the scale.
+        Vector3 local_center =
+            body_rot.inv().rotateVec(center - body_pos);
+        local_center.x /= body_scale.d0;
+        local_center.y /= body_scale.d1;
+        local_center.z /= body_scale.d2;
+
+        float max_dist = -FLT_MAX;
+        Vector3 max_normal = math::up;
+        for (CountT i = 0; i < (CountT)src_mesh.numFaces; i++) {
+            geo::Plane plane = src_mesh.facePlanes[i];
+
+            Vector3 scaled_normal {
+                plane.normal.x / body_scale.d0,
+                plane.normal.y / body_scale.d1,
+                plane.normal.z / body_scale.d2,
+            };
+            float inv_len = 1.f / scaled_normal.length();
+
+            float face_dist =
+                (dot(plane.normal, local_center) - plane.d) * inv_len;
+            if (face_dist > max_dist) {
+                max_dist = face_dist;
+                max_normal = scaled_normal * inv_len;
+            }
+        }
+
+        Vector3 normal = body_rot.rotateVec(max_normal);
+
+        out->dist = max_dist;
+        out->normal = normal;
+        out->surfacePoint = center - max_dist * normal;
+    } break;
+    default: MADRONA_UNREACHABLE();
+    }
+
+    return out->dist < radius;
+}
+
+// Resolves each particle - rigid body pair found this step against the
+// body's deepest primitive. The particle is treated as a body with zero
+// inverse inertia whose contact point is on its surface toward the rigid
+// body, so the contact goes through the same handleContactConstraint as
+// rigid contacts and setVelocities picks up the body's response.
+inline void solveParticleRigidContacts(Context &ctx, ParticleState &particles)
+{
+    PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
+    const ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
+
+    float max_penetration = physics_sys.stepPenetration;
+    for (CountT pair_idx = 0; pair_idx < particles.numRigidPairs;
+         pair_idx++) {
+        uint32_t particle_idx = particles.rigidPairParticles[pair_idx];
+        Loc body_loc = particles.rigidPairBodies[pair_idx];
+
+        float inv_m1 = particles.invMasses[particle_idx];
+        float radius = particles.radii[particle_idx];
+
+        Vector3 x1 {
+            particles.posX[particle_idx],
+            particles.posY[particle_idx],
+            particles.posZ[particle_idx],
+        };
+
+        Position *x2_ptr =
+            &ctx.getDirect<Position>(RGDCols::Position, body_loc);
+        Rotation *q2_ptr =
+            &ctx.getDirect<Rotation>(RGDCols::Rotation, body_loc);
+        Scale scale = ctx.getDirect<Scale>(RGDCols::Scale, body_loc);
+        ObjectID obj_id = ctx.getDirect<ObjectID>(RGDCols::ObjectID, body_loc);
+        ResponseType resp_type = ctx.getDirect<ResponseType>(
+            RGDCols::ResponseType, body_loc);
+
+        Vector3 x2 = *x2_ptr;
+        Quat q2 = *q2_ptr;
+
+        ParticlePrimitiveContact deepest;
+        deepest.dist = FLT_MAX;
+
+        CountT prim_offset = obj_mgr.rigidBodyPrimitiveOffsets[obj_id.idx];
+        CountT num_prims = obj_mgr.rigidBodyPrimitiveCounts[obj_id.idx];
+        for (CountT i = 0; i < num_prims; i++) {
+            CountT prim_idx = prim_offset + i;
+
+            ParticlePrimitiveContact contact;
+            bool hit = particlePrimitiveContact(
+                obj_mgr.collisionPrimitives[prim_idx],
+                obj_mgr.primitiveAABBs[prim_idx],
+                x1, radius, x2, q2, scale, &contact);
+
+            if (hit && contact.dist < deepest.dist) {
+                deepest = contact;
+            }
+        }
+
+        if (deepest.dist == FLT_MAX) {
+            continue;
+        }
+
+        max_penetration = fmaxf(max_penetration, radius - deepest.dist);
+
+        RigidBodyMetadata metadata = obj_mgr.metadata[obj_id.idx];
+
+        float inv_m2 = metadata.mass.invMass;
+        Vector3 inv_I2 = metadata.mass.invInertiaTensor;
+        if (resp_type == ResponseType::Static) {
+            inv_m2 = 0.f;
+            inv_I2 = Vector3::zero();
+        }
+
+        if (inv_m1 == 0.f && inv_m2 == 0.f) {
+            continue;
+        }
+
+        Quat q1 { 1, 0, 0, 0 };
+
+        SubstepPrevState prev1 {
+            .prevPosition = {
+                particles.prevX[particle_idx],
+                particles.prevY[particle_idx],
+                particles.prevZ[particle_idx],
+            },
+            .prevRotation = q1,
+        };
+        SubstepPrevState prev2 = ctx.getDirect<SubstepPrevState>(
+            XPBDCols::SubstepPrevState, body_loc);
+
+        // Normal from the particle toward the body
+        Vector3 n_world = -deepest.normal;
+        Vector3 r1 = radius * n_world;
+        Vector3 r2 = q2.inv().rotateVec(deepest.surfacePoint - x2);
+
+        float avg_mu_s = 0.5f * (particles.friction + metadata.friction.muS);
+
+        float lambda_n = 0.f;
+        float lambda_t = 0.f;
+        handleContactConstraint(x1, x2,
+                                q1, q2,
+                                prev1, prev2,
+                                inv_m1, inv_m2,
+                                Vector3::zero(), inv_I2,
+                                r1, r2,
+                                n_world,
+                                avg_mu_s,
+                                &lambda_n,
+                                &lambda_t);
+
+        particles.posX[particle_idx] = x1.x;
+        particles.posY[particle_idx] = x1.y;
+        particles.posZ[particle_idx] = x1.z;
+
+        *x2_ptr = x2;
+        *q2_ptr = q2;
+    }
+    physics_sys.stepPenetration = max_penetration;
+}
+
 static void applyJointOrientationConstraint(
     Quat &q1, Quat &q2,
     Quat attach_q1, Quat attach_q2,
@@ -604,8 +860,9 @@ static void applyJointAxisConstraint(
     }
 }
 
-inline void handleJointConstraint(Context &ctx,
-                                  JointConstraint joint)
+// Returns the positional error before the correction
+inline float handleJointConstraint(Context &ctx,
+                                   JointConstraint joint)
 {
     Loc l1 = ctx.loc(joint.e1);
     Loc l2 = ctx.loc(joint.e2);
@@ -715,24 +972,41 @@ inline void handleJointConstraint(Context &ctx,
     *x2_ptr = x2;
     *q1_ptr = q1;
     *q2_ptr = q2;
+
+    return pos_correction_magnitude;
 }
 
 inline void solvePositions(Context &ctx, SolverState &solver_state)
 {
+    PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
     ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
 
+    float max_penetration = physics_sys.stepPenetration;
     ctx.iterateQuery(solver_state.contactQuery,
     [&](ContactConstraint &contact, XPBDContactState &contact_solver_state) {
         contact_solver_state.lambdaN[0] = 0.f;
         contact_solver_state.lambdaN[1] = 0.f;
         contact_solver_state.lambdaN[2] = 0.f;
         contact_solver_state.lambdaN[3] = 0.f;
+
+        for (CountT i = 0; i < contact.numPoints; i++) {
+            max_penetration = fmaxf(max_penetration, contact.points[i].w);
+        }
+
         handleContact(ctx, obj_mgr, contact, contact_solver_state.lambdaN);
     });
+    physics_sys.stepPenetration = max_penetration;
 
+    float max_joint_error = physics_sys.stepJointError;
     ctx.iterateQuery(solver_state.jointQuery, [&](JointConstraint joint) {
-        handleJointConstraint(ctx, joint);
+        max_joint_error =
+            fmaxf(max_joint_error, handleJointConstraint(ctx, joint));
     });
+    physics_sys.stepJointError = max_joint_error;
 }
 
 inline void setVelocities(Context &ctx,
@@ -742,6 +1016,10 @@ inline void setVelocities(Context &ctx,
                           Velocity &vel)
 {
     const auto &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
+
     float h = physics_sys.h;
 
     Vector3 x = pos;
@@ -1042,6 +1320,9 @@ inline void solveVelocities(Context &ctx, SolverState &solver)
 {
     ObjectManager &obj_mgr = *ctx.singleton<ObjectData>().mgr;
     PhysicsSystemState &physics_sys = ctx.singleton<PhysicsSystemState>();
+    if (!physics_sys.substepActive()) {
+        return;
+    }
 
     ctx.iterateQuery(solver.contactQuery,
     [&](ContactConstraint &contact, XPBDContactState &contact_solver_state) {
@@ -1059,7 +1340,9 @@ void registerTypes(ECSRegistry &registry)
     registry.registerComponent<XPBDContactState>();
 
     registry.registerArchetype<Joint>();
-    registry.registerArchetype<Contact>();
+    registry.registerArchetype<Contact>(
+        ComponentMetadataSelector<> {},
+        ArchetypeFlags::ExcludeFromInitialState);
 
     registry.registerSingleton<SolverState>();
 
@@ -1095,6 +1378,8 @@ TaskGraphNodeID setupXPBDSolverTasks(
     cur_node = builder.addToGraph<ResetTmpAllocNode>({cur_node});
 #endif
 
+    cur_node = particles::setupRigidPairTasks(builder, {cur_node});
+
     for (CountT i = 0; i < num_substeps; i++) {
         auto rgb_update = builder.addToGraph<ParallelForNode<Context,
             substepRigidBodies, Position, Rotation, Velocity, ObjectID,
@@ -1102,6 +1387,9 @@ TaskGraphNodeID setupXPBDSolverTasks(
             SubstepPrevState, PreSolvePositional,
             PreSolveVelocity>>({cur_node});
 
+        auto particle_update =
+            particles::setupIntegrateTasks(builder, {cur_node});
+
         auto run_narrowphase = narrowphase::setupTasks(builder, {rgb_update});
 
 #ifdef MADRONA_GPU_MODE
@@ -1116,18 +1404,32 @@ TaskGraphNodeID setupXPBDSolverTasks(
             solvePositions, SolverState>>(
                 {run_narrowphase});
 
+        // Particle - rigid contacts go last so particles don't end
+        // the substep inside geometry
+        auto solve_particles = particles::setupSolveTasks(
+            builder, {solve_pos, particle_update});
+
+        auto solve_particle_rigid = builder.addToGraph<ParallelForNode<
+            Context, solveParticleRigidContacts, ParticleState>>(
+                {solve_particles});
+
         auto vel_set = builder.addToGraph<ParallelForNode<Context,
             setVelocities, Position, Rotation,
-            SubstepPrevState, Velocity>>({solve_pos});
+            SubstepPrevState, Velocity>>({solve_particle_rigid});
+
+        auto particle_vel_set = particles::setupVelocityTasks(
+            builder, {solve_particle_rigid});
 
         auto solve_vel = builder.addToGraph<ParallelForNode<Context,
             solveVelocities, SolverState>>({vel_set});
 
         auto clear_contacts = builder.addToGraph<
-            ClearTmpNode<Contact>>({solve_vel});
+            ClearTmpNode<Contact>>({solve_vel, particle_vel_set});
             
         cur_node = builder.addToGraph<ResetTmpAllocNode>({clear_contacts});
 
+        cur_node = setupSubstepEndTasks(builder, {cur_node});
+
 #if 0
         cur_node = builder.addToGraph<ParallelForNode<Context,
             checkSubstep, Entity, Position, Rotation, Velocity,
@@ -13,6 +13,7 @@
 
 #include <span>
 #include <array>
+#include <unordered_map>
 
 using bytes = std::span<const std::byte>;
 
@@ -138,11 +139,24 @@ static HeapArray<MeshBVH> createMeshBVHs(
         }
     }
 
+    // Objects sharing geometry reuse the first object's BVH. makeBVHData
+    // recognizes these by their identical node pointers.
+    std::unordered_map<const SourceMesh *, CountT> bvhs_by_meshes;
+
     for (CountT obj_idx = 0; obj_idx < objs.size(); obj_idx++) {
         const SourceObject &obj = objs[obj_idx];
 
+        auto iter = bvhs_by_meshes.find(obj.meshes.data());
+        if (iter != bvhs_by_meshes.end() &&
+                sharesGeometry(obj, objs[iter->second])) {
+            mesh_bvhs[obj_idx] = mesh_bvhs[iter->second];
+            continue;
+        }
+
         MeshBVH bvh = MeshBVHBuilder::build(obj.meshes);
         mesh_bvhs[obj_idx] = bvh;
+
+        bvhs_by_meshes.emplace(obj.meshes.data(), obj_idx);
     }
 
      if (bvh_cache_path) {
@@ -161,9 +175,17 @@ MeshBVHData makeBVHData(Span<const imp::SourceObject> src_objs)
     uint64_t num_leaf_mats = 0;
     uint64_t num_vertices = 0;
 
+    // Shared BVHs are uploaded once and referenced by every object using
+    // them.
+    std::unordered_map<const QBVHNode *, CountT> uploaded_bvhs;
+
     for (CountT bvh_idx = 0; bvh_idx < mesh_bvhs.size(); ++bvh_idx) {
         const MeshBVH &bvh = mesh_bvhs[bvh_idx];
 
+        if (!uploaded_bvhs.emplace(bvh.nodes, bvh_idx).second) {
+            continue;
+        }
+
         num_nodes += bvh.numNodes;
 #ifdef MADRONA_COMPRESSED_DEINDEXED_TEX
         num_leaf_mats += bvh.numVerts/3;
@@ -200,9 +222,20 @@ MeshBVHData makeBVHData(Span<const imp::SourceObject> src_objs)
     uint64_t leaf_offset = 0;
     uint64_t vert_offset = 0;
 
+    HeapArray<MeshBVH> gpu_bvhs(mesh_bvhs.size());
+
     for (CountT bvh_idx = 0; bvh_idx < mesh_bvhs.size(); ++bvh_idx) {
         const MeshBVH &bvh = mesh_bvhs[bvh_idx];
 
+        CountT canonical_idx = uploaded_bvhs.find(bvh.nodes)->second;
+        if (canonical_idx != bvh_idx) {
+            gpu_bvhs[bvh_idx] = gpu_bvhs[canonical_idx];
+
+            REQ_CUDA(cudaMemcpy(bvhs + bvh_idx, &gpu_bvhs[bvh_idx],
+                sizeof(MeshBVH), cudaMemcpyHostToDevice));
+            continue;
+        }
+
         // Need to make sure the pointers in the BVH point to GPU memory
         MeshBVH tmp = bvh;
         tmp.nodes = nodes + node_offset;
@@ -213,6 +246,8 @@ MeshBVHData makeBVHData(Span<const imp::SourceObject> src_objs)
         tmp.leafMats = nullptr;
 #endif
 
+        gpu_bvhs[bvh_idx] = tmp;
+
         REQ_CUDA(cudaMemcpy(bvhs + bvh_idx,
             &tmp, sizeof(tmp), cudaMemcpyHostToDevice));
         REQ_CUDA(cudaMemcpy(nodes + node_offset,
@@ -1502,27 +1502,28 @@ static void issueMemoryBarrier(vk::Device &dev,
                               0, nullptr, 0, nullptr);
 }
 
-static void sortInstancesAndViewsCPU(EngineInterop *interop)
+static void sortInstancesAndViewsCPU(EngineInterop *interop,
+                                     const ECSSnapshot &src)
 {
-    for (uint32_t i = 0; i < *interop->bridge.totalNumInstances; ++i) {
+    for (uint32_t i = 0; i < src.numInstances; ++i) {
         interop->iotaArrayInstancesCPU[i] = i;
     }
 
-    for (uint32_t i = 0; i < *interop->bridge.totalNumViews; ++i) {
+    for (uint32_t i = 0; i < src.numViews; ++i) {
         interop->iotaArrayViewsCPU[i] = i;
     }
 
     { // Sort the indices based on worldID/entityID number
         std::sort(interop->iotaArrayInstancesCPU, 
-                  interop->iotaArrayInstancesCPU + *interop->bridge.totalNumInstances,
-                  [&interop] (uint32_t a, uint32_t b) {
-                      return interop->bridge.instancesWorldIDs[a] < interop->bridge.instancesWorldIDs[b];
+                  interop->iotaArrayInstancesCPU + src.numInstances,
+                  [&src] (uint32_t a, uint32_t b) {
+                      return src.instanceWorldIDs[a] < src.instanceWorldIDs[b];
                   });
 
         std::sort(interop->iotaArrayViewsCPU,
-                  interop->iotaArrayViewsCPU + *interop->bridge.totalNumViews,
-                  [&interop] (uint32_t a, uint32_t b) {
-                      return interop->bridge.viewsWorldIDs[a] < interop->bridge.viewsWorldIDs[b];
+                  interop->iotaArrayViewsCPU + src.numViews,
+                  [&src] (uint32_t a, uint32_t b) {
+                      return src.viewWorldIDs[a] < src.viewWorldIDs[b];
                   });
     }
 
@@ -1530,19 +1531,19 @@ static void sortInstancesAndViewsCPU(EngineInterop *interop)
     PerspectiveCameraData *views = (PerspectiveCameraData *)interop->viewsCPU->ptr;
 
     { // Write the sorted array of views and instances
-        for (uint32_t i = 0; i < *interop->bridge.totalNumInstances; ++i) {
-            instances[i] = interop->bridge.instances[interop->iotaArrayInstancesCPU[i]];
+        for (uint32_t i = 0; i < src.numInstances; ++i) {
+            instances[i] = src.instances[interop->iotaArrayInstancesCPU[i]];
 
             // We also need to have the sorted instance IDs in order to extract the offsets
             interop->sortedInstanceWorldIDs[i] = 
-                interop->bridge.instancesWorldIDs[interop->iotaArrayInstancesCPU[i]];
+                src.instanceWorldIDs[interop->iotaArrayInstancesCPU[i]];
         }
 
-        for (uint32_t i = 0; i < *interop->bridge.totalNumViews; ++i) {
-            views[i] = interop->bridge.views[interop->iotaArrayViewsCPU[i]];
+        for (uint32_t i = 0; i < src.numViews; ++i) {
+            views[i] = src.views[interop->iotaArrayViewsCPU[i]];
 
             interop->sortedViewWorldIDs[i] = 
-                interop->bridge.viewsWorldIDs[interop->iotaArrayViewsCPU[i]];
+                src.viewWorldIDs[interop->iotaArrayViewsCPU[i]];
         }
     }
 }
@@ -1583,6 +1584,37 @@ static void computeViewOffsets(EngineInterop *interop, uint32_t num_worlds)
     }
 }
 
+void prepareECSOutputCPU(EngineInterop *interop, uint32_t num_worlds)
+{
+    ECSSnapshot src;
+    if (interop->asyncSnapshots) {
+        // The simulation thread already took the counts and copied
+        // the ECS output out, see RenderContext::publishECSSnapshot
+        src = interop->asyncSnapshots->slots[
+            interop->asyncSnapshots->readIdx];
+    } else {
+        src = {
+            .instances = interop->bridge.instances,
+            .views = interop->bridge.views,
+            .instanceWorldIDs = interop->bridge.instancesWorldIDs,
+            .viewWorldIDs = interop->bridge.viewsWorldIDs,
+            .numInstances = interop->bridge.totalNumInstancesCPUInc->load_acquire(),
+            .numViews = interop->bridge.totalNumViewsCPUInc->load_acquire(),
+        };
+
+        interop->bridge.totalNumViewsCPUInc->store_release(0);
+        interop->bridge.totalNumInstancesCPUInc->store_release(0);
+    }
+
+    *interop->bridge.totalNumViews = src.numViews;
+    *interop->bridge.totalNumInstances = src.numInstances;
+
+    // First, need to perform the sorts
+    sortInstancesAndViewsCPU(interop, src);
+    computeInstanceOffsets(interop, num_worlds);
+    computeViewOffsets(interop, num_worlds);
+}
+
 void BatchRenderer::prepareForRendering(BatchRenderInfo info,
                                         EngineInterop *interop)
 {
@@ -1591,20 +1623,11 @@ void BatchRenderer::prepareForRendering(BatchRenderInfo info,
 
     { // Flush CPU buffers if we used CPU buffers
         if (interop->viewsCPU.has_value()) {
-            *interop->bridge.totalNumViews = interop->bridge.totalNumViewsCPUInc->load_acquire();
-            *interop->bridge.totalNumInstances = interop->bridge.totalNumInstancesCPUInc->load_acquire();
+            prepareECSOutputCPU(interop, info.numWorlds);
 
             info.numInstances = *interop->bridge.totalNumInstances;
             info.numViews = *interop->bridge.totalNumViews;
 
-            interop->bridge.totalNumViewsCPUInc->store_release(0);
-            interop->bridge.totalNumInstancesCPUInc->store_release(0);
-
-            // First, need to perform the sorts
-            sortInstancesAndViewsCPU(interop);
-            computeInstanceOffsets(interop, info.numWorlds);
-            computeViewOffsets(interop, info.numWorlds);
-
             // Need to flush engine input state before copy
             interop->viewsCPU->flush(impl->dev);
             interop->viewOffsetsCPU->flush(impl->dev);
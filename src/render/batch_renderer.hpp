@@ -52,6 +52,11 @@ struct BatchImportedBuffers {
     render::vk::LocalBuffer instanceOffsets;
 };
 
+// Sorts the CPU backend's ECS output (or the acquired async snapshot) by
+// world into the interop's CPU buffers and computes the per world offsets.
+// Sets the bridge's totalNumViews and totalNumInstances.
+void prepareECSOutputCPU(EngineInterop *interop, uint32_t num_worlds);
+
 struct BatchRenderer {
     struct Impl;
     std::unique_ptr<Impl> impl;
@@ -0,0 +1,837 @@
+#include "cpu_rasterizer.hpp"
+#include "render_common.hpp"
+
+#include <madrona/heap_array.hpp>
+#include <madrona/dyn_array.hpp>
+#include <madrona/sync.hpp>
+#include <madrona/crash.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <thread>
+#include <unordered_map>
+
+namespace madrona::render {
+
+using namespace math;
+
+namespace {
+
+constexpr int32_t tileSize = 8;
+constexpr int32_t tilePixels = tileSize * tileSize;
+
+// Same ambient floor as the GPU raycaster
+constexpr float ambientLight = 0.2f;
+
+constexpr uint32_t missColor = 0xFF00'0000;
+
+struct RasterMesh {
+    uint32_t vertexOffset;
+    uint32_t numVertices;
+    uint32_t indexOffset;
+    uint32_t numTris;
+    int32_t materialIdx;
+};
+
+struct RasterObject {
+    uint32_t meshOffset;
+    uint32_t numMeshes;
+    AABB bounds;
+};
+
+struct VisibleInstance {
+    // Object space to view space
+    Mat3x3 toView;
+    Vector3 viewTranslation;
+    float nearestDepth;
+    uint32_t instanceIdx;
+};
+
+// Screen space triangle. Edge functions and inverse depth are planes over
+// pixel coordinates, f(x, y) = a * x + b * y + c, with the edges oriented
+// so the inside is where all three are >= 0.
+struct ScreenTri {
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+    float invDepthA;
+    float invDepthB;
+    float invDepthC;
+    float maxInvDepth;
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    int32_t maxY;
+    uint32_t color;
+};
+
+// Per thread, reused across views
+struct ViewScratch {
+    DynArray<VisibleInstance> visible;
+    DynArray<Vector3> viewVerts;
+    DynArray<ScreenTri> tris;
+    HeapArray<DynArray<uint32_t>> tileBins;
+    DynArray<Vector3> viewLightDirs;
+
+    ViewScratch(CountT num_tiles)
+        : visible(0),
+          viewVerts(0),
+          tris(0),
+          tileBins(num_tiles),
+          viewLightDirs(0)
+    {
+        for (CountT i = 0; i < num_tiles; i++) {
+            tileBins.emplace(i, 0);
+        }
+    }
+};
+
+}
+
+struct CPURasterizer::Impl {
+    uint32_t renderWidth;
+    uint32_t renderHeight;
+    uint32_t numTilesX;
+    uint32_t numTilesY;
+    bool renderRGB;
+    float minProjectedSize;
+
+    DynArray<Vector3> positions;
+    DynArray<uint32_t> indices;
+    DynArray<RasterMesh> meshes;
+    DynArray<RasterObject> objects;
+    DynArray<Vector3> materialColors;
+    DynArray<Vector3> lightDirs;
+
+    HeapArray<uint32_t> rgbOut;
+    HeapArray<float> depthOut;
+
+    // scratch[0] belongs to the thread calling renderViews, scratch[i + 1]
+    // to workers[i]
+    HeapArray<ViewScratch> scratch;
+    HeapArray<std::thread> workers;
+
+    // Inputs of the current renderViews call
+    const PerspectiveCameraData *curViews;
+    const uint64_t *curViewWorldIDs;
+    const InstanceData *curInstances;
+    const uint64_t *curInstanceWorldIDs;
+    uint32_t curNumViews;
+    uint32_t curNumInstances;
+
+    // Upper 32 bits: run counter, lowest bit: 1 = render, 0 = exit
+    alignas(MADRONA_CACHE_LINE) AtomicU64 workerWakeup;
+    alignas(MADRONA_CACHE_LINE) AtomicU32 nextView;
+    alignas(MADRONA_CACHE_LINE) AtomicU32 numFinished;
+    uint64_t runCounter;
+
+    Impl(const Config &cfg);
+    ~Impl();
+
+    void workerThread(CountT worker_idx);
+    void renderAvailableViews(ViewScratch &view_scratch);
+    void renderView(ViewScratch &view_scratch, uint32_t view_idx);
+
+    void cullInstances(ViewScratch &view_scratch,
+                       const PerspectiveCameraData &view,
+                       uint32_t instance_start,
+                       uint32_t instance_end);
+    void setupTriangles(ViewScratch &view_scratch,
+                        const PerspectiveCameraData &view);
+    void rasterizeTiles(ViewScratch &view_scratch, uint32_t view_idx);
+};
+
+// The executor already has a worker per core, so the default pool stays
+// small rather than doubling the thread count.
+static constexpr uint32_t defaultNumThreads = 4;
+
+static CountT getNumThreads(uint32_t num_threads)
+{
+    if (num_threads > 0) {
+        return num_threads;
+    }
+
+    return std::clamp(std::thread::hardware_concurrency(),
+                      1u, defaultNumThreads);
+}
+
+CPURasterizer::Impl::Impl(const Config &cfg)
+    : renderWidth(cfg.renderWidth),
+      renderHeight(cfg.renderHeight),
+      numTilesX((cfg.renderWidth + tileSize - 1) / tileSize),
+      numTilesY((cfg.renderHeight + tileSize - 1) / tileSize),
+      renderRGB(cfg.renderMode == RenderManager::Config::RenderMode::RGBD),
+      minProjectedSize(cfg.minProjectedSize),
+      positions(0),
+      indices(0),
+      meshes(0),
+      objects(0),
+      materialColors(0),
+      lightDirs(0),
+      rgbOut(renderRGB ? (CountT)cfg.numWorlds * cfg.maxViewsPerWorld *
+             cfg.renderWidth * cfg.renderHeight : 0),
+      depthOut((CountT)cfg.numWorlds * cfg.maxViewsPerWorld *
+               cfg.renderWidth * cfg.renderHeight),
+      scratch(getNumThreads(cfg.numThreads)),
+      workers(scratch.size() - 1),
+      curViews(nullptr),
+      curViewWorldIDs(nullptr),
+      curInstances(nullptr),
+      curInstanceWorldIDs(nullptr),
+      curNumViews(0),
+      curNumInstances(0),
+      workerWakeup(0),
+      nextView(0),
+      numFinished(0),
+      runCounter(0)
+{
+    for (CountT i = 0; i < scratch.size(); i++) {
+        scratch.emplace(i, (CountT)numTilesX * numTilesY);
+    }
+
+    for (CountT i = 0; i < workers.size(); i++) {
+        workers.emplace(i, [](Impl *impl, CountT i) {
+            impl->workerThread(i);
+        }, this, i);
+    }
+}
+
+CPURasterizer::Impl::~Impl()
+{
+    runCounter += 1;
+    workerWakeup.store_release(runCounter << 32);
+    workerWakeup.notify_all();
+
+    for (CountT i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void CPURasterizer::Impl::workerThread(CountT worker_idx)
+{
+    ViewScratch &view_scratch = scratch[worker_idx + 1];
+
+    uint64_t cur_wakeup = 0;
+    while (true) {
+        workerWakeup.wait<sync::acquire>(cur_wakeup);
+        cur_wakeup = workerWakeup.load_acquire();
+
+        if ((cur_wakeup & 1) == 0) {
+            break;
+        }
+
+        renderAvailableViews(view_scratch);
+
+        numFinished.fetch_add_acq_rel(1);
+        numFinished.notify_all();
+    }
+}
+
+void CPURasterizer::Impl::renderAvailableViews(ViewScratch &view_scratch)
+{
+    while (true) {
+        uint32_t view_idx = nextView.fetch_add_relaxed(1);
+        if (view_idx >= curNumViews) {
+            break;
+        }
+
+        renderView(view_scratch, view_idx);
+    }
+}
+
+static inline Vector3 hexToRgb(uint32_t hex)
+{
+    float r = ((hex >> 16) & 0xFF) / 255.f;
+    float g = ((hex >> 8) & 0xFF) / 255.f;
+    float b = (hex & 0xFF) / 255.f;
+
+    return { r, g, b };
+}
+
+static inline float linearToSRGB(float v)
+{
+    if (v <= 0.00031308f) {
+        return 12.92f * v;
+    } else {
+        return 1.055f * powf(v, 1.f / 2.4f) - 0.055f;
+    }
+}
+
+// Same encoding as the batch renderer's lighting pass
+static inline uint32_t linearToSRGB8(Vector3 rgb)
+{
+    auto quantize = [](float v) {
+        return (uint32_t)(255.f * std::clamp(linearToSRGB(v), 0.f, 1.f));
+    };
+
+    return quantize(rgb.x) | (quantize(rgb.y) << 8) |
+        (quantize(rgb.z) << 16) | (255u << 24);
+}
+
+void CPURasterizer::Impl::renderView(ViewScratch &view_scratch,
+                                     uint32_t view_idx)
+{
+    const PerspectiveCameraData &view = curViews[view_idx];
+
+    // Instances are sorted by world, so this view's are one range
+    uint64_t world_key = curViewWorldIDs[view_idx] & 0xFFFF'FFFF'0000'0000;
+    const uint64_t *instance_ids_end = curInstanceWorldIDs + curNumInstances;
+
+    uint32_t instance_start = uint32_t(std::lower_bound(
+        curInstanceWorldIDs, instance_ids_end, world_key) -
+            curInstanceWorldIDs);
+    uint32_t instance_end = uint32_t(std::lower_bound(
+        curInstanceWorldIDs + instance_start, instance_ids_end,
+        world_key + (1_u64 << 32)) - curInstanceWorldIDs);
+
+    view_scratch.viewLightDirs.clear();
+    for (Vector3 dir : lightDirs) {
+        view_scratch.viewLightDirs.push_back(view.rotation.rotateVec(dir));
+    }
+
+    cullInstances(view_scratch, view, instance_start, instance_end);
+    setupTriangles(view_scratch, view);
+    rasterizeTiles(view_scratch, view_idx);
+}
+
+void CPURasterizer::Impl::cullInstances(ViewScratch &view_scratch,
+                                        const PerspectiveCameraData &view,
+                                        uint32_t instance_start,
+                                        uint32_t instance_end)
+{
+    view_scratch.visible.clear();
+
+    float x_scale = fabsf(view.xScale);
+    float y_scale = fabsf(view.yScale);
+
+    for (uint32_t i = instance_start; i < instance_end; i++) {
+        const InstanceData &instance = curInstances[i];
+        if (instance.objectID < 0 ||
+                instance.objectID >= (int32_t)objects.size()) {
+            continue;
+        }
+
+        const RasterObject &obj = objects[instance.objectID];
+
+        Mat3x3 to_view = Mat3x3::fromQuat(view.rotation * instance.rotation) *
+            instance.scale;
+        Vector3 view_translation =
+            view.rotation.rotateVec(instance.position - view.position);
+
+        // Count the bounds' corners outside each frustum plane (near,
+        // left, right, bottom, top). The instance is culled if all 8 are
+        // outside any one of them.
+        int32_t num_outside[5] = {};
+        float nearest_depth = FLT_MAX;
+        Vector2 screen_min { FLT_MAX, FLT_MAX };
+        Vector2 screen_max { -FLT_MAX, -FLT_MAX };
+
+        for (int32_t corner_idx = 0; corner_idx < 8; corner_idx++) {
+            Vector3 corner {
+                (corner_idx & 1) ? obj.bounds.pMax.x : obj.bounds.pMin.x,
+                (corner_idx & 2) ? obj.bounds.pMax.y : obj.bounds.pMin.y,
+                (corner_idx & 4) ? obj.bounds.pMax.z : obj.bounds.pMin.z,
+            };
+
+            Vector3 v = to_view * corner + view_translation;
+
+            num_outside[0] += v.y < view.zNear;
+            num_outside[1] += x_scale * v.x < -v.y;
+            num_outside[2] += x_scale * v.x > v.y;
+            num_outside[3] += y_scale * v.z < -v.y;
+            num_outside[4] += y_scale * v.z > v.y;
+
+            nearest_depth = fminf(nearest_depth, v.y);
+
+            if (v.y >= view.zNear) {
+                Vector2 ndc { x_scale * v.x / v.y, y_scale * v.z / v.y };
+                screen_min.x = fminf(screen_min.x, ndc.x);
+                screen_min.y = fminf(screen_min.y, ndc.y);
+                screen_max.x = fmaxf(screen_max.x, ndc.x);
+                screen_max.y = fmaxf(screen_max.y, ndc.y);
+            }
+        }
+
+        if (num_outside[0] == 8 || num_outside[1] == 8 ||
+                num_outside[2] == 8 || num_outside[3] == 8 ||
+                num_outside[4] == 8) {
+            continue;
+        }
+
+        // Projected size is only meaningful if the bounds are entirely in
+        // front of the near plane
+        if (minProjectedSize > 0.f && num_outside[0] == 0) {
+            float projected_size = fmaxf(
+                (screen_max.x - screen_min.x) * 0.5f * renderWidth,
+                (screen_max.y - screen_min.y) * 0.5f * renderHeight);
+
+            if (projected_size < minProjectedSize) {
+                continue;
+            }
+        }
+
+        view_scratch.visible.push_back({
+            .toView = to_view,
+            .viewTranslation = view_translation,
+            .nearestDepth = fmaxf(nearest_depth, view.zNear),
+            .instanceIdx = i,
+        });
+    }
+
+    // Front to back, so the per tile depth bounds reject as much as
+    // possible
+    std::sort(view_scratch.visible.begin(), view_scratch.visible.end(),
+              [](const VisibleInstance &a, const VisibleInstance &b) {
+        return a.nearestDepth < b.nearestDepth;
+    });
+}
+
+static void emitTriangle(ViewScratch &view_scratch,
+                         const PerspectiveCameraData &view,
+                         uint32_t num_tiles_x,
+                         int32_t width,
+                         int32_t height,
+                         Vector3 v0,
+                         Vector3 v1,
+                         Vector3 v2,
+                         uint32_t color)
+{
+    float xs[3], ys[3], inv_depths[3];
+    Vector3 verts[3] = { v0, v1, v2 };
+    for (int32_t i = 0; i < 3; i++) {
+        float inv_depth = 1.f / verts[i].y;
+        xs[i] = (0.5f + 0.5f * view.xScale * verts[i].x * inv_depth) * width;
+        ys[i] = (0.5f + 0.5f * view.yScale * verts[i].z * inv_depth) * height;
+        inv_depths[i] = inv_depth;
+    }
+
+    // Pixel centers are at integer + 0.5
+    float min_x = fminf(fminf(xs[0], xs[1]), xs[2]);
+    float max_x = fmaxf(fmaxf(xs[0], xs[1]), xs[2]);
+    float min_y = fminf(fminf(ys[0], ys[1]), ys[2]);
+    float max_y = fmaxf(fmaxf(ys[0], ys[1]), ys[2]);
+
+    int32_t px_min_x = (int32_t)ceilf(fmaxf(min_x - 0.5f, 0.f));
+    int32_t px_max_x = (int32_t)floorf(fminf(max_x - 0.5f, float(width - 1)));
+    int32_t px_min_y = (int32_t)ceilf(fmaxf(min_y - 0.5f, 0.f));
+    int32_t px_max_y =
+        (int32_t)floorf(fminf(max_y - 0.5f, float(height - 1)));
+
+    if (px_min_x > px_max_x || px_min_y > px_max_y) {
+        return;
+    }
+
+    ScreenTri tri;
+    for (int32_t i = 0; i < 3; i++) {
+        int32_t j = (i + 1) % 3;
+        int32_t k = (i + 2) % 3;
+
+        tri.edgeA[i] = ys[j] - ys[k];
+        tri.edgeB[i] = xs[k] - xs[j];
+        tri.edgeC[i] = xs[j] * ys[k] - xs[k] * ys[j];
+    }
+
+    // Edge 0 evaluated at vertex 0 is twice the signed area
+    float area = tri.edgeA[0] * xs[0] + tri.edgeB[0] * ys[0] + tri.edgeC[0];
+    if (fabsf(area) < 1e-8f) {
+        return;
+    }
+
+    // No backface culling, orient the edges so inside is positive
+    if (area < 0.f) {
+        for (int32_t i = 0; i < 3; i++) {
+            tri.edgeA[i] = -tri.edgeA[i];
+            tri.edgeB[i] = -tri.edgeB[i];
+            tri.edgeC[i] = -tri.edgeC[i];
+        }
+        area = -area;
+    }
+
+    // Edge i divided by the area is the barycentric weight of vertex i
+    float inv_area = 1.f / area;
+    tri.invDepthA = inv_area * (tri.edgeA[0] * inv_depths[0] +
+        tri.edgeA[1] * inv_depths[1] + tri.edgeA[2] * inv_depths[2]);
+    tri.invDepthB = inv_area * (tri.edgeB[0] * inv_depths[0] +
+        tri.edgeB[1] * inv_depths[1] + tri.edgeB[2] * inv_depths[2]);
+    tri.invDepthC = inv_area * (tri.edgeC[0] * inv_depths[0] +
+        tri.edgeC[1] * inv_depths[1] + tri.edgeC[2] * inv_depths[2]);
+    tri.maxInvDepth =
+        fmaxf(fmaxf(inv_depths[0], inv_depths[1]), inv_depths[2]);
+
+    tri.minX = px_min_x;
+    tri.minY = px_min_y;
+    tri.maxX = px_max_x;
+    tri.maxY = px_max_y;
+    tri.color = color;
+
+    uint32_t tri_idx = (uint32_t)view_scratch.tris.size();
+    view_scratch.tris.push_back(tri);
+
+    for (int32_t tile_y = px_min_y / tileSize;
+         tile_y <= px_max_y / tileSize; tile_y++) {
+        float tile_min_y = float(tile_y * tileSize) + 0.5f;
+        float tile_max_y = tile_min_y + float(tileSize - 1);
+
+        for (int32_t tile_x = px_min_x / tileSize;
+             tile_x <= px_max_x / tileSize; tile_x++) {
+            float tile_min_x = float(tile_x * tileSize) + 0.5f;
+            float tile_max_x = tile_min_x + float(tileSize - 1);
+
+            // Skip tiles entirely outside one edge, tested at the tile
+            // corner furthest inside that edge
+            bool outside = false;
+            for (int32_t i = 0; i < 3; i++) {
+                float x = tri.edgeA[i] >= 0.f ? tile_max_x : tile_min_x;
+                float y = tri.edgeB[i] >= 0.f ? tile_max_y : tile_min_y;
+
+                outside |= tri.edgeA[i] * x + tri.edgeB[i] * y +
+                    tri.edgeC[i] < 0.f;
+            }
+
+            if (!outside) {
+                view_scratch.tileBins[tile_y * num_tiles_x + tile_x]
+                    .push_back(tri_idx);
+            }
+        }
+    }
+}
+
+void CPURasterizer::Impl::setupTriangles(ViewScratch &view_scratch,
+                                         const PerspectiveCameraData &view)
+{
+    view_scratch.tris.clear();
+    for (DynArray<uint32_t> &bin : view_scratch.tileBins) {
+        bin.clear();
+    }
+
+    float z_near = view.zNear;
+
+    for (const VisibleInstance &visible : view_scratch.visible) {
+        const InstanceData &instance = curInstances[visible.instanceIdx];
+        const RasterObject &obj = objects[instance.objectID];
+
+        for (uint32_t mesh_idx = 0; mesh_idx < obj.numMeshes; mesh_idx++) {
+            const RasterMesh &mesh = meshes[obj.meshOffset + mesh_idx];
+
+            Vector3 base_color { 1.f, 1.f, 1.f };
+            if (instance.matID == -2) {
+                base_color = hexToRgb(instance.color);
+            } else {
+                int32_t mat_idx = instance.matID == -1 ?
+                    mesh.materialIdx : instance.matID;
+
+                if (mat_idx >= 0 && mat_idx < (int32_t)materialColors.size()) {
+                    base_color = materialColors[mat_idx];
+                }
+            }
+
+            view_scratch.viewVerts.clear();
+            for (uint32_t i = 0; i < mesh.numVertices; i++) {
+                view_scratch.viewVerts.push_back(
+                    visible.toView * positions[mesh.vertexOffset + i] +
+                    visible.viewTranslation);
+            }
+
+            const uint32_t *mesh_indices = &indices[mesh.indexOffset];
+            for (uint32_t tri_idx = 0; tri_idx < mesh.numTris; tri_idx++) {
+                Vector3 in_verts[3] = {
+                    view_scratch.viewVerts[mesh_indices[3 * tri_idx]],
+                    view_scratch.viewVerts[mesh_indices[3 * tri_idx + 1]],
+                    view_scratch.viewVerts[mesh_indices[3 * tri_idx + 2]],
+                };
+
+                if (in_verts[0].y < z_near && in_verts[1].y < z_near &&
+                        in_verts[2].y < z_near) {
+                    continue;
+                }
+
+                Vector3 normal = (in_verts[1] - in_verts[0]).cross(
+                    in_verts[2] - in_verts[0]);
+                float normal_len = normal.length();
+                if (normal_len == 0.f) {
+                    continue;
+                }
+                normal /= normal_len;
+
+                // Light the side facing the camera
+                if (dot(normal, in_verts[0]) > 0.f) {
+                    normal = -normal;
+                }
+
+                uint32_t color = missColor;
+                if (renderRGB) {
+                    float light = 0.f;
+                    for (Vector3 light_dir : view_scratch.viewLightDirs) {
+                        light += std::clamp(
+                            dot(normal, -light_dir), 0.f, 1.f);
+                    }
+
+                    color = linearToSRGB8(
+                        fmaxf(ambientLight, light) * base_color);
+                }
+
+                // Clip against the near plane, leaves up to 4 vertices
+                Vector3 clipped[4];
+                int32_t num_clipped = 0;
+                for (int32_t i = 0; i < 3; i++) {
+                    Vector3 a = in_verts[i];
+                    Vector3 b = in_verts[(i + 1) % 3];
+                    bool a_inside = a.y >= z_near;
+                    bool b_inside = b.y >= z_near;
+
+                    if (a_inside) {
+                        clipped[num_clipped++] = a;
+                    }
+
+                    if (a_inside != b_inside) {
+                        float t = (z_near - a.y) / (b.y - a.y);
+                        Vector3 v = a + t * (b - a);
+                        v.y = z_near;
+                        clipped[num_clipped++] = v;
+                    }
+                }
+
+                for (int32_t i = 1; i + 1 < num_clipped; i++) {
+                    emitTriangle(view_scratch, view, numTilesX,
+                                 (int32_t)renderWidth, (int32_t)renderHeight,
+                                 clipped[0], clipped[i], clipped[i + 1],
+                                 color);
+                }
+            }
+        }
+    }
+}
+
+void CPURasterizer::Impl::rasterizeTiles(ViewScratch &view_scratch,
+                                         uint32_t view_idx)
+{
+    const int32_t width = (int32_t)renderWidth;
+    const int32_t height = (int32_t)renderHeight;
+
+    uint64_t view_pixel_offset = (uint64_t)view_idx * width * height;
+    uint32_t *view_rgb_out = renderRGB ?
+        rgbOut.data() + view_pixel_offset : nullptr;
+    float *view_depth_out = depthOut.data() + view_pixel_offset;
+
+    for (int32_t tile_y = 0; tile_y < (int32_t)numTilesY; tile_y++) {
+        for (int32_t tile_x = 0; tile_x < (int32_t)numTilesX; tile_x++) {
+            const int32_t tile_x0 = tile_x * tileSize;
+            const int32_t tile_y0 = tile_y * tileSize;
+
+            // Inverse view depth, 0 means nothing was drawn
+            float tile_inv_depth[tilePixels];
+            uint32_t tile_color[tilePixels];
+            for (int32_t i = 0; i < tilePixels; i++) {
+                tile_inv_depth[i] = 0.f;
+                tile_color[i] = missColor;
+            }
+
+            float pixel_xs[tileSize];
+            for (int32_t i = 0; i < tileSize; i++) {
+                pixel_xs[i] = float(tile_x0 + i) + 0.5f;
+            }
+
+            // Farthest inverse depth in the tile
+            float tile_far_inv_depth = 0.f;
+
+            const DynArray<uint32_t> &bin =
+                view_scratch.tileBins[tile_y * numTilesX + tile_x];
+
+            for (uint32_t tri_idx : bin) {
+                const ScreenTri &tri = view_scratch.tris[tri_idx];
+
+                // Nearest point of the triangle is behind every pixel
+                if (tri.maxInvDepth < tile_far_inv_depth) {
+                    continue;
+                }
+
+                int32_t row_start = std::max(tri.minY - tile_y0, 0);
+                int32_t row_end = std::min(tri.maxY - tile_y0, tileSize - 1);
+
+                uint32_t written = 0;
+                for (int32_t row = row_start; row <= row_end; row++) {
+                    float pixel_y = float(tile_y0 + row) + 0.5f;
+
+                    float e0_row = tri.edgeB[0] * pixel_y + tri.edgeC[0];
+                    float e1_row = tri.edgeB[1] * pixel_y + tri.edgeC[1];
+                    float e2_row = tri.edgeB[2] * pixel_y + tri.edgeC[2];
+                    float z_row = tri.invDepthB * pixel_y + tri.invDepthC;
+
+                    float *depth_row = tile_inv_depth + row * tileSize;
+                    uint32_t *color_row = tile_color + row * tileSize;
+
+                    // Branch free so the compiler vectorizes the row
+                    uint32_t row_written = 0;
+                    for (int32_t i = 0; i < tileSize; i++) {
+                        float px = pixel_xs[i];
+                        float e0 = tri.edgeA[0] * px + e0_row;
+                        float e1 = tri.edgeA[1] * px + e1_row;
+                        float e2 = tri.edgeA[2] * px + e2_row;
+                        float z = tri.invDepthA * px + z_row;
+
+                        uint32_t pass = (e0 >= 0.f) & (e1 >= 0.f) &
+                            (e2 >= 0.f) & (z > depth_row[i]);
+
+                        depth_row[i] = pass ? z : depth_row[i];
+                        color_row[i] = pass ? tri.color : color_row[i];
+                        row_written |= pass;
+                    }
+
+                    written |= row_written;
+                }
+
+                if (written) {
+                    float far_inv_depth = tile_inv_depth[0];
+                    for (int32_t i = 1; i < tilePixels; i++) {
+                        far_inv_depth = fminf(far_inv_depth, tile_inv_depth[i]);
+                    }
+                    tile_far_inv_depth = far_inv_depth;
+                }
+            }
+
+            int32_t num_rows = std::min(tileSize, height - tile_y0);
+            int32_t num_cols = std::min(tileSize, width - tile_x0);
+            for (int32_t row = 0; row < num_rows; row++) {
+                uint64_t out_offset =
+                    (uint64_t)(tile_y0 + row) * width + tile_x0;
+
+                for (int32_t col = 0; col < num_cols; col++) {
+                    float inv_depth = tile_inv_depth[row * tileSize + col];
+                    view_depth_out[out_offset + col] =
+                        inv_depth > 0.f ? 1.f / inv_depth : 0.f;
+                }
+
+                if (view_rgb_out) {
+                    for (int32_t col = 0; col < num_cols; col++) {
+                        view_rgb_out[out_offset + col] =
+                            tile_color[row * tileSize + col];
+                    }
+                }
+            }
+        }
+    }
+}
+
+CPURasterizer::CPURasterizer(const Config &cfg)
+    : impl(std::make_unique<Impl>(cfg))
+{}
+
+CPURasterizer::~CPURasterizer() = default;
+
+void CPURasterizer::loadObjects(Span<const imp::SourceObject> src_objs,
+                                Span<const imp::SourceMaterial> src_mats)
+{
+    using namespace imp;
+
+    // Meshes sharing geometry (see imp::sharesGeometry) reference the
+    // vertex and index ranges of the first copy.
+    struct LoadedGeometry {
+        const SourceMesh *mesh;
+        RasterMesh rasterMesh;
+    };
+    std::unordered_map<const Vector3 *, LoadedGeometry> loaded_geometry;
+
+    for (const SourceObject &obj : src_objs) {
+        RasterObject raster_obj {
+            .meshOffset = (uint32_t)impl->meshes.size(),
+            .numMeshes = (uint32_t)obj.meshes.size(),
+            .bounds = AABB::invalid(),
+        };
+
+        for (const SourceMesh &mesh : obj.meshes) {
+            if (mesh.faceCounts != nullptr) {
+                FATAL("Render mesh isn't triangular");
+            }
+
+            for (uint32_t i = 0; i < mesh.numVertices; i++) {
+                raster_obj.bounds.expand(mesh.positions[i]);
+            }
+
+            RasterMesh raster_mesh;
+            auto iter = loaded_geometry.find(mesh.positions);
+            if (iter != loaded_geometry.end() &&
+                    sharesGeometry(mesh, *iter->second.mesh)) {
+                raster_mesh = iter->second.rasterMesh;
+            } else {
+                raster_mesh = {
+                    .vertexOffset = (uint32_t)impl->positions.size(),
+                    .numVertices = mesh.numVertices,
+                    .indexOffset = (uint32_t)impl->indices.size(),
+                    .numTris = mesh.numFaces,
+                    .materialIdx = -1,
+                };
+
+                for (uint32_t i = 0; i < mesh.numVertices; i++) {
+                    impl->positions.push_back(mesh.positions[i]);
+                }
+
+                for (uint32_t i = 0; i < mesh.numFaces * 3; i++) {
+                    impl->indices.push_back(mesh.indices[i]);
+                }
+
+                loaded_geometry.emplace(mesh.positions,
+                    LoadedGeometry { &mesh, raster_mesh });
+            }
+
+            raster_mesh.materialIdx = (int32_t)mesh.materialIDX;
+            impl->meshes.push_back(raster_mesh);
+        }
+
+        impl->objects.push_back(raster_obj);
+    }
+
+    for (const SourceMaterial &mat : src_mats) {
+        impl->materialColors.push_back(
+            Vector3 { mat.color.x, mat.color.y, mat.color.z });
+    }
+}
+
+void CPURasterizer::configureLighting(Span<const LightConfig> lights)
+{
+    impl->lightDirs.clear();
+
+    for (const LightConfig &light : lights) {
+        if (light.isDirectional) {
+            impl->lightDirs.push_back(light.dir.normalize());
+        }
+    }
+}
+
+void CPURasterizer::renderViews(const EngineInterop &interop)
+{
+    impl->curViews = (const PerspectiveCameraData *)interop.viewsCPU->ptr;
+    impl->curViewWorldIDs = interop.sortedViewWorldIDs;
+    impl->curInstances = (const InstanceData *)interop.instancesCPU->ptr;
+    impl->curInstanceWorldIDs = interop.sortedInstanceWorldIDs;
+    impl->curNumViews = *interop.bridge.totalNumViews;
+    impl->curNumInstances = *interop.bridge.totalNumInstances;
+
+    impl->nextView.store_relaxed(0);
+    impl->numFinished.store_relaxed(0);
+    impl->runCounter += 1;
+    impl->workerWakeup.store_release((impl->runCounter << 32) | 1);
+    impl->workerWakeup.notify_all();
+
+    impl->renderAvailableViews(impl->scratch[0]);
+
+    // Every worker checks out once per run, so none of them is still
+    // reading the inputs above when this returns
+    uint32_t num_workers = (uint32_t)impl->workers.size();
+    uint32_t num_finished;
+    while ((num_finished = impl->numFinished.load_acquire()) != num_workers) {
+        impl->numFinished.wait<sync::acquire>(num_finished);
+    }
+}
+
+const uint8_t * CPURasterizer::getRGBOut() const
+{
+    return impl->renderRGB ? (const uint8_t *)impl->rgbOut.data() : nullptr;
+}
+
+const float * CPURasterizer::getDepthOut() const
+{
+    return impl->depthOut.data();
+}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <madrona/importer.hpp>
+#include <madrona/render/render_mgr.hpp>
+
+#include <memory>
+
+namespace madrona::render {
+
+struct EngineInterop;
+
+// Triangle rasterizer for the CPU backend, meant for the small agent views
+// (64x64 - 128x128) used in training, where keeping everything on the CPU
+// beats the round trip through the Vulkan batch renderer.
+//
+// Each view is rendered start to finish by one thread: instances are
+// frustum culled against their object bounds and sorted front to back,
+// triangles are clipped against the near plane and binned into 8x8 pixel
+// tiles, then every tile is rasterized into a local buffer with a per tile
+// farthest depth used to reject occluded triangles early. Shading is flat
+// Lambert with the material (or instance) color; textures are ignored.
+//
+// Output matches the batch renderer layout: view i of the world sorted view
+// list occupies [i * width * height, (i + 1) * width * height) of the RGBA8
+// and depth outputs. Pixels that hit nothing are opaque black with depth 0.
+struct CPURasterizer {
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+
+    struct Config {
+        RenderManager::Config::RenderMode renderMode;
+        uint32_t renderWidth;
+        uint32_t renderHeight;
+        uint32_t numWorlds;
+        uint32_t maxViewsPerWorld;
+
+        // Size of the rasterizer's own thread pool, including the thread
+        // calling renderViews. Its workers sleep outside renderViews, but
+        // they are separate from the executor's, so keep the total within
+        // the core count. 0 picks min(4, cores).
+        uint32_t numThreads;
+
+        // Instances whose projected bounds are smaller than this many
+        // pixels on screen are skipped.
+        float minProjectedSize;
+    };
+
+    CPURasterizer(const Config &cfg);
+    ~CPURasterizer();
+
+    void loadObjects(Span<const imp::SourceObject> src_objs,
+                     Span<const imp::SourceMaterial> src_mats);
+
+    // Only directional lights are used
+    void configureLighting(Span<const LightConfig> lights);
+
+    // Renders the views sorted into the interop's CPU buffers by
+    // prepareECSOutputCPU.
+    void renderViews(const EngineInterop &interop);
+
+    const uint8_t * getRGBOut() const;
+    const float * getDepthOut() const;
+};
+
+}
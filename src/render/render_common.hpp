@@ -5,6 +5,7 @@
 #include <madrona/dyn_array.hpp>
 
 #include <cstdint>
+#include <mutex>
 
 #include "vk/memory.hpp"
 #include "vk/descriptors.hpp"
@@ -101,6 +102,34 @@ struct AssetData {
     VkDescriptorSet aabbSet;
 };
 
+// Copy of the CPU backend's ECS render output, taken right after a step.
+struct ECSSnapshot {
+    InstanceData *instances;
+    PerspectiveCameraData *views;
+    uint64_t *instanceWorldIDs;
+    uint64_t *viewWorldIDs;
+    uint32_t numInstances;
+    uint32_t numViews;
+};
+
+// When the simulation steps on a different thread than the renderer,
+// RenderManager::readECS only publishes a snapshot of the ECS output and
+// the render thread picks up the latest published one at its own rate.
+// The simulation writes into writeIdx and swaps it with readyIdx once done;
+// the renderer swaps readyIdx with readIdx when a new snapshot is present.
+// Neither side ever waits on the other for more than the swap.
+struct AsyncECSSnapshots {
+    std::mutex lock;
+    ECSSnapshot slots[3];
+    uint32_t writeIdx;
+    uint32_t readyIdx;
+    uint32_t readIdx;
+    bool hasNewSnapshot;
+
+    // If >= 0, only this world's instances and views are snapshotted
+    AtomicI32 followWorld;
+};
+
 struct EngineInterop {
     Optional<render::vk::HostBuffer> viewsCPU;
     Optional<render::vk::HostBuffer> viewOffsetsCPU;
@@ -155,6 +184,9 @@ struct EngineInterop {
     // We need the sorted instance world IDs in order to compute the instance offsets
     uint64_t *sortedInstanceWorldIDs;
     uint64_t *sortedViewWorldIDs;
+
+    // Only set if async ECS readback was enabled (CPU backend only)
+    AsyncECSSnapshots *asyncSnapshots;
 };
 
 struct ShadowOffsets {
@@ -3,6 +3,7 @@
 #include <span>
 #include <array>
 #include <string_view>
+#include <unordered_map>
 #include <filesystem>
 
 #include <madrona/render/vk/backend.hpp>
@@ -871,7 +872,8 @@ static EngineInterop setupEngineInterop(Device &dev,
         iota_array_instances,
         iota_array_views,
         sorted_instance_world_ids,
-        sorted_view_world_ids
+        sorted_view_world_ids,
+        nullptr,
     };
 }
 
@@ -1451,11 +1453,40 @@ RenderContext::RenderContext(
     };
 
     batchRenderer = std::make_unique<BatchRenderer>(br_cfg, *this);
+
+    if (cfg.useCPURasterizer) {
+        if (gpu_input_) {
+            FATAL("The CPU rasterizer is only supported with the CPU backend");
+        }
+
+        CPURasterizer::Config raster_cfg = {
+            .renderMode = cfg.renderMode,
+            .renderWidth = br_width_,
+            .renderHeight = br_height_,
+            .numWorlds = cfg.numWorlds,
+            .maxViewsPerWorld = cfg.maxViewsPerWorld,
+            .numThreads = cfg.numCPURasterThreads,
+            .minProjectedSize = cfg.cpuRasterMinProjectedSize,
+        };
+
+        cpuRasterizer = std::make_unique<CPURasterizer>(raster_cfg);
+    }
 }
 
 RenderContext::~RenderContext()
 {
     waitForIdle();
+
+    if (engine_interop_.asyncSnapshots) {
+        for (ECSSnapshot &slot : engine_interop_.asyncSnapshots->slots) {
+            free(slot.instances);
+            free(slot.views);
+            free(slot.instanceWorldIDs);
+            free(slot.viewWorldIDs);
+        }
+
+        delete engine_interop_.asyncSnapshots;
+    }
     
     loaded_assets_.clear();
 
@@ -1505,6 +1536,39 @@ RenderContext::~RenderContext()
     dev.dt.destroyPipelineCache(dev.hdl, pipelineCache, nullptr);
 }
 
+// One copy per mip level, the levels are packed back to back in the
+// staging buffer in the same layout as the SourceTexture
+static DynArray<VkBufferImageCopy> textureLevelCopies(
+    const imp::SourceTexture &tx)
+{
+    DynArray<VkBufferImageCopy> copies(tx.numLevels);
+
+    VkDeviceSize offset = 0;
+    for (uint32_t level = 0; level < tx.numLevels; level++) {
+        uint32_t level_width = max(tx.width >> level, 1u);
+        uint32_t level_height = max(tx.height >> level, 1u);
+
+        VkBufferImageCopy copy = {};
+        copy.bufferOffset = offset;
+        copy.bufferRowLength = 0;
+        copy.bufferImageHeight = 0;
+        copy.imageExtent.width = level_width;
+        copy.imageExtent.height = level_height;
+        copy.imageExtent.depth = 1;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.mipLevel = level;
+        copy.imageSubresource.baseArrayLayer = 0;
+        copy.imageSubresource.layerCount = 1;
+
+        copies.push_back(copy);
+
+        offset += imp::sourceTextureLevelBytes(
+            tx.format, level_width, level_height);
+    }
+
+    return copies;
+}
+
 static DynArray<MaterialTexture> loadTextures(
     const vk::Device &dev, MemoryAllocator &alloc, VkQueue queue,
     Span<const imp::SourceTexture> textures)
@@ -1535,7 +1599,7 @@ static DynArray<MaterialTexture> loadTextures(
                      height = tx.height;
 
             auto [texture, texture_reqs] = alloc.makeTexture2D(
-                    width, height, 1, VK_FORMAT_BC7_UNORM_BLOCK);
+                    width, height, tx.numLevels, VK_FORMAT_BC7_UNORM_BLOCK);
 
             HostBuffer texture_hb_staging = alloc.makeStagingBuffer(texture_reqs.size);
             memcpy(texture_hb_staging.ptr, pixel_data, pixel_data_size);
@@ -1559,7 +1623,7 @@ static DynArray<MaterialTexture> loadTextures(
                     texture.image,
                     {
                         VK_IMAGE_ASPECT_COLOR_BIT,
-                        0, 1, 0, 1
+                        0, tx.numLevels, 0, 1
                     },
             };
 
@@ -1570,20 +1634,12 @@ static DynArray<MaterialTexture> loadTextures(
                     0, nullptr, 0, nullptr,
                     1, &copy_prepare);
 
-            VkBufferImageCopy copy = {};
-            copy.bufferOffset = 0;
-            copy.bufferRowLength = 0;
-            copy.bufferImageHeight = 0;
-            copy.imageExtent.width = width;
-            copy.imageExtent.height = height;
-            copy.imageExtent.depth = 1;
-            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copy.imageSubresource.mipLevel = 0;
-            copy.imageSubresource.baseArrayLayer = 0;
-            copy.imageSubresource.layerCount = 1;
+            DynArray<VkBufferImageCopy> copies =
+                textureLevelCopies(tx);
 
             dev.dt.cmdCopyBufferToImage(cmdbuf, texture_hb_staging.buffer,
-                    texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+                    texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    (uint32_t)copies.size(), copies.data());
 
             VkImageMemoryBarrier finish_prepare {
                 VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -1597,7 +1653,7 @@ static DynArray<MaterialTexture> loadTextures(
                     texture.image,
                     {
                         VK_IMAGE_ASPECT_COLOR_BIT,
-                        0, 1, 0, 1
+                        0, tx.numLevels, 0, 1
                     },
             };
 
@@ -1615,7 +1671,7 @@ static DynArray<MaterialTexture> loadTextures(
             VkImageSubresourceRange &view_info_sr = view_info.subresourceRange;
             view_info_sr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             view_info_sr.baseMipLevel = 0;
-            view_info_sr.levelCount = 1;
+            view_info_sr.levelCount = tx.numLevels;
             view_info_sr.baseArrayLayer = 0;
             view_info_sr.layerCount = 1;
 
@@ -1632,10 +1688,10 @@ static DynArray<MaterialTexture> loadTextures(
             uint32_t height = tx.height;
 
             auto [texture, texture_reqs] = alloc.makeTexture2D(
-                    width, height, 1, VK_FORMAT_R8G8B8A8_SRGB);
+                    width, height, tx.numLevels, VK_FORMAT_R8G8B8A8_SRGB);
 
             HostBuffer texture_hb_staging = alloc.makeStagingBuffer(texture_reqs.size);
-            memcpy(texture_hb_staging.ptr, pixels, width * height * 4 * sizeof(char));
+            memcpy(texture_hb_staging.ptr, pixels, tx.numBytes);
             texture_hb_staging.flush(dev);
 
             std::optional<VkDeviceMemory> texture_backing = alloc.alloc(texture_reqs.size);
@@ -1656,7 +1712,7 @@ static DynArray<MaterialTexture> loadTextures(
                     texture.image,
                     {
                         VK_IMAGE_ASPECT_COLOR_BIT,
-                        0, 1, 0, 1
+                        0, tx.numLevels, 0, 1
                     },
             };
 
@@ -1667,20 +1723,12 @@ static DynArray<MaterialTexture> loadTextures(
                     0, nullptr, 0, nullptr,
                     1, &copy_prepare);
 
-            VkBufferImageCopy copy = {};
-            copy.bufferOffset = 0;
-            copy.bufferRowLength = 0;
-            copy.bufferImageHeight = 0;
-            copy.imageExtent.width = width;
-            copy.imageExtent.height = height;
-            copy.imageExtent.depth = 1;
-            copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copy.imageSubresource.mipLevel = 0;
-            copy.imageSubresource.baseArrayLayer = 0;
-            copy.imageSubresource.layerCount = 1;
+            DynArray<VkBufferImageCopy> copies =
+                textureLevelCopies(tx);
 
             dev.dt.cmdCopyBufferToImage(cmdbuf, texture_hb_staging.buffer,
-                    texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+                    texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    (uint32_t)copies.size(), copies.data());
 
             VkImageMemoryBarrier finish_prepare {
                 VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -1694,7 +1742,7 @@ static DynArray<MaterialTexture> loadTextures(
                     texture.image,
                     {
                         VK_IMAGE_ASPECT_COLOR_BIT,
-                        0, 1, 0, 1
+                        0, tx.numLevels, 0, 1
                     },
             };
 
@@ -1712,7 +1760,7 @@ static DynArray<MaterialTexture> loadTextures(
             VkImageSubresourceRange &view_info_sr = view_info.subresourceRange;
             view_info_sr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             view_info_sr.baseMipLevel = 0;
-            view_info_sr.levelCount = 1;
+            view_info_sr.levelCount = tx.numLevels;
             view_info_sr.baseArrayLayer = 0;
             view_info_sr.layerCount = 1;
 
@@ -1761,10 +1809,35 @@ CountT RenderContext::loadObjects(Span<const imp::SourceObject> src_objs,
 
     assert(loaded_assets_.size() == 0);
 
+    if (cpuRasterizer) {
+        cpuRasterizer->loadObjects(src_objs, src_mats);
+    }
+
     int64_t num_total_vertices = 0;
     int64_t num_total_indices = 0;
     int64_t num_total_meshes = 0;
 
+    // Meshes sharing geometry (see imp::sharesGeometry) reference the
+    // vertex and index ranges of the first upload.
+    struct UploadedGeometry {
+        const SourceMesh *mesh;
+        int32_t vertexOffset;
+        int32_t indexOffset;
+    };
+    std::unordered_map<const Vector3 *, UploadedGeometry> uploaded_geometry;
+
+    auto findUploaded = [&uploaded_geometry](const SourceMesh &mesh)
+        -> UploadedGeometry *
+    {
+        auto iter = uploaded_geometry.find(mesh.positions);
+        if (iter == uploaded_geometry.end() ||
+                !sharesGeometry(mesh, *iter->second.mesh)) {
+            return nullptr;
+        }
+
+        return &iter->second;
+    };
+
     for (const SourceObject &obj : src_objs) {
         num_total_meshes += obj.meshes.size();
 
@@ -1773,6 +1846,13 @@ CountT RenderContext::loadObjects(Span<const imp::SourceObject> src_objs,
                 FATAL("Render mesh isn't triangular");
             }
 
+            if (findUploaded(mesh) != nullptr) {
+                continue;
+            }
+
+            uploaded_geometry.emplace(mesh.positions,
+                UploadedGeometry { &mesh, -1, -1 });
+
             num_total_vertices += mesh.numVertices;
             num_total_indices += mesh.numFaces * 3;
         }
@@ -1843,15 +1923,30 @@ CountT RenderContext::loadObjects(Span<const imp::SourceObject> src_objs,
             int32_t num_mesh_verts = (int32_t)mesh.numVertices;
             int32_t num_mesh_indices = (int32_t)mesh.numFaces * 3;
 
+            UploadedGeometry *uploaded = findUploaded(mesh);
+            bool already_uploaded = uploaded != nullptr &&
+                uploaded->vertexOffset != -1;
+
             MeshData mesh_data = MeshData {};
-            mesh_data.vertexOffset = vertex_offset;
+            mesh_data.vertexOffset = already_uploaded ?
+                uploaded->vertexOffset : vertex_offset;
             mesh_data.numVertices = num_mesh_verts;
-            mesh_data.indexOffset = index_offset;
+            mesh_data.indexOffset = already_uploaded ?
+                uploaded->indexOffset : index_offset;
             mesh_data.numIndices = num_mesh_indices;
             mesh_data.materialIndex = (int32_t)material_idx;
 
             mesh_ptr[mesh_offset++] = mesh_data;
 
+            if (already_uploaded) {
+                continue;
+            }
+
+            if (uploaded != nullptr) {
+                uploaded->vertexOffset = vertex_offset;
+                uploaded->indexOffset = index_offset;
+            }
+
             // Compute new normals
             auto new_normals = Optional<HeapArray<Vector3>>::none();
             if (!mesh.normals) {
@@ -2136,6 +2231,10 @@ void RenderContext::configureLighting(Span<const LightConfig> lights)
             math::Vector4{lights[i].color.x, lights[i].color.y, lights[i].color.z, 1.0f}
         });
     }
+
+    if (cpuRasterizer) {
+        cpuRasterizer->configureLighting(lights);
+    }
 }
 
 void RenderContext::waitForIdle()
@@ -2143,4 +2242,124 @@ void RenderContext::waitForIdle()
     dev.dt.deviceWaitIdle(dev.hdl);
 }
 
+void RenderContext::enableAsyncECSReadback()
+{
+    if (gpu_input_) {
+        FATAL("Async ECS readback is only supported with the CPU backend");
+    }
+
+    if (cpuRasterizer) {
+        FATAL("Async ECS readback is not supported with the CPU rasterizer");
+    }
+
+    if (engine_interop_.asyncSnapshots) {
+        return;
+    }
+
+    const uint64_t max_instances =
+        (uint64_t)num_worlds_ * engine_interop_.maxInstancesPerWorld;
+    const uint64_t max_views =
+        (uint64_t)num_worlds_ * engine_interop_.maxViewsPerWorld;
+
+    auto snapshots = new AsyncECSSnapshots {
+        .lock {},
+        .slots {},
+        .writeIdx = 0,
+        .readyIdx = 1,
+        .readIdx = 2,
+        .hasNewSnapshot = false,
+        .followWorld = -1,
+    };
+
+    for (ECSSnapshot &slot : snapshots->slots) {
+        slot.instances =
+            (InstanceData *)malloc(sizeof(InstanceData) * max_instances);
+        slot.views = (PerspectiveCameraData *)malloc(
+            sizeof(PerspectiveCameraData) * max_views);
+        slot.instanceWorldIDs =
+            (uint64_t *)malloc(sizeof(uint64_t) * max_instances);
+        slot.viewWorldIDs = (uint64_t *)malloc(sizeof(uint64_t) * max_views);
+        slot.numInstances = 0;
+        slot.numViews = 0;
+    }
+
+    engine_interop_.asyncSnapshots = snapshots;
+}
+
+void RenderContext::publishECSSnapshot()
+{
+    AsyncECSSnapshots &snapshots = *engine_interop_.asyncSnapshots;
+    const RenderECSBridge &bridge = engine_interop_.bridge;
+
+    uint32_t num_instances =
+        bridge.totalNumInstancesCPUInc->load_acquire();
+    uint32_t num_views = bridge.totalNumViewsCPUInc->load_acquire();
+
+    bridge.totalNumInstancesCPUInc->store_release(0);
+    bridge.totalNumViewsCPUInc->store_release(0);
+
+    ECSSnapshot &dst = snapshots.slots[snapshots.writeIdx];
+    int32_t follow_world = snapshots.followWorld.load_relaxed();
+
+    if (follow_world < 0) {
+        memcpy(dst.instances, bridge.instances,
+               sizeof(InstanceData) * num_instances);
+        memcpy(dst.instanceWorldIDs, bridge.instancesWorldIDs,
+               sizeof(uint64_t) * num_instances);
+        memcpy(dst.views, bridge.views,
+               sizeof(PerspectiveCameraData) * num_views);
+        memcpy(dst.viewWorldIDs, bridge.viewsWorldIDs,
+               sizeof(uint64_t) * num_views);
+
+        dst.numInstances = num_instances;
+        dst.numViews = num_views;
+    } else {
+        uint32_t num_dst_instances = 0;
+        for (uint32_t i = 0; i < num_instances; i++) {
+            uint64_t world_id = bridge.instancesWorldIDs[i];
+            if ((int32_t)(world_id >> 32) != follow_world) {
+                continue;
+            }
+
+            dst.instances[num_dst_instances] = bridge.instances[i];
+            dst.instanceWorldIDs[num_dst_instances] = world_id;
+            num_dst_instances++;
+        }
+
+        uint32_t num_dst_views = 0;
+        for (uint32_t i = 0; i < num_views; i++) {
+            uint64_t world_id = bridge.viewsWorldIDs[i];
+            if ((int32_t)(world_id >> 32) != follow_world) {
+                continue;
+            }
+
+            dst.views[num_dst_views] = bridge.views[i];
+            dst.viewWorldIDs[num_dst_views] = world_id;
+            num_dst_views++;
+        }
+
+        dst.numInstances = num_dst_instances;
+        dst.numViews = num_dst_views;
+    }
+
+    std::lock_guard lock(snapshots.lock);
+    std::swap(snapshots.writeIdx, snapshots.readyIdx);
+    snapshots.hasNewSnapshot = true;
+}
+
+bool RenderContext::acquireECSSnapshot()
+{
+    AsyncECSSnapshots &snapshots = *engine_interop_.asyncSnapshots;
+
+    std::lock_guard lock(snapshots.lock);
+    if (!snapshots.hasNewSnapshot) {
+        return false;
+    }
+
+    std::swap(snapshots.readyIdx, snapshots.readIdx);
+    snapshots.hasNewSnapshot = false;
+
+    return true;
+}
+
 }
@@ -3,6 +3,7 @@
 #include <madrona/render/render_mgr.hpp>
 
 #include "batch_renderer.hpp"
+#include "cpu_rasterizer.hpp"
 
 namespace madrona::render {
 
@@ -22,6 +23,14 @@ struct RenderContext {
 
     void waitForIdle();
 
+    // Async ECS readback (CPU backend only): publishECSSnapshot is called
+    // on the simulation thread after each step, acquireECSSnapshot on the
+    // render thread. acquireECSSnapshot returns false if nothing new was
+    // published since the last call.
+    void enableAsyncECSReadback();
+    void publishECSSnapshot();
+    bool acquireECSSnapshot();
+
     vk::Backend &backend;
     vk::Device &dev;
     vk::MemoryAllocator alloc;
@@ -66,6 +75,8 @@ struct RenderContext {
 
     uint32_t num_worlds_;
     std::unique_ptr<BatchRenderer> batchRenderer;
+    // Replaces batchRenderer for agent views if useCPURasterizer was set
+    std::unique_ptr<CPURasterizer> cpuRasterizer;
 
     VkDescriptorSetLayout asset_layout_;
     VkDescriptorSetLayout asset_tex_layout_;
@@ -36,6 +36,17 @@ RenderManager::~RenderManager() = default;
 
 void RenderManager::readECS()
 {
+    if (rctx_->cpuRasterizer) {
+        prepareECSOutputCPU(&rctx_->engine_interop_, rctx_->num_worlds_);
+        return;
+    }
+
+    if (rctx_->engine_interop_.asyncSnapshots) {
+        // The renderer will pick this up on its own thread
+        rctx_->publishECSSnapshot();
+        return;
+    }
+
     uint32_t cur_num_views = *rctx_->engine_interop_.bridge.totalNumViews;
     uint32_t cur_num_instances = *rctx_->engine_interop_.bridge.totalNumInstances;
 
@@ -50,6 +61,11 @@ void RenderManager::readECS()
 
 void RenderManager::batchRender()
 {
+    if (rctx_->cpuRasterizer) {
+        rctx_->cpuRasterizer->renderViews(rctx_->engine_interop_);
+        return;
+    }
+
     uint32_t cur_num_views = *rctx_->engine_interop_.bridge.totalNumViews;
     uint32_t cur_num_instances = *rctx_->engine_interop_.bridge.totalNumInstances;
 
@@ -66,11 +82,19 @@ void RenderManager::batchRender()
 
 const uint8_t * RenderManager::batchRendererRGBOut() const
 {
+    if (rctx_->cpuRasterizer) {
+        return rctx_->cpuRasterizer->getRGBOut();
+    }
+
     return rctx_->batchRenderer->getRGBCUDAPtr();
 }
 
 const float * RenderManager::batchRendererDepthOut() const
 {
+    if (rctx_->cpuRasterizer) {
+        return rctx_->cpuRasterizer->getDepthOut();
+    }
+
     return rctx_->batchRenderer->getDepthCUDAPtr();
 }
 
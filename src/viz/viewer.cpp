@@ -2,6 +2,7 @@
 #include <madrona/stack_alloc.hpp>
 #include <madrona/utils.hpp>
 #include <madrona/math.hpp>
+#include <madrona/sync.hpp>
 
 #include "viewer_common.hpp"
 #include "viewer_renderer.hpp"
@@ -11,6 +12,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <thread>
+#include <mutex>
 #include <algorithm>
 
 using namespace std;
@@ -40,7 +42,9 @@ struct Viewer::Impl {
     uint32_t maxNumAgents;
     int32_t simTickRate;
     float cameraMoveSpeed;
-    bool shouldExit;
+    bool asyncSimulation;
+    bool followSelectedWorld;
+    AtomicU32 shouldExit;
 
     inline Impl(const render::RenderManager &render_mgr,
                 const Window *window,
@@ -63,6 +67,16 @@ struct Viewer::Impl {
         void *agent_input_data,
         void (*step_fn)(void *), void *step_data,
         void (*ui_fn)(void *), void *ui_data);
+
+    // Steps the simulation on its own thread, see
+    // Viewer::Config::asyncSimulation
+    inline void asyncLoop(
+        void (*world_input_fn)(void *, CountT, const UserInput &),
+        void *world_input_data,
+        void (*agent_input_fn)(void *, CountT, CountT, const UserInput &),
+        void *agent_input_data,
+        void (*step_fn)(void *), void *step_data,
+        void (*ui_fn)(void *), void *ui_data);
 };
 
 static void handleCamera(GLFWwindow *window,
@@ -545,8 +559,14 @@ Viewer::Impl::Impl(
           render_mgr.renderContext().engine_interop_.maxViewsPerWorld),
       simTickRate(cfg.simTickRate),
       cameraMoveSpeed(cfg.cameraMoveSpeed),
-      shouldExit(false)
-{}
+      asyncSimulation(cfg.asyncSimulation),
+      followSelectedWorld(cfg.followSelectedWorld),
+      shouldExit(0)
+{
+    if (asyncSimulation) {
+        renderer.enableAsyncECSReadback();
+    }
+}
 
 void Viewer::Impl::render(float frame_duration)
 {
@@ -564,20 +584,9 @@ Viewer::UserInput::UserInput(bool *keys_state, bool *press_state)
     : keys_state_(keys_state), press_state_(press_state)
 {}
 
-void Viewer::Impl::loop(
-    void (*world_input_fn)(void *, CountT, const UserInput &),
-    void *world_input_data,
-    void (*agent_input_fn)(void *, CountT, CountT, const UserInput &),
-    void *agent_input_data,
-    void (*step_fn)(void *), void *step_data,
-    void (*ui_fn)(void *), void *ui_data)
+static std::array<int, (size_t)Viewer::KeyboardKey::NumKeys> getGLFWKeys()
 {
-    GLFWwindow *window = renderer.osWindow();
-
-    std::array<bool, (size_t)KeyboardKey::NumKeys> key_state;
-    std::array<bool, (size_t)KeyboardKey::NumKeys> press_state;
-    std::array<bool, (size_t)KeyboardKey::NumKeys> prev_key_state;
-    utils::zeroN<bool>(prev_key_state.data(), prev_key_state.size());
+    using KeyboardKey = Viewer::KeyboardKey;
 
     std::array<int, (size_t)KeyboardKey::NumKeys> glfw_keys;
 #define SETGLFWKEY(KB) \
@@ -626,9 +635,37 @@ void Viewer::Impl::loop(
     glfw_keys[(size_t)KeyboardKey::Shift] = GLFW_KEY_LEFT_SHIFT;
     glfw_keys[(size_t)KeyboardKey::Space] = GLFW_KEY_SPACE;
 
+    return glfw_keys;
+}
+
+void Viewer::Impl::loop(
+    void (*world_input_fn)(void *, CountT, const UserInput &),
+    void *world_input_data,
+    void (*agent_input_fn)(void *, CountT, CountT, const UserInput &),
+    void *agent_input_data,
+    void (*step_fn)(void *), void *step_data,
+    void (*ui_fn)(void *), void *ui_data)
+{
+    if (asyncSimulation) {
+        asyncLoop(world_input_fn, world_input_data,
+                  agent_input_fn, agent_input_data,
+                  step_fn, step_data, ui_fn, ui_data);
+        return;
+    }
+
+    GLFWwindow *window = renderer.osWindow();
+
+    std::array<bool, (size_t)KeyboardKey::NumKeys> key_state;
+    std::array<bool, (size_t)KeyboardKey::NumKeys> press_state;
+    std::array<bool, (size_t)KeyboardKey::NumKeys> prev_key_state;
+    utils::zeroN<bool>(prev_key_state.data(), prev_key_state.size());
+
+    std::array<int, (size_t)KeyboardKey::NumKeys> glfw_keys =
+        getGLFWKeys();
+
     float frame_duration = InternalConfig::secondsPerFrame;
     auto last_sim_tick_time = chrono::steady_clock::now();
-    while (!glfwWindowShouldClose(window) && !shouldExit) {
+    while (!glfwWindowShouldClose(window) && !shouldExit.load_acquire()) {
         utils::zeroN<bool>(key_state.data(), key_state.size());
         utils::zeroN<bool>(press_state.data(), press_state.size());
 
@@ -675,6 +712,133 @@ void Viewer::Impl::loop(
     renderer.waitForIdle();
 }
 
+void Viewer::Impl::asyncLoop(
+    void (*world_input_fn)(void *, CountT, const UserInput &),
+    void *world_input_data,
+    void (*agent_input_fn)(void *, CountT, CountT, const UserInput &),
+    void *agent_input_data,
+    void (*step_fn)(void *), void *step_data,
+    void (*ui_fn)(void *), void *ui_data)
+{
+    using KeyArray = std::array<bool, (size_t)KeyboardKey::NumKeys>;
+
+    GLFWwindow *window = renderer.osWindow();
+    std::array<int, (size_t)KeyboardKey::NumKeys> glfw_keys =
+        getGLFWKeys();
+
+    // Everything the simulation thread needs from the UI. Key hits are
+    // accumulated until the simulation consumes them so none are dropped
+    // when the render and simulation rates differ.
+    struct {
+        std::mutex lock;
+        KeyArray keyState;
+        KeyArray pressState;
+        uint32_t worldIdx;
+        uint32_t controlIdx;
+        int32_t tickRate;
+    } shared;
+
+    utils::zeroN<bool>(shared.keyState.data(), shared.keyState.size());
+    utils::zeroN<bool>(shared.pressState.data(), shared.pressState.size());
+    shared.worldIdx = vizCtrl.worldIdx;
+    shared.controlIdx = vizCtrl.controlIdx;
+    shared.tickRate = simTickRate;
+
+    AtomicU32 sim_exit(0);
+
+    std::thread sim_thread([&]() {
+        KeyArray key_state;
+        KeyArray press_state;
+
+        auto last_sim_tick_time = chrono::steady_clock::now();
+        while (!sim_exit.load_acquire()) {
+            uint32_t world_idx, control_idx;
+            int32_t tick_rate;
+            {
+                std::lock_guard lock(shared.lock);
+                key_state = shared.keyState;
+                press_state = shared.pressState;
+                utils::zeroN<bool>(shared.pressState.data(),
+                                   shared.pressState.size());
+
+                world_idx = shared.worldIdx;
+                control_idx = shared.controlIdx;
+                tick_rate = shared.tickRate;
+            }
+
+            // In async mode a tick rate of 0 means unthrottled
+            if (tick_rate > 0) {
+                auto sim_delta_t = chrono::duration_cast<
+                    chrono::steady_clock::duration>(
+                        chrono::duration<float>(1.f / (float)tick_rate));
+
+                this_thread::sleep_until(last_sim_tick_time + sim_delta_t);
+            }
+            last_sim_tick_time = chrono::steady_clock::now();
+
+            UserInput user_input(key_state.data(), press_state.data());
+
+            world_input_fn(world_input_data, world_idx, user_input);
+
+            if (control_idx != 0) {
+                agent_input_fn(agent_input_data, world_idx,
+                               control_idx - 1, user_input);
+            }
+
+            step_fn(step_data);
+        }
+    });
+
+    KeyArray key_state;
+    KeyArray prev_key_state;
+    utils::zeroN<bool>(prev_key_state.data(), prev_key_state.size());
+
+    float frame_duration = InternalConfig::secondsPerFrame;
+    while (!glfwWindowShouldClose(window) && !shouldExit.load_acquire()) {
+        {
+            std::lock_guard lock(shared.lock);
+
+            for (CountT i = 0; i < (CountT)KeyboardKey::NumKeys; i++) {
+                key_state[i] =
+                    glfwGetKey(window, glfw_keys[i]) == GLFW_PRESS;
+                shared.keyState[i] = key_state[i];
+                shared.pressState[i] |= !prev_key_state[i] && key_state[i];
+            }
+
+            shared.worldIdx = vizCtrl.worldIdx;
+            shared.controlIdx = vizCtrl.controlIdx;
+            shared.tickRate = simTickRate;
+        }
+        prev_key_state = key_state;
+
+        renderer.setSnapshotWorld(
+            followSelectedWorld ? (int32_t)vizCtrl.worldIdx : -1);
+
+        if (vizCtrl.controlIdx == 0) {
+            handleCamera(window, vizCtrl.flyCam, cameraMoveSpeed);
+        }
+
+        auto cur_frame_start_time = chrono::steady_clock::now();
+
+        bool success = startFrame();
+
+        if (success) {
+            renderer.readECSSnapshot();
+
+            ui_fn(ui_data);
+
+            render(frame_duration);
+
+            frame_duration = throttleFPS(cur_frame_start_time);
+        }
+    }
+
+    sim_exit.store_release(1);
+    sim_thread.join();
+
+    renderer.waitForIdle();
+}
+
 Viewer::Viewer(const render::RenderManager &render_mgr,
                const Window *window,
                const Config &cfg)
@@ -713,7 +877,7 @@ void Viewer::loop(
 
 void Viewer::stopLoop()
 {
-    impl_->shouldExit = true;
+    impl_->shouldExit.store_release(1);
 }
 
 CountT Viewer::getCurrentWorldID() const
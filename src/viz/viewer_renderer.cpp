@@ -3687,6 +3687,34 @@ void ViewerRenderer::render(const viz::ViewerControl &viz_ctrl)
     state_.renderGUIAndPresent(viz_ctrl, prepare_screenshot);
 }
 
+void ViewerRenderer::enableAsyncECSReadback()
+{
+    state_.rctx.enableAsyncECSReadback();
+}
+
+void ViewerRenderer::setSnapshotWorld(int32_t world_idx)
+{
+    state_.rctx.engine_interop_.asyncSnapshots->followWorld.store_relaxed(
+        world_idx);
+}
+
+void ViewerRenderer::readECSSnapshot()
+{
+    render::RenderContext &rctx = state_.rctx;
+
+    if (!rctx.acquireECSSnapshot()) {
+        return;
+    }
+
+    render::BatchRenderInfo info = {
+        .numViews = 0,
+        .numInstances = 0,
+        .numWorlds = rctx.num_worlds_,
+    };
+
+    rctx.batchRenderer->prepareForRendering(info, &rctx.engine_interop_);
+}
+
 
 CountT ViewerRenderer::loadObjects(Span<const imp::SourceObject> objs,
                                    Span<const imp::SourceMaterial> mats,
@@ -138,6 +138,13 @@ public:
     void startFrame();
     void render(const ViewerControl &viewer_ctrl);
 
+    // Used when the simulation runs on its own thread. readECSSnapshot
+    // prepares the most recently published ECS snapshot for rendering,
+    // if there is one.
+    void enableAsyncECSReadback();
+    void setSnapshotWorld(int32_t world_idx);
+    void readECSSnapshot();
+
     CountT loadObjects(Span<const imp::SourceObject> objs,
                        Span<const imp::SourceMaterial> mats,
                        Span<const imp::SourceTexture> textures,
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/physics.hpp>
+#include <madrona/physics_assets.hpp>
+#include <madrona/physics_loader.hpp>
+#include <madrona/rand.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/taskgraph_builder.hpp>
+
+#include "../src/core/worker_init.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::base;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace {
+
+constexpr CountT num_worlds = 2;
+
+struct Body : Archetype<RigidBody> {};
+
+// Object 0 is a dynamic unit cube, object 1 the same cube but static
+void loadCubes(PhysicsLoader &loader)
+{
+    Vector3 positions[8];
+    for (int32_t i = 0; i < 8; i++) {
+        positions[i] = {
+            (i & 1) ? 0.5f : -0.5f,
+            (i & 2) ? 0.5f : -0.5f,
+            (i & 4) ? 0.5f : -0.5f,
+        };
+    }
+
+    // Counter clockwise seen from outside
+    uint32_t indices[] = {
+        0, 4, 6, 2,
+        1, 3, 7, 5,
+        0, 1, 5, 4,
+        2, 6, 7, 3,
+        0, 2, 3, 1,
+        4, 5, 7, 6,
+    };
+
+    uint32_t face_counts[] = { 4, 4, 4, 4, 4, 4 };
+
+    imp::SourceMesh cube_mesh {
+        .positions = positions,
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices,
+        .faceCounts = face_counts,
+        .faceMaterials = nullptr,
+        .numVertices = 8,
+        .numFaces = 6,
+        .materialIDX = 0,
+    };
+
+    SourceCollisionPrimitive cube_prim {
+        .type = CollisionPrimitive::Type::Hull,
+        .hullInput = { 0 },
+    };
+
+    SourceCollisionObject objs[] = {
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&cube_prim, 1),
+            .invMass = 1.f,
+            .friction = { 0.5f, 0.5f },
+        },
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&cube_prim, 1),
+            .invMass = 0.f,
+            .friction = { 0.5f, 0.5f },
+        },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_bytes;
+    void *buffer = RigidBodyAssets::processRigidBodyAssets(
+        Span<const imp::SourceMesh>(&cube_mesh, 1), objs, false,
+        tmp_alloc, &assets, &num_bytes);
+    ASSERT_NE(buffer, nullptr);
+
+    loader.loadRigidBodies(assets);
+    free(buffer);
+}
+
+struct BodyInstance {
+    Vector3 position;
+    Quat rotation;
+    Diag3x3 scale;
+};
+
+BodyInstance randomBody(RNG &rng)
+{
+    Vector3 axis = normalize(Vector3 {
+        rng.sampleUniform() - 0.5f,
+        rng.sampleUniform() - 0.5f,
+        rng.sampleUniform() - 0.5f,
+    });
+
+    return BodyInstance {
+        .position = {
+            rng.sampleUniform() * 20.f,
+            rng.sampleUniform() * 20.f,
+            rng.sampleUniform() * 20.f,
+        },
+        .rotation = Quat::angleAxis(rng.sampleUniform() * 6.f, axis),
+        .scale = {
+            1.f + 2.f * rng.sampleUniform(),
+            1.f + 2.f * rng.sampleUniform(),
+            1.f + 2.f * rng.sampleUniform(),
+        },
+    };
+}
+
+// Same static colliders in every world, different dynamic ones per world
+struct Scene {
+    std::vector<BodyInstance> statics;
+    std::vector<BodyInstance> dynamics[num_worlds];
+};
+
+// Pair of body indices (statics first, then dynamics) in ascending order
+using BodyPair = std::pair<int32_t, int32_t>;
+
+struct RayHit {
+    int32_t body;
+    float t;
+};
+
+// Every world runs the broadphase once. The statics are either bound to
+// static_tree or get a leaf in each world's own BVH. delta_t only sets the
+// motion margin of the world's own leaves.
+class BroadphaseWorlds {
+public:
+    BroadphaseWorlds(ObjectManager *obj_mgr,
+                     const broadphase::BVH *static_tree,
+                     const Scene &scene,
+                     float delta_t)
+        : state_(num_worlds),
+          cache_()
+    {
+        ECSRegistry registry(&state_, nullptr);
+        base::registerTypes(registry);
+        PhysicsSystem::registerTypes(registry);
+        registry.registerArchetype<Body>();
+
+        for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+            worlds_[world_idx] = std::make_unique<World>(
+                state_, cache_, (uint32_t)world_idx);
+            World &world = *worlds_[world_idx];
+
+            CountT max_leaves = (CountT)scene.statics.size() +
+                (CountT)scene.dynamics[world_idx].size();
+
+            PhysicsSystem::init(world.ctx, obj_mgr, delta_t, 1,
+                                Vector3 { 0, 0, -9.8f }, max_leaves);
+
+            if (static_tree) {
+                PhysicsSystem::setStaticBVH(world.ctx, static_tree);
+            }
+
+            for (CountT i = 0; i < (CountT)scene.statics.size(); i++) {
+                Entity e = makeBody(world, scene.statics[i], 1,
+                                    ResponseType::Static);
+
+                world.ctx.get<broadphase::LeafID>(e) = static_tree ?
+                    PhysicsSystem::registerStaticEntity(world.ctx, e, i) :
+                    PhysicsSystem::registerEntity(world.ctx, e,
+                                                  ObjectID { 1 });
+            }
+
+            for (const BodyInstance &inst : scene.dynamics[world_idx]) {
+                Entity e = makeBody(world, inst, 0, ResponseType::Dynamic);
+
+                world.ctx.get<broadphase::LeafID>(e) =
+                    PhysicsSystem::registerEntity(world.ctx, e,
+                                                  ObjectID { 0 });
+            }
+
+            TaskGraphBuilder &builder = world.mgr.init(0u);
+            auto broadphase = PhysicsSystem::setupBroadphaseTasks(
+                builder, {});
+            PhysicsSystem::setupStandaloneBroadphaseOverlapTasks(
+                builder, {broadphase});
+            world.graphs = world.mgr.constructGraphs();
+
+            world.graphs[0].run(&world.ctx);
+        }
+    }
+
+    std::vector<BodyPair> candidatePairs(CountT world_idx)
+    {
+        World &world = *worlds_[world_idx];
+
+        std::vector<BodyPair> pairs;
+        auto query = world.ctx.query<CandidateCollision>();
+        world.ctx.iterateQuery(query, [&](CandidateCollision &candidate) {
+            int32_t a = bodyIndex(world,
+                world.ctx.getDirect<Entity>(0, candidate.a));
+            int32_t b = bodyIndex(world,
+                world.ctx.getDirect<Entity>(0, candidate.b));
+
+            pairs.push_back({ std::min(a, b), std::max(a, b) });
+        });
+
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+
+    RayHit traceRay(CountT world_idx, Vector3 o, Vector3 d)
+    {
+        World &world = *worlds_[world_idx];
+        broadphase::BVH &bvh = world.ctx.singleton<broadphase::BVH>();
+
+        float hit_t;
+        Vector3 hit_normal;
+        Entity hit = bvh.traceRay(o, d, &hit_t, &hit_normal, 50.f);
+
+        if (hit == Entity::none()) {
+            return { -1, 0.f };
+        }
+
+        return { bodyIndex(world, hit), hit_t };
+    }
+
+private:
+    struct World {
+        WorkerInit init;
+        Context ctx;
+        TaskGraphManager mgr;
+        HeapArray<TaskGraph> graphs;
+        std::unordered_map<int32_t, int32_t> bodyIndices;
+
+        World(StateManager &state, StateCache &cache, uint32_t world_idx)
+            : init { &state, &cache, world_idx },
+              ctx(nullptr, init),
+              mgr(1, init),
+              graphs(0),
+              bodyIndices()
+        {}
+    };
+
+    Entity makeBody(World &world, const BodyInstance &inst, uint32_t obj,
+                    ResponseType response_type)
+    {
+        Entity e = state_.makeEntityNow<Body>(world.init.worldID, cache_);
+
+        world.ctx.get<Position>(e) = inst.position;
+        world.ctx.get<Rotation>(e) = inst.rotation;
+        world.ctx.get<Scale>(e) = inst.scale;
+        world.ctx.get<ObjectID>(e) = ObjectID { (int32_t)obj };
+        world.ctx.get<ResponseType>(e) = response_type;
+        world.ctx.get<Velocity>(e) = { Vector3::zero(), Vector3::zero() };
+        world.ctx.get<ExternalForce>(e) = Vector3::zero();
+        world.ctx.get<ExternalTorque>(e) = Vector3::zero();
+
+        int32_t body_idx = (int32_t)world.bodyIndices.size();
+        world.bodyIndices.emplace(e.id, body_idx);
+
+        return e;
+    }
+
+    static int32_t bodyIndex(const World &world, Entity e)
+    {
+        return world.bodyIndices.at(e.id);
+    }
+
+    StateManager state_;
+    StateCache cache_;
+    std::unique_ptr<World> worlds_[num_worlds];
+};
+
+}
+
+TEST(Broadphase, SharedStaticTreeMatchesPerWorldLeaves)
+{
+    PhysicsLoader loader(ExecMode::CPU, 2);
+    loadCubes(loader);
+    ObjectManager *obj_mgr = &loader.getObjectManager();
+
+    RNG rng(11);
+
+    Scene scene;
+    for (int32_t i = 0; i < 60; i++) {
+        scene.statics.push_back(randomBody(rng));
+    }
+
+    for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+        for (int32_t i = 0; i < 30; i++) {
+            scene.dynamics[world_idx].push_back(randomBody(rng));
+        }
+    }
+
+    std::vector<PhysicsLoader::StaticInstance> static_instances;
+    for (const BodyInstance &inst : scene.statics) {
+        static_instances.push_back({
+            .objID = ObjectID { 1 },
+            .position = inst.position,
+            .rotation = inst.rotation,
+            .scale = inst.scale,
+        });
+    }
+
+    const broadphase::BVH *static_tree =
+        loader.buildStaticBVH(static_instances);
+
+    // The shared tree's leaves have no motion margin since statics never
+    // move, so without margins both setups see exactly the same bounds
+    BroadphaseWorlds shared(obj_mgr, static_tree, scene, 0.f);
+    BroadphaseWorlds per_world(obj_mgr, nullptr, scene, 0.f);
+
+    for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+        std::vector<BodyPair> shared_pairs = shared.candidatePairs(world_idx);
+        std::vector<BodyPair> expected_pairs =
+            per_world.candidatePairs(world_idx);
+
+        // Some of the pairs are between a dynamic and a static body
+        int32_t num_static_pairs = 0;
+        for (const BodyPair &pair : expected_pairs) {
+            num_static_pairs +=
+                pair.first < (int32_t)scene.statics.size() ? 1 : 0;
+        }
+        EXPECT_GT(num_static_pairs, 0);
+
+        EXPECT_EQ(shared_pairs, expected_pairs);
+
+        RNG ray_rng(100 + (uint32_t)world_idx);
+        int32_t num_static_hits = 0;
+        for (int32_t i = 0; i < 500; i++) {
+            Vector3 o {
+                ray_rng.sampleUniform() * 20.f,
+                ray_rng.sampleUniform() * 20.f,
+                ray_rng.sampleUniform() * 20.f,
+            };
+
+            Vector3 d = normalize(Vector3 {
+                ray_rng.sampleUniform() - 0.5f,
+                ray_rng.sampleUniform() - 0.5f,
+                ray_rng.sampleUniform() - 0.5f,
+            });
+
+            RayHit shared_hit = shared.traceRay(world_idx, o, d);
+            RayHit expected_hit = per_world.traceRay(world_idx, o, d);
+
+            EXPECT_EQ(shared_hit.body, expected_hit.body);
+            if (expected_hit.body != -1) {
+                EXPECT_NEAR(shared_hit.t, expected_hit.t, 1e-4f);
+            }
+
+            num_static_hits +=
+                expected_hit.body != -1 &&
+                expected_hit.body < (int32_t)scene.statics.size() ? 1 : 0;
+        }
+        EXPECT_GT(num_static_hits, 0);
+    }
+
+    // With a real timestep the per-world static leaves get a margin too, so
+    // they can only add dynamic-static pairs
+    BroadphaseWorlds shared_margin(obj_mgr, static_tree, scene, 1.f / 30.f);
+    BroadphaseWorlds per_world_margin(obj_mgr, nullptr, scene, 1.f / 30.f);
+
+    for (CountT world_idx = 0; world_idx < num_worlds; world_idx++) {
+        std::vector<BodyPair> shared_pairs =
+            shared_margin.candidatePairs(world_idx);
+        std::vector<BodyPair> per_world_pairs =
+            per_world_margin.candidatePairs(world_idx);
+
+        EXPECT_TRUE(std::includes(per_world_pairs.begin(),
+                                  per_world_pairs.end(),
+                                  shared_pairs.begin(),
+                                  shared_pairs.end()));
+
+        std::vector<BodyPair> extra_pairs;
+        std::set_difference(per_world_pairs.begin(), per_world_pairs.end(),
+                            shared_pairs.begin(), shared_pairs.end(),
+                            std::back_inserter(extra_pairs));
+
+        for (const BodyPair &pair : extra_pairs) {
+            EXPECT_LT(pair.first, (int32_t)scene.statics.size());
+            EXPECT_GE(pair.second, (int32_t)scene.statics.size());
+        }
+    }
+}
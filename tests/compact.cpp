@@ -0,0 +1,60 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/compact.hpp>
+
+using namespace madrona;
+using namespace madrona::math;
+
+TEST(Compact, HalfRoundTrip)
+{
+    // Every finite half value must survive a round trip through float
+    for (uint32_t bits = 0; bits < 0x7C00; bits++) {
+        float v = halfBitsToFloat(uint16_t(bits));
+        EXPECT_EQ(floatToHalfBits(v), bits);
+        EXPECT_EQ(floatToHalfBits(-v), bits | 0x8000);
+    }
+
+    EXPECT_EQ(floatToHalfBits(1.f), 0x3C00);
+    EXPECT_EQ(floatToHalfBits(65504.f), 0x7BFF);
+    EXPECT_EQ(floatToHalfBits(65520.f), 0x7C00);
+    EXPECT_EQ(floatToHalfBits(1e-9f), 0);
+}
+
+TEST(Compact, SNormQuat)
+{
+    Quat q = Quat::angleAxis(1.2f, Vector3 { 1, 2, 3 }.normalize());
+
+    SNormQuat packed;
+    packed.encode(q);
+    Quat decoded = packed.decode();
+
+    // Encoding may flip the sign, both represent the same rotation
+    float dot = q.w * decoded.w + q.x * decoded.x +
+        q.y * decoded.y + q.z * decoded.z;
+    EXPECT_NEAR(fabsf(dot), 1.f, 1e-4f);
+}
+
+TEST(Compact, FixedVector3)
+{
+    Vector3 origin { 100, -20, 5 };
+    float resolution = 1.f / 256.f;
+
+    FixedVector3 packed;
+    packed.encode(Vector3 { 110.3f, -25.f, 5.01f }, origin, resolution);
+    Vector3 decoded = packed.decode(origin, resolution);
+
+    EXPECT_NEAR(decoded.x, 110.3f, resolution);
+    EXPECT_NEAR(decoded.y, -25.f, resolution);
+    EXPECT_NEAR(decoded.z, 5.01f, resolution);
+
+    // Out of range offsets clamp
+    packed.encode(Vector3 { 1000, 0, 0 }, origin, resolution);
+    EXPECT_EQ(packed.x, 32767);
+}
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/hierarchy.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/taskgraph_builder.hpp>
+
+#include "../src/core/worker_init.hpp"
+
+using namespace madrona;
+using namespace madrona::base;
+using namespace madrona::math;
+
+namespace {
+
+struct RootNode : Archetype<Position, Rotation, Scale> {};
+
+struct ChildNode : Archetype<
+    Position,
+    Rotation,
+    Scale,
+    hierarchy::Child
+> {};
+
+struct Transform {
+    Vector3 pos;
+    Quat rot;
+    Diag3x3 scale;
+};
+
+Transform compose(const Transform &parent,
+                  const hierarchy::LocalTransform &local)
+{
+    return Transform {
+        parent.pos + parent.rot.rotateVec(parent.scale * local.position),
+        parent.rot * local.rotation,
+        parent.scale * local.scale,
+    };
+}
+
+struct HierarchyWorld {
+    StateManager state;
+    StateCache cache;
+    WorkerInit init;
+    Context ctx;
+    TaskGraphManager mgr;
+    HeapArray<TaskGraph> graphs;
+
+    HierarchyWorld()
+        : state(1),
+          cache(),
+          init { &state, &cache, 0 },
+          ctx(nullptr, init),
+          mgr(1, init),
+          graphs(0)
+    {
+        ECSRegistry registry(&state, nullptr);
+        base::registerTypes(registry);
+        hierarchy::registerTypes(registry);
+        registry.registerArchetype<RootNode>();
+        registry.registerArchetype<ChildNode>();
+
+        hierarchy::init(ctx, 16);
+
+        TaskGraphBuilder &builder = mgr.init(0u);
+        hierarchy::setupPropagateTasks(builder, {});
+        graphs = mgr.constructGraphs();
+    }
+
+    template <typename ArchetypeT>
+    Entity make(const Transform &xform)
+    {
+        Entity e = state.makeEntityNow<ArchetypeT>(0, cache);
+        set(e, xform);
+        return e;
+    }
+
+    void set(Entity e, const Transform &xform)
+    {
+        ctx.get<Position>(e) = xform.pos;
+        ctx.get<Rotation>(e) = xform.rot;
+        ctx.get<Scale>(e) = xform.scale;
+    }
+
+    Transform get(Entity e)
+    {
+        return Transform {
+            ctx.get<Position>(e),
+            ctx.get<Rotation>(e),
+            ctx.get<Scale>(e),
+        };
+    }
+
+    void step()
+    {
+        graphs[0].run(&ctx);
+    }
+};
+
+void expectTransform(const Transform &a, const Transform &b)
+{
+    constexpr float eps = 1e-4f;
+
+    EXPECT_NEAR(a.pos.x, b.pos.x, eps);
+    EXPECT_NEAR(a.pos.y, b.pos.y, eps);
+    EXPECT_NEAR(a.pos.z, b.pos.z, eps);
+    EXPECT_NEAR(a.rot.w, b.rot.w, eps);
+    EXPECT_NEAR(a.rot.x, b.rot.x, eps);
+    EXPECT_NEAR(a.rot.y, b.rot.y, eps);
+    EXPECT_NEAR(a.rot.z, b.rot.z, eps);
+    EXPECT_NEAR(a.scale.d0, b.scale.d0, eps);
+    EXPECT_NEAR(a.scale.d1, b.scale.d1, eps);
+    EXPECT_NEAR(a.scale.d2, b.scale.d2, eps);
+}
+
+}
+
+TEST(Hierarchy, PropagateAndDetach)
+{
+    HierarchyWorld world;
+
+    const Transform root_xform {
+        Vector3 { 1, 2, 3 },
+        Quat::angleAxis(0.5f, Vector3 { 0, 0, 1 }),
+        Diag3x3::uniform(2.f),
+    };
+
+    const Transform zero_xform {
+        Vector3 { 0, 0, 0 },
+        Quat::id(),
+        Diag3x3::id(),
+    };
+
+    const hierarchy::LocalTransform local_a {
+        Vector3 { 1, 0, 0 },
+        Quat::angleAxis(0.25f, Vector3 { 1, 0, 0 }),
+        Diag3x3 { 1, 2, 1 },
+    };
+
+    const hierarchy::LocalTransform local_b {
+        Vector3 { 0, 1, 0 },
+        Quat::angleAxis(-0.75f, Vector3 { 0, 1, 0 }),
+        Diag3x3::uniform(0.5f),
+    };
+
+    const hierarchy::LocalTransform local_c {
+        Vector3 { 0, 0, 2 },
+        Quat::id(),
+        Diag3x3::id(),
+    };
+
+    const hierarchy::LocalTransform local_sibling {
+        Vector3 { -1, 0, 0 },
+        Quat::id(),
+        Diag3x3::uniform(3.f),
+    };
+
+    // Deepest first, so the query order doesn't match the depth order
+    Entity c = world.make<ChildNode>(zero_xform);
+    Entity b = world.make<ChildNode>(zero_xform);
+    Entity a = world.make<ChildNode>(zero_xform);
+    Entity sibling = world.make<ChildNode>(zero_xform);
+    Entity root = world.make<RootNode>(root_xform);
+
+    hierarchy::attach(world.ctx, c, b, local_c);
+    hierarchy::attach(world.ctx, b, a, local_b);
+    hierarchy::attach(world.ctx, a, root, local_a);
+    hierarchy::attach(world.ctx, sibling, root, local_sibling);
+
+    world.step();
+
+    Transform expected_a = compose(root_xform, local_a);
+    Transform expected_b = compose(expected_a, local_b);
+    Transform expected_c = compose(expected_b, local_c);
+    Transform expected_sibling = compose(root_xform, local_sibling);
+
+    expectTransform(world.get(a), expected_a);
+    expectTransform(world.get(b), expected_b);
+    expectTransform(world.get(c), expected_c);
+    expectTransform(world.get(sibling), expected_sibling);
+
+    // b keeps its last world transform and c now follows b as a root
+    hierarchy::detach(world.ctx, b);
+
+    const Transform moved_root_xform {
+        Vector3 { -4, 0, 1 },
+        Quat::angleAxis(1.5f, Vector3 { 0, 1, 0 }),
+        Diag3x3::uniform(0.5f),
+    };
+    world.set(root, moved_root_xform);
+
+    world.step();
+
+    expectTransform(world.get(a), compose(moved_root_xform, local_a));
+    expectTransform(world.get(sibling),
+                    compose(moved_root_xform, local_sibling));
+    expectTransform(world.get(b), expected_b);
+    expectTransform(world.get(c), expected_c);
+
+    // Moving the detached b now moves c
+    const Transform moved_b_xform {
+        Vector3 { 0, 5, 0 },
+        Quat::id(),
+        Diag3x3::id(),
+    };
+    world.set(b, moved_b_xform);
+
+    world.step();
+
+    expectTransform(world.get(b), moved_b_xform);
+    expectTransform(world.get(c), compose(moved_b_xform, local_c));
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/mesh_bvh.hpp>
+#include <madrona/mesh_bvh_builder.hpp>
+#include <madrona/rand.hpp>
+
+#include <cfloat>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+
+namespace {
+
+void expectEncloses(const QBVHNode &node, const AABB *child_aabbs,
+                    CountT num_children)
+{
+    QBVHNode::DecodedChildren decoded = node.decodeChildren();
+
+    for (CountT i = 0; i < num_children; i++) {
+        const AABB &aabb = child_aabbs[i];
+
+        EXPECT_LE(decoded.minX[i], aabb.pMin.x);
+        EXPECT_LE(decoded.minY[i], aabb.pMin.y);
+        EXPECT_LE(decoded.minZ[i], aabb.pMin.z);
+        EXPECT_GE(decoded.maxX[i], aabb.pMax.x);
+        EXPECT_GE(decoded.maxY[i], aabb.pMax.y);
+        EXPECT_GE(decoded.maxZ[i], aabb.pMax.z);
+    }
+}
+
+// Bumpy grid_size x grid_size heightfield in the z = 0 plane
+MeshBVH buildHeightfield(int32_t grid_size)
+{
+    int32_t num_verts_side = grid_size + 1;
+
+    std::vector<Vector3> positions;
+    for (int32_t y = 0; y < num_verts_side; y++) {
+        for (int32_t x = 0; x < num_verts_side; x++) {
+            float z = sinf((float)x * 0.7f) * cosf((float)y * 0.4f);
+            positions.push_back({ (float)x, (float)y, z });
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    for (int32_t y = 0; y < grid_size; y++) {
+        for (int32_t x = 0; x < grid_size; x++) {
+            uint32_t v00 = (uint32_t)(y * num_verts_side + x);
+            uint32_t v10 = v00 + 1;
+            uint32_t v01 = v00 + (uint32_t)num_verts_side;
+            uint32_t v11 = v01 + 1;
+
+            indices.insert(indices.end(), { v00, v10, v11, v00, v11, v01 });
+        }
+    }
+
+    imp::SourceMesh mesh {
+        .positions = positions.data(),
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices.data(),
+        .faceCounts = nullptr,
+        .faceMaterials = nullptr,
+        .numVertices = (uint32_t)positions.size(),
+        .numFaces = (uint32_t)(indices.size() / 3),
+        .materialIDX = 0,
+    };
+
+    return MeshBVHBuilder::build(Span<const imp::SourceMesh>(&mesh, 1));
+}
+
+// Nearby sweeps next to each other, as sphereCastBatch suggests, mostly
+// moving down into the heightfield but some moving away and missing
+std::vector<MeshBVH::SphereSweep> makeSweeps(int32_t grid_size,
+                                             CountT num_sweeps)
+{
+    RNG rng(3);
+
+    std::vector<MeshBVH::SphereSweep> sweeps;
+    for (CountT i = 0; i < num_sweeps; i++) {
+        float cell = (float)(i / 16);
+        Vector3 o {
+            fmodf(cell * 3.7f, (float)grid_size) + rng.sampleUniform(),
+            fmodf(cell * 1.3f, (float)grid_size) + rng.sampleUniform(),
+            1.5f + 2.f * rng.sampleUniform(),
+        };
+
+        Vector3 d = normalize(Vector3 {
+            rng.sampleUniform() - 0.5f,
+            rng.sampleUniform() - 0.5f,
+            rng.sampleUniform() - 0.8f,
+        });
+
+        sweeps.push_back({
+            .o = o,
+            .d = d,
+            .radius = 0.05f + 0.5f * rng.sampleUniform(),
+            .tMax = 10.f,
+        });
+    }
+
+    return sweeps;
+}
+
+// sphereCast and the batched sweeps can disagree on the sign of the
+// normal, so only the axis is compared
+void expectSameHit(const MeshBVH::SweepHit &hit, float expected_t,
+                   Vector3 expected_normal, float t_max)
+{
+    EXPECT_NEAR(hit.tHit, expected_t, 1e-4f);
+
+    if (expected_t < t_max && hit.tHit < t_max) {
+        EXPECT_NEAR(fabsf(dot(hit.normal, expected_normal)), 1.f, 1e-3f);
+    }
+}
+
+}
+
+TEST(MeshBVH, QuantizedChildrenEncloseBounds)
+{
+    RNG rng(5);
+
+    int32_t child_indices[MeshBVH::nodeWidth];
+    for (CountT i = 0; i < MeshBVH::nodeWidth; i++) {
+        child_indices[i] = (int32_t)i + 1;
+    }
+
+    // Random boxes from 2^-20 to 2^20 across, away from the origin so
+    // node_min + scale * q rounds
+    for (int32_t iter = 0; iter < 10000; iter++) {
+        float scale = exp2f((float)rng.sampleI32(-20, 21));
+        Vector3 offset {
+            (rng.sampleUniform() - 0.5f) * 1000.f,
+            (rng.sampleUniform() - 0.5f) * 1000.f,
+            (rng.sampleUniform() - 0.5f) * 1000.f,
+        };
+
+        AABB child_aabbs[MeshBVH::nodeWidth];
+        for (CountT i = 0; i < MeshBVH::nodeWidth; i++) {
+            Vector3 a {
+                rng.sampleUniform(), rng.sampleUniform(), rng.sampleUniform(),
+            };
+            Vector3 b {
+                rng.sampleUniform(), rng.sampleUniform(), rng.sampleUniform(),
+            };
+
+            child_aabbs[i] = AABB {
+                .pMin = offset + scale * Vector3::min(a, b),
+                .pMax = offset + scale * Vector3::max(a, b),
+            };
+        }
+
+        QBVHNode node = QBVHNode::construct(
+            MeshBVH::nodeWidth, child_aabbs, child_indices);
+
+        expectEncloses(node, child_aabbs, MeshBVH::nodeWidth);
+    }
+}
+
+TEST(MeshBVH, QuantizedChildrenEncloseBoundsMaxExponent)
+{
+    // The extent overflows to infinity, which clamps the exponent to 127
+    EXPECT_EQ(QBVHNode::computeExponent(-FLT_MAX, FLT_MAX), 127);
+
+    AABB child_aabbs[] = {
+        {
+            .pMin = { -FLT_MAX, -FLT_MAX, -FLT_MAX },
+            .pMax = { -1e38f, -1e30f, 0.f },
+        },
+        {
+            .pMin = { 1e38f, 1e30f, 0.f },
+            .pMax = { FLT_MAX, FLT_MAX, FLT_MAX },
+        },
+        {
+            .pMin = { -1.f, -1.f, -1.f },
+            .pMax = { 1.f, 1.f, 1.f },
+        },
+    };
+
+    int32_t child_indices[] = { 1, 2, 3 };
+
+    QBVHNode node = QBVHNode::construct(3, child_aabbs, child_indices);
+    EXPECT_EQ(node.expX, 127);
+    EXPECT_EQ(node.expY, 127);
+    EXPECT_EQ(node.expZ, 127);
+
+    expectEncloses(node, child_aabbs, 3);
+
+    // Directly at the exponent, including values right at node_min where
+    // dividing by 2^127 loses the low bits
+    for (float v : { -FLT_MAX, -1e38f, -1.f, 0.f, 1.f, 1e38f, FLT_MAX }) {
+        float node_min = -FLT_MAX;
+        float scale = QBVHNode::exponentScale(127);
+
+        uint8_t q_min = QBVHNode::quantizeMin(v, node_min, 127);
+        uint8_t q_max = QBVHNode::quantizeMax(v, node_min, 127);
+
+        EXPECT_LE(node_min + scale * (float)q_min, v);
+        EXPECT_GE(node_min + scale * (float)q_max, v);
+    }
+}
+
+TEST(MeshBVH, SphereCastBatchMatchesSphereCast)
+{
+    constexpr int32_t grid_size = 32;
+    MeshBVH bvh = buildHeightfield(grid_size);
+
+    std::vector<MeshBVH::SphereSweep> sweeps = makeSweeps(grid_size, 500);
+
+    std::vector<MeshBVH::SweepHit> hits(sweeps.size());
+    bvh.sphereCastBatch(sweeps.data(), hits.data(), (CountT)sweeps.size());
+
+    int32_t num_hits = 0;
+    for (size_t i = 0; i < sweeps.size(); i++) {
+        const MeshBVH::SphereSweep &sweep = sweeps[i];
+
+        Vector3 normal;
+        float t = bvh.sphereCast(sweep.o, sweep.d, sweep.radius, &normal,
+                                 sweep.tMax);
+
+        expectSameHit(hits[i], t, normal, sweep.tMax);
+        num_hits += t < sweep.tMax ? 1 : 0;
+    }
+
+    // Both outcomes are covered
+    EXPECT_GT(num_hits, 0);
+    EXPECT_LT(num_hits, (int32_t)sweeps.size());
+}
+
+TEST(MeshBVH, CapsuleCastBatchMatchesSphereCast)
+{
+    constexpr int32_t grid_size = 32;
+    MeshBVH bvh = buildHeightfield(grid_size);
+
+    std::vector<MeshBVH::SphereSweep> sweeps = makeSweeps(grid_size, 500);
+
+    // A capsule with p0 == p1 is a sphere
+    std::vector<MeshBVH::CapsuleSweep> capsules;
+    for (const MeshBVH::SphereSweep &sweep : sweeps) {
+        capsules.push_back({
+            .p0 = sweep.o,
+            .p1 = sweep.o,
+            .d = sweep.d,
+            .radius = sweep.radius,
+            .tMax = sweep.tMax,
+        });
+    }
+
+    std::vector<MeshBVH::SweepHit> hits(capsules.size());
+    bvh.capsuleCastBatch(capsules.data(), hits.data(),
+                         (CountT)capsules.size());
+
+    for (size_t i = 0; i < sweeps.size(); i++) {
+        const MeshBVH::SphereSweep &sweep = sweeps[i];
+
+        Vector3 normal;
+        float t = bvh.sphereCast(sweep.o, sweep.d, sweep.radius, &normal,
+                                 sweep.tMax);
+
+        expectSameHit(hits[i], t, normal, sweep.tMax);
+    }
+}
+
+// The vertex test used to offset vertices by the ray origin twice, so it
+// only worked for sweeps starting at the origin
+TEST(MeshBVH, SphereCastTriangleVertexAwayFromOrigin)
+{
+    MeshBVH bvh {};
+
+    Vector3 offset { 100, 100, 100 };
+
+    // Moving in the triangle's plane straight at vertex a
+    Vector3 a = offset + Vector3 { 5, 0, 0 };
+    Vector3 b = offset + Vector3 { 10, -3, 0 };
+    Vector3 c = offset + Vector3 { 10, 3, 0 };
+
+    Vector3 normal;
+    float t = bvh.sphereCastTriangle(a, b, c, offset, Vector3 { 1, 0, 0 },
+                                     100.f, 1.f, &normal);
+
+    EXPECT_NEAR(t, 4.f, 1e-4f);
+    EXPECT_NEAR(normal.x, 1.f, 1e-4f);
+    EXPECT_NEAR(normal.y, 0.f, 1e-4f);
+    EXPECT_NEAR(normal.z, 0.f, 1e-4f);
+}
+
+// The edge test used to reject edges that the sweep only reaches after
+// moving one unit, rather than after the current hit distance
+TEST(MeshBVH, SphereCastTriangleEdgeAfterUnitDistance)
+{
+    MeshBVH bvh {};
+
+    Vector3 a { 0, 0, 0 };
+    Vector3 b { 10, 0, 0 };
+    Vector3 c { 5, -10, 0 };
+
+    // Starts behind a along the edge ab, reaches the edge at (3, 1, 0),
+    // 4 * sqrt(5) along the sweep, and never touches a vertex
+    Vector3 d = normalize(Vector3 { 2, -1, 0 });
+
+    Vector3 normal;
+    float t = bvh.sphereCastTriangle(a, b, c, Vector3 { -5, 5, 0 }, d,
+                                     100.f, 1.f, &normal);
+
+    EXPECT_NEAR(t, 4.f * sqrtf(5.f), 1e-4f);
+    EXPECT_NEAR(normal.x, 0.f, 1e-4f);
+    EXPECT_NEAR(normal.y, -1.f, 1e-4f);
+    EXPECT_NEAR(normal.z, 0.f, 1e-4f);
+}
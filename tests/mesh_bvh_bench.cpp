@@ -0,0 +1,139 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+
+// Single threaded MeshBVH::traceRay timing on a heightfield.
+// Usage: mesh_bvh_bench [grid size] [num rays]
+// The defaults give 320k triangles and 300k rays.
+
+#include <madrona/mesh_bvh_builder.hpp>
+#include <madrona/rand.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace madrona;
+using namespace madrona::math;
+
+static float heightAt(int32_t x, int32_t y)
+{
+    return 2.f * sinf((float)x * 0.05f) * cosf((float)y * 0.07f) +
+        0.5f * sinf((float)(x + y) * 0.31f);
+}
+
+int main(int argc, char *argv[])
+{
+    int32_t grid_size = argc > 1 ? atoi(argv[1]) : 400;
+    int32_t num_rays = argc > 2 ? atoi(argv[2]) : 300'000;
+
+    if (grid_size < 2 || num_rays < 1) {
+        fprintf(stderr, "Usage: %s [grid size] [num rays]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int32_t num_verts_side = grid_size + 1;
+
+    std::vector<Vector3> positions;
+    positions.reserve((size_t)num_verts_side * num_verts_side);
+    for (int32_t y = 0; y < num_verts_side; y++) {
+        for (int32_t x = 0; x < num_verts_side; x++) {
+            positions.push_back({ (float)x, (float)y, heightAt(x, y) });
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve((size_t)grid_size * grid_size * 6);
+    for (int32_t y = 0; y < grid_size; y++) {
+        for (int32_t x = 0; x < grid_size; x++) {
+            uint32_t v00 = (uint32_t)(y * num_verts_side + x);
+            uint32_t v10 = v00 + 1;
+            uint32_t v01 = v00 + (uint32_t)num_verts_side;
+            uint32_t v11 = v01 + 1;
+
+            indices.insert(indices.end(), { v00, v10, v11, v00, v11, v01 });
+        }
+    }
+
+    imp::SourceMesh mesh {
+        .positions = positions.data(),
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices.data(),
+        .faceCounts = nullptr,
+        .faceMaterials = nullptr,
+        .numVertices = (uint32_t)positions.size(),
+        .numFaces = (uint32_t)(indices.size() / 3),
+        .materialIDX = 0,
+    };
+
+    auto build_start = std::chrono::steady_clock::now();
+    MeshBVH bvh = MeshBVHBuilder::build(Span<const imp::SourceMesh>(&mesh, 1));
+    auto build_end = std::chrono::steady_clock::now();
+
+    // Half the rays come straight down, half are random directions from
+    // above the surface, so both coherent and incoherent traversals count
+    struct Ray {
+        Vector3 o;
+        Vector3 d;
+    };
+
+    RNG rng(7);
+    std::vector<Ray> rays;
+    rays.reserve(num_rays);
+    for (int32_t i = 0; i < num_rays; i++) {
+        Vector3 o {
+            rng.sampleUniform() * (float)grid_size,
+            rng.sampleUniform() * (float)grid_size,
+            5.f,
+        };
+
+        Vector3 d;
+        if (i % 2 == 0) {
+            d = { 0, 0, -1 };
+        } else {
+            d = normalize(Vector3 {
+                rng.sampleUniform() - 0.5f,
+                rng.sampleUniform() - 0.5f,
+                -rng.sampleUniform() - 0.05f,
+            });
+        }
+
+        rays.push_back({ o, d });
+    }
+
+    int32_t num_hits = 0;
+    double t_sum = 0.0;
+
+    auto trace_start = std::chrono::steady_clock::now();
+    for (const Ray &ray : rays) {
+        MeshBVH::HitInfo hit_info {};
+        int32_t stack[64];
+        int32_t stack_size = 0;
+
+        if (bvh.traceRay(ray.o, ray.d, &hit_info, stack, stack_size)) {
+            num_hits += 1;
+            t_sum += hit_info.tHit;
+        }
+    }
+    auto trace_end = std::chrono::steady_clock::now();
+
+    double build_ms = std::chrono::duration<double, std::milli>(
+        build_end - build_start).count();
+    double trace_ns = std::chrono::duration<double, std::nano>(
+        trace_end - trace_start).count();
+
+    printf("%u triangles, %u nodes, built in %.1f ms\n",
+           mesh.numFaces, bvh.numNodes, build_ms);
+    printf("%d rays: %.1f ns/ray, %d hits, mean t %f\n",
+           num_rays, trace_ns / (double)num_rays, num_hits,
+           num_hits > 0 ? t_sum / (double)num_hits : 0.0);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2021-2023 Brennan Shacklett and contributors
+ *
+ * Use of this source code is governed by an MIT-style
+ * license that can be found in the LICENSE file or at
+ * https://opensource.org/licenses/MIT.
+ */
+#include <gtest/gtest.h>
+
+#include <madrona/particles.hpp>
+#include <madrona/physics.hpp>
+#include <madrona/physics_assets.hpp>
+#include <madrona/physics_loader.hpp>
+#include <madrona/rand.hpp>
+#include <madrona/registry.hpp>
+#include <madrona/taskgraph_builder.hpp>
+
+#include "../src/core/worker_init.hpp"
+
+using namespace madrona;
+using namespace madrona::base;
+using namespace madrona::math;
+using namespace madrona::phys;
+
+namespace {
+
+struct Body : Archetype<RigidBody> {};
+
+constexpr float deltaT = 1.f / 60.f;
+
+// Object 0 is a static ground plane, object 1 a static unit cube
+void loadColliders(PhysicsLoader &loader)
+{
+    Vector3 positions[8];
+    for (int32_t i = 0; i < 8; i++) {
+        positions[i] = {
+            (i & 1) ? 0.5f : -0.5f,
+            (i & 2) ? 0.5f : -0.5f,
+            (i & 4) ? 0.5f : -0.5f,
+        };
+    }
+
+    // Counter clockwise seen from outside
+    uint32_t indices[] = {
+        0, 4, 6, 2,
+        1, 3, 7, 5,
+        0, 1, 5, 4,
+        2, 6, 7, 3,
+        0, 2, 3, 1,
+        4, 5, 7, 6,
+    };
+
+    uint32_t face_counts[] = { 4, 4, 4, 4, 4, 4 };
+
+    imp::SourceMesh cube_mesh {
+        .positions = positions,
+        .normals = nullptr,
+        .tangentAndSigns = nullptr,
+        .uvs = nullptr,
+        .indices = indices,
+        .faceCounts = face_counts,
+        .faceMaterials = nullptr,
+        .numVertices = 8,
+        .numFaces = 6,
+        .materialIDX = 0,
+    };
+
+    SourceCollisionPrimitive plane_prim {
+        .type = CollisionPrimitive::Type::Plane,
+        .plane = {},
+    };
+
+    SourceCollisionPrimitive cube_prim {
+        .type = CollisionPrimitive::Type::Hull,
+        .hullInput = { 0 },
+    };
+
+    SourceCollisionObject objs[] = {
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&plane_prim, 1),
+            .invMass = 0.f,
+            .friction = { 0.5f, 0.5f },
+        },
+        {
+            .prims = Span<const SourceCollisionPrimitive>(&cube_prim, 1),
+            .invMass = 0.f,
+            .friction = { 0.5f, 0.5f },
+        },
+    };
+
+    StackAlloc tmp_alloc;
+    RigidBodyAssets assets;
+    CountT num_bytes;
+    void *buffer = RigidBodyAssets::processRigidBodyAssets(
+        Span<const imp::SourceMesh>(&cube_mesh, 1), objs, false,
+        tmp_alloc, &assets, &num_bytes);
+    ASSERT_NE(buffer, nullptr);
+
+    loader.loadRigidBodies(assets);
+    free(buffer);
+}
+
+// One world running the full XPBD step with a single substep
+struct ParticleWorld {
+    StateManager state;
+    StateCache cache;
+    WorkerInit init;
+    Context ctx;
+    TaskGraphManager mgr;
+    HeapArray<TaskGraph> graphs;
+
+    ParticleWorld(ObjectManager *obj_mgr, Vector3 gravity)
+        : state(1),
+          cache(),
+          init { &state, &cache, 0 },
+          ctx(nullptr, init),
+          mgr(1, init),
+          graphs(0)
+    {
+        ECSRegistry registry(&state, nullptr);
+        base::registerTypes(registry);
+        PhysicsSystem::registerTypes(registry);
+        registry.registerArchetype<Body>();
+
+        PhysicsSystem::init(ctx, obj_mgr, deltaT, 1, gravity, 8);
+
+        particles::init(ctx, particles::Config {
+            .maxParticles = 256,
+            .maxRadius = 0.1f,
+            .friction = 0.5f,
+            .maxRigidPairs = 64,
+        });
+
+        TaskGraphBuilder &builder = mgr.init(0u);
+        auto broadphase = PhysicsSystem::setupBroadphaseTasks(builder, {});
+        auto step = PhysicsSystem::setupPhysicsStepTasks(
+            builder, {broadphase}, 1);
+        PhysicsSystem::setupCleanupTasks(builder, {step});
+        graphs = mgr.constructGraphs();
+    }
+
+    void addStatic(uint32_t obj, Vector3 position)
+    {
+        Entity e = state.makeEntityNow<Body>(0, cache);
+
+        ctx.get<Position>(e) = position;
+        ctx.get<Rotation>(e) = Quat::id();
+        ctx.get<Scale>(e) = Diag3x3::id();
+        ctx.get<ObjectID>(e) = ObjectID { (int32_t)obj };
+        ctx.get<ResponseType>(e) = ResponseType::Static;
+        ctx.get<Velocity>(e) = { Vector3::zero(), Vector3::zero() };
+        ctx.get<ExternalForce>(e) = Vector3::zero();
+        ctx.get<ExternalTorque>(e) = Vector3::zero();
+
+        ctx.get<broadphase::LeafID>(e) = PhysicsSystem::registerEntity(
+            ctx, e, ObjectID { (int32_t)obj });
+    }
+
+    Vector3 position(CountT idx)
+    {
+        particles::ParticleData data = particles::getParticles(ctx);
+        return { data.posX[idx], data.posY[idx], data.posZ[idx] };
+    }
+
+    // Sum of the overlap depths of every overlapping pair
+    float totalOverlap()
+    {
+        particles::ParticleData data = particles::getParticles(ctx);
+
+        float total = 0.f;
+        for (CountT i = 0; i < data.numParticles; i++) {
+            for (CountT j = i + 1; j < data.numParticles; j++) {
+                float dist = position(i).distance(position(j));
+                total += fmaxf(data.radii[i] + data.radii[j] - dist, 0.f);
+            }
+        }
+
+        return total;
+    }
+
+    void step()
+    {
+        graphs[0].run(&ctx);
+    }
+};
+
+}
+
+TEST(Particles, OverlappingPairSeparates)
+{
+    PhysicsLoader loader(ExecMode::CPU, 2);
+    loadColliders(loader);
+
+    ParticleWorld world(&loader.getObjectManager(), Vector3::zero());
+
+    // Equal masses split the correction, a pinned particle doesn't move
+    CountT a = particles::spawn(world.ctx, { 0, 0, 0 }, Vector3::zero(),
+                                0.1f, 1.f);
+    CountT b = particles::spawn(world.ctx, { 0.1f, 0, 0 }, Vector3::zero(),
+                                0.1f, 1.f);
+    CountT pinned = particles::spawn(world.ctx, { 5, 0, 0 },
+                                     Vector3::zero(), 0.1f, 0.f);
+    CountT c = particles::spawn(world.ctx, { 5, 0, 0.15f }, Vector3::zero(),
+                                0.1f, 1.f);
+
+    world.step();
+
+    EXPECT_NEAR(world.position(a).x, -0.05f, 1e-5f);
+    EXPECT_NEAR(world.position(b).x, 0.15f, 1e-5f);
+    EXPECT_NEAR(world.position(b).distance(world.position(a)), 0.2f, 1e-5f);
+
+    EXPECT_EQ(world.position(pinned).z, 0.f);
+    EXPECT_NEAR(world.position(c).z, 0.2f, 1e-5f);
+
+    // The correction becomes a separating velocity
+    particles::ParticleData data = particles::getParticles(world.ctx);
+    EXPECT_LT(data.velX[a], 0.f);
+    EXPECT_GT(data.velX[b], 0.f);
+    EXPECT_EQ(data.velZ[pinned], 0.f);
+}
+
+TEST(Particles, OverlapReducedInCluster)
+{
+    PhysicsLoader loader(ExecMode::CPU, 2);
+    loadColliders(loader);
+
+    ParticleWorld world(&loader.getObjectManager(), Vector3::zero());
+
+    // Enough particles in a small box that buckets hold more than a
+    // test block and different cells share buckets
+    RNG rng(7);
+    for (int32_t i = 0; i < 200; i++) {
+        Vector3 pos {
+            rng.sampleUniform() * 1.5f,
+            rng.sampleUniform() * 1.5f,
+            rng.sampleUniform() * 1.5f,
+        };
+
+        particles::spawn(world.ctx, pos, Vector3::zero(),
+                         0.05f + 0.05f * rng.sampleUniform(), 1.f);
+    }
+
+    float prev_overlap = world.totalOverlap();
+    float initial_overlap = prev_overlap;
+    ASSERT_GT(initial_overlap, 0.f);
+
+    world.step();
+
+    float overlap = world.totalOverlap();
+    EXPECT_LT(overlap, prev_overlap);
+
+    for (int32_t i = 0; i < 20; i++) {
+        world.step();
+    }
+
+    EXPECT_LT(world.totalOverlap(), 0.1f * initial_overlap);
+}
+
+TEST(Particles, RestingParticlesPushedOutOfPlaneAndHull)
+{
+    PhysicsLoader loader(ExecMode::CPU, 2);
+    loadColliders(loader);
+
+    ParticleWorld world(&loader.getObjectManager(),
+                        Vector3 { 0, 0, -9.8f });
+
+    world.addStatic(0, Vector3::zero());
+    world.addStatic(1, Vector3 { 5, 0, 0.5f });
+
+    // Both start half a radius inside the surface below them
+    CountT on_plane = particles::spawn(world.ctx, { 0, 0, 0.05f },
+                                       Vector3::zero(), 0.1f, 1.f);
+    CountT on_hull = particles::spawn(world.ctx, { 5, 0, 1.05f },
+                                      Vector3::zero(), 0.1f, 1.f);
+
+    world.step();
+
+    EXPECT_GT(world.position(on_plane).z, 0.05f);
+    EXPECT_GT(world.position(on_hull).z, 1.05f);
+
+    // And stay on top of it under gravity
+    for (int32_t i = 0; i < 60; i++) {
+        world.step();
+    }
+
+    Vector3 plane_pos = world.position(on_plane);
+    Vector3 hull_pos = world.position(on_hull);
+
+    EXPECT_NEAR(plane_pos.z, 0.1f, 1e-2f);
+    EXPECT_NEAR(plane_pos.x, 0.f, 1e-3f);
+    EXPECT_NEAR(plane_pos.y, 0.f, 1e-3f);
+
+    EXPECT_NEAR(hull_pos.z, 1.1f, 1e-2f);
+    EXPECT_NEAR(hull_pos.x, 5.f, 1e-3f);
+    EXPECT_NEAR(hull_pos.y, 0.f, 1e-3f);
+}
@@ -9,6 +9,7 @@
 
 #include <madrona/state.hpp>
 #include <madrona/registry.hpp>
+#include <madrona/compact.hpp>
 
 #include <array>
 
@@ -36,6 +37,8 @@ struct Archetype1 : Archetype<Component1> {};
 struct Archetype2 : Archetype<Component1, Component2, Component3> {};
 struct Archetype3 : Archetype<ComponentBig> {};
 
+#ifndef MADRONA_MW_MODE
+
 TEST(State, Indexing)
 {
     int num_entities = 1'000'000;
@@ -269,3 +272,236 @@ TEST(State, Reset)
         EXPECT_TRUE(state.get<Component1>(e).valid());
     }
 }
+
+TEST(State, InitialState)
+{
+    StateManager state;
+    StateCache cache;
+    ECSRegistry registry(&state, nullptr);
+    registry.registerComponent<Component1>();
+    registry.registerComponent<Component2>();
+    registry.registerComponent<Component3>();
+    registry.registerArchetype<Archetype1>();
+    registry.registerArchetype<Archetype2>();
+
+    int num_entities = 1'000;
+
+    DynArray<Entity> entities(num_entities);
+    for (int i = 0; i < num_entities; i++) {
+        Entity e = state.makeEntityNow<Archetype2>(cache);
+        state.get<Component1>(e).value().v = i;
+        state.get<Component2>(e).value().x = i * 2;
+        entities.push_back(e);
+    }
+
+    CountT state_idx = state.captureInitialState();
+    EXPECT_EQ(state_idx, 0);
+    EXPECT_EQ(state.numInitialStates(), 1);
+
+    for (Entity e : entities) {
+        state.get<Component1>(e).value().v = 0;
+        state.get<Component2>(e).value().x = 0;
+    }
+
+    DynArray<Entity> extra(num_entities);
+    for (int i = 0; i < num_entities; i++) {
+        extra.push_back(state.makeEntityNow<Archetype2>(cache));
+        extra.push_back(state.makeEntityNow<Archetype1>(cache));
+    }
+
+    state.restoreInitialState(cache, state_idx);
+
+    // Rows are reused in order, so the original handles stay valid
+    for (int i = 0; i < num_entities; i++) {
+        EXPECT_EQ(state.get<Component1>(entities[i]).value().v,
+                  (uint32_t)i);
+        EXPECT_EQ(state.get<Component2>(entities[i]).value().x,
+                  (uint32_t)i * 2);
+    }
+
+    for (Entity e : extra) {
+        EXPECT_FALSE(state.getLoc(e).valid());
+    }
+}
+
+#else
+
+// Built into mw_core_tests
+
+struct FloatComponent {
+    float x;
+    float y;
+};
+
+struct FloatArchetype : Archetype<FloatComponent> {};
+
+TEST(StateMW, EncodedExportIsOutputOnly)
+{
+    StateManager state(2);
+    StateCache cache;
+    void *export_ptrs[2];
+    ECSRegistry registry(&state, export_ptrs);
+    registry.registerComponent<FloatComponent>();
+    registry.registerArchetype<FloatArchetype>();
+    registry.exportColumn<FloatArchetype, FloatComponent>(
+        0, ExportEncoding::SNorm16);
+    registry.exportColumn<FloatArchetype, FloatComponent>(
+        1, ExportEncoding::Float16);
+
+    // Outside [-1, 1], and not representable as a half
+    const FloatComponent values[2] = {
+        { 3.5f, -1.0001f },
+        { 1.0001f, 12345.678f },
+    };
+
+    Entity entities[2];
+    for (uint32_t world_idx = 0; world_idx < 2; world_idx++) {
+        entities[world_idx] =
+            state.makeEntityNow<FloatArchetype>(world_idx, cache);
+        state.get<FloatComponent>(world_idx, entities[world_idx]).value() =
+            values[world_idx];
+    }
+
+    // One step: copy out after, copy in before the next
+    state.copyOutExportedColumns();
+    state.copyInExportedColumns();
+
+    for (uint32_t world_idx = 0; world_idx < 2; world_idx++) {
+        FloatComponent v = state.get<FloatComponent>(
+            world_idx, entities[world_idx]).value();
+        EXPECT_EQ(v.x, values[world_idx].x);
+        EXPECT_EQ(v.y, values[world_idx].y);
+    }
+
+    // The export buffers still hold the encoded values
+    EXPECT_EQ(((const int16_t *)export_ptrs[0])[0], 32767);
+    EXPECT_EQ(((const uint16_t *)export_ptrs[1])[0],
+              floatToHalfBits(3.5f));
+}
+
+TEST(StateMW, FixedTableRemoveRow)
+{
+    constexpr uint32_t num_worlds = 3;
+    constexpr int num_entities = 20;
+
+    StateManager state(num_worlds);
+    StateCache cache;
+    ECSRegistry registry(&state, nullptr);
+    registry.registerComponent<Component1>();
+    registry.registerArchetype<Archetype1>();
+
+    DynArray<Entity> entities[num_worlds] {
+        DynArray<Entity>(0), DynArray<Entity>(0), DynArray<Entity>(0),
+    };
+
+    for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+        for (int i = 0; i < num_entities; i++) {
+            Entity e = state.makeEntityNow<Archetype1>(world_idx, cache);
+            state.get<Component1>(world_idx, e).value().v =
+                world_idx * 1000 + i;
+            entities[world_idx].push_back(e);
+        }
+    }
+
+    state.fixTableCapacities(1.f, 0);
+
+    // Removing rows in the middle of worlds other than 0 compacts within
+    // that world's slice
+    for (uint32_t world_idx = 1; world_idx < num_worlds; world_idx++) {
+        for (int i = 0; i < num_entities; i += 3) {
+            state.destroyEntityNow(world_idx, cache, entities[world_idx][i]);
+        }
+    }
+
+    for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+        for (int i = 0; i < num_entities; i++) {
+            Entity e = entities[world_idx][i];
+
+            if (world_idx != 0 && i % 3 == 0) {
+                EXPECT_FALSE(state.getLoc(e).valid());
+                continue;
+            }
+
+            auto c = state.get<Component1>(world_idx, e);
+            EXPECT_TRUE(c.valid());
+            EXPECT_EQ(c.value().v, world_idx * 1000 + i);
+        }
+    }
+
+    auto query = state.query<Component1>();
+    for (uint32_t world_idx = 0; world_idx < num_worlds; world_idx++) {
+        int num_matches = 0;
+        state.iterateQuery(world_idx, query, [&](Component1 &c) {
+            EXPECT_EQ(c.v / 1000, world_idx);
+            num_matches++;
+        });
+
+        EXPECT_EQ(num_matches,
+                  world_idx == 0 ? num_entities : num_entities - 7);
+    }
+}
+
+TEST(StateMW, SharedTemplateWritesStayLocal)
+{
+    constexpr uint32_t num_worlds = 3;
+    constexpr int num_entities = 4;
+
+    StateManager state(num_worlds);
+    StateCache cache;
+    ECSRegistry registry(&state, nullptr);
+    registry.registerComponent<Component1>();
+    registry.registerArchetype<Archetype1>(
+        ComponentMetadataSelector<> {}, ArchetypeFlags::SharedTemplate);
+
+    Entity entities[num_entities];
+    for (int i = 0; i < num_entities; i++) {
+        entities[i] = state.makeEntityNow<Archetype1>(0, cache);
+        state.get<Component1>(0, entities[i]).value().v = i;
+    }
+
+    state.sealSharedTemplates();
+
+    auto read_query = state.query<const Component1, const WorldID>();
+    auto checkWorld = [&](uint32_t world_idx, uint32_t offset) {
+        int num_matches = 0;
+        state.iterateQuery(world_idx, read_query,
+                           [&](const Component1 &c, const WorldID &w) {
+            EXPECT_EQ(c.v, num_matches + offset);
+            EXPECT_EQ(w.idx, (int32_t)world_idx);
+            num_matches++;
+        });
+
+        EXPECT_EQ(num_matches, num_entities);
+    };
+
+    // Every world reads the template rows, with its own WorldID
+    checkWorld(0, 0);
+    checkWorld(1, 0);
+    checkWorld(2, 0);
+
+    auto write_query = state.query<Component1>();
+    state.iterateQuery(1, write_query, [](Component1 &c) {
+        c.v += 100;
+    });
+
+    checkWorld(0, 0);
+    checkWorld(1, 100);
+    checkWorld(2, 0);
+
+    state.get<Component1>(2, entities[0]).value().v = 1000;
+
+    EXPECT_EQ(state.get<const Component1>(0, entities[0]).value().v, 0u);
+    EXPECT_EQ(state.get<const Component1>(1, entities[0]).value().v, 100u);
+    EXPECT_EQ(state.get<const Component1>(2, entities[0]).value().v, 1000u);
+    EXPECT_EQ(state.get<const Component1>(2, entities[1]).value().v, 1u);
+
+    // The row set is shared, changing it from one world is fatal
+    EXPECT_DEATH(state.clear<Archetype1>(1, cache, false), "sealed");
+    EXPECT_DEATH(state.clear<Archetype1>(0, cache, false), "sealed");
+    EXPECT_DEATH(state.makeEntityNow<Archetype1>(2, cache), "sealed");
+
+    checkWorld(0, 0);
+    checkWorld(1, 100);
+}
+
+#endif